@@ -0,0 +1,409 @@
+/*
+ * Numcy/bench/Bench.hh
+ *
+ * The benchmark harness the programs in bench/ share, no dependencies beyond the standard library
+ * (and lib/Perf.hh for hardware counters). A case is warmed up, then repeated until it has run
+ * both a minimum number of times and a minimum time. It reports median and p99 per call, bytes/s
+ * and FLOP/s, as a table or as JSON that can be kept per release and compared.
+ *
+ *     --filter=gemv        only the cases whose name contains "gemv"
+ *     --min-time=0.5       seconds of repetitions per case (default 0.2)
+ *     --reps=30            at least this many repetitions (default 10)
+ *     --warmup=3           calls before timing starts (default 2)
+ *     --json[=file]        JSON to stdout (or to file) instead of the table
+ *     --counters           IPC, LLC miss rate and, given the peaks of the machine (roofline()),
+ *                          memory or compute bound and the fraction of that roof reached per case
+ *
+ * Q@hackers.pk
+ */
+
+#ifndef NUMCY_BENCH_HH
+#define NUMCY_BENCH_HH
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../lib/Perf.hh"
+
+namespace NumcyBench
+{
+    /*
+        Keeps the compiler from deleting the computation of value as dead code
+     */
+    template <typename T>
+    inline void keep(const T& value)
+    {
+#if defined(__GNUC__)
+        __asm__ volatile ("" : : "g"(&value) : "memory");
+#else
+        static volatile const void* sink;
+        sink = &value;
+#endif
+    }
+
+    /*
+        One case, every time per call (a body that makes several calls divides by how many)
+     */
+    struct Result
+    {
+        std::string name;
+        size_t repetitions;
+        double median;  // Seconds
+        double p99;
+        double min;
+        double mean;
+        double bytes;   // Moved per call, 0 when not meaningful
+        double flops;   // Per call, 0 when not meaningful
+        NumcyPerf::Sample counters;  // Per call, with --counters
+        std::string bound;           // "memory" or "compute", with --counters and a roofline
+        double roof;                 // Fraction of that roof reached
+    };
+
+    struct Options
+    {
+        std::string filter;
+        double min_time;
+        size_t min_repetitions;
+        size_t warmup;
+        bool json;
+        std::string json_path;
+        bool counters;
+
+        Options(void) : filter(), min_time(0.2), min_repetitions(10), warmup(2), json(false), json_path(), counters(false)
+        {
+        }
+    };
+
+    inline Options parse(int argc, char** argv)
+    {
+        Options options;
+
+        for (int i = 1; i < argc; i++)
+        {
+            std::string argument = argv[i];
+            std::string value = argument.find('=') == std::string::npos ? "" : argument.substr(argument.find('=') + 1);
+
+            if (argument.rfind("--filter=", 0) == 0)
+            {
+                options.filter = value;
+            }
+            else if (argument.rfind("--min-time=", 0) == 0)
+            {
+                options.min_time = std::atof(value.c_str());
+            }
+            else if (argument.rfind("--reps=", 0) == 0)
+            {
+                options.min_repetitions = std::max(size_t(1), std::strtoul(value.c_str(), nullptr, 10));
+            }
+            else if (argument.rfind("--warmup=", 0) == 0)
+            {
+                options.warmup = std::strtoul(value.c_str(), nullptr, 10);
+            }
+            else if (argument == "--counters")
+            {
+                options.counters = true;
+            }
+            else if (argument.rfind("--json", 0) == 0)
+            {
+                options.json = true;
+                options.json_path = value;
+            }
+            else
+            {
+                std::cerr << "unknown option " << argument << ", see bench/Bench.hh" << std::endl;
+                std::exit(2);
+            }
+        }
+
+        return options;
+    }
+
+    /*
+        p in [0, 1] of sorted, nearest rank
+     */
+    inline double percentile(const std::vector<double>& sorted, double p)
+    {
+        size_t rank = size_t(std::ceil(p * double(sorted.size())));
+
+        return sorted[std::min(sorted.size(), std::max(size_t(1), rank)) - 1];
+    }
+
+    inline std::string escape(const std::string& text)
+    {
+        std::string out;
+
+        for (size_t i = 0; i < text.size(); i++)
+        {
+            if (text[i] == '"' || text[i] == '\\')
+            {
+                out += '\\';
+            }
+
+            out += text[i];
+        }
+
+        return out;
+    }
+
+    /*
+        Harness
+        -------
+            NumcyBench::Harness bench(argc, argv);
+
+            bench.run("scale_host [1024, 1024]", 2.0 * bytes, flops, [&]() { NumcyUtils::scale_host(c, 0.5); });
+            bench.run("Collective copy", 0, 0, [&]() { for (...) { Collective<float> h(c); } }, 1000000);
+
+            return bench.finish();
+
+        run(name, bytes, flops, body, calls)
+        ├─► skipped unless name contains the --filter text
+        ├─► warmup calls of body, untimed (first touch, caches, dispatch resolution)
+        ├─► body timed call by call until min_repetitions and min_time are both reached
+        ├─► calls — how many operations one body() performs, for ops too quick to time one by one
+        └─► --counters, the hardware counters run over all the timed calls
+     */
+    class Harness
+    {
+        Options options;
+        std::vector<Result> results;
+        std::vector<std::pair<std::string, std::string>> context;
+        std::unique_ptr<NumcyPerf::Counters> counters;
+        NumcyPerf::Roofline peaks;
+
+        /*
+            Opened by the first case, so they cover the thread pool it starts
+         */
+        NumcyPerf::Counters& _counters(void)
+        {
+            if (!this->counters)
+            {
+                this->counters.reset(new NumcyPerf::Counters());
+
+                if (!this->counters->isAvailable())
+                {
+                    std::cerr << "no hardware counters, " << this->counters->getError() << std::endl;
+                }
+            }
+
+            return *this->counters;
+        }
+
+        public:
+            Harness(int argc, char** argv) : options(parse(argc, argv)), results(), context(), counters(), peaks()
+            {
+                if (!this->options.json)
+                {
+                    std::cout << std::left << std::setw(52) << "case" << std::right << std::setw(8) << "reps" << std::setw(12) << "median" << std::setw(12) << "p99" << std::setw(12) << "GB/s" << std::setw(12) << "GFLOP/s";
+
+                    if (this->options.counters)
+                    {
+                        std::cout << std::setw(8) << "IPC" << std::setw(10) << "LLC miss" << std::setw(16) << "bound";
+                    }
+
+                    std::cout << std::endl;
+                }
+            }
+
+            bool isProfiling(void) const
+            {
+                return this->options.counters;
+            }
+
+            /*
+                The peaks of the machine every case is held against with --counters, measured by the
+                program (see bench/kernels.cpp), also written to the JSON context
+             */
+            void roofline(const NumcyPerf::Roofline& roof)
+            {
+                this->peaks = roof;
+
+                this->describe("peak bytes/s", std::to_string(roof.bytes_per_s));
+                this->describe("peak flops/s", std::to_string(roof.flops_per_s));
+            }
+
+            /*
+                A key and value written to the JSON next to the results, the machine and build the
+                numbers came from
+             */
+            void describe(const std::string& key, const std::string& value)
+            {
+                this->context.push_back(std::make_pair(key, value));
+            }
+
+            template <typename F>
+            void run(const std::string& name, double bytes, double flops, F body, size_t calls = 1)
+            {
+                if (name.find(this->options.filter) == std::string::npos)
+                {
+                    return;
+                }
+
+                for (size_t i = 0; i < this->options.warmup; i++)
+                {
+                    body();
+                }
+
+                std::vector<double> times;
+                double total = 0.0;
+
+                if (this->options.counters)
+                {
+                    this->_counters().start();
+                }
+
+                while (times.size() < this->options.min_repetitions || total < this->options.min_time)
+                {
+                    auto start = std::chrono::steady_clock::now();
+                    body();
+                    auto stop = std::chrono::steady_clock::now();
+
+                    double seconds = std::chrono::duration<double>(stop - start).count();
+
+                    times.push_back(seconds / double(calls));
+                    total = total + seconds;
+                }
+
+                NumcyPerf::Sample sample;
+
+                if (this->options.counters)
+                {
+                    sample = this->_counters().stop().per(double(times.size() * calls));
+                }
+
+                std::sort(times.begin(), times.end());
+
+                Result result = {name, times.size(), percentile(times, 0.5), percentile(times, 0.99), times.front(), total / double(times.size() * calls), bytes, flops, sample, this->peaks.bound(bytes, flops), 0.0};
+
+                result.roof = this->peaks.efficiency(bytes, flops, result.median);
+
+                this->results.push_back(result);
+
+                if (!this->options.json)
+                {
+                    std::cout << std::left << std::setw(52) << name << std::right << std::setw(8) << result.repetitions << std::setw(12) << format(result.median) << std::setw(12) << format(result.p99) << std::fixed << std::setprecision(2) << std::setw(12) << (bytes > 0.0 ? bytes / result.median * 1e-9 : 0.0) << std::setw(12) << (flops > 0.0 ? flops / result.median * 1e-9 : 0.0);
+
+                    if (this->options.counters)
+                    {
+                        std::ostringstream bound;
+
+                        if (!result.bound.empty())
+                        {
+                            bound << result.bound << " " << std::fixed << std::setprecision(0) << result.roof * 100.0 << "%";
+                        }
+
+                        std::cout << std::setw(8) << (sample.has(NumcyPerf::Cycles) ? std::to_string(sample.ipc()).substr(0, 4) : "-") << std::setw(10) << (sample.has(NumcyPerf::CacheMisses) ? std::to_string(sample.llcMissRate() * 100.0).substr(0, 4) + "%" : "-") << std::setw(16) << (bound.str().empty() ? "-" : bound.str());
+                    }
+
+                    std::cout << std::defaultfloat << std::endl;
+                }
+            }
+
+            /*
+                Seconds with a unit that keeps 3-4 significant digits
+             */
+            static std::string format(double seconds)
+            {
+                std::ostringstream out;
+
+                out << std::fixed << std::setprecision(2);
+
+                if (seconds < 1e-6)
+                {
+                    out << seconds * 1e9 << " ns";
+                }
+                else if (seconds < 1e-3)
+                {
+                    out << seconds * 1e6 << " us";
+                }
+                else
+                {
+                    out << seconds * 1e3 << " ms";
+                }
+
+                return out.str();
+            }
+
+            const std::vector<Result>& getResults(void) const
+            {
+                return this->results;
+            }
+
+            std::string json(void) const
+            {
+                std::ostringstream out;
+
+                out << std::setprecision(9);
+                out << "{\n  \"format\": 1,\n  \"context\": {";
+
+                for (size_t i = 0; i < this->context.size(); i++)
+                {
+                    out << (i == 0 ? "" : ",") << "\n    \"" << escape(this->context[i].first) << "\": \"" << escape(this->context[i].second) << "\"";
+                }
+
+                out << "\n  },\n  \"results\": [";
+
+                for (size_t i = 0; i < this->results.size(); i++)
+                {
+                    const Result& r = this->results[i];
+
+                    out << (i == 0 ? "" : ",") << "\n    {\"name\": \"" << escape(r.name) << "\", \"repetitions\": " << r.repetitions
+                        << ", \"median_s\": " << r.median << ", \"p99_s\": " << r.p99 << ", \"min_s\": " << r.min << ", \"mean_s\": " << r.mean
+                        << ", \"bytes\": " << r.bytes << ", \"flops\": " << r.flops
+                        << ", \"bytes_per_s\": " << (r.bytes > 0.0 ? r.bytes / r.median : 0.0) << ", \"flops_per_s\": " << (r.flops > 0.0 ? r.flops / r.median : 0.0);
+
+                    if (this->options.counters)
+                    {
+                        for (size_t e = 0; e < NumcyPerf::EVENTS; e++)
+                        {
+                            if (r.counters.counted[e])
+                            {
+                                out << ", \"" << NumcyPerf::name(e) << "\": " << r.counters.value[e];
+                            }
+                        }
+
+                        out << ", \"ipc\": " << r.counters.ipc() << ", \"llc_miss_rate\": " << r.counters.llcMissRate() << ", \"bound\": \"" << r.bound << "\", \"roof_fraction\": " << r.roof;
+                    }
+
+                    out << "}";
+                }
+
+                out << "\n  ]\n}\n";
+
+                return out.str();
+            }
+
+            /*
+                The JSON, when asked for, the exit code of main()
+             */
+            int finish(void) const
+            {
+                if (!this->options.json)
+                {
+                    return 0;
+                }
+
+                if (this->options.json_path.empty())
+                {
+                    std::cout << this->json();
+
+                    return 0;
+                }
+
+                std::ofstream file(this->options.json_path);
+                file << this->json();
+
+                return file ? 0 : 1;
+            }
+    };
+}
+
+#endif
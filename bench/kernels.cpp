@@ -0,0 +1,471 @@
+/*
+ * Numcy/bench/kernels.cpp
+ *
+ * Every host kernel through the harness of bench/Bench.hh, one case per kernel and shape. The
+ * JSON output is what is kept per release to catch regressions.
+ *
+ * make bench
+ * bench/kernels.out > bench_output.txt
+ * bench/kernels.out --json=bench.json                 (machine readable)
+ * bench/kernels.out --filter=gemv --min-time=1        (one kernel, longer)
+ * bench/kernels.out --counters                        (IPC, LLC misses, memory or compute bound)
+ *
+ * The io.* cases write their files to the current directory and remove them again.
+ *
+ * Q@hackers.pk
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+
+#include "../header.hh"
+#include "./Bench.hh"
+
+Dimensions<> shape(const std::vector<size_t>& dims)
+{
+    Dimensions<> d;
+    d.fromVector(dims);
+
+    return d;
+}
+
+std::string label(const char* kernel, const std::vector<size_t>& dims)
+{
+    std::string text = std::string(kernel) + " [";
+
+    for (size_t i = 0; i < dims.size(); i++)
+    {
+        text += std::to_string(dims[i]) + (i + 1 < dims.size() ? ", " : "]");
+    }
+
+    return text;
+}
+
+/*
+    The roofline of this machine, the best of a few runs of a parallel triad over arrays far larger
+    than the caches (bytes/s) and of a float GEMM large enough to keep every core busy (FLOP/s)
+ */
+NumcyPerf::Roofline peaks(void)
+{
+    const size_t n = size_t(1) << 22, m = 1024;
+
+    std::vector<double> a(n, 0.0), b(n, 1.0), c(n, 2.0);
+    Collective<float> x = Numcy::astype<float>(NumcyUtils::randn_host<double>(shape({m, m}), 3));
+
+    double triad = 0.0, gemm = 0.0;
+
+    for (size_t run = 0; run < 5; run++)
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        NumcyThreads::parallel_for_static(0, n, 1 << 14, [&](size_t first, size_t last)
+        {
+            for (size_t i = first; i < last; i++)
+            {
+                a[i] = b[i] + 3.0 * c[i];
+            }
+        });
+
+        triad = std::max(triad, 3.0 * double(n) * sizeof(double) / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        NumcyBench::keep(a);
+    }
+
+    for (size_t run = 0; run < 3; run++)
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        Collective<float> r = Numcy::matmul(x, x);
+        NumcyBench::keep(r);
+
+        gemm = std::max(gemm, 2.0 * double(m) * double(m) * double(m) / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    return NumcyPerf::Roofline(triad, gemm);
+}
+
+/*
+    Collective, Dimensions and the utilities every op is built on
+ */
+void core(NumcyBench::Harness& bench)
+{
+    const size_t rows = 1024, columns = 1024;
+    const double elements = double(rows * columns), bytes = elements * sizeof(double);
+
+    Collective<double> c = NumcyUtils::randn_host<double>(shape({rows, columns}), 1);
+
+    bench.run(label("randn_host<double>", {rows, columns}), bytes, 0.0, [&]()
+    {
+        Collective<double> r = NumcyUtils::randn_host<double>(shape({rows, columns}), 2);
+        NumcyBench::keep(r);
+    });
+
+    bench.run(label("scale_host<double>", {rows, columns}), 2.0 * bytes, elements, [&]()
+    {
+        NumcyUtils::scale_host(c, 1.0);
+    });
+
+    bench.run(label("transpose<double>", {rows, columns}), 2.0 * bytes, 0.0, [&]()
+    {
+        Collective<double> t = Numcy::transpose(c);
+        NumcyBench::keep(t);
+    });
+
+    Collective<float> batched = Numcy::astype<float>(NumcyUtils::randn_host<double>(shape({64, 128, 256}), 3));
+
+    bench.run(label("transpose<float>", {64, 128, 256}), 2.0 * 64 * 128 * 256 * sizeof(float), 0.0, [&]()
+    {
+        Collective<float> t = Numcy::transpose(batched);
+        NumcyBench::keep(t);
+    });
+
+    bench.run("Collective copy (reference count)", 0.0, 0.0, [&]()
+    {
+        for (size_t i = 0; i < 1000000; i++)
+        {
+            Collective<double> handle(c);
+            NumcyBench::keep(handle);
+        }
+    }, 1000000);
+
+    bench.run(label("astype<double> (deep copy)", {rows, columns}), 2.0 * bytes, 0.0, [&]()
+    {
+        Collective<double> copy = Numcy::astype<double>(c);
+        NumcyBench::keep(copy);
+    });
+
+    Dimensions<> d = shape({8, 16, 32, 64});
+
+    bench.run("Dimensions::numel [8, 16, 32, 64]", 0.0, 0.0, [&]()
+    {
+        for (size_t i = 0; i < 1000000; i++)
+        {
+            size_t n = d.numel();
+            NumcyBench::keep(n);
+        }
+    }, 1000000);
+
+    bench.run("Dimensions::reshape [8, 16, 32, 64]", 0.0, 0.0, [&]()
+    {
+        for (size_t i = 0; i < 10000; i++)
+        {
+            d.reshape({128, 32, 64});
+            d.reshape({8, 16, 32, 64});
+        }
+    }, 20000);
+}
+
+/*
+    GEMM, batched GEMM, gemv and the similarity scan, top-k
+ */
+void linear(NumcyBench::Harness& bench)
+{
+    for (size_t n : {size_t(128), size_t(512)})
+    {
+        Collective<float> a = Numcy::astype<float>(NumcyUtils::randn_host<double>(shape({n, n}), 4));
+        Collective<double> b = NumcyUtils::randn_host<double>(shape({n, n}), 5);
+        double flops = 2.0 * double(n) * double(n) * double(n);
+
+        bench.run(label("matmul<float>", {n, n, n}), 3.0 * double(n * n) * sizeof(float), flops, [&]()
+        {
+            Collective<float> r = Numcy::matmul(a, a);
+            NumcyBench::keep(r);
+        });
+
+        bench.run(label("matmul<double>", {n, n, n}), 3.0 * double(n * n) * sizeof(double), flops, [&]()
+        {
+            Collective<double> r = Numcy::matmul(b, b);
+            NumcyBench::keep(r);
+        });
+    }
+
+    Collective<float> q = Numcy::astype<float>(NumcyUtils::randn_host<double>(shape({16, 128, 64}), 6));
+    Collective<float> k = Numcy::astype<float>(NumcyUtils::randn_host<double>(shape({16, 64, 128}), 7));
+
+    bench.run(label("bmatmul<float>", {16, 128, 64, 128}), 3.0 * 16 * 128 * 128 * sizeof(float), 2.0 * 16 * 128 * 128 * 64, [&]()
+    {
+        Collective<float> r = Numcy::bmatmul(q, k);
+        NumcyBench::keep(r);
+    });
+
+    const size_t n = 100000, dim = 300;
+
+    Collective<float> table = Numcy::astype<float>(NumcyUtils::randn_host<double>(shape({n, dim}), 8));
+    Collective<float> query = Numcy::astype<float>(NumcyUtils::randn_host<double>(shape({1, dim}), 9));
+    Collective<float> norms = Numcy::row_norms(table);
+    double table_bytes = double(n * dim) * sizeof(float);
+
+    bench.run(label("gemv<float>", {n, dim}), table_bytes, 2.0 * double(n * dim), [&]()
+    {
+        Collective<float> r = Numcy::gemv(table, query);
+        NumcyBench::keep(r);
+    });
+
+    bench.run(label("row_norms<float>", {n, dim}), table_bytes, 2.0 * double(n * dim), [&]()
+    {
+        Collective<float> r = Numcy::row_norms(table);
+        NumcyBench::keep(r);
+    });
+
+    bench.run(label("cosine_similarity<float>", {1, n, dim}), table_bytes, 2.0 * double(n * dim), [&]()
+    {
+        Collective<float> r = Numcy::cosine_similarity(query, table, norms);
+        NumcyBench::keep(r);
+    });
+
+    Collective<float> scores = Numcy::astype<float>(NumcyUtils::randn_host<double>(shape({1, 1000000}), 10));
+
+    bench.run(label("topk<float> k=10", {1, 1000000}), 1000000.0 * sizeof(float), 0.0, [&]()
+    {
+        std::pair<Collective<float>, Collective<size_t>> r = Numcy::topk(scores, size_t(10));
+        NumcyBench::keep(r);
+    });
+
+    const float* x = table.getData();
+    const float* y = table.getData() + n * dim / 2;
+
+    bench.run("NumcyGemm::dot<float> [15000000]", 2.0 * double(n * dim / 2) * sizeof(float), 2.0 * double(n * dim / 2), [&]()
+    {
+        float r = NumcyGemm::dot<float>(n * dim / 2, x, y);
+        NumcyBench::keep(r);
+    });
+}
+
+/*
+    16 bit types and int8
+ */
+void precision(NumcyBench::Harness& bench)
+{
+    const size_t n = 100000, dim = 300;
+    double elements = double(n * dim);
+
+    Collective<float> table = Numcy::astype<float>(NumcyUtils::randn_host<double>(shape({n, dim}), 11));
+    Collective<numcy::bfloat16> bf16 = Numcy::astype<numcy::bfloat16>(table);
+    Collective<numcy::float16> fp16 = Numcy::astype<numcy::float16>(table);
+    Collective<numcy::bfloat16> bf16_query = Numcy::astype<numcy::bfloat16>(Numcy::astype<float>(NumcyUtils::randn_host<double>(shape({1, dim}), 12)));
+
+    bench.run(label("astype float -> bfloat16", {n, dim}), elements * 6.0, 0.0, [&]()
+    {
+        Collective<numcy::bfloat16> r = Numcy::astype<numcy::bfloat16>(table);
+        NumcyBench::keep(r);
+    });
+
+    bench.run(label("astype float -> float16", {n, dim}), elements * 6.0, 0.0, [&]()
+    {
+        Collective<numcy::float16> r = Numcy::astype<numcy::float16>(table);
+        NumcyBench::keep(r);
+    });
+
+    bench.run(label("astype float16 -> float", {n, dim}), elements * 6.0, 0.0, [&]()
+    {
+        Collective<float> r = Numcy::astype<float>(fp16);
+        NumcyBench::keep(r);
+    });
+
+    bench.run(label("gemv<bfloat16>", {n, dim}), elements * 2.0, 2.0 * elements, [&]()
+    {
+        Collective<numcy::bfloat16> r = Numcy::gemv(bf16, bf16_query);
+        NumcyBench::keep(r);
+    });
+
+    const size_t m = 512;
+
+    Collective<float> a = Numcy::astype<float>(NumcyUtils::randn_host<double>(shape({m, m}), 13));
+    NumcyQuant::Quantized<size_t> qa = Numcy::quantize(a);
+
+    bench.run(label("quantize<float> per row", {m, m}), double(m * m) * 5.0, 0.0, [&]()
+    {
+        NumcyQuant::Quantized<size_t> r = Numcy::quantize(a);
+        NumcyBench::keep(r);
+    });
+
+    bench.run(label("qmatmul", {m, m, m}), double(m * m) * 6.0, 2.0 * double(m * m * m), [&]()
+    {
+        Collective<float> r = Numcy::qmatmul(qa, qa);
+        NumcyBench::keep(r);
+    });
+}
+
+/*
+    Fused graph execution and the autograd tape
+ */
+void graphs(NumcyBench::Harness& bench)
+{
+    const size_t rows = 1024, columns = 1024;
+
+    Collective<float> x = Numcy::astype<float>(NumcyUtils::randn_host<double>(shape({rows, columns}), 14));
+    Collective<float> bias = Numcy::astype<float>(NumcyUtils::randn_host<double>(shape({1, columns}), 15));
+
+    Numcy::Graph<float> g;
+    size_t in = g.input(x), b = g.input(bias);
+    size_t out = g.sum(g.relu(g.add(g.scale(in, 0.5f), b)));
+    NumcyLazy::Program<float, size_t> program = g.compile({out});
+
+    bench.run(label("Graph sum(relu(x * s + b)) fused", {rows, columns}), double(rows * columns) * sizeof(float), 4.0 * double(rows * columns), [&]()
+    {
+        std::vector<Collective<float>> r = program.run();
+        NumcyBench::keep(r);
+    });
+
+    const size_t batch = 256, width = 512;
+
+    Collective<float> input = Numcy::astype<float>(NumcyUtils::randn_host<double>(shape({batch, width}), 16));
+    Collective<float> w = Numcy::astype<float>(NumcyUtils::randn_host<double>(shape({width, width}), 17));
+    Collective<float> wb = Numcy::astype<float>(NumcyUtils::randn_host<double>(shape({1, width}), 18));
+
+    bench.run(label("Tape forward + backward, dense + relu", {batch, width, width}), 0.0, 3.0 * 2.0 * double(batch * width * width), [&]()
+    {
+        NumcyAutograd::Tape<float> tape;
+        size_t t_x = tape.constant(input), t_w = tape.variable(w), t_b = tape.variable(wb);
+        size_t y = tape.relu(tape.add(tape.matmul(t_x, t_w), t_b));
+
+        tape.backward(tape.mean(tape.mul(y, y)));
+        NumcyBench::keep(tape.grad(t_w));
+    });
+}
+
+/*
+    Files, in the current directory
+ */
+void io(NumcyBench::Harness& bench)
+{
+    const size_t rows = 8192, columns = 1024;
+    double bytes = double(rows * columns) * sizeof(float);
+
+    Collective<float> c = Numcy::astype<float>(NumcyUtils::randn_host<double>(shape({rows, columns}), 19));
+
+    bench.run(label("io.save", {rows, columns}), bytes, 0.0, [&]()
+    {
+        Numcy::save("bench_tmp.ncy", c);
+    });
+
+    bench.run(label("io.load mmap", {rows, columns}), 0.0, 0.0, [&]()
+    {
+        Collective<float> r = Numcy::load<float>("bench_tmp.ncy");
+        NumcyBench::keep(r);
+    });
+
+    bench.run(label("io.load copy + verify", {rows, columns}), bytes, 0.0, [&]()
+    {
+        Collective<float> r = Numcy::load<float>("bench_tmp.ncy", numcy::Mapping::Copy, true);
+        NumcyBench::keep(r);
+    });
+
+    Numcy::save_npy("bench_tmp.npy", c);
+
+    bench.run(label("io.load_npy copy", {rows, columns}), bytes, 0.0, [&]()
+    {
+        Collective<float> r = Numcy::load_npy<float>("bench_tmp.npy", numcy::Mapping::Copy);
+        NumcyBench::keep(r);
+    });
+
+    bench.run(label("io.StreamReader 256 rows", {rows, columns}), bytes, 0.0, [&]()
+    {
+        Numcy::StreamReader<float> stream("bench_tmp.npy", 256);
+        Collective<float> batch;
+
+        while (stream.next(batch))
+        {
+            NumcyBench::keep(batch);
+        }
+    });
+
+    bench.run(label("io.checkpoint commit 4 MB chunks", {rows, columns}), bytes, 0.0, [&]()
+    {
+        Numcy::CheckpointWriter writer("bench_tmp.ckpt", size_t(4) << 20);
+        writer.add("c", c);
+        writer.commit();
+    });
+
+    // A 16 MB CSV, 17 significant digits, what a full precision dump looks like
+    {
+        std::ofstream csv("bench_tmp.csv");
+        const float* data = c.getData();
+
+        csv.precision(9);
+
+        for (size_t i = 0; i < 16384 && csv; i++)
+        {
+            for (size_t j = 0; j < 64; j++)
+            {
+                csv << data[i * 64 + j] << (j + 1 < 64 ? ',' : '\n');
+            }
+        }
+    }
+
+    std::ifstream probe("bench_tmp.csv", std::ios::binary | std::ios::ate);
+    double csv_bytes = double(probe.tellg());
+
+    bench.run("io.from_csv<float> [16384, 64]", csv_bytes, 0.0, [&]()
+    {
+        Collective<float> r = Numcy::from_csv<float>("bench_tmp.csv");
+        NumcyBench::keep(r);
+    });
+
+    std::remove("bench_tmp.ncy");
+    std::remove("bench_tmp.npy");
+    std::remove("bench_tmp.csv");
+
+    try
+    {
+        NumcyCheckpoint::Index index = NumcyCheckpoint::parse("bench_tmp.ckpt/index");
+
+        for (size_t s = 0; s < index.shards; s++)
+        {
+            std::remove(NumcyCheckpoint::shardPath("bench_tmp.ckpt", index.tag, s).c_str());
+        }
+
+        std::remove("bench_tmp.ckpt/index");
+        std::remove("bench_tmp.ckpt");
+    }
+    catch (std::runtime_error&)
+    {
+        // The checkpoint case was filtered out
+    }
+}
+
+int main(int argc, char** argv)
+{
+    NumcyBench::Harness bench(argc, argv);
+
+    try
+    {
+        if (bench.isProfiling())
+        {
+            bench.roofline(peaks());
+        }
+
+        core(bench);
+        linear(bench);
+        precision(bench);
+        graphs(bench);
+        io(bench);
+    }
+    catch (std::runtime_error& e)
+    {
+        std::cerr << e.what() << std::endl;
+
+        return 1;
+    }
+
+    bench.describe("isa", NumcyCpu::name(NumcyCpu::isa()));
+    bench.describe("threads", std::to_string(Numcy::ThreadPool::global().getNumberOfThreads()));
+#if defined(__VERSION__)
+    bench.describe("compiler", __VERSION__);
+#endif
+
+    std::vector<std::pair<std::string, std::string>> kernels = NumcyCpu::Registry::global().entries();
+
+    for (size_t i = 0; i < kernels.size(); i++)
+    {
+        bench.describe("kernel " + kernels[i].first, kernels[i].second);
+    }
+
+    return bench.finish();
+}
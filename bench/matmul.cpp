@@ -0,0 +1,125 @@
+/*
+ * Numcy/bench/matmul.cpp
+ *
+ * GFLOP/s of Numcy::matmul() over square, tall-skinny and small shapes, float and double,
+ * and of Numcy::bmatmul() over attention shaped batches.
+ *
+ * g++ -std=c++17 -O2 -march=native -pthread bench/matmul.cpp -o matmul.out
+ * ./matmul.out > bench_output.txt
+ *
+ * Q@hackers.pk
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+
+#include "../header.hh"
+
+/*
+    Runs C = A * B enough times to cover at least ~0.2 s (and at least 3 repetitions),
+    then reports the best repetition, best-of is the usual way to filter out scheduler noise.
+ */
+template <typename T>
+void bench(const char* label, size_t m, size_t k, size_t n)
+{
+    Collective<T> a = NumcyUtils::randn_host<T>(Dimensions<>(k, m), 1);
+    Collective<T> b = NumcyUtils::randn_host<T>(Dimensions<>(n, k), 2);
+
+    double flops = 2.0 * static_cast<double>(m) * static_cast<double>(n) * static_cast<double>(k);
+    double best = std::numeric_limits<double>::max();
+    double total = 0.0;
+    size_t repetitions = 0;
+
+    while (repetitions < 3 || total < 0.2)
+    {
+        auto start = std::chrono::steady_clock::now();
+        Collective<T> c = Numcy::matmul(a, b);
+        auto stop = std::chrono::steady_clock::now();
+
+        double seconds = std::chrono::duration<double>(stop - start).count();
+
+        best = std::min(best, seconds);
+        total = total + seconds;
+        repetitions++;
+    }
+
+    std::cout << label << " " << (sizeof(T) == sizeof(float) ? "float " : "double") << " "
+              << m << "x" << k << " * " << k << "x" << n << " : "
+              << flops / best * 1e-9 << " GFLOP/s (best of " << repetitions << ")" << std::endl;
+}
+
+/*
+    Attention shaped batched product, [batch, heads, seq, d] * [batch, heads, d, seq],
+    and the same with B broadcast over the batch, [1, heads, d, seq].
+ */
+template <typename T>
+void bench_batched(const char* label, size_t batch, size_t heads, size_t seq, size_t d, bool broadcast)
+{
+    Dimensions<> da, db;
+    da.fromVector({batch, heads, seq, d});
+    db.fromVector({broadcast ? 1 : batch, heads, d, seq});
+
+    Collective<T> a = NumcyUtils::randn_host<T>(da, 1);
+    Collective<T> b = NumcyUtils::randn_host<T>(db, 2);
+
+    double flops = 2.0 * static_cast<double>(batch * heads) * static_cast<double>(seq) * static_cast<double>(seq) * static_cast<double>(d);
+    double best = std::numeric_limits<double>::max();
+    double total = 0.0;
+    size_t repetitions = 0;
+
+    while (repetitions < 3 || total < 0.2)
+    {
+        auto start = std::chrono::steady_clock::now();
+        Collective<T> c = Numcy::bmatmul(a, b);
+        auto stop = std::chrono::steady_clock::now();
+
+        double seconds = std::chrono::duration<double>(stop - start).count();
+
+        best = std::min(best, seconds);
+        total = total + seconds;
+        repetitions++;
+    }
+
+    std::cout << label << " " << (sizeof(T) == sizeof(float) ? "float " : "double") << " "
+              << "[" << batch << ", " << heads << ", " << seq << ", " << d << "] * "
+              << "[" << (broadcast ? 1 : batch) << ", " << heads << ", " << d << ", " << seq << "] : "
+              << flops / best * 1e-9 << " GFLOP/s (best of " << repetitions << ")" << std::endl;
+}
+
+int main(void)
+{
+    size_t square[] = {64, 128, 256, 512, 1024};
+    size_t small[] = {4, 8, 16, 32};
+
+    for (size_t s : square)
+    {
+        bench<double>("square     ", s, s, s);
+        bench<float>("square     ", s, s, s);
+    }
+
+    // Tall-skinny, e.g. a long sequence of tokens through a narrow projection
+    bench<double>("tall-skinny", 65536, 64, 64);
+    bench<float>("tall-skinny", 65536, 64, 64);
+    bench<double>("tall-skinny", 16384, 300, 16);
+    bench<float>("tall-skinny", 16384, 300, 16);
+    bench<double>("tall-skinny", 64, 16384, 64);
+    bench<float>("tall-skinny", 64, 16384, 64);
+
+    for (size_t s : small)
+    {
+        bench<double>("small      ", s, s, s);
+        bench<float>("small      ", s, s, s);
+    }
+
+    bench_batched<float>("batched    ", 8, 12, 128, 64, false);
+    bench_batched<float>("batched    ", 8, 12, 128, 64, true);
+    bench_batched<float>("batched    ", 2, 4, 512, 64, false);
+    bench_batched<double>("batched    ", 8, 12, 128, 64, false);
+    bench_batched<double>("batched    ", 8, 12, 128, 64, true);
+
+    return 0;
+}
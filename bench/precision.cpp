@@ -0,0 +1,127 @@
+/*
+ * Numcy/bench/precision.cpp
+ *
+ * The same embedding table as double, float, bfloat16 and float16: bytes it takes, GB/s of
+ * the conversion kernels, GB/s of a gemv/cosine scan over it and GFLOP/s of a matmul with it.
+ * The 16 bit scans stream a quarter of the bytes of the double one for the same rows.
+ *
+ * g++ -std=c++17 -O2 -pthread bench/precision.cpp -o precision.out
+ * ./precision.out > bench_output.txt
+ * NUMCY_ISA=avx2 ./precision.out     (the AVX2 kernels on an AVX-512 machine)
+ *
+ * Q@hackers.pk
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+
+#include "../header.hh"
+
+template <typename F>
+double best_of(F run)
+{
+    double best = std::numeric_limits<double>::max();
+    double total = 0.0;
+    size_t repetitions = 0;
+
+    while (repetitions < 3 || total < 0.5)
+    {
+        auto start = std::chrono::steady_clock::now();
+        run();
+        auto stop = std::chrono::steady_clock::now();
+
+        double seconds = std::chrono::duration<double>(stop - start).count();
+
+        best = std::min(best, seconds);
+        total = total + seconds;
+        repetitions++;
+    }
+
+    return best;
+}
+
+template <typename T>
+const char* name(void)
+{
+    if (std::is_same<T, numcy::bfloat16>::value) return "bfloat16";
+    if (std::is_same<T, numcy::float16>::value)  return "float16 ";
+    if (std::is_same<T, float>::value)           return "float   ";
+
+    return "double  ";
+}
+
+/*
+    table is the double table converted to T, so every type scans the same values
+ */
+template <typename T>
+void bench(const Collective<double>& source, size_t m)
+{
+    size_t n = source.getShape().getNumberOfRows();
+    size_t d = source.getShape().getNumberOfColumns();
+
+    Collective<T> table = Numcy::astype<T>(source);
+    Collective<T> query = Numcy::astype<T>(NumcyUtils::randn_host<double>(Dimensions<>(d, 1), 2));
+    Collective<T> norms = Numcy::row_norms(table);
+    Collective<T> batch = Numcy::astype<T>(NumcyUtils::randn_host<double>(Dimensions<>(d, m), 3));
+
+    double bytes = static_cast<double>(n * d * sizeof(T));
+    double flops = 2.0 * static_cast<double>(m) * static_cast<double>(d) * 1024.0;
+
+    std::cout << name<T>() << " table [" << n << ", " << d << "] : " << bytes * 1e-6 << " MB" << std::endl;
+
+    double seconds = best_of([&]() { Collective<T> y = Numcy::gemv(table, query); });
+    std::cout << name<T>() << " gemv                : " << bytes / seconds * 1e-9 << " GB/s, " << seconds * 1e3 << " ms" << std::endl;
+
+    seconds = best_of([&]() { Collective<T> s = Numcy::cosine_similarity(query, table, norms); });
+    std::cout << name<T>() << " cosine_similarity   : " << bytes / seconds * 1e-9 << " GB/s, " << seconds * 1e3 << " ms" << std::endl;
+
+    Collective<T> weights = Numcy::transpose(Numcy::astype<T>(NumcyUtils::randn_host<double>(Dimensions<>(d, 1024), 4)));
+
+    seconds = best_of([&]() { Collective<T> c = Numcy::matmul(batch, weights); });
+    std::cout << name<T>() << " matmul " << m << "x" << d << " * " << d << "x1024 : " << flops / seconds * 1e-9 << " GFLOP/s" << std::endl;
+}
+
+/*
+    float ↔ T, GB/s counted over the bytes read plus the bytes written
+ */
+template <typename T>
+void bench_conversion(size_t n)
+{
+    Collective<float> wide = NumcyUtils::randn_host<float>(Dimensions<>(n, 1), 5);
+    Collective<T> narrow = Numcy::astype<T>(wide);
+
+    double bytes = static_cast<double>(n * (sizeof(float) + sizeof(T)));
+
+    double seconds = best_of([&]() { NumcyHalf::convert(wide.getData(), narrow.getData(), n); });
+    std::cout << name<T>() << " convert from float  : " << bytes / seconds * 1e-9 << " GB/s" << std::endl;
+
+    seconds = best_of([&]() { NumcyHalf::convert(narrow.getData(), wide.getData(), n); });
+    std::cout << name<T>() << " convert to float    : " << bytes / seconds * 1e-9 << " GB/s" << std::endl;
+}
+
+int main(void)
+{
+    Collective<double> table = NumcyUtils::randn_host<double>(Dimensions<>(300, 250000), 1);
+
+    bench<double>(table, 256);
+    bench<float>(table, 256);
+    bench<numcy::bfloat16>(table, 256);
+    bench<numcy::float16>(table, 256);
+
+    bench_conversion<numcy::bfloat16>(1 << 24);
+    bench_conversion<numcy::float16>(1 << 24);
+
+    std::cout << "isa " << NumcyCpu::name(NumcyCpu::isa()) << std::endl;
+
+    for (const auto& entry : NumcyCpu::Registry::global().entries())
+    {
+        std::cout << "    " << entry.first << " : " << entry.second << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,78 @@
+/*
+ * Numcy/bench/similarity.cpp
+ *
+ * Nearest neighbour style query of one embedding against an [N, 300] table.
+ * Reports GB/s of table streamed, the scan is memory bound so this is the number to compare
+ * against the machine's memory bandwidth.
+ *
+ * g++ -std=c++17 -O2 -march=native -pthread bench/similarity.cpp -o similarity.out
+ * ./similarity.out > bench_output.txt
+ *
+ * Q@hackers.pk
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+
+#include "../header.hh"
+
+template <typename F>
+double best_of(F run)
+{
+    double best = std::numeric_limits<double>::max();
+    double total = 0.0;
+    size_t repetitions = 0;
+
+    while (repetitions < 3 || total < 0.5)
+    {
+        auto start = std::chrono::steady_clock::now();
+        run();
+        auto stop = std::chrono::steady_clock::now();
+
+        double seconds = std::chrono::duration<double>(stop - start).count();
+
+        best = std::min(best, seconds);
+        total = total + seconds;
+        repetitions++;
+    }
+
+    return best;
+}
+
+template <typename T>
+void bench(size_t n, size_t d, size_t k)
+{
+    Collective<T> table = NumcyUtils::randn_host<T>(Dimensions<>(d, n), 1);
+    Collective<T> query = NumcyUtils::randn_host<T>(Dimensions<>(d, 1), 2);
+    Collective<T> norms = Numcy::row_norms(table);
+
+    double bytes = static_cast<double>(n * d * sizeof(T));
+    const char* type = sizeof(T) == sizeof(float) ? "float " : "double";
+
+    double seconds = best_of([&]() { Collective<T> y = Numcy::gemv(table, query); });
+    std::cout << "gemv              " << type << " [" << n << ", " << d << "] : " << bytes / seconds * 1e-9 << " GB/s" << std::endl;
+
+    seconds = best_of([&]() { Collective<T> s = Numcy::cosine_similarity(query, table, norms); });
+    std::cout << "cosine_similarity " << type << " [" << n << ", " << d << "] : " << bytes / seconds * 1e-9 << " GB/s" << std::endl;
+
+    seconds = best_of([&]() { Collective<T> v; Collective<size_t, size_t> i; Numcy::cosine_similarity(query, table, norms, k, v, i); });
+    std::cout << "cosine top-" << k << "      " << type << " [" << n << ", " << d << "] : " << bytes / seconds * 1e-9 << " GB/s" << std::endl;
+
+    Collective<T> scores = Numcy::cosine_similarity(query, table, norms);
+    double score_bytes = static_cast<double>(n * sizeof(T));
+
+    seconds = best_of([&]() { auto r = Numcy::topk(scores, k); });
+    std::cout << "topk-" << k << "           " << type << " [1, " << n << "] : " << score_bytes / seconds * 1e-9 << " GB/s" << std::endl;
+}
+
+int main(void)
+{
+    bench<float>(1000000, 300, 10);
+    bench<double>(250000, 300, 10);
+
+    return 0;
+}
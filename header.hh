@@ -18,15 +18,35 @@
 
 #include "./lib/Axis.hh"
 #include "./lib/MemoryLocation.hh"
+#include "./lib/Cpu.hh" // CPU feature detection and kernel dispatch
+#include "./lib/Half.hh" // bfloat16 and float16 element types
+#include "./lib/Numa.hh" // NUMA topology, page placement and pinning
+#include "./lib/ThreadPool.hh" // Worker threads of every host kernel
 
 #include "./lib/DimensionsProperties.hh"
-#include "./lib/CollectiveProperties.hh"
+#include "./lib/DimensionsCache.hh" // Interned shapes, shared by every Dimensions of a shape
 #include "./lib/Dimensions.hh"
+#include "./lib/Memory.hh" // Live/peak bytes and allocation sites of collectives
+#include "./lib/CollectiveProperties.hh"
 #include "./lib/Collective.hh"
+#include "./lib/StaticCollective.hh" // Compile-time shapes, inline storage, unrolled kernels
+#include "./lib/Trace.hh" // Per-op tracing, compiled in with -DNUMCY_TRACE
+#include "./lib/Perf.hh" // Hardware performance counters, roofline
 
 #include "./lib/kernels.hh"
+#include "./lib/Gemm.hh" // Host GEMM engine
+#include "./lib/Quantize.hh" // int8 quantization and the int8 matrix product
+#include "./lib/TopK.hh"
+#include "./lib/Async.hh" // Dependency scheduler of Numcy::async()
+#include "./lib/Graph.hh" // Deferred execution, fusion and memory planning
+#include "./lib/Serialize.hh" // Binary save/load, mmap backed loading
+#include "./lib/Npy.hh" // NumPy .npy/.npz files
+#include "./lib/Stream.hh" // Read-ahead batches of on-disk arrays
+#include "./lib/Checkpoint.hh" // Sharded checkpoints, parallel chunk writes
+#include "./lib/Csv.hh" // Parallel numeric CSV/TSV parsing
 #include "./lib/NumcyUtils.hh" // Helper functions
 #include "./lib/Numcy.hh"
+#include "./lib/Autograd.hh" // Reverse-mode autodiff tape
 
 #endif
 
@@ -0,0 +1,90 @@
+/*
+ * Numcy/lib/Async.hh
+ *
+ * Dependency scheduler behind Numcy::async(). An op is queued on the thread pool once every
+ * collective it depends on is ready, its result is a pending Collective handed out right away.
+ *
+ * Q@hackers.pk
+ */
+
+#ifndef NUMCY_ASYNC_HH
+#define NUMCY_ASYNC_HH
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <type_traits>
+
+namespace NumcyAsync
+{
+    /*
+        One scheduled op, shared by the continuations registered on its dependencies
+        ├─► waiting — dependencies not ready yet, plus one held by schedule() itself while it is
+        │             still registering, so that the op cannot start before every dependency is seen
+        ├─► op      — returns the Collective<T, E> that result becomes
+        └─► result  — the pending handle schedule() returned
+     */
+    template <typename R, typename F>
+    struct Node
+    {
+        std::atomic<size_t> waiting;
+        F op;
+        R result;
+
+        Node(F f, R placeholder, size_t dependencies) : waiting(dependencies + 1), op(f), result(placeholder)
+        {
+        }
+    };
+
+    /*
+        Drops one dependency of node, the last one queues the op on the thread pool
+     */
+    template <typename R, typename F>
+    void release(std::shared_ptr<Node<R, F>> node)
+    {
+        if (node->waiting.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        {
+            return;
+        }
+
+        NumcyThreads::ThreadPool::global().submit([node]()
+        {
+            try
+            {
+                R value = node->op();
+
+                node->result.resolve(value);
+            }
+            catch (...)
+            {
+                node->result.fail(std::current_exception());
+            }
+        });
+    }
+
+    /*
+        schedule(op, dependencies...)
+        ├─► result = a pending Collective, returned immediately
+        ├─► every dependency (any Collective) gets a continuation, the op waits for all of them
+        ├─► then op() runs on the thread pool and its return value resolves result, an exception
+        │   thrown by op (or by reading a dependency that failed) fails result instead
+        └─► a thread that reads result before then blocks in getData()/operator[]/getShape()
+     */
+    template <typename F, typename... Dependencies>
+    auto schedule(F op, const Dependencies&... dependencies) -> typename std::decay<decltype(op())>::type
+    {
+        typedef typename std::decay<decltype(op())>::type R;
+
+        R result = R::pending();
+        std::shared_ptr<Node<R, F>> node = std::make_shared<Node<R, F>>(op, result, sizeof...(dependencies));
+
+        (dependencies.whenReady([node]() { release(node); }), ...);
+
+        release(node);
+
+        return result;
+    }
+}
+
+#endif
@@ -0,0 +1,630 @@
+/*
+ * Numcy/lib/Autograd.hh
+ *
+ * Reverse-mode automatic differentiation. Ops run eagerly through Numcy and, on a
+ * NumcyAutograd::Tape, also record how to push a gradient back to their operands. backward()
+ * replays those records in reverse. Included after Numcy.hh, the ops it records are Numcy's.
+ *
+ * Q@hackers.pk
+ */
+
+#ifndef NUMCY_AUTOGRAD_HH
+#define NUMCY_AUTOGRAD_HH
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace NumcyAutograd
+{
+    /*
+        One value on the tape
+        ├─► value         — the forward result, released once backward() no longer needs it
+        ├─► grad          — d(loss)/d(value), accumulated in place by every consumer
+        ├─► requires_grad — false for constants and for anything computed from constants only
+        ├─► leaf          — made by variable()/constant(), its value and grad outlive backward()
+        └─► backward      — pushes grad to the operands, holds the activations it saved, empty for leaves
+     */
+    template <typename T, typename E>
+    struct Node
+    {
+        Collective<T, E> value;
+        Collective<T, E> grad;
+        bool requires_grad;
+        bool leaf;
+        std::function<void(Collective<T, E>&)> backward;
+
+        Node(const Collective<T, E>& v, bool requires, bool is_leaf) : value(v), grad(), requires_grad(requires), leaf(is_leaf), backward()
+        {
+        }
+    };
+
+    /*
+        Tape
+        ----
+        Ids are handed out in execution order, so the reverse of that order visits every consumer of
+        a value before the value itself and its gradient is complete by the time it is pushed on.
+
+            NumcyAutograd::Tape<double> tape;
+
+            size_t x = tape.constant(batch);
+            size_t w = tape.variable(weights);
+            size_t b = tape.variable(bias);                        // [1, n], broadcast over the rows
+            size_t y = tape.relu(tape.add(tape.matmul(x, w), b));
+            size_t loss = tape.mean(tape.mul(y, y));
+
+            tape.backward(loss);
+            tape.grad(w);                                          // d(loss)/d(weights), same shape as weights
+
+        Memory
+        ├─► an op records a backward step only when one of its operands requires a gradient
+        ├─► gradients are accumulated in place, GEMM with beta = 1 for matmul, += for the rest
+        ├─► a gradient buffer that arrives at an elementwise op is reused for the operand's gradient
+        │   (relu, scale, add, sub, mul) instead of allocating a new one
+        ├─► backward() frees each intermediate's gradient, saved activations and value as soon as its
+        │   backward step has run, only leaves and the loss survive
+        └─► checkpoint() stores a segment's output only, its activations are recomputed during backward()
+
+        A tape is good for one backward(), make a new one per training step. Variables share the
+        buffers of the collectives they were made from, the caller may update those in place after
+        backward().
+     */
+    template <typename T = double, typename E = size_t>
+    class Tape
+    {
+        std::vector<Node<T, E>> nodes;
+
+        Node<T, E>& _at(size_t id, const char* caller)
+        {
+            if (id >= this->nodes.size())
+            {
+                throw std::runtime_error(std::string("NumcyAutograd::Tape<T, E>::") + caller + " Error: unknown value id");
+            }
+
+            return this->nodes[id];
+        }
+
+        size_t _record(const Collective<T, E>& value, bool requires_grad, bool leaf)
+        {
+            this->nodes.push_back(Node<T, E>(value, requires_grad, leaf));
+
+            return this->nodes.size() - 1;
+        }
+
+        static Collective<T, E> _allocate(const Dimensions<E>& shape)
+        {
+            T* data = new T[shape.numel()];
+
+            try
+            {
+                return Collective<T, E>(data, shape, MemoryLocation::Host);
+            }
+            catch (...)
+            {
+                delete[] data;
+                throw;
+            }
+        }
+
+        /*
+            Adds contribution(dy[i], i) to the gradient of node id, element by element
+            ├─► no gradient yet, reuse = true  → dy's buffer becomes the gradient, written in place,
+            │                                    the caller must not read dy after this
+            ├─► no gradient yet, reuse = false → a new buffer
+            └─► gradient already there        → += into it
+         */
+        template <typename F>
+        void _contribute(size_t id, Collective<T, E>& dy, bool reuse, F contribution)
+        {
+            Node<T, E>& node = this->nodes[id];
+
+            if (!node.requires_grad)
+            {
+                return;
+            }
+
+            bool fresh = node.grad.isEmpty();
+
+            if (fresh)
+            {
+                node.grad = reuse ? dy : _allocate(node.value.getShape());
+            }
+
+            T* g = node.grad.getData();
+            const T* d = dy.getData();
+
+            NumcyThreads::parallel_for_static(0, node.value.getShape().numel(), NumcyThreads::ThreadPool::global().getSerialThreshold(), [=](size_t first, size_t last)
+            {
+                for (size_t i = first; i < last; i++)
+                {
+                    g[i] = fresh ? contribution(d[i], i) : g[i] + contribution(d[i], i);
+                }
+            });
+        }
+
+        bool _requiresGrad(size_t a, size_t b) const
+        {
+            return this->nodes[a].requires_grad || this->nodes[b].requires_grad;
+        }
+
+        /*
+            add()/sub() with sign = +1/-1, b is either the shape of a or a row [1, n] broadcast over
+            the rows of a (a bias), whose gradient is then the column sums of dy
+         */
+        size_t _addOrSub(size_t a, size_t b, T sign, const char* caller)
+        {
+            const Collective<T, E> x = this->_at(a, caller).value;
+            const Collective<T, E> y = this->_at(b, caller).value;
+
+            size_t numel = x.getShape().numel();
+            size_t columns = x.getShape().getNumberOfColumns();
+            bool same = x.getShape() == y.getShape();
+
+            if (!same && !(y.getShape().numel() == columns && y.getShape().getNumberOfColumns() == columns))
+            {
+                throw std::runtime_error(std::string("NumcyAutograd::Tape<T, E>::") + caller + " Error: b must have the shape of a or be a row [1, n] with n the last axis of a");
+            }
+
+            Collective<T, E> out = _allocate(x.getShape());
+            const T* p = x.getData();
+            const T* q = y.getData();
+            T* o = out.getData();
+
+            NumcyThreads::parallel_for_static(0, numel, NumcyThreads::ThreadPool::global().getSerialThreshold(), [=](size_t first, size_t last)
+            {
+                for (size_t i = first; i < last; i++)
+                {
+                    o[i] = p[i] + sign * q[same ? i : i % columns];
+                }
+            });
+
+            size_t id = this->_record(out, this->_requiresGrad(a, b), false);
+
+            if (this->nodes[id].requires_grad)
+            {
+                this->nodes[id].backward = [this, a, b, sign, same, numel, columns](Collective<T, E>& dy)
+                {
+                    if (same)
+                    {
+                        this->_contribute(b, dy, false, [sign](T d, size_t) { return sign * d; });
+                    }
+                    else if (this->nodes[b].requires_grad)
+                    {
+                        Node<T, E>& bias = this->nodes[b];
+                        bool fresh = bias.grad.isEmpty();
+
+                        if (fresh)
+                        {
+                            bias.grad = _allocate(bias.value.getShape());
+                        }
+
+                        T* g = bias.grad.getData();
+                        const T* d = dy.getData();
+
+                        for (size_t j = 0; j < columns; j++)
+                        {
+                            g[j] = fresh ? T(0) : g[j];
+                        }
+
+                        for (size_t i = 0; i < numel; i++)
+                        {
+                            g[i % columns] += sign * d[i];
+                        }
+                    }
+
+                    this->_contribute(a, dy, true, [](T d, size_t) { return d; });
+                };
+            }
+
+            return id;
+        }
+
+    public:
+        Tape(void) : nodes()
+        {
+        }
+
+        Tape(const Tape<T, E>&) = delete;
+        Tape<T, E>& operator=(const Tape<T, E>&) = delete;
+
+        /*
+            A leaf whose gradient backward() computes, shares the buffer of c
+         */
+        size_t variable(const Collective<T, E>& c, bool requires_grad = true)
+        {
+            if (c.getMemoryLocation() != MemoryLocation::Host)
+            {
+                throw std::runtime_error("NumcyAutograd::Tape<T, E>::variable(const Collective<T, E>&, bool) Error: only host collectives are supported");
+            }
+
+            return this->_record(c, requires_grad, true);
+        }
+
+        /*
+            A leaf without a gradient, inputs and targets
+         */
+        size_t constant(const Collective<T, E>& c)
+        {
+            return this->variable(c, false);
+        }
+
+        /*
+            [..., m, k] x [k, n] → [..., m, n], backward is Numcy::matmul_backward()'s pair of GEMMs,
+            each writing straight into the operand's gradient (beta = 1 once it exists)
+         */
+        size_t matmul(size_t a, size_t b)
+        {
+            try
+            {
+                const Collective<T, E> x = this->_at(a, "matmul(size_t, size_t)").value;
+                const Collective<T, E> w = this->_at(b, "matmul(size_t, size_t)").value;
+
+                size_t id = this->_record(Numcy::matmul(x, w), this->_requiresGrad(a, b), false);
+
+                if (this->nodes[id].requires_grad)
+                {
+                    this->nodes[id].backward = [this, a, b, x, w](Collective<T, E>& dy)
+                    {
+                        if (this->nodes[a].requires_grad)
+                        {
+                            Collective<T, E>& da = this->nodes[a].grad;
+
+                            Numcy::matmul(dy, w, false, true, T(1), da.isEmpty() ? T(0) : T(1), da); // dA = dC * B^T
+                        }
+
+                        if (this->nodes[b].requires_grad)
+                        {
+                            Collective<T, E>& db = this->nodes[b].grad;
+
+                            Numcy::matmul(x, dy, true, false, T(1), db.isEmpty() ? T(0) : T(1), db); // dB = A^T * dC
+                        }
+                    };
+                }
+
+                return id;
+            }
+            catch (std::runtime_error& e)
+            {
+                throw std::runtime_error(std::string("NumcyAutograd::Tape<T, E>::matmul(size_t, size_t) -> ") + e.what());
+            }
+        }
+
+        size_t add(size_t a, size_t b) { return this->_addOrSub(a, b, T(1), "add(size_t, size_t)"); }
+        size_t sub(size_t a, size_t b) { return this->_addOrSub(a, b, T(-1), "sub(size_t, size_t)"); }
+
+        /*
+            Elementwise product of two values of the same shape
+         */
+        size_t mul(size_t a, size_t b)
+        {
+            const Collective<T, E> x = this->_at(a, "mul(size_t, size_t)").value;
+            const Collective<T, E> y = this->_at(b, "mul(size_t, size_t)").value;
+
+            if (x.getShape() != y.getShape())
+            {
+                throw std::runtime_error("NumcyAutograd::Tape<T, E>::mul(size_t, size_t) Error: operands must have the same shape");
+            }
+
+            Collective<T, E> out = _allocate(x.getShape());
+            const T* p = x.getData();
+            const T* q = y.getData();
+            T* o = out.getData();
+
+            NumcyThreads::parallel_for_static(0, x.getShape().numel(), NumcyThreads::ThreadPool::global().getSerialThreshold(), [=](size_t first, size_t last)
+            {
+                for (size_t i = first; i < last; i++)
+                {
+                    o[i] = p[i] * q[i];
+                }
+            });
+
+            size_t id = this->_record(out, this->_requiresGrad(a, b), false);
+
+            if (this->nodes[id].requires_grad)
+            {
+                this->nodes[id].backward = [this, a, b, x, y](Collective<T, E>& dy)
+                {
+                    const T* u = x.getData();
+                    const T* v = y.getData();
+
+                    this->_contribute(b, dy, false, [u](T d, size_t i) { return d * u[i]; });
+                    this->_contribute(a, dy, true, [v](T d, size_t i) { return d * v[i]; });
+                };
+            }
+
+            return id;
+        }
+
+        /*
+            max(x, 0), saves its output, the gradient passes where the output is positive
+         */
+        size_t relu(size_t a)
+        {
+            const Collective<T, E> x = this->_at(a, "relu(size_t)").value;
+            Collective<T, E> out = _allocate(x.getShape());
+            const T* p = x.getData();
+            T* o = out.getData();
+
+            NumcyThreads::parallel_for_static(0, x.getShape().numel(), NumcyThreads::ThreadPool::global().getSerialThreshold(), [=](size_t first, size_t last)
+            {
+                for (size_t i = first; i < last; i++)
+                {
+                    o[i] = p[i] > T(0) ? p[i] : T(0);
+                }
+            });
+
+            size_t id = this->_record(out, this->nodes[a].requires_grad, false);
+
+            if (this->nodes[id].requires_grad)
+            {
+                this->nodes[id].backward = [this, a, out](Collective<T, E>& dy)
+                {
+                    const T* y = out.getData();
+
+                    this->_contribute(a, dy, true, [y](T d, size_t i) { return y[i] > T(0) ? d : T(0); });
+                };
+            }
+
+            return id;
+        }
+
+        /*
+            x * s
+         */
+        size_t scale(size_t a, T s)
+        {
+            const Collective<T, E> x = this->_at(a, "scale(size_t, T)").value;
+            Collective<T, E> out = _allocate(x.getShape());
+            const T* p = x.getData();
+            T* o = out.getData();
+
+            NumcyThreads::parallel_for_static(0, x.getShape().numel(), NumcyThreads::ThreadPool::global().getSerialThreshold(), [=](size_t first, size_t last)
+            {
+                for (size_t i = first; i < last; i++)
+                {
+                    o[i] = p[i] * s;
+                }
+            });
+
+            size_t id = this->_record(out, this->nodes[a].requires_grad, false);
+
+            if (this->nodes[id].requires_grad)
+            {
+                this->nodes[id].backward = [this, a, s](Collective<T, E>& dy)
+                {
+                    this->_contribute(a, dy, true, [s](T d, size_t) { return d * s; });
+                };
+            }
+
+            return id;
+        }
+
+        /*
+            Sum of every element, a [1, 1] value
+         */
+        size_t sum(size_t a)
+        {
+            return this->_total(a, false, "sum(size_t)");
+        }
+
+        /*
+            Mean of every element, a [1, 1] value
+         */
+        size_t mean(size_t a)
+        {
+            return this->_total(a, true, "mean(size_t)");
+        }
+
+        /*
+            Gradient checkpointing
+            ----------------------
+            segment(tape, inputs) records a stretch of the model on a tape of its own, with inputs[i]
+            standing for this tape's inputs[i]. Only its output is kept here, every activation inside
+            the segment is freed as soon as the forward pass leaves it. backward() records the
+            segment again from the same inputs and back-propagates through that copy, trading one
+            extra forward pass of the segment for its activations.
+
+                size_t h = tape.checkpoint([](NumcyAutograd::Tape<double>& t, const std::vector<size_t>& in)
+                {
+                    return t.relu(t.add(t.matmul(in[0], in[1]), in[2]));
+                }, {x, w1, b1});
+
+            segment must be deterministic and must not reach values of this tape other than through
+            inputs.
+         */
+        size_t checkpoint(std::function<size_t(Tape<T, E>&, const std::vector<size_t>&)> segment, const std::vector<size_t>& inputs)
+        {
+            Collective<T, E> out;
+            bool requires_grad = false;
+
+            {
+                Tape<T, E> inner;
+                std::vector<size_t> ids;
+
+                for (size_t i = 0; i < inputs.size(); i++)
+                {
+                    const Node<T, E>& input = this->_at(inputs[i], "checkpoint(std::function<size_t(Tape<T, E>&, const std::vector<size_t>&)>, const std::vector<size_t>&)");
+
+                    ids.push_back(inner.variable(input.value, input.requires_grad));
+                    requires_grad = requires_grad || input.requires_grad;
+                }
+
+                out = inner.value(segment(inner, ids));
+            }
+
+            size_t id = this->_record(out, requires_grad, false);
+
+            if (requires_grad)
+            {
+                this->nodes[id].backward = [this, segment, inputs](Collective<T, E>& dy)
+                {
+                    Tape<T, E> inner;
+                    std::vector<size_t> ids;
+
+                    for (size_t i = 0; i < inputs.size(); i++)
+                    {
+                        ids.push_back(inner.variable(this->nodes[inputs[i]].value, this->nodes[inputs[i]].requires_grad));
+                    }
+
+                    inner._backward(segment(inner, ids), dy);
+
+                    for (size_t i = 0; i < inputs.size(); i++)
+                    {
+                        Collective<T, E> g = inner.grad(ids[i]);
+
+                        if (!g.isEmpty())
+                        {
+                            // The inner tape is gone after this step, its gradient buffers are handed over rather than copied
+                            this->_contribute(inputs[i], g, true, [](T d, size_t) { return d; });
+                        }
+                    }
+                };
+            }
+
+            return id;
+        }
+
+        /*
+            backward(loss), loss must hold a single element, its gradient starts at 1
+         */
+        void backward(size_t loss)
+        {
+            if (this->_at(loss, "backward(size_t)").value.getShape().numel() != 1)
+            {
+                throw std::runtime_error("NumcyAutograd::Tape<T, E>::backward(size_t) Error: loss must hold a single element, pass a seed gradient for anything else");
+            }
+
+            Collective<T, E> seed = _allocate(this->nodes[loss].value.getShape());
+            seed[0] = T(1);
+
+            this->_backward(loss, seed);
+        }
+
+        /*
+            backward(output, seed), the gradient of output starts at a copy of seed (same shape)
+         */
+        void backward(size_t output, const Collective<T, E>& seed)
+        {
+            const Collective<T, E>& value = this->_at(output, "backward(size_t, const Collective<T, E>&)").value;
+
+            if (seed.getShape().numel() != value.getShape().numel())
+            {
+                throw std::runtime_error("NumcyAutograd::Tape<T, E>::backward(size_t, const Collective<T, E>&) Error: seed must have the shape of the output");
+            }
+
+            Collective<T, E> copy = _allocate(value.getShape());
+            std::memcpy(copy.getData(), seed.getData(), value.getShape().numel() * sizeof(T));
+
+            this->_backward(output, copy);
+        }
+
+        /*
+            The forward value of id, intermediates read as empty once backward() has run
+         */
+        const Collective<T, E>& value(size_t id)
+        {
+            return this->_at(id, "value(size_t)").value;
+        }
+
+        /*
+            d(output)/d(id) after backward(), empty when no gradient reached id or id is an intermediate
+         */
+        const Collective<T, E>& grad(size_t id)
+        {
+            return this->_at(id, "grad(size_t)").grad;
+        }
+
+        size_t getNumberOfNodes(void) const
+        {
+            return this->nodes.size();
+        }
+
+    private:
+        size_t _total(size_t a, bool average, const char* caller)
+        {
+            const Collective<T, E> x = this->_at(a, caller).value;
+            size_t numel = x.getShape().numel();
+            const T* p = x.getData();
+            T total = T(0);
+
+            for (size_t i = 0; i < numel; i++)
+            {
+                total += p[i];
+            }
+
+            T factor = average ? T(1) / T(numel) : T(1);
+
+            Collective<T, E> out = _allocate(Dimensions<E>(1, 1));
+            out[0] = total * factor;
+
+            size_t id = this->_record(out, this->nodes[a].requires_grad, false);
+
+            if (this->nodes[id].requires_grad)
+            {
+                this->nodes[id].backward = [this, a, factor](Collective<T, E>& dy)
+                {
+                    T d = dy[0] * factor;
+                    Node<T, E>& node = this->nodes[a];
+
+                    if (node.grad.isEmpty())
+                    {
+                        node.grad = _allocate(node.value.getShape());
+
+                        std::fill(node.grad.getData(), node.grad.getData() + node.value.getShape().numel(), d);
+                    }
+                    else
+                    {
+                        T* g = node.grad.getData();
+
+                        for (size_t i = 0; i < node.value.getShape().numel(); i++)
+                        {
+                            g[i] += d;
+                        }
+                    }
+                };
+            }
+
+            return id;
+        }
+
+        /*
+            Reverse sweep from output, every step takes its node's gradient out of the node (it is
+            complete, all consumers have higher ids) and runs, then the step and its saved
+            activations are dropped and so is the value unless it is a leaf or output itself
+         */
+        void _backward(size_t output, Collective<T, E>& seed)
+        {
+            this->nodes[output].grad = seed;
+
+            for (size_t i = output + 1; i-- > 0;)
+            {
+                Node<T, E>& node = this->nodes[i];
+
+                if (node.leaf)
+                {
+                    continue;
+                }
+
+                if (node.backward && !node.grad.isEmpty())
+                {
+                    Collective<T, E> dy = node.grad;
+                    node.grad = Collective<T, E>();
+
+                    node.backward(dy);
+                }
+
+                node.grad = Collective<T, E>();
+                node.backward = nullptr;
+
+                if (i != output)
+                {
+                    node.value = Collective<T, E>();
+                }
+            }
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,723 @@
+/*
+ * Numcy/lib/Checkpoint.hh
+ *
+ * Sharded checkpoints. A checkpoint is a directory, the tensors are cut into chunks that the
+ * thread pool writes in parallel into several shard files, an index file says where every chunk
+ * went. The index is renamed into place last, a reader sees the previous checkpoint or the new
+ * one, never half of one.
+ *
+ * Q@hackers.pk
+ */
+
+#ifndef NUMCY_CHECKPOINT_HH
+#define NUMCY_CHECKPOINT_HH
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace NumcyCheckpoint
+{
+    constexpr size_t DEFAULT_CHUNK_BYTES = size_t(64) << 20;
+    constexpr uint32_t FORMAT_VERSION = 1;
+
+    /*
+        Layout of a checkpoint directory
+        ├─► index                 text, written last (renamed over the previous one)
+        │     numcy-checkpoint 1
+        │     shards <tag> <count>
+        │     tensor <name> <dtype> <element size> <rank> <d0> ... <dn-1> <chunks>
+        │     chunk <shard> <offset> <bytes> <checksum, 0 when not computed>
+        │     ...
+        │     end <checksum of every line before this one>
+        └─► <tag>.<i>.shard       chunks back to back, <tag> is new for every commit so the shards
+                                  of the previous checkpoint stay intact until the index no
+                                  longer names them
+     */
+    struct Chunk
+    {
+        size_t shard;
+        size_t offset;
+        size_t bytes;
+        uint64_t checksum;
+    };
+
+    struct Tensor
+    {
+        std::string name;
+        uint32_t dtype;
+        size_t element_size;
+        std::vector<uint64_t> shape;
+        std::vector<Chunk> chunks;
+
+        Tensor(void) : name(), dtype(0), element_size(0), shape(), chunks()
+        {
+        }
+
+        Tensor(const std::string& n, uint32_t type, size_t size, const std::vector<uint64_t>& dims) : name(n), dtype(type), element_size(size), shape(dims), chunks()
+        {
+        }
+    };
+
+    struct Index
+    {
+        std::string tag;
+        size_t shards;
+        std::vector<Tensor> tensors;
+
+        Index(void) : tag(), shards(0), tensors()
+        {
+        }
+    };
+
+    inline std::string shardPath(const std::string& directory, const std::string& tag, size_t shard)
+    {
+        return directory + "/" + tag + "." + std::to_string(shard) + ".shard";
+    }
+
+    inline std::string format(const Index& index)
+    {
+        std::ostringstream out;
+
+        out << "numcy-checkpoint " << FORMAT_VERSION << "\n";
+        out << "shards " << index.tag << " " << index.shards << "\n";
+
+        for (size_t t = 0; t < index.tensors.size(); t++)
+        {
+            const Tensor& tensor = index.tensors[t];
+
+            out << "tensor " << tensor.name << " " << tensor.dtype << " " << tensor.element_size << " " << tensor.shape.size();
+
+            for (size_t i = 0; i < tensor.shape.size(); i++)
+            {
+                out << " " << tensor.shape[i];
+            }
+
+            out << " " << tensor.chunks.size() << "\n";
+
+            for (size_t c = 0; c < tensor.chunks.size(); c++)
+            {
+                out << "chunk " << tensor.chunks[c].shard << " " << tensor.chunks[c].offset << " " << tensor.chunks[c].bytes << " " << tensor.chunks[c].checksum << "\n";
+            }
+        }
+
+        std::string text = out.str();
+
+        return text + "end " + std::to_string(NumcySerialize::checksumBlock(reinterpret_cast<const unsigned char*>(text.data()), text.size())) + "\n";
+    }
+
+    /*
+        The index at path, throws when it is missing, of another version or does not match its
+        own checksum
+     */
+    inline Index parse(const std::string& path)
+    {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+
+        if (!file)
+        {
+            throw std::runtime_error("cannot open " + path);
+        }
+
+        std::string text(size_t(file.tellg()), '\0');
+
+        file.seekg(0);
+        file.read(&text[0], std::streamsize(text.size()));
+        size_t end = text.rfind("end ");
+
+        if (end == std::string::npos || std::to_string(NumcySerialize::checksumBlock(reinterpret_cast<const unsigned char*>(text.data()), end)) + "\n" != text.substr(end + 4))
+        {
+            throw std::runtime_error(path + " is incomplete or corrupt");
+        }
+
+        std::istringstream in(text.substr(0, end));
+        std::string word;
+        uint32_t version = 0;
+        Index index;
+
+        if (!(in >> word >> version) || word != "numcy-checkpoint" || version != FORMAT_VERSION)
+        {
+            throw std::runtime_error(path + " is not a checkpoint index of version " + std::to_string(FORMAT_VERSION));
+        }
+
+        in >> word >> index.tag >> index.shards;
+
+        while (in >> word)
+        {
+            if (word == "tensor")
+            {
+                Tensor tensor;
+                size_t rank = 0, chunks = 0;
+
+                in >> tensor.name >> tensor.dtype >> tensor.element_size >> rank;
+                tensor.shape.resize(rank);
+
+                for (size_t i = 0; i < rank; i++)
+                {
+                    in >> tensor.shape[i];
+                }
+
+                in >> chunks;
+                tensor.chunks.resize(chunks);
+
+                for (size_t c = 0; c < chunks; c++)
+                {
+                    in >> word >> tensor.chunks[c].shard >> tensor.chunks[c].offset >> tensor.chunks[c].bytes >> tensor.chunks[c].checksum;
+                }
+
+                index.tensors.push_back(tensor);
+            }
+        }
+
+        if (in.bad())
+        {
+            throw std::runtime_error(path + " is malformed");
+        }
+
+        return index;
+    }
+
+    /*
+        Writes n bytes at offset of a shard, pwrite() on an open descriptor or, without POSIX I/O,
+        a stream of its own per call
+     */
+    inline void _writeAt(int fd, const std::string& path, const void* data, size_t n, size_t offset)
+    {
+#if defined(NUMCY_MMAP)
+        for (size_t done = 0; done < n; )
+        {
+            ssize_t put = pwrite(fd, static_cast<const char*>(data) + done, n - done, off_t(offset + done));
+
+            if (put <= 0)
+            {
+                throw std::runtime_error("write to " + path + " failed");
+            }
+
+            done = done + size_t(put);
+        }
+#else
+        (void)fd;
+
+        std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+
+        file.seekp(std::streamoff(offset));
+        file.write(static_cast<const char*>(data), std::streamsize(n));
+        file.flush();
+
+        if (!file)
+        {
+            throw std::runtime_error("write to " + path + " failed");
+        }
+#endif
+    }
+
+    inline void _readAt(int fd, const std::string& path, void* data, size_t n, size_t offset)
+    {
+#if defined(NUMCY_MMAP)
+        for (size_t done = 0; done < n; )
+        {
+            ssize_t got = pread(fd, static_cast<char*>(data) + done, n - done, off_t(offset + done));
+
+            if (got <= 0)
+            {
+                throw std::runtime_error("read of " + path + " failed");
+            }
+
+            done = done + size_t(got);
+        }
+#else
+        (void)fd;
+
+        std::ifstream file(path, std::ios::binary);
+
+        file.seekg(std::streamoff(offset));
+
+        if (!file.read(static_cast<char*>(data), std::streamsize(n)))
+        {
+            throw std::runtime_error("read of " + path + " failed");
+        }
+#endif
+    }
+
+    /*
+        Writer
+        ------
+            NumcyCheckpoint::Writer checkpoint("ckpt/step-1000");
+            checkpoint.add("embedding", embedding);
+            checkpoint.add("layer0.w", w0);
+            checkpoint.commit();
+
+        ├─► add() keeps a handle of the collective, nothing is written until commit()
+        ├─► commit()
+        │     ├─► every tensor cut into chunks of chunk_bytes, chunk j of the whole checkpoint goes
+        │     │   to shard j % shards, shards defaults to the number of pool threads
+        │     ├─► the chunks are written with pwrite() by the thread pool, checksummed on the way
+        │     │   when checksums is set, every shard fsync()ed
+        │     ├─► the index is written to a temporary file, fsync()ed and renamed to index
+        │     └─► the shards of the checkpoint the old index named are removed. A Reader opened on
+        │         it holds its shards open and keeps reading them.
+        └─► a commit that throws removes what it wrote, the previous checkpoint stays as it was
+
+        Names are single words, the index is split on white space.
+     */
+    class Writer
+    {
+        struct Pending
+        {
+            std::string name;
+            uint32_t dtype;
+            size_t element_size;
+            std::vector<uint64_t> shape;
+            const unsigned char* data;
+            size_t bytes;
+            std::shared_ptr<void> keep; // The collective handle, data stays alive until commit()
+        };
+
+        std::string directory;
+        size_t chunk_bytes;
+        size_t shards;
+        bool checksums;
+        std::vector<Pending> pending;
+
+        static std::string _tag(void)
+        {
+            uint64_t now = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+            std::ostringstream out;
+
+            out << std::hex << now;
+#if defined(NUMCY_MMAP)
+            out << "-" << getpid();
+#endif
+            return out.str();
+        }
+
+        public:
+            explicit Writer(const std::string& path, size_t bytes_per_chunk = DEFAULT_CHUNK_BYTES, size_t shard_count = 0, bool checksum_chunks = true) : directory(path), chunk_bytes(bytes_per_chunk), shards(shard_count), checksums(checksum_chunks), pending()
+            {
+                if (bytes_per_chunk == 0)
+                {
+                    throw std::runtime_error("NumcyCheckpoint::Writer::Writer(const std::string&, size_t, size_t, bool) Error: chunk size is 0");
+                }
+            }
+
+            template <typename T, typename E>
+            void add(const std::string& name, const Collective<T, E>& c)
+            {
+                static_assert(std::is_trivially_copyable<T>::value, "NumcyCheckpoint::Writer::add(): the element type must be trivially copyable");
+
+                if (name.empty() || name.find_first_of(" \t\r\n") != std::string::npos)
+                {
+                    throw std::runtime_error("NumcyCheckpoint::Writer::add(const std::string&, const Collective<T, E>&) Error: name \"" + name + "\" is empty or has white space");
+                }
+
+                if (c.isEmpty() || c.getMemoryLocation() != MemoryLocation::Host)
+                {
+                    throw std::runtime_error("NumcyCheckpoint::Writer::add(const std::string&, const Collective<T, E>&) Error: only host collectives are supported");
+                }
+
+                std::vector<E> dims = c.getShape().toVector();
+
+                Pending entry = {name, uint32_t(NumcySerialize::TypeOf<T>::value), sizeof(T), std::vector<uint64_t>(dims.begin(), dims.end()), reinterpret_cast<const unsigned char*>(c.getData()), c.getShape().numel() * sizeof(T), std::make_shared<Collective<T, E>>(c)};
+
+                this->pending.push_back(entry);
+            }
+
+            void commit(void)
+            {
+                Index index;
+                std::vector<int> descriptors;
+                std::vector<const unsigned char*> sources;
+                std::string temporary;
+
+                index.tag = _tag();
+                temporary = this->directory + "/index." + index.tag + ".tmp";
+
+                // Cut into chunks, chunk j of the checkpoint to shard j % shards
+                size_t total = 0;
+
+                for (size_t t = 0; t < this->pending.size(); t++)
+                {
+                    total = total + (this->pending[t].bytes + this->chunk_bytes - 1) / this->chunk_bytes;
+                }
+
+                index.shards = std::max(size_t(1), std::min(total, this->shards != 0 ? this->shards : NumcyThreads::ThreadPool::global().getNumberOfThreads()));
+
+                std::vector<size_t> shard_bytes(index.shards, 0);
+                std::vector<Chunk*> chunks;
+
+                for (size_t t = 0, j = 0; t < this->pending.size(); t++)
+                {
+                    const Pending& p = this->pending[t];
+                    Tensor tensor(p.name, p.dtype, p.element_size, p.shape);
+
+                    for (size_t at = 0; at < p.bytes; at += this->chunk_bytes, j++)
+                    {
+                        size_t shard = j % index.shards, bytes = std::min(this->chunk_bytes, p.bytes - at);
+
+                        tensor.chunks.push_back(Chunk{shard, shard_bytes[shard], bytes, 0});
+                        shard_bytes[shard] = shard_bytes[shard] + bytes;
+                    }
+
+                    index.tensors.push_back(tensor);
+                }
+
+                for (size_t t = 0; t < index.tensors.size(); t++)
+                {
+                    for (size_t c = 0; c < index.tensors[t].chunks.size(); c++)
+                    {
+                        chunks.push_back(&index.tensors[t].chunks[c]);
+                        sources.push_back(this->pending[t].data + c * this->chunk_bytes);
+                    }
+                }
+
+                try
+                {
+#if defined(NUMCY_MMAP)
+                    if (mkdir(this->directory.c_str(), 0777) != 0 && errno != EEXIST)
+                    {
+                        throw std::runtime_error("cannot create " + this->directory);
+                    }
+#endif
+                    // Shards created at their final size, the chunks land anywhere in them
+                    for (size_t s = 0; s < index.shards; s++)
+                    {
+                        std::string path = shardPath(this->directory, index.tag, s);
+#if defined(NUMCY_MMAP)
+                        int fd = open(path.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0644);
+
+                        if (fd < 0 || ftruncate(fd, off_t(shard_bytes[s])) != 0)
+                        {
+                            if (fd >= 0)
+                            {
+                                close(fd);
+                            }
+
+                            throw std::runtime_error("cannot create " + path);
+                        }
+
+                        descriptors.push_back(fd);
+#else
+                        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+
+                        if (!file)
+                        {
+                            throw std::runtime_error("cannot create " + path);
+                        }
+
+                        descriptors.push_back(-1);
+#endif
+                    }
+
+                    const std::string& directory_path = this->directory;
+                    const std::string& tag = index.tag;
+                    bool checksum_chunks = this->checksums;
+
+                    NumcyThreads::parallel_for(0, chunks.size(), 1, [&, checksum_chunks](size_t first, size_t last)
+                    {
+                        for (size_t j = first; j < last; j++)
+                        {
+                            Chunk& chunk = *chunks[j];
+
+                            if (checksum_chunks)
+                            {
+                                chunk.checksum = NumcySerialize::checksum(sources[j], chunk.bytes);
+                            }
+
+                            _writeAt(descriptors[chunk.shard], shardPath(directory_path, tag, chunk.shard), sources[j], chunk.bytes, chunk.offset);
+                        }
+                    });
+
+#if defined(NUMCY_MMAP)
+                    NumcyThreads::parallel_for(0, descriptors.size(), 1, [&](size_t first, size_t last)
+                    {
+                        for (size_t s = first; s < last; s++)
+                        {
+                            if (fsync(descriptors[s]) != 0)
+                            {
+                                throw std::runtime_error("fsync() of " + shardPath(directory_path, tag, s) + " failed");
+                            }
+                        }
+                    });
+#endif
+                    // The commit point, index replaced in one rename()
+                    std::string text = format(index);
+                    std::string path = this->directory + "/index";
+                    Index previous;
+                    bool replaces = true;
+
+                    try
+                    {
+                        previous = parse(path);
+                    }
+                    catch (std::runtime_error&)
+                    {
+                        replaces = false;
+                    }
+#if defined(NUMCY_MMAP)
+                    int fd = open(temporary.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0644);
+
+                    if (fd < 0)
+                    {
+                        throw std::runtime_error("cannot create " + temporary);
+                    }
+
+                    bool written = ::write(fd, text.data(), text.size()) == ssize_t(text.size()) && fsync(fd) == 0;
+
+                    close(fd);
+
+                    if (!written)
+                    {
+                        throw std::runtime_error("write to " + temporary + " failed");
+                    }
+#else
+                    {
+                        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+
+                        file.write(text.data(), std::streamsize(text.size()));
+                        file.flush();
+
+                        if (!file)
+                        {
+                            throw std::runtime_error("write to " + temporary + " failed");
+                        }
+                    }
+
+                    std::remove(path.c_str()); // rename() does not replace outside POSIX
+#endif
+                    if (std::rename(temporary.c_str(), path.c_str()) != 0)
+                    {
+                        throw std::runtime_error("rename() of " + temporary + " failed");
+                    }
+#if defined(NUMCY_MMAP)
+                    int directory_fd = open(this->directory.c_str(), O_RDONLY);
+
+                    if (directory_fd >= 0)
+                    {
+                        fsync(directory_fd);
+                        close(directory_fd);
+                    }
+#endif
+                    for (size_t s = 0; replaces && previous.tag != index.tag && s < previous.shards; s++)
+                    {
+                        std::remove(shardPath(this->directory, previous.tag, s).c_str());
+                    }
+                }
+                catch (std::runtime_error& e)
+                {
+                    this->_abandon(descriptors, index, temporary);
+                    throw std::runtime_error("NumcyCheckpoint::Writer::commit() -> " + std::string(e.what()));
+                }
+                catch (...)
+                {
+                    this->_abandon(descriptors, index, temporary);
+                    throw std::runtime_error("NumcyCheckpoint::Writer::commit() Error: Unknown exception");
+                }
+
+                for (size_t s = 0; s < descriptors.size(); s++)
+                {
+#if defined(NUMCY_MMAP)
+                    close(descriptors[s]);
+#endif
+                }
+
+                this->pending.clear();
+            }
+
+        private:
+            void _abandon(const std::vector<int>& descriptors, const Index& index, const std::string& temporary)
+            {
+                for (size_t s = 0; s < descriptors.size(); s++)
+                {
+#if defined(NUMCY_MMAP)
+                    close(descriptors[s]);
+#endif
+                    std::remove(shardPath(this->directory, index.tag, s).c_str());
+                }
+
+                std::remove(temporary.c_str());
+            }
+    };
+
+    /*
+        Reader
+        ------
+            NumcyCheckpoint::Reader checkpoint("ckpt/step-1000");
+            Collective<float> w0 = checkpoint.get<float>("layer0.w");
+
+        ├─► the constructor reads the index and opens every shard it names, what it reads is that
+        │   checkpoint even if a Writer commits a newer one meanwhile
+        └─► get<T, E>(name, verify) reads the chunks in parallel into one buffer, verify (default)
+            checks every chunk against its checksum
+     */
+    class Reader
+    {
+        std::string directory;
+        Index index;
+        std::vector<int> descriptors;
+
+        public:
+            explicit Reader(const std::string& path) : directory(path), index(), descriptors()
+            {
+                try
+                {
+                    this->index = parse(path + "/index");
+
+                    for (size_t s = 0; s < this->index.shards; s++)
+                    {
+#if defined(NUMCY_MMAP)
+                        std::string shard = shardPath(path, this->index.tag, s);
+                        int fd = open(shard.c_str(), O_RDONLY);
+
+                        if (fd < 0)
+                        {
+                            throw std::runtime_error("cannot open " + shard);
+                        }
+
+                        this->descriptors.push_back(fd);
+#else
+                        this->descriptors.push_back(-1);
+#endif
+                    }
+                }
+                catch (std::runtime_error& e)
+                {
+                    this->_close();
+                    throw std::runtime_error("NumcyCheckpoint::Reader::Reader(const std::string&) -> " + std::string(e.what()));
+                }
+            }
+
+            Reader(const Reader&) = delete;
+            Reader& operator=(const Reader&) = delete;
+
+            ~Reader()
+            {
+                this->_close();
+            }
+
+            std::vector<std::string> names(void) const
+            {
+                std::vector<std::string> all;
+
+                for (size_t t = 0; t < this->index.tensors.size(); t++)
+                {
+                    all.push_back(this->index.tensors[t].name);
+                }
+
+                return all;
+            }
+
+            template <typename T = double, typename E = size_t>
+            Collective<T, E> get(const std::string& name, bool verify = true) const
+            {
+                const Tensor* tensor = nullptr;
+
+                for (size_t t = 0; t < this->index.tensors.size() && tensor == nullptr; t++)
+                {
+                    tensor = this->index.tensors[t].name == name ? &this->index.tensors[t] : nullptr;
+                }
+
+                if (tensor == nullptr)
+                {
+                    throw std::runtime_error("NumcyCheckpoint::Reader::get(const std::string&, bool) Error: no tensor " + name + " in " + this->directory);
+                }
+
+                if (tensor->dtype != uint32_t(NumcySerialize::TypeOf<T>::value) || tensor->element_size != sizeof(T))
+                {
+                    throw std::runtime_error("NumcyCheckpoint::Reader::get(const std::string&, bool) Error: element type of " + name + " (dtype " + std::to_string(tensor->dtype) + ") is not the one requested");
+                }
+
+                size_t numel = 1, bytes = 0;
+
+                for (size_t i = 0; i < tensor->shape.size(); i++)
+                {
+                    numel = numel * size_t(tensor->shape[i]);
+                }
+
+                for (size_t c = 0; c < tensor->chunks.size(); c++)
+                {
+                    bytes = bytes + tensor->chunks[c].bytes;
+                }
+
+                if (bytes != numel * sizeof(T))
+                {
+                    throw std::runtime_error("NumcyCheckpoint::Reader::get(const std::string&, bool) Error: chunks of " + name + " do not add up to its shape");
+                }
+
+                void* pages = NumcyNuma::allocate(bytes, numcy::NumaPolicy::FirstTouch);
+
+                try
+                {
+                    unsigned char* to = static_cast<unsigned char*>(pages);
+                    const std::string& path = this->directory;
+                    const std::string& tag = this->index.tag;
+                    const std::vector<int>& fds = this->descriptors;
+
+                    std::vector<size_t> starts(tensor->chunks.size(), 0);
+
+                    for (size_t c = 1; c < starts.size(); c++)
+                    {
+                        starts[c] = starts[c - 1] + tensor->chunks[c - 1].bytes;
+                    }
+
+                    NumcyThreads::parallel_for(0, tensor->chunks.size(), 1, [&, to, verify](size_t first, size_t last)
+                    {
+                        for (size_t c = first; c < last; c++)
+                        {
+                            const Chunk& chunk = tensor->chunks[c];
+
+                            _readAt(fds[chunk.shard], shardPath(path, tag, chunk.shard), to + starts[c], chunk.bytes, chunk.offset);
+
+                            if (verify && chunk.checksum != 0 && NumcySerialize::checksum(to + starts[c], chunk.bytes) != chunk.checksum)
+                            {
+                                throw std::runtime_error("checksum mismatch in chunk " + std::to_string(c) + ", shard " + std::to_string(chunk.shard) + " is corrupt");
+                            }
+                        }
+                    });
+
+                    Dimensions<E> dims;
+                    dims.fromVector(std::vector<E>(tensor->shape.begin(), tensor->shape.end()));
+
+                    Collective<T, E> c = Collective<T, E>::mapped(static_cast<T*>(pages), dims, bytes);
+                    pages = nullptr; // Owned by c from here on
+
+                    return c;
+                }
+                catch (std::runtime_error& e)
+                {
+                    NumcyNuma::release(pages, bytes);
+                    throw std::runtime_error("NumcyCheckpoint::Reader::get(const std::string&, bool) -> " + name + ": " + std::string(e.what()));
+                }
+                catch (...)
+                {
+                    if (pages != nullptr)
+                    {
+                        NumcyNuma::release(pages, bytes);
+                    }
+
+                    throw std::runtime_error("NumcyCheckpoint::Reader::get(const std::string&, bool) Error: Unknown exception");
+                }
+            }
+
+        private:
+            void _close(void)
+            {
+#if defined(NUMCY_MMAP)
+                for (size_t s = 0; s < this->descriptors.size(); s++)
+                {
+                    close(this->descriptors[s]);
+                }
+#endif
+                this->descriptors.clear();
+            }
+    };
+}
+
+#endif
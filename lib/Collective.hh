@@ -21,7 +21,33 @@ class Collective
      *                                               every Dimensions that shares them)
      */
     CollectiveProperties<T, E>* properties;
-    
+
+    /*
+        Before a write through this handle, see setCopyOnWrite()
+        void _detach(void)
+        ├─► if (!copy-on-write || this->properties->getReferenceCount() <= 1)
+        │     └─► return                                   // No other handle sees the write
+        └─► this->properties = this->properties->clone()   // The others keep the old buffer
+     */
+    void _detach(void)
+    {
+        if (this->properties == nullptr || !this->properties->isCopyOnWrite() || this->properties->getReferenceCount() <= 1)
+        {
+            return;
+        }
+
+        NumcyMemory::Site site("copy-on-write");
+
+        CollectiveProperties<T, E>* own = this->properties->clone();
+
+        if (this->properties->decrementReferenceCount() == 0)
+        {
+            delete this->properties; // The other handles went away meanwhile
+        }
+
+        this->properties = own;
+    }
+
     public: 
 
         /*
@@ -81,6 +107,54 @@ class Collective
             }            
         }
 
+        /*
+            *  Collective(const Dimensions<E>& d, numcy::NumaPolicy policy)
+            *  ├─► try
+            *  │     ├─► this->properties = new CollectiveProperties<T, E>(d, policy)
+            *  └─► a host collective whose pages are placed on the NUMA nodes by policy
+         */
+        Collective(const Dimensions<E>& d, numcy::NumaPolicy policy) : properties(nullptr)
+        {
+            try
+            {
+                properties = new CollectiveProperties<T, E>(d, policy);
+            }
+            catch (std::runtime_error& e)
+            {
+                throw std::runtime_error("Collective<T, E>::Collective(Dimensions<E>, NumaPolicy) -> " + std::string(e.what()));
+            }
+            catch (...)
+            {
+                throw std::runtime_error("Collective<T, E>::Collective(Dimensions<E>, NumaPolicy) Error: Unknown exception");
+            }
+        }
+
+        /*
+            *  static Collective<T, E> mapped(T* pages, const Dimensions<E>& d, size_t bytes, size_t offset = 0)
+            *  ├─► a host collective over elements offset bytes into bytes of pages that were mmap()ed or came
+            *  │   from NumcyNuma::allocate()
+            *  └─► the last handle gives them back with NumcyNuma::release() (munmap()) instead of delete[]
+         */
+        static Collective<T, E> mapped(T* pages, const Dimensions<E>& d, size_t bytes, size_t offset = 0)
+        {
+            Collective<T, E> collective;
+
+            try
+            {
+                collective.properties = new CollectiveProperties<T, E>(pages, d, bytes, offset);
+            }
+            catch (std::runtime_error& e)
+            {
+                throw std::runtime_error("Collective<T, E>::mapped(T*, Dimensions<E>, size_t, size_t) -> " + std::string(e.what()));
+            }
+            catch (...)
+            {
+                throw std::runtime_error("Collective<T, E>::mapped(T*, Dimensions<E>, size_t, size_t) Error: Unknown exception");
+            }
+
+            return collective;
+        }
+
         /*
             *  Collective(const Collective<T, E>& other)
             *  └─► this->properties = other.properties
@@ -128,9 +202,7 @@ class Collective
             {
                 if (this->properties != nullptr)  // ← guard
                 {
-                    this->properties->decrementReferenceCount();
-
-                    if (this->properties->getReferenceCount() == 0)
+                    if (this->properties->decrementReferenceCount() == 0)
                     {
                         delete this->properties;
                     }
@@ -160,9 +232,7 @@ class Collective
              */
             if (this->properties != nullptr)
             {
-                this->properties->decrementReferenceCount();
-
-                if (this->properties->getReferenceCount() == 0)
+                if (this->properties->decrementReferenceCount() == 0)
                 {
                     delete this->properties;                                                 
                 }
@@ -182,6 +252,7 @@ class Collective
             *  │     └─► throw std::runtime_error("Collective<T, E>::operator[](E) Error: properties is nullptr")
             *  ├─► if (index >= this->getShape().numel())
             *  │     └─► throw std::runtime_error("Collective<T, E>::operator[](E) Error: index out of bounds")
+            *  ├─► this->_detach()                          // Copy-on-write only
             *  └─► return this->properties->getData()[index]
          */
         T& operator[](E index)
@@ -196,6 +267,8 @@ class Collective
                 throw std::runtime_error("Collective<T, E>::operator[](E) Error: index out of bounds");
             }
 
+            this->_detach();
+
             return this->properties->getData()[index];
         }
 
@@ -266,6 +339,127 @@ class Collective
             return this->properties->getData();
         }
 
+        /*
+            T* getData(void)
+            └─► the same on a non-const handle, which may write through the pointer, so a
+                copy-on-write collective detaches first (see setCopyOnWrite()). Read through a
+                const reference to not clone.
+         */
+        T* getData(void)
+        {
+            if (this->properties == nullptr)
+            {
+                throw std::runtime_error("Collective<T, E>::getData() Error: CollectiveProperties<T, E> is nullptr");
+            }
+
+            this->_detach();
+
+            return this->properties->getData();
+        }
+
+        /*
+            Copy-on-write, opt in per buffer
+            --------------------------------
+            Copies of a collective share its buffer, a write through one is seen by all. With
+            copy-on-write set, on any handle of the buffer, every handle writing through the
+            non-const operator[] or getData() while the buffer has other handles gets a copy of its
+            own first, the others keep the old one. A buffer with one handle is written in place.
+            ├─► setCopyOnWrite(true)   — value semantics without copying before every mutation
+            ├─► the copy keeps copy-on-write, handles made from it share it the same way
+            └─► the const operator[] and getData() (every Numcy op takes const references) never
+                copy, nor does writing through a pointer taken before the copy was made
+         */
+        void setCopyOnWrite(bool on = true)
+        {
+            if (this->properties == nullptr)
+            {
+                throw std::runtime_error("Collective<T, E>::setCopyOnWrite(bool) Error: CollectiveProperties<T, E> is nullptr");
+            }
+
+            this->properties->setCopyOnWrite(on);
+        }
+
+        bool isCopyOnWrite(void) const
+        {
+            return this->properties != nullptr && this->properties->isCopyOnWrite();
+        }
+
+        /*
+            bool isEmpty(void) const
+            └─► return this->properties == nullptr   // Default constructed, nothing allocated yet
+         */
+        bool isEmpty(void) const
+        {
+            return this->properties == nullptr;
+        }
+
+        /*
+            Future-like use, see Numcy::async()
+            -----------------------------------
+            static Collective<T, E> pending(void)
+            └─► a collective without data yet, every accessor (getShape(), getData(), operator[],
+                getMemoryLocation()) blocks until resolve() or fail() is called on one of its handles
+
+            isReady()        — never blocks
+            wait()           — blocks until ready, rethrows the producing op's exception
+            whenReady(f)     — f() once ready
+            resolve(value)   — value becomes the content of this (pending) collective
+            fail(error)      — the producing op threw error
+         */
+        static Collective<T, E> pending(void)
+        {
+            Collective<T, E> placeholder(nullptr, Dimensions<E>(), MemoryLocation::None);
+
+            placeholder.properties->markPending();
+
+            return placeholder;
+        }
+
+        bool isReady(void) const
+        {
+            return this->properties == nullptr || this->properties->isReady();
+        }
+
+        void wait(void) const
+        {
+            if (this->properties != nullptr)
+            {
+                this->properties->waitUntilReady();
+            }
+        }
+
+        void whenReady(std::function<void()> continuation) const
+        {
+            if (this->properties == nullptr)
+            {
+                continuation();
+
+                return;
+            }
+
+            this->properties->whenReady(continuation);
+        }
+
+        void resolve(Collective<T, E>& value)
+        {
+            if (this->properties == nullptr || value.properties == nullptr)
+            {
+                throw std::runtime_error("Collective<T, E>::resolve(Collective<T, E>&) Error: CollectiveProperties<T, E> is nullptr");
+            }
+
+            this->properties->resolve(*value.properties);
+        }
+
+        void fail(std::exception_ptr error)
+        {
+            if (this->properties == nullptr)
+            {
+                throw std::runtime_error("Collective<T, E>::fail(std::exception_ptr) Error: CollectiveProperties<T, E> is nullptr");
+            }
+
+            this->properties->fail(error);
+        }
+
         MemoryLocation getMemoryLocation(void) const
         {
             if (this->properties == nullptr)
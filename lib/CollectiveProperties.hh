@@ -8,6 +8,19 @@
 #define NUMCY_COLLECTIVE_PROPERTIES_HH
 
 #include "./Dimensions.hh"
+#include "./Memory.hh"
+#include "./Numa.hh"
+#include "./ThreadPool.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <type_traits>
+#include <vector>
 
 template <typename T = double, typename E = size_t>
 class CollectiveProperties
@@ -21,8 +34,70 @@ class CollectiveProperties
      */
     Dimensions<E> dimensions; // It's a value member it destructor will be called automatically when the object is destroyed
     T* data; // It's a pointer member it destructor will not be called automatically when the object is destroyed
-    size_t reference_count;
+    std::atomic<size_t> reference_count; // Atomic, handles to one collective live on several threads once ops run asynchronously
     MemoryLocation memory_location;
+    size_t mapped_bytes; // Non-zero when data came from NumcyNuma::allocate(), it is then given back with NumcyNuma::release() instead of delete[]
+    size_t mapped_offset; // Bytes from the start of those pages to data, a file mapped from a page boundary before the elements
+    size_t accounted_bytes; // What data counts for in NumcyMemory while this object owns it, 0 when not counted
+    std::atomic<bool> copy_on_write; // See Collective::setCopyOnWrite(), a handle writing to data while it has others clones it first
+
+    /*
+        Readiness, see markPending(). Every collective is ready from birth except the placeholder
+        Numcy::async() returns, which becomes ready when its op has run (resolve() or fail()).
+     */
+    std::atomic<bool> ready;
+    mutable std::mutex ready_lock;
+    mutable std::condition_variable ready_signal;
+    std::exception_ptr failure;
+    std::vector<std::function<void()>> on_ready;
+
+    /*
+        data, just allocated or taken over, counted in NumcyMemory (see lib/Memory.hh)
+     */
+    void _account(void)
+    {
+        size_t bytes = this->mapped_bytes != 0 ? this->mapped_bytes : this->dimensions.numel() * sizeof(T);
+
+        if (this->data != nullptr && bytes != 0)
+        {
+            NumcyMemory::Accounting::global().allocated(this->data, bytes, this->memory_location, this->dimensions);
+            this->accounted_bytes = bytes;
+        }
+    }
+
+    /*
+        data is about to be given back, before it is so its address cannot be reused meanwhile
+     */
+    void _unaccount(void)
+    {
+        if (this->accounted_bytes != 0)
+        {
+            NumcyMemory::Accounting::global().released(this->data, this->accounted_bytes, this->memory_location);
+            this->accounted_bytes = 0;
+        }
+    }
+
+    /*
+        Marks ready, wakes the waiting threads and runs the continuations registered by whenReady()
+     */
+    void _setReady(void)
+    {
+        std::vector<std::function<void()>> continuations;
+
+        {
+            std::lock_guard<std::mutex> guard(this->ready_lock);
+
+            this->ready.store(true, std::memory_order_release);
+            continuations.swap(this->on_ready);
+        }
+
+        this->ready_signal.notify_all();
+
+        for (size_t i = 0; i < continuations.size(); i++)
+        {
+            continuations[i]();
+        }
+    }
     
     public:
 
@@ -33,8 +108,9 @@ class CollectiveProperties
             *  ├─► this->reference_count = 1
             *  └─► this->memory_location = mem_loc
          */
-        CollectiveProperties(T* ptr, const Dimensions<E>& d, MemoryLocation mem_loc = MemoryLocation::Device) : dimensions(d), data(ptr), reference_count(1), memory_location(mem_loc)
+        CollectiveProperties(T* ptr, const Dimensions<E>& d, MemoryLocation mem_loc = MemoryLocation::Device) : dimensions(d), data(ptr), reference_count(1), memory_location(mem_loc), mapped_bytes(0), mapped_offset(0), accounted_bytes(0), copy_on_write(false), ready(true), ready_lock(), ready_signal(), failure(nullptr), on_ready()
         {
+            this->_account();
         }
 
         /*
@@ -44,15 +120,16 @@ class CollectiveProperties
             *  ├─► this->reference_count = 1
             *  └─► this->memory_location = mem_loc
          */
-        CollectiveProperties(const Dimensions<E>& d, MemoryLocation mem_loc = MemoryLocation::Host) : dimensions(d), data(nullptr), reference_count(1), memory_location(mem_loc)
+        CollectiveProperties(const Dimensions<E>& d, MemoryLocation mem_loc = MemoryLocation::Host) : dimensions(d), data(nullptr), reference_count(1), memory_location(mem_loc), mapped_bytes(0), mapped_offset(0), accounted_bytes(0), copy_on_write(false), ready(true), ready_lock(), ready_signal(), failure(nullptr), on_ready()
         {
             try
             {
                 this->data = new T[this->dimensions.numel()];
+                this->_account();
             }
             catch (const std::bad_alloc& e)
             {
-                throw std::runtime_error("CollectiveProperties<T, E>::CollectiveProperties(Dimensions<E>) Error: " + std::string(e.what()));
+                throw std::runtime_error("CollectiveProperties<T, E>::CollectiveProperties(Dimensions<E>) Error: " + std::string(e.what()) + NumcyMemory::Accounting::global().outOfMemory(this->dimensions.numel() * sizeof(T), this->memory_location));
             }
             catch (const std::exception& e)
             {
@@ -64,6 +141,69 @@ class CollectiveProperties
             }
         }
 
+        /*
+            *  CollectiveProperties(const Dimensions<E>& d, numcy::NumaPolicy policy)
+            *  ├─► this->dimensions = d
+            *  ├─► this->data = NumcyNuma::allocate(numel * sizeof(T), policy), pages placed by policy
+            *  ├─► policy == FirstTouch
+            *  │     └─► every element set to T() by NumcyThreads::parallel_for_static(), each page is
+            *  │         first written by (and so lives on the node of) the pool thread that owns its slice
+            *  ├─► this->reference_count = 1
+            *  └─► this->memory_location = MemoryLocation::Host
+            *
+            *  Only for element types that need no constructor or destructor run, the pages are raw memory.
+         */
+        CollectiveProperties(const Dimensions<E>& d, numcy::NumaPolicy policy) : dimensions(d), data(nullptr), reference_count(1), memory_location(MemoryLocation::Host), mapped_bytes(0), mapped_offset(0), accounted_bytes(0), copy_on_write(false), ready(true), ready_lock(), ready_signal(), failure(nullptr), on_ready()
+        {
+            static_assert(std::is_trivially_default_constructible<T>::value && std::is_trivially_destructible<T>::value, "CollectiveProperties<T, E>: NUMA placed buffers need a trivial element type");
+
+            try
+            {
+                size_t numel = this->dimensions.numel();
+
+                this->data = static_cast<T*>(NumcyNuma::allocate(numel * sizeof(T), policy));
+                this->mapped_bytes = numel * sizeof(T) == 0 ? 1 : numel * sizeof(T);
+                this->_account();
+
+                if (policy == numcy::NumaPolicy::FirstTouch)
+                {
+                    T* pages = this->data;
+
+                    NumcyThreads::parallel_for_static(0, numel, NumcyThreads::ThreadPool::global().getSerialThreshold(), [pages](size_t first, size_t last)
+                    {
+                        for (size_t i = first; i < last; i++)
+                        {
+                            pages[i] = T();
+                        }
+                    });
+                }
+            }
+            catch (const std::bad_alloc& e)
+            {
+                throw std::runtime_error("CollectiveProperties<T, E>::CollectiveProperties(Dimensions<E>, NumaPolicy) Error: " + std::string(e.what()) + NumcyMemory::Accounting::global().outOfMemory(this->dimensions.numel() * sizeof(T), this->memory_location));
+            }
+            catch (const std::exception& e)
+            {
+                throw std::runtime_error("CollectiveProperties<T, E>::CollectiveProperties(Dimensions<E>, NumaPolicy) Error: " + std::string(e.what()));
+            }
+            catch (...)
+            {
+                throw std::runtime_error("CollectiveProperties<T, E>::CollectiveProperties(Dimensions<E>, NumaPolicy) Error: Unknown exception");
+            }
+        }
+
+        /*
+            *  CollectiveProperties(T* pages, const Dimensions<E>& d, size_t bytes, size_t offset = 0)
+            *  ├─► this->data = pages, offset bytes into bytes of mmap()ed pages (a file, see Numcy::load()) or of
+            *  │   pages from NumcyNuma::allocate()
+            *  ├─► this->mapped_bytes = bytes, so the destructor gives them back with NumcyNuma::release()
+            *  └─► this->memory_location = MemoryLocation::Host
+         */
+        CollectiveProperties(T* pages, const Dimensions<E>& d, size_t bytes, size_t offset = 0) : dimensions(d), data(pages), reference_count(1), memory_location(MemoryLocation::Host), mapped_bytes(bytes == 0 ? 1 : bytes), mapped_offset(offset), accounted_bytes(0), copy_on_write(false), ready(true), ready_lock(), ready_signal(), failure(nullptr), on_ready()
+        {
+            this->_account();
+        }
+
         /*
             *  CollectiveProperties(const CollectiveProperties<T, E>& other)
             *  ├─► this->dimensions = other.dimensions
@@ -71,7 +211,7 @@ class CollectiveProperties
             *  ├─► this->reference_count = other.reference_count
             *  └─► this->memory_location = other.memory_location
          */
-        CollectiveProperties(const CollectiveProperties<T, E>& other) : dimensions(other.dimensions), data(other.data), reference_count(other.reference_count), memory_location(other.mem_loc)
+        CollectiveProperties(const CollectiveProperties<T, E>& other) : dimensions(other.dimensions), data(other.data), reference_count(other.reference_count.load()), memory_location(other.memory_location), mapped_bytes(other.mapped_bytes), mapped_offset(other.mapped_offset), accounted_bytes(0), copy_on_write(other.copy_on_write.load()), ready(other.ready.load()), ready_lock(), ready_signal(), failure(other.failure), on_ready()
         {
             this->incrementReferenceCount();
         }
@@ -102,7 +242,14 @@ class CollectiveProperties
              *              └─► ~T() (for each element)
              *        └─► this->data = nullptr
              */
-            if (this->data != nullptr && this->memory_location == MemoryLocation::Host)
+            this->_unaccount();
+
+            if (this->data != nullptr && this->memory_location == MemoryLocation::Host && this->mapped_bytes != 0)
+            {
+                NumcyNuma::release(static_cast<char*>(static_cast<void*>(this->data)) - this->mapped_offset, this->mapped_bytes);
+                this->data = nullptr;
+            }
+            else if (this->data != nullptr && this->memory_location == MemoryLocation::Host)
             {
                 delete[] this->data;
                 this->data = nullptr;
@@ -131,20 +278,215 @@ class CollectiveProperties
 
         void incrementReferenceCount(void)
         {
-            this->reference_count++;
+            this->reference_count.fetch_add(1, std::memory_order_relaxed);
         }
 
-        void decrementReferenceCount(void)
+        /*
+            Returns the count left. Only the thread that sees 0 here may delete this object, reading
+            getReferenceCount() afterwards would race with a release on another thread.
+         */
+        size_t decrementReferenceCount(void)
         {
-            if (this->reference_count > 0)
+            size_t count = this->reference_count.load(std::memory_order_relaxed);
+
+            while (count > 0 && !this->reference_count.compare_exchange_weak(count, count - 1, std::memory_order_acq_rel))
             {
-                this->reference_count--;
             }
+
+            return count > 0 ? count - 1 : 0;
         }
 
         size_t getReferenceCount(void) const
         {
-            return this->reference_count;
+            return this->reference_count.load(std::memory_order_acquire);
+        }
+
+        /*
+            Asynchronous results
+            --------------------
+            markPending()    — this (still empty) collective will be produced by an async op
+            isReady()        — true unless still pending, never blocks
+            waitUntilReady() — blocks until ready, helping the thread pool meanwhile, then rethrows
+                               the op's exception if it failed
+            resolve(other)   — the op's result: other's buffer (moved when other is its only
+                               handle, copied otherwise) and shape become this collective's
+            fail(e)          — the op threw e, every later access rethrows it
+            whenReady(f)     — f() once ready, right away if already ready
+
+            getDimensions(), getData() and getMemoryLocation() call waitUntilReady(), which on a
+            ready collective is a single atomic load.
+         */
+        void markPending(void)
+        {
+            this->ready.store(false, std::memory_order_release);
+        }
+
+        bool isReady(void) const
+        {
+            return this->ready.load(std::memory_order_acquire);
+        }
+
+        void waitUntilReady(void) const
+        {
+            while (!this->isReady())
+            {
+                if (NumcyThreads::ThreadPool::global().runPendingTask())
+                {
+                    continue;
+                }
+
+                std::unique_lock<std::mutex> lock(this->ready_lock);
+
+                this->ready_signal.wait_for(lock, std::chrono::microseconds(200), [this]() { return this->isReady(); });
+            }
+
+            if (this->failure)
+            {
+                std::rethrow_exception(this->failure);
+            }
+        }
+
+        void resolve(CollectiveProperties<T, E>& other)
+        {
+            other.waitUntilReady();
+
+            size_t numel = other.dimensions.numel();
+
+            // A shape of its own, not nodes shared with other, other is released on the op's thread
+            if (other.dimensions.size() > 0)
+            {
+                Dimensions<E> shape;
+                shape.fromVector(other.dimensions.toVector());
+                this->dimensions = shape;
+            }
+
+            this->memory_location = other.memory_location;
+
+            if (other.getReferenceCount() <= 1 || other.data == nullptr)
+            {
+                // Sole owner, take the buffer as it is
+                this->data = other.data;
+                this->mapped_bytes = other.mapped_bytes;
+                this->mapped_offset = other.mapped_offset;
+                this->accounted_bytes = other.accounted_bytes;
+
+                other.data = nullptr;
+                other.mapped_bytes = 0;
+                other.mapped_offset = 0;
+                other.accounted_bytes = 0;
+            }
+            else if (other.memory_location == MemoryLocation::Host)
+            {
+                this->data = new T[numel];
+                std::copy(other.data, other.data + numel, this->data);
+
+                this->_account();
+            }
+#ifdef COMPILE_FOR_DEVICE
+            else
+            {
+                cudaError_t err = cudaMalloc(&this->data, numel * sizeof(T));
+
+                if (err == cudaSuccess)
+                {
+                    err = cudaMemcpy(this->data, other.data, numel * sizeof(T), cudaMemcpyDeviceToDevice);
+                }
+
+                if (err != cudaSuccess)
+                {
+                    throw std::runtime_error("CollectiveProperties<T, E>::resolve(CollectiveProperties<T, E>&) Error: " + std::string(cudaGetErrorString(err)));
+                }
+
+                this->_account();
+            }
+#endif
+
+            this->_setReady();
+        }
+
+        void fail(std::exception_ptr error)
+        {
+            this->failure = error;
+            this->_setReady();
+        }
+
+        void whenReady(std::function<void()> continuation)
+        {
+            {
+                std::lock_guard<std::mutex> guard(this->ready_lock);
+
+                if (!this->isReady())
+                {
+                    this->on_ready.push_back(continuation);
+
+                    return;
+                }
+            }
+
+            continuation();
+        }
+
+        /*
+            Copy-on-write, see Collective::setCopyOnWrite()
+            ├─► setCopyOnWrite(on) / isCopyOnWrite()
+            └─► clone() — a new object (reference count 1, copy-on-write) with a buffer of its own
+                          holding a copy of data, same shape and location. Pages of NumcyNuma
+                          become an ordinary host buffer.
+         */
+        void setCopyOnWrite(bool on)
+        {
+            this->copy_on_write.store(on, std::memory_order_relaxed);
+        }
+
+        bool isCopyOnWrite(void) const
+        {
+            return this->copy_on_write.load(std::memory_order_relaxed);
+        }
+
+        CollectiveProperties<T, E>* clone(void) const
+        {
+            this->waitUntilReady();
+
+            size_t numel = this->dimensions.numel();
+            CollectiveProperties<T, E>* copy = nullptr;
+
+#ifdef COMPILE_FOR_DEVICE
+            if (this->memory_location == MemoryLocation::Device)
+            {
+                T* device = nullptr;
+                cudaError_t err = cudaMalloc(&device, numel * sizeof(T));
+
+                if (err == cudaSuccess)
+                {
+                    err = cudaMemcpy(device, this->data, numel * sizeof(T), cudaMemcpyDeviceToDevice);
+
+                    if (err != cudaSuccess)
+                    {
+                        cudaFree(device);
+                    }
+                }
+
+                if (err != cudaSuccess)
+                {
+                    throw std::runtime_error("CollectiveProperties<T, E>::clone() Error: " + std::string(cudaGetErrorString(err)));
+                }
+
+                copy = new CollectiveProperties<T, E>(device, this->dimensions, MemoryLocation::Device);
+            }
+            else
+#endif
+            {
+                copy = new CollectiveProperties<T, E>(this->dimensions, this->memory_location);
+
+                if (this->data != nullptr)
+                {
+                    std::copy(this->data, this->data + numel, copy->data);
+                }
+            }
+
+            copy->setCopyOnWrite(true);
+
+            return copy;
         }
 
         /*
@@ -167,6 +509,8 @@ class CollectiveProperties
                 Returning by reference avoids copying the entire Dimensions object, which can be expensive if it has many nodes.
                 The const ensures that the caller cannot modify the Dimensions object.
             */
+            this->waitUntilReady();
+
             return this->dimensions;
         }
 
@@ -176,6 +520,8 @@ class CollectiveProperties
          */
         T* getData(void) const
         {
+            this->waitUntilReady();
+
             return this->data; // Return by pointer to avoid copy
         }
 
@@ -185,6 +531,8 @@ class CollectiveProperties
          */
         MemoryLocation getMemoryLocation(void) const
         {
+            this->waitUntilReady();
+
             return this->memory_location;
         }
 };
@@ -0,0 +1,282 @@
+/*
+ * Numcy/lib/Cpu.hh
+ *
+ * CPU feature detection and the kernel registry. The SIMD kernels are compiled for every
+ * instruction set they have a variant for, whatever -march says, each kernel family picks the
+ * best variant the machine runs once, on first use, and calls it through a function pointer
+ * from then on. One binary uses AVX2 on Haswell and AVX-512 / VNNI on Skylake-SP and Zen 4.
+ *
+ * NUMCY_ISA=scalar|avx2|avx512 caps the instruction set, for benchmarks and tests of the
+ * narrower variants on a wide machine. It never enables what the CPU does not have, any other
+ * value is an error.
+ *
+ * Q@hackers.pk
+ */
+
+#ifndef NUMCY_CPU_HH
+#define NUMCY_CPU_HH
+
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+    NUMCY_X86 — GCC/Clang on x86, variants are compiled with NUMCY_TARGET("avx2,fma") and friends,
+    everywhere else only the portable kernels exist
+ */
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+    #define NUMCY_X86 1
+    #define NUMCY_TARGET(features) __attribute__((target(features)))
+
+    #include <cpuid.h>
+    #include <immintrin.h>
+#else
+    #define NUMCY_TARGET(features)
+#endif
+
+namespace numcy {
+
+    /*
+        Instruction set levels, each includes the ones before it. A level exists only when some
+        kernel has a variant for it.
+     */
+    enum class Isa : int {
+        Scalar = 0, // Portable C++ only (still the baseline SSE2 of x86-64 the compiler auto-vectorizes with)
+        AVX2   = 1, // AVX2 + FMA + F16C (Haswell and later)
+        AVX512 = 2  // AVX-512 F/BW/VL/DQ (Skylake-SP and later), VNNI and BF16 as the CPU has them
+    };
+}
+
+namespace NumcyCpu
+{
+    struct Features
+    {
+        bool avx2;
+        bool fma;
+        bool f16c;
+        bool avx512;     // F, BW, VL and DQ together
+        bool avx512vnni;
+        bool avx512bf16;
+
+        Features(void) : avx2(false), fma(false), f16c(false), avx512(false), avx512vnni(false), avx512bf16(false)
+        {
+        }
+    };
+
+    /*
+        What the CPU and the operating system support, cpuid for the instructions, xgetbv for
+        whether the OS saves the ymm/zmm registers on a context switch
+     */
+    inline Features detect(void)
+    {
+        Features f;
+
+#if defined(NUMCY_X86)
+        unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+
+        if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        {
+            return f;
+        }
+
+        bool osxsave = (ecx & (1U << 27)) != 0;
+        bool avx = (ecx & (1U << 28)) != 0;
+        bool fma = (ecx & (1U << 12)) != 0;
+        bool f16c = (ecx & (1U << 29)) != 0;
+
+        unsigned long long xcr0 = 0;
+
+        if (osxsave)
+        {
+            unsigned int lo = 0, hi = 0;
+
+            __asm__ volatile ("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+
+            xcr0 = (static_cast<unsigned long long>(hi) << 32) | lo;
+        }
+
+        bool ymm = (xcr0 & 0x6ULL) == 0x6ULL;
+        bool zmm = (xcr0 & 0xE6ULL) == 0xE6ULL;
+
+        if (__get_cpuid_max(0, nullptr) >= 7)
+        {
+            __cpuid_count(7, 0, eax, ebx, ecx, edx);
+
+            f.avx2 = avx && ymm && (ebx & (1U << 5)) != 0;
+            f.fma = f.avx2 && fma;
+            f.f16c = f.avx2 && f16c;
+
+            bool avx512f = (ebx & (1U << 16)) != 0, avx512dq = (ebx & (1U << 17)) != 0;
+            bool avx512bw = (ebx & (1U << 30)) != 0, avx512vl = (ebx & (1U << 31)) != 0;
+
+            f.avx512 = f.fma && zmm && avx512f && avx512dq && avx512bw && avx512vl;
+            f.avx512vnni = f.avx512 && (ecx & (1U << 11)) != 0;
+
+            __cpuid_count(7, 1, eax, ebx, ecx, edx);
+
+            f.avx512bf16 = f.avx512 && (eax & (1U << 5)) != 0;
+        }
+#endif
+        return f;
+    }
+
+    inline numcy::Isa levelOf(const Features& f)
+    {
+        if (f.avx512)
+        {
+            return numcy::Isa::AVX512;
+        }
+        if (f.avx2 && f.fma)
+        {
+            return numcy::Isa::AVX2;
+        }
+        return numcy::Isa::Scalar;
+    }
+
+    inline const char* name(numcy::Isa isa)
+    {
+        switch (isa)
+        {
+            case numcy::Isa::AVX512: return "avx512";
+            case numcy::Isa::AVX2:   return "avx2";
+            default:                 return "scalar";
+        }
+    }
+
+    /*
+        Features with everything above level switched off
+     */
+    inline Features limit(Features f, numcy::Isa level)
+    {
+        if (level < numcy::Isa::AVX512)
+        {
+            f.avx512 = f.avx512vnni = f.avx512bf16 = false;
+        }
+        if (level < numcy::Isa::AVX2)
+        {
+            f.avx2 = f.fma = f.f16c = false;
+        }
+        return f;
+    }
+
+    /*
+        features()
+        ├─► detect(), capped by NUMCY_ISA when it is set to one of the level names
+        ├─► any other non-empty NUMCY_ISA throws, from every call, rather than run what was not asked for
+        └─► read once, every kernel family resolves its variant from this
+     */
+    inline const Features& features(void)
+    {
+        static const Features active = []()
+        {
+            Features f = detect();
+            const char* forced = std::getenv("NUMCY_ISA");
+
+            if (forced == nullptr || forced[0] == '\0')
+            {
+                return f;
+            }
+
+            for (int level = 0; level <= int(numcy::Isa::AVX512); level++)
+            {
+                if (std::strcmp(forced, name(numcy::Isa(level))) == 0)
+                {
+                    return limit(f, numcy::Isa(level));
+                }
+            }
+
+            throw std::runtime_error("NumcyCpu::features() Error: NUMCY_ISA=" + std::string(forced) + " is not one of scalar, avx2, avx512");
+        }();
+
+        return active;
+    }
+
+    inline numcy::Isa isa(void)
+    {
+        return levelOf(features());
+    }
+
+    /*
+        Registry
+        --------
+        Which variant every kernel family resolved to, in the order they were first used.
+        entries() for a benchmark header or a test that wants to see what actually ran.
+     */
+    class Registry
+    {
+        mutable std::mutex lock;
+        std::vector<std::pair<std::string, std::string>> chosen;
+
+        Registry(void) : lock(), chosen()
+        {
+        }
+
+    public:
+        Registry(const Registry&) = delete;
+        Registry& operator=(const Registry&) = delete;
+
+        static Registry& global(void)
+        {
+            static Registry registry;
+
+            return registry;
+        }
+
+        void record(const std::string& kernel, const std::string& variant)
+        {
+            std::lock_guard<std::mutex> guard(this->lock);
+
+            this->chosen.push_back(std::make_pair(kernel, variant));
+        }
+
+        std::vector<std::pair<std::string, std::string>> entries(void) const
+        {
+            std::lock_guard<std::mutex> guard(this->lock);
+
+            return this->chosen;
+        }
+    };
+
+    /*
+        One compiled variant of a kernel, available when the CPU (after NUMCY_ISA) can run it
+     */
+    template <typename F>
+    struct Variant
+    {
+        bool available;
+        const char* name;
+        F function;
+    };
+
+    /*
+        select<F>(kernel, {variants...})
+        ├─► the first available variant, best first, the portable one last and always available
+        └─► the choice is recorded in the Registry under kernel
+     */
+    template <typename F>
+    F select(const char* kernel, std::initializer_list<Variant<F>> variants)
+    {
+        const Variant<F>* chosen = variants.begin() + (variants.size() - 1);
+
+        for (const Variant<F>* v = variants.begin(); v != variants.end(); v++)
+        {
+            if (v->available)
+            {
+                chosen = v;
+
+                break;
+            }
+        }
+
+        Registry::global().record(kernel, chosen->name);
+
+        return chosen->function;
+    }
+}
+
+#endif
@@ -0,0 +1,335 @@
+/*
+ * Numcy/lib/Csv.hh
+ *
+ * Numeric CSV / TSV files into one collective. The file is mmap()ed, cut at line boundaries into
+ * one piece per slice of the thread pool, every piece is counted and then parsed in place with
+ * std::from_chars() straight into its rows of the result.
+ *
+ * Q@hackers.pk
+ */
+
+#ifndef NUMCY_CSV_HH
+#define NUMCY_CSV_HH
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace NumcyCsv
+{
+    /*
+        One field of [p, end) into value, false when it is not a number. Leading spaces and a
+        leading '+' (which from_chars() does not take) are skipped, so are trailing spaces.
+        An empty field of a floating point column is NaN.
+     */
+    template <typename T>
+    bool parseField(const char* p, const char* end, T& value)
+    {
+        while (p < end && (*p == ' ' || *p == '"'))
+        {
+            p++;
+        }
+
+        while (end > p && (end[-1] == ' ' || end[-1] == '"'))
+        {
+            end--;
+        }
+
+        if (p < end && *p == '+')
+        {
+            p++;
+        }
+
+        if constexpr (std::is_integral<T>::value && !std::is_same<T, bool>::value)
+        {
+            std::from_chars_result result = std::from_chars(p, end, value);
+
+            return p < end && result.ec == std::errc() && result.ptr == end;
+        }
+        else if constexpr (std::is_same<T, bool>::value)
+        {
+            unsigned int digit = 0;
+            std::from_chars_result result = std::from_chars(p, end, digit);
+
+            value = digit != 0;
+
+            return p < end && result.ec == std::errc() && result.ptr == end && digit <= 1;
+        }
+        else
+        {
+            // double and float as they are, the 16 bit types through float
+            using Wide = typename std::conditional<std::is_same<T, double>::value, double, float>::type;
+
+            Wide wide = std::numeric_limits<Wide>::quiet_NaN();
+
+            if (p < end)
+            {
+#if defined(__cpp_lib_to_chars)
+                std::from_chars_result result = std::from_chars(p, end, wide);
+
+                if (result.ec == std::errc::result_out_of_range)
+                {
+                    // Underflow to 0 or overflow to infinity, what strtod() gives
+                    char buffer[64] = {0};
+                    std::memcpy(buffer, p, std::min(sizeof(buffer) - 1, size_t(end - p)));
+
+                    wide = Wide(std::strtod(buffer, nullptr));
+                }
+                else if (result.ec != std::errc() || result.ptr != end)
+                {
+                    return false;
+                }
+#else
+                char buffer[64] = {0};
+                char* stop = nullptr;
+
+                if (size_t(end - p) >= sizeof(buffer))
+                {
+                    return false;
+                }
+
+                std::memcpy(buffer, p, size_t(end - p));
+                wide = Wide(std::strtod(buffer, &stop));
+
+                if (stop != buffer + (end - p))
+                {
+                    return false;
+                }
+#endif
+            }
+
+            value = T(wide);
+
+            return true;
+        }
+    }
+
+    /*
+        Start of the line after the one p is in (end when there is none)
+     */
+    inline const char* nextLine(const char* p, const char* end)
+    {
+        const void* newline = std::memchr(p, '\n', size_t(end - p));
+
+        return newline == nullptr ? end : static_cast<const char*>(newline) + 1;
+    }
+
+    /*
+        [p, line end) without its '\r', true when it holds nothing but white space
+     */
+    inline bool blank(const char* p, const char* line_end)
+    {
+        for (; p < line_end; p++)
+        {
+            if (*p != ' ' && *p != '\t' && *p != '\r' && *p != '\n')
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    /*
+        The fields of the line [p, line_end) into row, at most columns of them, returns how many
+        there were, or columns + 1 when there were more, or -1 for a field that is not a number
+     */
+    template <typename T>
+    long parseLine(const char* p, const char* line_end, char delimiter, T* row, size_t columns)
+    {
+        while (line_end > p && (line_end[-1] == '\n' || line_end[-1] == '\r'))
+        {
+            line_end--;
+        }
+
+        size_t field = 0;
+
+        while (true)
+        {
+            const void* at = std::memchr(p, delimiter, size_t(line_end - p));
+            const char* field_end = at == nullptr ? line_end : static_cast<const char*>(at);
+
+            if (field == columns)
+            {
+                return long(columns) + 1;
+            }
+
+            if (!parseField(p, field_end, row[field]))
+            {
+                return -1;
+            }
+
+            field++;
+
+            if (field_end == line_end)
+            {
+                return long(field);
+            }
+
+            p = field_end + 1;
+        }
+    }
+
+    /*
+        read<T, E>(path, delimiter)
+        ├─► delimiter 0 — a tab when the first line has one, otherwise ','
+        ├─► a first line that does not parse as numbers is a header and is skipped, blank lines are
+        │   skipped everywhere
+        ├─► columns from the first data line, every other line must have as many fields
+        ├─► pass 1: the data is cut into pieces at line boundaries, the lines of each are counted in
+        │   parallel (memchr() over the mapping), a prefix sum gives the first row of every piece
+        ├─► the result, [rows, columns], allocated once
+        └─► pass 2: every piece parsed in parallel into its own rows, nothing is copied in between
+     */
+    template <typename T, typename E>
+    Collective<T, E> read(const std::string& path, char delimiter)
+    {
+        size_t size = NumcyNpy::fileSize(path);
+
+        if (size == 0)
+        {
+            throw std::runtime_error(path + " is empty");
+        }
+
+        NumcyNpy::MappedFile file(path, numcy::Mapping::ReadOnly, 0, size);
+
+        const char* begin = reinterpret_cast<const char*>(file.data());
+        const char* end = begin + size;
+
+        // Skip blank lines up to the first one with something in it
+        const char* first = begin;
+
+        while (first < end && blank(first, nextLine(first, end)))
+        {
+            first = nextLine(first, end);
+        }
+
+        if (first == end)
+        {
+            throw std::runtime_error(path + " has no data");
+        }
+
+        const char* first_end = nextLine(first, end);
+
+        if (delimiter == 0)
+        {
+            delimiter = std::memchr(first, '\t', size_t(first_end - first)) != nullptr ? '\t' : ',';
+        }
+
+        size_t columns = 1;
+
+        for (const char* p = first; p < first_end; p++)
+        {
+            columns = columns + (*p == delimiter ? 1 : 0);
+        }
+
+        std::vector<T> probe(columns);
+
+        if (parseLine(first, first_end, delimiter, probe.data(), columns) != long(columns))
+        {
+            first = first_end; // A header
+        }
+
+        // Pieces, each starting at the beginning of a line
+        size_t pieces = std::max(size_t(1), std::min(NumcyThreads::ThreadPool::global().getNumberOfThreads() * 4, size_t(end - first) / (size_t(1) << 16)));
+        std::vector<const char*> bounds(1, first);
+
+        for (size_t i = 1; i < pieces; i++)
+        {
+            const char* cut = first + (size_t(end - first) / pieces) * i;
+
+            bounds.push_back(std::max(bounds.back(), cut == first ? first : nextLine(cut - 1, end)));
+        }
+
+        bounds.push_back(end);
+
+        // Pass 1, rows of every piece
+        std::vector<size_t> rows(pieces + 1, 0);
+
+        NumcyThreads::parallel_for(0, pieces, 1, [&](size_t lo, size_t hi)
+        {
+            for (size_t i = lo; i < hi; i++)
+            {
+                size_t count = 0;
+
+                for (const char* p = bounds[i]; p < bounds[i + 1]; )
+                {
+                    const char* line_end = nextLine(p, bounds[i + 1]);
+
+                    count = count + (blank(p, line_end) ? 0 : 1);
+                    p = line_end;
+                }
+
+                rows[i + 1] = count;
+            }
+        });
+
+        for (size_t i = 0; i < pieces; i++)
+        {
+            rows[i + 1] = rows[i + 1] + rows[i];
+        }
+
+        if (rows[pieces] == 0)
+        {
+            throw std::runtime_error(path + " has a header but no data");
+        }
+
+        Dimensions<E> dims;
+        dims.fromVector(std::vector<E>{E(rows[pieces]), E(columns)});
+
+        Collective<T, E> result(dims, MemoryLocation::Host);
+        T* data = result.getData();
+
+        // Pass 2, parse in place, the first bad line of every piece is kept, the earliest reported
+        std::vector<size_t> bad(pieces, std::numeric_limits<size_t>::max());
+        std::vector<long> fields(pieces, 0);
+
+        NumcyThreads::parallel_for(0, pieces, 1, [&](size_t lo, size_t hi)
+        {
+            for (size_t i = lo; i < hi; i++)
+            {
+                size_t row = rows[i];
+
+                for (const char* p = bounds[i]; p < bounds[i + 1]; )
+                {
+                    const char* line_end = nextLine(p, bounds[i + 1]);
+
+                    if (!blank(p, line_end))
+                    {
+                        long got = parseLine(p, line_end, delimiter, data + row * columns, columns);
+
+                        if (got != long(columns))
+                        {
+                            bad[i] = row;
+                            fields[i] = got;
+
+                            break;
+                        }
+
+                        row++;
+                    }
+
+                    p = line_end;
+                }
+            }
+        });
+
+        for (size_t i = 0; i < pieces; i++)
+        {
+            if (bad[i] != std::numeric_limits<size_t>::max())
+            {
+                throw std::runtime_error("data row " + std::to_string(bad[i] + 1) + " of " + path + (fields[i] < 0 ? " has a field that is not a number" : " does not have " + std::to_string(columns) + " fields"));
+            }
+        }
+
+        return result;
+    }
+}
+
+#endif
@@ -88,6 +88,36 @@ class Dimensions
      */
     size_t n; 
 
+    /*
+        Nodes for vec, appended one by one, never from DimensionsCache
+     */
+    void _build(const std::vector<T>& vec)
+    {
+        size_t vecSize = vec.size();
+
+        for (size_t i = 0; i < vecSize - 2; i++)
+        {
+            this->append(T(0) /*Columns*/, vec[i] /*Rows*/);
+        }
+
+        this->append(vec[vecSize - 1] /*Columns*/, vec[vecSize - 2] /*Rows*/);
+    }
+
+    /*
+        An empty Dimensions takes the chain head ... tail, one more reference on each of its nodes
+     */
+    void _attach(DimensionsProperties<T>* h, DimensionsProperties<T>* t)
+    {
+        this->head = h;
+        this->tail = t;
+
+        for (DimensionsProperties<T>* current = h; current != nullptr; current = current->getNext())
+        {
+            current->incrementReferenceCount();
+            this->n++;
+        }
+    }
+
     public:
         /*
             *  Dimensions()
@@ -163,8 +193,8 @@ class Dimensions
             *  ├─► if (this->head != nullptr)
             *  │     ├─► current = this->head
             *  │     ├─► while (current != nullptr)
-            *  │     │     ├─► current->decrementReferenceCount()
-            *  │     │     ├─► if (current->getReferenceCount() == 0)
+            *  │     │     ├─► remaining = current->decrementReferenceCount()
+            *  │     │     ├─► if (remaining == 0)
             *  │     │     │     ├─► next = current->getNext()
             *  │     │     │     ├─► prev = current->getPrevious()
             *  │     │     │     ├─► delete current
@@ -182,7 +212,7 @@ class Dimensions
 
                 while (current != nullptr) // The release loop
                 {
-                    current->decrementReferenceCount();
+                    size_t remaining = current->decrementReferenceCount();
 
                     /*
                         Decrement this node's ref count. If it reaches 0 (means that no Dimensions object owns this node),
@@ -194,7 +224,7 @@ class Dimensions
                         Our reference counts can be mixed, because an append method creates nodes with independent ref counts,
                         allowing a middle node to be deleted while its neighbors survive.                    
                      */
-                    if (current->getReferenceCount() == 0)
+                    if (remaining == 0)
                     {
                         DimensionsProperties<T>* next = current->getNext();
                         DimensionsProperties<T>* prev = current->getPrevious();
@@ -277,8 +307,8 @@ class Dimensions
             *  ├─► if (this == &rhs) return *this
             *  ├─► current = this->head
             * │     ├─► while (current != nullptr)
-            * │     │     ├─► current->decrementReferenceCount()
-            * │     │     ├─► if (current->getReferenceCount() == 0)
+            * │     │     ├─► remaining = current->decrementReferenceCount()
+            * │     │     ├─► if (remaining == 0)
             * │     │     │     ├─► next = current->getNext()
             * │     │     │     ├─► prev = current->getPrevious()
             * │     │     │     ├─► delete current
@@ -314,7 +344,7 @@ class Dimensions
                         
             while (current != nullptr) // The release loop
             {
-                current->decrementReferenceCount();
+                size_t remaining = current->decrementReferenceCount();
 
                 /*
                     Decrement this node's ref count. If it reaches 0 (means that no Dimensions object owns this node),
@@ -326,7 +356,7 @@ class Dimensions
                     Our reference counts can be mixed, because an append method creates nodes with independent ref counts,
                     allowing a middle node to be deleted while its neighbors survive.                    
                  */
-                if (current->getReferenceCount() == 0)
+                if (remaining == 0)
                 {
                     DimensionsProperties<T>* next = current->getNext();
                     DimensionsProperties<T>* prev = current->getPrevious();
@@ -476,6 +506,18 @@ class Dimensions
             */
             assert((this->head == nullptr) == (this->tail == nullptr));
 
+            /*
+                An interned chain (see DimensionsCache) is shared by every Dimensions of its shape
+                and must never change, this object gets a chain of its own first
+            */
+            if (this->tail != nullptr && this->tail->isInterned())
+            {
+                Dimensions<T> own;
+                own._build(this->toVector());
+
+                *this = own;
+            }
+
             DimensionsProperties<T>* node = nullptr;
 
             try
@@ -591,6 +633,11 @@ class Dimensions
          * COMPLEXITY:
          *     O(n), where n is the number of elements in the input vector.
          *     Each element is processed once to create a node.
+         *
+         * INTERNING:
+         *     An empty Dimensions takes the shared chain of its shape from DimensionsCache
+         *     when there is one, no node is allocated. Otherwise the nodes it builds become
+         *     the chain of that shape (while the cache has room).
          */
         void fromVector(const std::vector<T>& vec)
         {
@@ -610,14 +657,20 @@ class Dimensions
                 }
             }
 
-            try
+            bool empty = this->head == nullptr;
+            DimensionsProperties<T>* h = nullptr;
+            DimensionsProperties<T>* t = nullptr;
+
+            if (empty && DimensionsCache<T>::global().find(vec, h, t))
             {
-                for (size_t i = 0; i < vecSize - 2; i++)
-                {
-                    this->append(T(0) /*Columns*/, vec[i] /*Rows*/);
-                }
+                this->_attach(h, t);
 
-                this->append(vec[vecSize - 1] /*Columns*/, vec[vecSize - 2] /*Rows*/);
+                return;
+            }
+
+            try
+            {
+                this->_build(vec);
             }
             catch (const std::exception& e)
             {
@@ -629,6 +682,47 @@ class Dimensions
             }
 
             // append() increments n, so we don't need to do it here.
+
+            if (empty)
+            {
+                DimensionsCache<T>::global().insert(vec, this->head, this->tail);
+            }
+        }
+
+        /*
+         * operator==(const Dimensions<T>& other) const
+         *
+         * Same shape. Two interned shapes (see DimensionsCache) are the same exactly when they
+         * share their chain, that is a pointer compare, any other pair compares toVector().
+         */
+        bool operator==(const Dimensions<T>& other) const
+        {
+            if (this->head == other.head && this->n == other.n)
+            {
+                return true;
+            }
+
+            if (this->head == nullptr || other.head == nullptr || (this->isInterned() && other.isInterned()))
+            {
+                return false;
+            }
+
+            return this->toVector() == other.toVector();
+        }
+
+        bool operator!=(const Dimensions<T>& other) const
+        {
+            return !(*this == other);
+        }
+
+        /*
+         * isInterned(void) const
+         *
+         * True when this shape is the shared chain of DimensionsCache.
+         */
+        bool isInterned(void) const
+        {
+            return this->head != nullptr && this->head->isInterned();
         }
 
         /*
@@ -869,7 +963,7 @@ class Dimensions
 
             while (current != nullptr) // The release loop
             {
-                current->decrementReferenceCount();
+                size_t remaining = current->decrementReferenceCount();
 
                 /*
                     Decrement this node's ref count. If it reaches 0 (means that no Dimensions object owns this node),
@@ -881,7 +975,7 @@ class Dimensions
                     Our reference counts can be mixed, because an append method creates nodes with independent ref counts,
                     allowing a middle node to be deleted while its neighbors survive.                    
                 */
-                if (current->getReferenceCount() == 0)
+                if (remaining == 0)
                 {
                     DimensionsProperties<T>* next = current->getNext();
                     DimensionsProperties<T>* prev = current->getPrevious();
@@ -0,0 +1,142 @@
+/*
+ * Numcy/lib/DimensionsCache.hh
+ *
+ * The process wide table of interned shapes. Dimensions::fromVector() looks its shape up here
+ * first, every Dimensions of a shape already seen then shares one chain of DimensionsProperties
+ * nodes, no node is allocated, and two such Dimensions are equal exactly when their heads are.
+ *
+ * The table holds a reference on every node of every chain it has, so they are never deleted and
+ * never relinked, and nothing ever changes them again (Dimensions::append() copies an interned
+ * chain before it appends). Sharing them between threads is as safe as reading them.
+ *
+ * Q@hackers.pk
+ */
+
+#ifndef NUMCY_DIMENSIONS_CACHE_HH
+#define NUMCY_DIMENSIONS_CACHE_HH
+
+#include <cstdlib>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/*
+    Shapes the table keeps at most, a program that makes ever new shapes (a sequence length per
+    batch, say) stops interning once it is full and allocates its nodes as before.
+    NUMCY_SHAPE_CACHE=n in the environment overrides it, 0 turns interning off.
+ */
+#ifndef NUMCY_SHAPE_CACHE_CAPACITY
+    #define NUMCY_SHAPE_CACHE_CAPACITY 4096
+#endif
+
+template <typename T = size_t>
+class DimensionsCache
+{
+    struct Hash
+    {
+        size_t operator()(const std::vector<T>& shape) const
+        {
+            size_t hash = 14695981039346656037UL;
+
+            for (size_t i = 0; i < shape.size(); i++)
+            {
+                hash = (hash ^ std::hash<T>()(shape[i])) * 1099511628211UL;
+            }
+
+            return hash;
+        }
+    };
+
+    typedef std::pair<DimensionsProperties<T>*, DimensionsProperties<T>*> Chain; // head, tail
+
+    mutable std::shared_mutex lock;
+    std::unordered_map<std::vector<T>, Chain, Hash> shapes;
+    size_t capacity;
+
+    DimensionsCache(void) : lock(), shapes(), capacity(NUMCY_SHAPE_CACHE_CAPACITY)
+    {
+        const char* env = std::getenv("NUMCY_SHAPE_CACHE");
+
+        if (env != nullptr)
+        {
+            this->capacity = std::strtoul(env, nullptr, 10);
+        }
+    }
+
+    public:
+        DimensionsCache(const DimensionsCache<T>&) = delete;
+        DimensionsCache<T>& operator=(const DimensionsCache<T>&) = delete;
+
+        /*
+            Never destroyed, Dimensions of static storage may still use its chains when the
+            program exits
+         */
+        static DimensionsCache<T>& global(void)
+        {
+            static DimensionsCache<T>* cache = new DimensionsCache<T>();
+
+            return *cache;
+        }
+
+        /*
+            The chain of shape, false when it has none
+         */
+        bool find(const std::vector<T>& shape, DimensionsProperties<T>*& head, DimensionsProperties<T>*& tail) const
+        {
+            if (this->capacity == 0)
+            {
+                return false;
+            }
+
+            std::shared_lock<std::shared_mutex> guard(this->lock);
+
+            auto found = this->shapes.find(shape);
+
+            if (found == this->shapes.end())
+            {
+                return false;
+            }
+
+            head = found->second.first;
+            tail = found->second.second;
+
+            return true;
+        }
+
+        /*
+            The chain head ... tail, just built for shape by fromVector(), becomes the chain of shape.
+            False, and the chain is left as it is, when the table is full or another thread was
+            first with the same shape.
+         */
+        bool insert(const std::vector<T>& shape, DimensionsProperties<T>* head, DimensionsProperties<T>* tail)
+        {
+            std::unique_lock<std::shared_mutex> guard(this->lock);
+
+            if (this->shapes.size() >= this->capacity || this->shapes.count(shape) != 0)
+            {
+                return false;
+            }
+
+            this->shapes.emplace(shape, Chain(head, tail));
+
+            for (DimensionsProperties<T>* node = head; node != nullptr; node = node->getNext())
+            {
+                node->incrementReferenceCount();
+                node->setInterned();
+            }
+
+            return true;
+        }
+
+        size_t size(void) const
+        {
+            std::shared_lock<std::shared_mutex> guard(this->lock);
+
+            return this->shapes.size();
+        }
+};
+
+#endif
@@ -17,6 +17,8 @@
 #ifndef NUMCY_DIMENSIONS_PROPERTIES_HH
 #define NUMCY_DIMENSIONS_PROPERTIES_HH
 
+#include <atomic>
+
 /*
     Linked List of 2D Slices. Each node represents one 2D matrix within a higher-dimensional tensor
 */
@@ -39,29 +41,38 @@ class DimensionsProperties
          *
          * The responsibility of managing the reference count lies with the Dimensions class
          * via incrementReferenceCount() and decrementReferenceCount().
+         *
+         * Atomic, a shape is copied on whichever thread an asynchronous op runs on.
          */        
-        size_t reference_count;
+        std::atomic<size_t> reference_count;
+        bool interned; // Part of a shape of DimensionsCache, shared by every Dimensions of that shape and never changed again
 
     public:
         /*
          * Constructor for creating a new DimensionsProperties node.
          * Initializes the columns and rows, and sets up the linked list pointers.
          */
-        DimensionsProperties(T c, T r) : columns(c), rows(r), next(nullptr), prev(nullptr), reference_count(1)
+        DimensionsProperties(T c, T r) : columns(c), rows(r), next(nullptr), prev(nullptr), reference_count(1), interned(false)
         {            
         }
 
         void incrementReferenceCount(void) 
         {
-            this->reference_count++;
+            this->reference_count.fetch_add(1, std::memory_order_relaxed);
         }
 
-        void decrementReferenceCount(void)
+        /*
+         * Returns the count left, the caller that sees 0 is the one that deletes the node.
+         */
+        size_t decrementReferenceCount(void)
         {
-            if (this->reference_count > 0)
+            size_t count = this->reference_count.load(std::memory_order_relaxed);
+
+            while (count > 0 && !this->reference_count.compare_exchange_weak(count, count - 1, std::memory_order_acq_rel))
             {
-                this->reference_count--;
             }
+
+            return count > 0 ? count - 1 : 0;
         }
 
         T getColumns(void) const
@@ -86,7 +97,17 @@ class DimensionsProperties
 
         size_t getReferenceCount(void) const
         {
-            return this->reference_count;
+            return this->reference_count.load(std::memory_order_acquire);
+        }
+
+        bool isInterned(void) const
+        {
+            return this->interned;
+        }
+
+        void setInterned(void)
+        {
+            this->interned = true;
         }
 
         void setColumns(T c)
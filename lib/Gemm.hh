@@ -0,0 +1,1175 @@
+/*
+ * Numcy/lib/Gemm.hh
+ *
+ * Host side GEMM engine, C = alpha * (op(A) * op(B)) + beta * C, for row-major flat buffers.
+ * Numcy::matmul() is a thin shape checking wrapper around NumcyGemm::gemm_host().
+ *
+ * Q@hackers.pk
+ */
+
+#ifndef NUMCY_GEMM_HH
+#define NUMCY_GEMM_HH
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <type_traits>
+#include <vector>
+
+/*
+    GotoBLAS / BLIS style layered GEMM
+    ----------------------------------
+    The legacy Numcy::matmul() walked i-j-k through bounds checked operator[]. Every
+    multiply-add re-read A and B from wherever they happened to be in the cache hierarchy.
+    Here the product is broken into blocks that each fit one cache level and the blocks
+    are copied ("packed") into contiguous buffers in exactly the order the micro-kernel
+    reads them.
+
+        for jc in [0, n) step NC          ─► B block (KC x NC) lives in L3
+          for pc in [0, k) step KC
+            pack B[pc:pc+KC, jc:jc+NC]    ─► B_packed, micro-panels of NR columns
+            for ic in [0, m) step MC      ─► A block (MC x KC) lives in L2
+              pack A[ic:ic+MC, pc:pc+KC]  ─► A_packed, micro-panels of MR rows
+              for jr in [0, NC) step NR   ─► one B micro-panel (KC x NR) lives in L1
+                for ir in [0, MC) step MR
+                  micro_kernel()          ─► MR x NR tile of C lives in registers
+
+    Packing pads partial micro-panels with zeros, so the micro-kernel always computes a
+    full MR x NR tile. Edge tiles are computed into a small local tile and only the valid
+    part is merged back into C.
+
+    Transposition
+    -------------
+    A and B are addressed through a row stride and a column stride, element (i, p) of A is
+    a[i * rsa + p * csa]. A row-major m x k matrix has (rsa, csa) = (k, 1); the transpose of a
+    row-major k x m matrix is the same m x k operand with (rsa, csa) = (1, m). Packing reads
+    through the strides and writes the same micro-panel layout either way, so op(A) = A^T
+    and op(B) = B^T never materialize a transposed copy.
+ */
+namespace NumcyGemm
+{
+    /*
+        Blocking parameters
+        -------------------
+        MR x NR — register tile. For the AVX2/FMA kernels, 6 rows x 2 vectors = 12 accumulators,
+                  plus 2 registers for B and 1 for the broadcast A value, out of 16 ymm registers.
+        KC      — depth of a packed panel. KC * NR * sizeof(T) of B micro-panel stays in L1.
+        MC      — height of a packed A block. MC * KC * sizeof(T) (about 144 KB) stays in L2.
+        NC      — width of a packed B block. KC * NC * sizeof(T) stays in L3.
+
+        MC must be a multiple of MR and NC must be a multiple of NR.
+     */
+    template <typename T>
+    struct Blocking
+    {
+        static constexpr size_t MR = 4;
+        static constexpr size_t NR = 4;
+        static constexpr size_t KC = 256;
+        static constexpr size_t MC = 128;
+        static constexpr size_t NC = 2048;
+    };
+
+    template <>
+    struct Blocking<double>
+    {
+        static constexpr size_t MR = 6;
+        static constexpr size_t NR = 8;
+        static constexpr size_t KC = 256;
+        static constexpr size_t MC = 72;
+        static constexpr size_t NC = 2048;
+    };
+
+    template <>
+    struct Blocking<float>
+    {
+        static constexpr size_t MR = 6;
+        static constexpr size_t NR = 16;
+        static constexpr size_t KC = 256;
+        static constexpr size_t MC = 144;
+        static constexpr size_t NC = 2048;
+    };
+
+    /*
+        Below this many floating point operations (2 * m * n * k) the product runs on the calling
+        thread only, starting threads would cost more than the arithmetic.
+     */
+    constexpr size_t GEMM_PARALLEL_THRESHOLD = 2 * 64 * 64 * 64;
+
+    /*
+        pack_a()
+        ├─► Copies the mc x kc block of A starting at a into micro-panels of MR rows,
+        │   element (i, p) of the block is a[i * rsa + p * csa].
+        └─► Within a micro-panel the MR values of one column of A are contiguous:
+
+                packed[p * MR + r] = A[r][p]    (r < MR, p < kc)
+
+            Rows past mc are padded with zeros. P is the type the micro-kernel computes in, a
+            bfloat16/float16 A is widened to float here, one panel at a time.
+     */
+    template <typename T, typename P>
+    void pack_a(size_t mc, size_t kc, const T* a, size_t rsa, size_t csa, P* packed)
+    {
+        constexpr size_t MR = Blocking<P>::MR;
+
+        for (size_t i = 0; i < mc; i += MR)
+        {
+            size_t rows = std::min(MR, mc - i);
+
+            for (size_t p = 0; p < kc; p++)
+            {
+                for (size_t r = 0; r < rows; r++)
+                {
+                    packed[p * MR + r] = a[(i + r) * rsa + p * csa];
+                }
+                for (size_t r = rows; r < MR; r++)
+                {
+                    packed[p * MR + r] = P(0);
+                }
+            }
+
+            packed = packed + kc * MR;
+        }
+    }
+
+    /*
+        pack_b()
+        ├─► Copies the kc x nc block of B starting at b into micro-panels of NR columns,
+        │   element (p, j) of the block is b[p * rsb + j * csb].
+        └─► Within a micro-panel the NR values of one row of B are contiguous:
+
+                packed[p * NR + c] = B[p][c]    (c < NR, p < kc)
+
+            Columns past nc are padded with zeros.
+     */
+    template <typename T, typename P>
+    void pack_b(size_t kc, size_t nc, const T* b, size_t rsb, size_t csb, P* packed)
+    {
+        constexpr size_t NR = Blocking<P>::NR;
+
+        for (size_t j = 0; j < nc; j += NR)
+        {
+            size_t cols = std::min(NR, nc - j);
+
+            for (size_t p = 0; p < kc; p++)
+            {
+                const T* row = b + p * rsb + j * csb;
+
+                for (size_t c = 0; c < cols; c++)
+                {
+                    packed[p * NR + c] = row[c * csb];
+                }
+                for (size_t c = cols; c < NR; c++)
+                {
+                    packed[p * NR + c] = P(0);
+                }
+            }
+
+            packed = packed + kc * NR;
+        }
+    }
+
+    /*
+        micro_kernel()
+        ├─► c[MR x NR] = alpha * (a_panel * b_panel) + beta * c[MR x NR]
+        └─► When beta is zero c is never read, so an uninitialized output buffer is fine
+            (and NaN garbage in it does not leak into the result).
+
+        This is the portable version. It keeps the MR x NR tile in a local array that the
+        compiler can keep in registers and auto-vectorize. micro_kernel_avx2() below is the
+        explicit AVX2/FMA code for float and double, used when the CPU has it.
+     */
+    template <typename T>
+    void micro_kernel(size_t kc, const T* a, const T* b, T* c, size_t ldc, T alpha, T beta)
+    {
+        constexpr size_t MR = Blocking<T>::MR;
+        constexpr size_t NR = Blocking<T>::NR;
+
+        T ab[MR * NR] = {};
+
+        for (size_t p = 0; p < kc; p++)
+        {
+            for (size_t i = 0; i < MR; i++)
+            {
+                const T a_ip = a[p * MR + i];
+
+                for (size_t j = 0; j < NR; j++)
+                {
+                    ab[i * NR + j] += a_ip * b[p * NR + j];
+                }
+            }
+        }
+
+        for (size_t i = 0; i < MR; i++)
+        {
+            for (size_t j = 0; j < NR; j++)
+            {
+                if (beta == T(0))
+                {
+                    c[i * ldc + j] = alpha * ab[i * NR + j];
+                }
+                else
+                {
+                    c[i * ldc + j] = alpha * ab[i * NR + j] + beta * c[i * ldc + j];
+                }
+            }
+        }
+    }
+
+#if defined(NUMCY_X86)
+    /*
+        6 x 8 double micro-kernel, each row of the C tile is two ymm registers.
+        Per k step: 2 loads of B, 6 broadcasts of A, 12 FMAs.
+     */
+    NUMCY_TARGET("avx2,fma")
+    inline void micro_kernel_avx2(size_t kc, const double* a, const double* b, double* c, size_t ldc, double alpha, double beta)
+    {
+        __m256d c00 = _mm256_setzero_pd(), c01 = _mm256_setzero_pd();
+        __m256d c10 = _mm256_setzero_pd(), c11 = _mm256_setzero_pd();
+        __m256d c20 = _mm256_setzero_pd(), c21 = _mm256_setzero_pd();
+        __m256d c30 = _mm256_setzero_pd(), c31 = _mm256_setzero_pd();
+        __m256d c40 = _mm256_setzero_pd(), c41 = _mm256_setzero_pd();
+        __m256d c50 = _mm256_setzero_pd(), c51 = _mm256_setzero_pd();
+
+        for (size_t p = 0; p < kc; p++)
+        {
+            __m256d b0 = _mm256_loadu_pd(b);
+            __m256d b1 = _mm256_loadu_pd(b + 4);
+            __m256d ai;
+
+            ai = _mm256_broadcast_sd(a + 0); c00 = _mm256_fmadd_pd(ai, b0, c00); c01 = _mm256_fmadd_pd(ai, b1, c01);
+            ai = _mm256_broadcast_sd(a + 1); c10 = _mm256_fmadd_pd(ai, b0, c10); c11 = _mm256_fmadd_pd(ai, b1, c11);
+            ai = _mm256_broadcast_sd(a + 2); c20 = _mm256_fmadd_pd(ai, b0, c20); c21 = _mm256_fmadd_pd(ai, b1, c21);
+            ai = _mm256_broadcast_sd(a + 3); c30 = _mm256_fmadd_pd(ai, b0, c30); c31 = _mm256_fmadd_pd(ai, b1, c31);
+            ai = _mm256_broadcast_sd(a + 4); c40 = _mm256_fmadd_pd(ai, b0, c40); c41 = _mm256_fmadd_pd(ai, b1, c41);
+            ai = _mm256_broadcast_sd(a + 5); c50 = _mm256_fmadd_pd(ai, b0, c50); c51 = _mm256_fmadd_pd(ai, b1, c51);
+
+            a = a + 6;
+            b = b + 8;
+        }
+
+        __m256d acc[12] = {c00, c01, c10, c11, c20, c21, c30, c31, c40, c41, c50, c51};
+        __m256d va = _mm256_set1_pd(alpha);
+        __m256d vb = _mm256_set1_pd(beta);
+
+        for (size_t i = 0; i < 6; i++)
+        {
+            for (size_t j = 0; j < 2; j++)
+            {
+                double* cij = c + i * ldc + j * 4;
+                __m256d r = _mm256_mul_pd(va, acc[i * 2 + j]);
+
+                if (beta != 0.0)
+                {
+                    r = _mm256_fmadd_pd(vb, _mm256_loadu_pd(cij), r);
+                }
+
+                _mm256_storeu_pd(cij, r);
+            }
+        }
+    }
+
+    /*
+        6 x 16 float micro-kernel, each row of the C tile is two ymm registers.
+        Per k step: 2 loads of B, 6 broadcasts of A, 12 FMAs.
+     */
+    NUMCY_TARGET("avx2,fma")
+    inline void micro_kernel_avx2(size_t kc, const float* a, const float* b, float* c, size_t ldc, float alpha, float beta)
+    {
+        __m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps();
+        __m256 c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+        __m256 c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps();
+        __m256 c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+        __m256 c40 = _mm256_setzero_ps(), c41 = _mm256_setzero_ps();
+        __m256 c50 = _mm256_setzero_ps(), c51 = _mm256_setzero_ps();
+
+        for (size_t p = 0; p < kc; p++)
+        {
+            __m256 b0 = _mm256_loadu_ps(b);
+            __m256 b1 = _mm256_loadu_ps(b + 8);
+            __m256 ai;
+
+            ai = _mm256_broadcast_ss(a + 0); c00 = _mm256_fmadd_ps(ai, b0, c00); c01 = _mm256_fmadd_ps(ai, b1, c01);
+            ai = _mm256_broadcast_ss(a + 1); c10 = _mm256_fmadd_ps(ai, b0, c10); c11 = _mm256_fmadd_ps(ai, b1, c11);
+            ai = _mm256_broadcast_ss(a + 2); c20 = _mm256_fmadd_ps(ai, b0, c20); c21 = _mm256_fmadd_ps(ai, b1, c21);
+            ai = _mm256_broadcast_ss(a + 3); c30 = _mm256_fmadd_ps(ai, b0, c30); c31 = _mm256_fmadd_ps(ai, b1, c31);
+            ai = _mm256_broadcast_ss(a + 4); c40 = _mm256_fmadd_ps(ai, b0, c40); c41 = _mm256_fmadd_ps(ai, b1, c41);
+            ai = _mm256_broadcast_ss(a + 5); c50 = _mm256_fmadd_ps(ai, b0, c50); c51 = _mm256_fmadd_ps(ai, b1, c51);
+
+            a = a + 6;
+            b = b + 16;
+        }
+
+        __m256 acc[12] = {c00, c01, c10, c11, c20, c21, c30, c31, c40, c41, c50, c51};
+        __m256 va = _mm256_set1_ps(alpha);
+        __m256 vb = _mm256_set1_ps(beta);
+
+        for (size_t i = 0; i < 6; i++)
+        {
+            for (size_t j = 0; j < 2; j++)
+            {
+                float* cij = c + i * ldc + j * 8;
+                __m256 r = _mm256_mul_ps(va, acc[i * 2 + j]);
+
+                if (beta != 0.0f)
+                {
+                    r = _mm256_fmadd_ps(vb, _mm256_loadu_ps(cij), r);
+                }
+
+                _mm256_storeu_ps(cij, r);
+            }
+        }
+    }
+#endif
+
+    template <typename T>
+    using MicroKernel = void (*)(size_t, const T*, const T*, T*, size_t, T, T);
+
+    /*
+        resolve_micro_kernel<T>()
+        ├─► the best micro-kernel the CPU runs, the portable template for a T without variants
+        └─► called once per T by micro_kernel_for<T>(), macro_kernel() calls through the pointer.
+            There is no AVX-512 micro-kernel, MR x NR is compile time blocking sized for 16 ymm
+            registers, an AVX-512 CPU runs the AVX2 one.
+     */
+    template <typename T>
+    MicroKernel<T> resolve_micro_kernel(void)
+    {
+        return &micro_kernel<T>;
+    }
+
+    template <>
+    inline MicroKernel<double> resolve_micro_kernel<double>(void)
+    {
+        return NumcyCpu::select<MicroKernel<double>>("micro_kernel<double>", {
+#if defined(NUMCY_X86)
+            {NumcyCpu::features().fma, "avx2", &micro_kernel_avx2},
+#endif
+            {true, "portable", &micro_kernel<double>}
+        });
+    }
+
+    template <>
+    inline MicroKernel<float> resolve_micro_kernel<float>(void)
+    {
+        return NumcyCpu::select<MicroKernel<float>>("micro_kernel<float>", {
+#if defined(NUMCY_X86)
+            {NumcyCpu::features().fma, "avx2", &micro_kernel_avx2},
+#endif
+            {true, "portable", &micro_kernel<float>}
+        });
+    }
+
+    template <typename T>
+    MicroKernel<T> micro_kernel_for(void)
+    {
+        static const MicroKernel<T> kernel = resolve_micro_kernel<T>();
+
+        return kernel;
+    }
+
+    /*
+        macro_kernel()
+        ├─► Multiplies one packed A block (mc x kc) with one packed B block (kc x nc)
+        └─► Full tiles go straight to C, edge tiles go through a local MR x NR tile
+     */
+    template <typename T>
+    void macro_kernel(size_t mc, size_t nc, size_t kc, const T* a_packed, const T* b_packed, T* c, size_t ldc, T alpha, T beta)
+    {
+        constexpr size_t MR = Blocking<T>::MR;
+        constexpr size_t NR = Blocking<T>::NR;
+
+        const MicroKernel<T> kernel = micro_kernel_for<T>();
+
+        T edge[MR * NR];
+
+        for (size_t jr = 0; jr < nc; jr += NR)
+        {
+            size_t cols = std::min(NR, nc - jr);
+
+            for (size_t ir = 0; ir < mc; ir += MR)
+            {
+                size_t rows = std::min(MR, mc - ir);
+                T* c_tile = c + ir * ldc + jr;
+
+                if (rows == MR && cols == NR)
+                {
+                    kernel(kc, a_packed + ir * kc, b_packed + jr * kc, c_tile, ldc, alpha, beta);
+                }
+                else
+                {
+                    kernel(kc, a_packed + ir * kc, b_packed + jr * kc, edge, NR, alpha, T(0));
+
+                    for (size_t i = 0; i < rows; i++)
+                    {
+                        for (size_t j = 0; j < cols; j++)
+                        {
+                            if (beta == T(0))
+                            {
+                                c_tile[i * ldc + j] = edge[i * NR + j];
+                            }
+                            else
+                            {
+                                c_tile[i * ldc + j] = edge[i * NR + j] + beta * c_tile[i * ldc + j];
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    /*
+        gemm_batch_packed()
+        ├─► C_i[m x n] = alpha * (A_i[m x k] * B[k x n]) + beta * C_i[m x n], for i in [0, count), on the calling thread
+        ├─► A_i and B (elements of type T) are read through (row, column) strides, C_i (elements of
+        │   the compute type P) is row-major with leading dimension ldc
+        ├─► All A_i share one B. Each KC x NC block of B is packed once and then multiplied
+        │   with every A_i, so a broadcast B costs one packing pass however many batches use it.
+        └─► beta is applied only on the first pass over k, later passes accumulate (beta = 1)
+     */
+    template <typename T, typename P>
+    void gemm_batch_packed(size_t m, size_t n, size_t k, P alpha, const T* const* a, size_t rsa, size_t csa, const T* b, size_t rsb, size_t csb, P beta, P* const* c, size_t ldc, size_t count)
+    {
+        constexpr size_t KC = Blocking<P>::KC;
+        constexpr size_t MC = Blocking<P>::MC;
+        constexpr size_t NC = Blocking<P>::NC;
+        constexpr size_t MR = Blocking<P>::MR;
+        constexpr size_t NR = Blocking<P>::NR;
+
+        if (m == 0 || n == 0 || count == 0)
+        {
+            return;
+        }
+
+        if (k == 0)
+        {
+            // Empty product, C = beta * C
+            for (size_t batch = 0; batch < count; batch++)
+            {
+                for (size_t i = 0; i < m; i++)
+                {
+                    for (size_t j = 0; j < n; j++)
+                    {
+                        c[batch][i * ldc + j] = (beta == P(0)) ? P(0) : beta * c[batch][i * ldc + j];
+                    }
+                }
+            }
+
+            return;
+        }
+
+        // Sized to the problem rather than to the blocking parameters, small products stay small
+        std::vector<P> a_packed(((std::min(MC, m) + MR - 1) / MR) * MR * std::min(KC, k));
+        std::vector<P> b_packed(((std::min(NC, n) + NR - 1) / NR) * NR * std::min(KC, k));
+
+        for (size_t jc = 0; jc < n; jc += NC)
+        {
+            size_t nc = std::min(NC, n - jc);
+
+            for (size_t pc = 0; pc < k; pc += KC)
+            {
+                size_t kc = std::min(KC, k - pc);
+                P beta_pc = (pc == 0) ? beta : P(1);
+
+                pack_b(kc, nc, b + pc * rsb + jc * csb, rsb, csb, b_packed.data());
+
+                for (size_t batch = 0; batch < count; batch++)
+                {
+                    for (size_t ic = 0; ic < m; ic += MC)
+                    {
+                        size_t mc = std::min(MC, m - ic);
+
+                        pack_a(mc, kc, a[batch] + ic * rsa + pc * csa, rsa, csa, a_packed.data());
+                        macro_kernel(mc, nc, kc, a_packed.data(), b_packed.data(), c[batch] + ic * ldc + jc, ldc, alpha, beta_pc);
+                    }
+                }
+            }
+        }
+    }
+
+    /*
+        gemm_batch_serial()
+        ├─► Same contract as gemm_batch_packed() with C of the element type
+        └─► bfloat16/float16 → packing widens A and B to float, each C_i is widened into a float
+            buffer first (only when beta reads it) and narrowed once at the end, so the whole sum
+            over k accumulates in float and is rounded to 16 bits once per element
+     */
+    template <typename T>
+    void gemm_batch_serial(size_t m, size_t n, size_t k, T alpha, const T* const* a, size_t rsa, size_t csa, const T* b, size_t rsb, size_t csb, T beta, T* const* c, size_t ldc, size_t count)
+    {
+        typedef typename NumcyHalf::Accumulate<T>::type P;
+
+        if constexpr (std::is_same<T, P>::value)
+        {
+            gemm_batch_packed(m, n, k, alpha, a, rsa, csa, b, rsb, csb, beta, c, ldc, count);
+        }
+        else
+        {
+            P wide_beta = beta;
+            std::vector<P> wide(m * n);
+            P* wide_c = wide.data();
+
+            for (size_t batch = 0; batch < count; batch++)
+            {
+                if (wide_beta != P(0))
+                {
+                    for (size_t i = 0; i < m; i++)
+                    {
+                        NumcyHalf::convert(c[batch] + i * ldc, wide_c + i * n, n);
+                    }
+                }
+
+                gemm_batch_packed(m, n, k, P(alpha), a + batch, rsa, csa, b, rsb, csb, wide_beta, &wide_c, n, 1);
+
+                for (size_t i = 0; i < m; i++)
+                {
+                    NumcyHalf::convert(wide_c + i * n, c[batch] + i * ldc, n);
+                }
+            }
+        }
+    }
+
+    /*
+        gemm_serial()
+        └─► C[m x n] = alpha * (A[m x k] * B[k x n]) + beta * C[m x n], on the calling thread
+     */
+    template <typename T>
+    void gemm_serial(size_t m, size_t n, size_t k, T alpha, const T* a, size_t rsa, size_t csa, const T* b, size_t rsb, size_t csb, T beta, T* c, size_t ldc)
+    {
+        gemm_batch_serial(m, n, k, alpha, &a, rsa, csa, b, rsb, csb, beta, &c, ldc, 1);
+    }
+
+    /*
+        gemm_threads()
+        └─► How many threads a product of this many floating point operations is worth
+     */
+    inline size_t gemm_threads(size_t flops)
+    {
+        return flops < GEMM_PARALLEL_THRESHOLD ? 1 : NumcyThreads::getNumberOfThreads();
+    }
+
+    /*
+        gemm_batch_host()
+        ├─► Same contract as gemm_batch_serial(), every A_i shares one B
+        └─► Parallelization
+              C is split into a grid of tm x tn rectangles, aligned to MR rows and NR columns, as
+              many rectangles as threads, handed out by parallel_for() (a thread may run several).
+              Each rectangle runs gemm_batch_serial() on its part of every C_i with its own packing
+              buffers, so the threads never write to the same cache line of C and never wait on
+              each other. Every rectangle packs its own rows of A and columns of B, B is therefore
+              packed tm times in all and every A_i tn times.
+     */
+    template <typename T>
+    void gemm_batch_host(size_t m, size_t n, size_t k, T alpha, const T* const* a, size_t rsa, size_t csa, const T* b, size_t rsb, size_t csb, T beta, T* const* c, size_t ldc, size_t count)
+    {
+        constexpr size_t MR = Blocking<typename NumcyHalf::Accumulate<T>::type>::MR;
+        constexpr size_t NR = Blocking<typename NumcyHalf::Accumulate<T>::type>::NR;
+
+        size_t m_tiles = (m + MR - 1) / MR;
+        size_t n_tiles = (n + NR - 1) / NR;
+
+        size_t threads = std::min(gemm_threads(2 * m * n * k * count), m_tiles * n_tiles);
+
+        if (threads <= 1)
+        {
+            gemm_batch_serial(m, n, k, alpha, a, rsa, csa, b, rsb, csb, beta, c, ldc, count);
+
+            return;
+        }
+
+        // Prefer splitting M: B is then packed once per row of rectangles, but the count A_i,
+        // which outweigh the one B they share, are each packed only once per column of them
+        size_t tm = std::min(threads, m_tiles);
+        size_t tn = std::max(size_t(1), std::min(threads / tm, n_tiles));
+
+        size_t rows_per_thread = ((m_tiles + tm - 1) / tm) * MR;
+        size_t cols_per_thread = ((n_tiles + tn - 1) / tn) * NR;
+
+        NumcyThreads::parallel_for(0, tm * tn, 1, [=](size_t first, size_t last)
+        {
+            for (size_t rectangle = first; rectangle < last; rectangle++)
+            {
+                size_t i0 = (rectangle / tn) * rows_per_thread;
+                size_t j0 = (rectangle % tn) * cols_per_thread;
+
+                if (i0 >= m || j0 >= n)
+                {
+                    continue;
+                }
+
+                size_t mi = std::min(rows_per_thread, m - i0);
+                size_t nj = std::min(cols_per_thread, n - j0);
+
+                // This rectangle of every A_i and C_i
+                std::vector<const T*> a_part(count);
+                std::vector<T*> c_part(count);
+
+                for (size_t batch = 0; batch < count; batch++)
+                {
+                    a_part[batch] = a[batch] + i0 * rsa;
+                    c_part[batch] = c[batch] + i0 * ldc + j0;
+                }
+
+                gemm_batch_serial(mi, nj, k, alpha, a_part.data(), rsa, csa, b + j0 * csb, rsb, csb, beta, c_part.data(), ldc, count);
+            }
+        });
+    }
+
+    /*
+        gemm_host()
+        ├─► C[m x n] = alpha * (op(A)[m x k] * op(B)[k x n]) + beta * C[m x n]
+        ├─► A, B and C are row-major buffers with leading dimensions lda, ldb and ldc
+        └─► trans_a / trans_b select op(X) = X^T, the buffer then holds the k x m (n x k) matrix,
+              the transposition is absorbed by the packing strides
+     */
+    template <typename T>
+    void gemm_host(bool trans_a, bool trans_b, size_t m, size_t n, size_t k, T alpha, const T* a, size_t lda, const T* b, size_t ldb, T beta, T* c, size_t ldc)
+    {
+        gemm_batch_host(m, n, k, alpha, &a, trans_a ? 1 : lda, trans_a ? lda : 1, b, trans_b ? 1 : ldb, trans_b ? ldb : 1, beta, &c, ldc, 1);
+    }
+
+    template <typename T>
+    void gemm_host(size_t m, size_t n, size_t k, T alpha, const T* a, size_t lda, const T* b, size_t ldb, T beta, T* c, size_t ldc)
+    {
+        gemm_host(false, false, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+    }
+
+    /*
+        bgemm_host()
+        ├─► C_i[m x n] = alpha * (A_i[m x k] * B_i[k x n]) + beta * C_i[m x n], for i in [0, count)
+        ├─► A_i, B_i and C_i are row-major with leading dimensions lda, ldb and ldc
+        ├─► Batches whose B_i is the same pointer (a broadcast B) are grouped, so that B is packed
+        │   once per group instead of once per batch.
+        └─► Scheduling
+              ├─► many batches, or batches too small to split → parallel over batches,
+              │     each thread takes a contiguous run of batches and multiplies them serially
+              └─► few, large batches → one group at a time, parallel inside each GEMM
+     */
+    template <typename T>
+    void bgemm_host(size_t m, size_t n, size_t k, T alpha, const T* const* a, size_t lda, const T* const* b, size_t ldb, T beta, T* const* c, size_t ldc, size_t count)
+    {
+        /*
+            Groups the batches [first, last) by their B pointer and runs run(b, a_list, c_list, size)
+            once per distinct B. The order of batches inside a group is preserved.
+         */
+        auto for_each_group = [a, b, c](size_t first, size_t last, auto run)
+        {
+            std::vector<size_t> order;
+
+            for (size_t i = first; i < last; i++)
+            {
+                order.push_back(i);
+            }
+
+            std::stable_sort(order.begin(), order.end(), [b](size_t x, size_t y) { return std::less<const T*>()(b[x], b[y]); });
+
+            std::vector<const T*> a_group;
+            std::vector<T*> c_group;
+
+            for (size_t i = 0; i < order.size(); i++)
+            {
+                a_group.push_back(a[order[i]]);
+                c_group.push_back(c[order[i]]);
+
+                if (i + 1 == order.size() || b[order[i + 1]] != b[order[i]])
+                {
+                    run(b[order[i]], a_group.data(), c_group.data(), a_group.size());
+
+                    a_group.clear();
+                    c_group.clear();
+                }
+            }
+        };
+
+        size_t threads = gemm_threads(2 * m * n * k * count);
+        bool batch_parallel = threads > 1 && (count >= threads || 2 * m * n * k < GEMM_PARALLEL_THRESHOLD);
+
+        if (!batch_parallel)
+        {
+            for_each_group(0, count, [=](const T* b_group, const T* const* a_group, T* const* c_group, size_t size)
+            {
+                gemm_batch_host(m, n, k, alpha, a_group, lda, size_t(1), b_group, ldb, size_t(1), beta, c_group, ldc, size);
+            });
+
+            return;
+        }
+
+        threads = std::min(threads, count);
+
+        size_t per_thread = (count + threads - 1) / threads;
+
+        NumcyThreads::parallel_for(0, threads, 1, [=](size_t first_thread, size_t last_thread)
+        {
+            size_t first = std::min(count, first_thread * per_thread);
+            size_t last = std::min(count, last_thread * per_thread);
+
+            for_each_group(first, last, [=](const T* b_group, const T* const* a_group, T* const* c_group, size_t size)
+            {
+                gemm_batch_serial(m, n, k, alpha, a_group, lda, size_t(1), b_group, ldb, size_t(1), beta, c_group, ldc, size);
+            });
+        });
+    }
+
+    /*
+        Level 2, memory bound kernels
+        -----------------------------
+        A matrix-vector product reads every element of A exactly once and does one multiply-add
+        with it, so it runs at the speed of memory, not of the FPU. Nothing is packed; each row
+        is streamed once through a SIMD dot product with several independent accumulators (to
+        hide FMA latency), and rows are split across threads so that all memory channels are busy.
+     */
+
+    /*
+        run_parallel()
+        └─► Runs work(t) for t in [0, threads) on the global thread pool, the calling thread included,
+            and rethrows the first exception any of them threw. With as many t as pool threads, t
+            always runs on pool thread t (parallel_for_static()), so the rows t owns are read from
+            the same NUMA node on every call.
+     */
+    template <typename F>
+    void run_parallel(size_t threads, F work)
+    {
+        NumcyThreads::parallel_for_static(0, threads, 1, [&work](size_t first, size_t last)
+        {
+            for (size_t t = first; t < last; t++)
+            {
+                work(t);
+            }
+        });
+    }
+
+    /*
+        gemv_threads()
+        └─► How many threads a memory bound pass over this many elements is worth, a pass at or
+            below the pool's serial threshold runs on the calling thread only
+     */
+    inline size_t gemv_threads(size_t elements)
+    {
+        return NumcyThreads::threadsFor(elements);
+    }
+
+    /*
+        dot_portable()
+        └─► sum(x[i] * y[i]) for i in [0, n), four independent partial sums
+     */
+    template <typename T>
+    T dot_portable(size_t n, const T* x, const T* y)
+    {
+        T s0 = T(0), s1 = T(0), s2 = T(0), s3 = T(0);
+        size_t i = 0;
+
+        for (; i + 4 <= n; i += 4)
+        {
+            s0 += x[i + 0] * y[i + 0];
+            s1 += x[i + 1] * y[i + 1];
+            s2 += x[i + 2] * y[i + 2];
+            s3 += x[i + 3] * y[i + 3];
+        }
+        for (; i < n; i++)
+        {
+            s0 += x[i] * y[i];
+        }
+
+        return (s0 + s1) + (s2 + s3);
+    }
+
+#if defined(NUMCY_X86)
+    /*
+        16 doubles per iteration in four ymm accumulators
+     */
+    NUMCY_TARGET("avx2,fma")
+    inline double dot_avx2(size_t n, const double* x, const double* y)
+    {
+        __m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd(), s2 = _mm256_setzero_pd(), s3 = _mm256_setzero_pd();
+        size_t i = 0;
+
+        for (; i + 16 <= n; i += 16)
+        {
+            s0 = _mm256_fmadd_pd(_mm256_loadu_pd(x + i + 0), _mm256_loadu_pd(y + i + 0), s0);
+            s1 = _mm256_fmadd_pd(_mm256_loadu_pd(x + i + 4), _mm256_loadu_pd(y + i + 4), s1);
+            s2 = _mm256_fmadd_pd(_mm256_loadu_pd(x + i + 8), _mm256_loadu_pd(y + i + 8), s2);
+            s3 = _mm256_fmadd_pd(_mm256_loadu_pd(x + i + 12), _mm256_loadu_pd(y + i + 12), s3);
+        }
+        for (; i + 4 <= n; i += 4)
+        {
+            s0 = _mm256_fmadd_pd(_mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i), s0);
+        }
+
+        double lanes[4];
+        _mm256_storeu_pd(lanes, _mm256_add_pd(_mm256_add_pd(s0, s1), _mm256_add_pd(s2, s3)));
+
+        double sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+
+        for (; i < n; i++)
+        {
+            sum += x[i] * y[i];
+        }
+
+        return sum;
+    }
+
+    /*
+        32 floats per iteration in four ymm accumulators
+     */
+    NUMCY_TARGET("avx2,fma")
+    inline float dot_avx2(size_t n, const float* x, const float* y)
+    {
+        __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps(), s2 = _mm256_setzero_ps(), s3 = _mm256_setzero_ps();
+        size_t i = 0;
+
+        for (; i + 32 <= n; i += 32)
+        {
+            s0 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i + 0), _mm256_loadu_ps(y + i + 0), s0);
+            s1 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i + 8), _mm256_loadu_ps(y + i + 8), s1);
+            s2 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i + 16), _mm256_loadu_ps(y + i + 16), s2);
+            s3 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i + 24), _mm256_loadu_ps(y + i + 24), s3);
+        }
+        for (; i + 8 <= n; i += 8)
+        {
+            s0 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i), s0);
+        }
+
+        float lanes[8];
+        _mm256_storeu_ps(lanes, _mm256_add_ps(_mm256_add_ps(s0, s1), _mm256_add_ps(s2, s3)));
+
+        float sum = ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+
+        for (; i < n; i++)
+        {
+            sum += x[i] * y[i];
+        }
+
+        return sum;
+    }
+
+    /*
+        32 doubles per iteration in four zmm accumulators, the rest masked into the first one
+     */
+    NUMCY_TARGET("avx512f,avx512dq,avx512bw,avx512vl,avx2,fma")
+    inline double dot_avx512(size_t n, const double* x, const double* y)
+    {
+        __m512d s0 = _mm512_setzero_pd(), s1 = _mm512_setzero_pd(), s2 = _mm512_setzero_pd(), s3 = _mm512_setzero_pd();
+        size_t i = 0;
+
+        for (; i + 32 <= n; i += 32)
+        {
+            s0 = _mm512_fmadd_pd(_mm512_loadu_pd(x + i + 0), _mm512_loadu_pd(y + i + 0), s0);
+            s1 = _mm512_fmadd_pd(_mm512_loadu_pd(x + i + 8), _mm512_loadu_pd(y + i + 8), s1);
+            s2 = _mm512_fmadd_pd(_mm512_loadu_pd(x + i + 16), _mm512_loadu_pd(y + i + 16), s2);
+            s3 = _mm512_fmadd_pd(_mm512_loadu_pd(x + i + 24), _mm512_loadu_pd(y + i + 24), s3);
+        }
+        for (; i < n; i += 8)
+        {
+            __mmask8 mask = static_cast<__mmask8>(n - i >= 8 ? 0xFFU : (1U << (n - i)) - 1U);
+
+            s0 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(mask, x + i), _mm512_maskz_loadu_pd(mask, y + i), s0);
+        }
+
+        double lanes[8];
+        _mm512_storeu_pd(lanes, _mm512_add_pd(_mm512_add_pd(s0, s1), _mm512_add_pd(s2, s3)));
+
+        return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+    }
+
+    /*
+        64 floats per iteration in four zmm accumulators, the rest masked into the first one
+     */
+    NUMCY_TARGET("avx512f,avx512dq,avx512bw,avx512vl,avx2,fma")
+    inline float dot_avx512(size_t n, const float* x, const float* y)
+    {
+        __m512 s0 = _mm512_setzero_ps(), s1 = _mm512_setzero_ps(), s2 = _mm512_setzero_ps(), s3 = _mm512_setzero_ps();
+        size_t i = 0;
+
+        for (; i + 64 <= n; i += 64)
+        {
+            s0 = _mm512_fmadd_ps(_mm512_loadu_ps(x + i + 0), _mm512_loadu_ps(y + i + 0), s0);
+            s1 = _mm512_fmadd_ps(_mm512_loadu_ps(x + i + 16), _mm512_loadu_ps(y + i + 16), s1);
+            s2 = _mm512_fmadd_ps(_mm512_loadu_ps(x + i + 32), _mm512_loadu_ps(y + i + 32), s2);
+            s3 = _mm512_fmadd_ps(_mm512_loadu_ps(x + i + 48), _mm512_loadu_ps(y + i + 48), s3);
+        }
+        for (; i < n; i += 16)
+        {
+            __mmask16 mask = static_cast<__mmask16>(n - i >= 16 ? 0xFFFFU : (1U << (n - i)) - 1U);
+
+            s0 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, x + i), _mm512_maskz_loadu_ps(mask, y + i), s0);
+        }
+
+        float lanes[16];
+        _mm512_storeu_ps(lanes, _mm512_add_ps(_mm512_add_ps(s0, s1), _mm512_add_ps(s2, s3)));
+
+        float sum = 0.0f;
+
+        for (size_t lane = 0; lane < 16; lane += 4)
+        {
+            sum += (lanes[lane + 0] + lanes[lane + 1]) + (lanes[lane + 2] + lanes[lane + 3]);
+        }
+
+        return sum;
+    }
+#endif
+
+    template <typename T>
+    using DotKernel = typename NumcyHalf::Accumulate<T>::type (*)(size_t, const T*, const T*);
+
+    /*
+        resolve_dot<T>()
+        └─► the best dot product the CPU runs, dot_portable() for a T without variants
+     */
+    template <typename T>
+    DotKernel<T> resolve_dot(void)
+    {
+        return &dot_portable<T>;
+    }
+
+    template <>
+    inline DotKernel<double> resolve_dot<double>(void)
+    {
+        return NumcyCpu::select<DotKernel<double>>("dot<double>", {
+#if defined(NUMCY_X86)
+            {NumcyCpu::features().avx512, "avx512", &dot_avx512},
+            {NumcyCpu::features().fma, "avx2", &dot_avx2},
+#endif
+            {true, "portable", &dot_portable<double>}
+        });
+    }
+
+    template <>
+    inline DotKernel<float> resolve_dot<float>(void)
+    {
+        return NumcyCpu::select<DotKernel<float>>("dot<float>", {
+#if defined(NUMCY_X86)
+            {NumcyCpu::features().avx512, "avx512", &dot_avx512},
+            {NumcyCpu::features().fma, "avx2", &dot_avx2},
+#endif
+            {true, "portable", &dot_portable<float>}
+        });
+    }
+
+    /*
+        dot()
+        ├─► sum(x[i] * y[i]) for i in [0, n), accumulated in NumcyHalf::Accumulate<T>::type
+        └─► through the variant resolve_dot<T>() picked on the first call
+     */
+    template <typename T>
+    typename NumcyHalf::Accumulate<T>::type dot(size_t n, const T* x, const T* y)
+    {
+        static const DotKernel<T> kernel = resolve_dot<T>();
+
+        return kernel(n, x, y);
+    }
+
+    /*
+        dot() of two bfloat16/float16 vectors, the accumulation never leaves float
+        ├─► AVX512-BF16 (bfloat16) → vdpbf16ps, 32 products per instruction straight from the
+        │                            16 bit values
+        ├─► AVX-512 (float16)      → 16 values widened per load with vcvtph2ps
+        ├─► AVX2/FMA, F16C         → each load of 8 values is widened in registers and fed to the
+        │                            FMA, 32 values per iteration in four accumulators, the scan
+        │                            reads 2 bytes per element
+        └─► otherwise              → widened a block at a time on the stack and summed with dot()
+     */
+    template <typename H>
+    float dot_widened(size_t n, const H* x, const H* y)
+    {
+        constexpr size_t BLOCK = 256;
+
+        float wide_x[BLOCK], wide_y[BLOCK];
+        float sum = 0.0f;
+
+        for (size_t i = 0; i < n; i += BLOCK)
+        {
+            size_t count = std::min(BLOCK, n - i);
+
+            NumcyHalf::convert(x + i, wide_x, count);
+            NumcyHalf::convert(y + i, wide_y, count);
+
+            sum += dot(count, wide_x, wide_y);
+        }
+
+        return sum;
+    }
+
+#if defined(NUMCY_X86)
+    NUMCY_TARGET("avx2,fma,f16c")
+    inline __m256 load_widened(const numcy::bfloat16* p)
+    {
+        __m256i wide = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+
+        return _mm256_castsi256_ps(_mm256_slli_epi32(wide, 16));
+    }
+
+    NUMCY_TARGET("avx2,fma,f16c")
+    inline __m256 load_widened(const numcy::float16* p)
+    {
+        return _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+    }
+
+    template <typename H>
+    NUMCY_TARGET("avx2,fma,f16c")
+    float dot_fused_avx2(size_t n, const H* x, const H* y)
+    {
+        __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps(), s2 = _mm256_setzero_ps(), s3 = _mm256_setzero_ps();
+        size_t i = 0;
+
+        for (; i + 32 <= n; i += 32)
+        {
+            s0 = _mm256_fmadd_ps(load_widened(x + i + 0), load_widened(y + i + 0), s0);
+            s1 = _mm256_fmadd_ps(load_widened(x + i + 8), load_widened(y + i + 8), s1);
+            s2 = _mm256_fmadd_ps(load_widened(x + i + 16), load_widened(y + i + 16), s2);
+            s3 = _mm256_fmadd_ps(load_widened(x + i + 24), load_widened(y + i + 24), s3);
+        }
+        for (; i + 8 <= n; i += 8)
+        {
+            s0 = _mm256_fmadd_ps(load_widened(x + i), load_widened(y + i), s0);
+        }
+
+        float lanes[8];
+        _mm256_storeu_ps(lanes, _mm256_add_ps(_mm256_add_ps(s0, s1), _mm256_add_ps(s2, s3)));
+
+        float sum = ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+
+        for (; i < n; i++)
+        {
+            sum += float(x[i]) * float(y[i]);
+        }
+
+        return sum;
+    }
+
+    /*
+        16 float16 values of p widened to float, the ones outside mask zero. The zero masking
+        form, GCC 12's unmasked _mm512_cvtph_ps() trips -Wmaybe-uninitialized.
+     */
+    NUMCY_TARGET("avx512f,avx512dq,avx512bw,avx512vl,avx2,fma")
+    inline __m512 load_widened(const numcy::float16* p, __mmask16 mask)
+    {
+        return _mm512_maskz_cvtph_ps(mask, _mm256_maskz_loadu_epi16(mask, p));
+    }
+
+    NUMCY_TARGET("avx512f,avx512dq,avx512bw,avx512vl,avx2,fma")
+    inline float dot_avx512(size_t n, const numcy::float16* x, const numcy::float16* y)
+    {
+        __m512 s0 = _mm512_setzero_ps(), s1 = _mm512_setzero_ps();
+        size_t i = 0;
+
+        for (; i + 32 <= n; i += 32)
+        {
+            s0 = _mm512_fmadd_ps(load_widened(x + i, 0xFFFF), load_widened(y + i, 0xFFFF), s0);
+            s1 = _mm512_fmadd_ps(load_widened(x + i + 16, 0xFFFF), load_widened(y + i + 16, 0xFFFF), s1);
+        }
+        for (; i < n; i += 16)
+        {
+            __mmask16 mask = static_cast<__mmask16>(n - i >= 16 ? 0xFFFFU : (1U << (n - i)) - 1U);
+
+            s0 = _mm512_fmadd_ps(load_widened(x + i, mask), load_widened(y + i, mask), s0);
+        }
+
+        float lanes[16];
+        _mm512_storeu_ps(lanes, _mm512_add_ps(s0, s1));
+
+        float sum = 0.0f;
+
+        for (size_t lane = 0; lane < 16; lane += 4)
+        {
+            sum += (lanes[lane + 0] + lanes[lane + 1]) + (lanes[lane + 2] + lanes[lane + 3]);
+        }
+
+        return sum;
+    }
+
+    /*
+        vdpbf16ps multiplies pairs of bfloat16 and adds both products to a float lane, 32 values
+        of x and y per instruction. Subnormal inputs are treated as zero.
+     */
+    NUMCY_TARGET("avx512bf16,avx512f,avx512dq,avx512bw,avx512vl,avx2,fma")
+    inline float dot_avx512bf16(size_t n, const numcy::bfloat16* x, const numcy::bfloat16* y)
+    {
+        __m512 s0 = _mm512_setzero_ps(), s1 = _mm512_setzero_ps();
+        __m512bh a, b;
+        size_t i = 0;
+
+        for (; i + 64 <= n; i += 64)
+        {
+            std::memcpy(&a, x + i, sizeof(a));
+            std::memcpy(&b, y + i, sizeof(b));
+            s0 = _mm512_dpbf16_ps(s0, a, b);
+
+            std::memcpy(&a, x + i + 32, sizeof(a));
+            std::memcpy(&b, y + i + 32, sizeof(b));
+            s1 = _mm512_dpbf16_ps(s1, a, b);
+        }
+        for (; i < n; i += 32)
+        {
+            __mmask32 mask = n - i >= 32 ? 0xFFFFFFFFU : (1U << (n - i)) - 1U;
+            __m512i xi = _mm512_maskz_loadu_epi16(mask, x + i), yi = _mm512_maskz_loadu_epi16(mask, y + i);
+
+            std::memcpy(&a, &xi, sizeof(a));
+            std::memcpy(&b, &yi, sizeof(b));
+            s0 = _mm512_dpbf16_ps(s0, a, b);
+        }
+
+        float lanes[16];
+        _mm512_storeu_ps(lanes, _mm512_add_ps(s0, s1));
+
+        float sum = 0.0f;
+
+        for (size_t lane = 0; lane < 16; lane += 4)
+        {
+            sum += (lanes[lane + 0] + lanes[lane + 1]) + (lanes[lane + 2] + lanes[lane + 3]);
+        }
+
+        return sum;
+    }
+#endif
+
+    template <>
+    inline DotKernel<numcy::bfloat16> resolve_dot<numcy::bfloat16>(void)
+    {
+        return NumcyCpu::select<DotKernel<numcy::bfloat16>>("dot<bfloat16>", {
+#if defined(NUMCY_X86)
+            {NumcyCpu::features().avx512bf16, "avx512bf16", &dot_avx512bf16},
+            {NumcyCpu::features().fma && NumcyCpu::features().f16c, "avx2", &dot_fused_avx2<numcy::bfloat16>},
+#endif
+            {true, "portable", &dot_widened<numcy::bfloat16>}
+        });
+    }
+
+    template <>
+    inline DotKernel<numcy::float16> resolve_dot<numcy::float16>(void)
+    {
+        return NumcyCpu::select<DotKernel<numcy::float16>>("dot<float16>", {
+#if defined(NUMCY_X86)
+            {NumcyCpu::features().avx512, "avx512", &dot_avx512},
+            {NumcyCpu::features().fma && NumcyCpu::features().f16c, "avx2", &dot_fused_avx2<numcy::float16>},
+#endif
+            {true, "portable", &dot_widened<numcy::float16>}
+        });
+    }
+
+    /*
+        gemv_host()
+        ├─► y[m] = alpha * (A[m x n] * x[n]) + beta * y[m], A row-major with leading dimension lda
+        └─► rows are split into one contiguous range per thread
+     */
+    template <typename T>
+    void gemv_host(size_t m, size_t n, T alpha, const T* a, size_t lda, const T* x, T beta, T* y)
+    {
+        size_t threads = std::max(size_t(1), std::min(gemv_threads(m * n), m)); // At least one, there may be no rows
+        size_t per_thread = (m + threads - 1) / threads;
+
+        run_parallel(threads, [=](size_t t)
+        {
+            size_t first = t * per_thread;
+            size_t last = std::min(m, first + per_thread);
+
+            for (size_t i = first; i < last; i++)
+            {
+                typename NumcyHalf::Accumulate<T>::type r = alpha * dot(n, a + i * lda, x);
+
+                y[i] = (beta == T(0)) ? r : r + beta * y[i];
+            }
+        });
+    }
+}
+
+#endif
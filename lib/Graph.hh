@@ -0,0 +1,750 @@
+/*
+ * Numcy/lib/Graph.hh
+ *
+ * Deferred execution. Ops are recorded into a NumcyLazy::Graph instead of running, the graph is
+ * compiled for the outputs actually asked for and then run as a handful of fused loops.
+ * Numcy::Graph<T, E> names the same class.
+ *
+ * Q@hackers.pk
+ */
+
+#ifndef NUMCY_GRAPH_HH
+#define NUMCY_GRAPH_HH
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace NumcyLazy
+{
+    enum class Op
+    {
+        Input,
+        // Elementwise, binary (the smaller operand may be a row vector [1, n], a column vector [m, 1] or a scalar, broadcast over the other)
+        Add, Sub, Mul, Div,
+        // Elementwise, unary (Scale and Shift take a scalar: x * s, x + s)
+        Neg, Exp, Log, Sqrt, Relu, Scale, Shift,
+        // Reductions over the last axis, [..., n] → [..., 1]
+        Sum, Max, Mean,
+        // Matrix product, [..., m, k] x [k, n] → [..., m, n], never fused
+        MatMul
+    };
+
+    inline bool isElementwise(Op op)
+    {
+        return op >= Op::Add && op <= Op::Shift;
+    }
+
+    inline bool isReduction(Op op)
+    {
+        return op == Op::Sum || op == Op::Max || op == Op::Mean;
+    }
+
+    /*
+        How a kernel reads one operand at iteration point (row r, column c)
+     */
+    enum class Access
+    {
+        Inline, // computed earlier in the same fused loop, read from its tile
+        Full,   // buffer[r * cols + c]
+        Row,    // buffer[c]
+        Column, // buffer[r]
+        Scalar  // buffer[0]
+    };
+
+    constexpr size_t NONE = static_cast<size_t>(-1);
+
+    /*
+        Elements of a row processed per step of a fused loop. Every intermediate of the loop lives in
+        a tile of this size, small enough for all of them to stay in L1.
+     */
+    constexpr size_t TILE = 256;
+
+    template <typename T = double, typename E = size_t>
+    struct Node
+    {
+        Op op;
+        size_t a;
+        size_t b;
+        T scalar;
+        std::vector<E> shape;
+        Collective<T, E> source; // Op::Input only
+
+        Node(Op o, size_t x, size_t y, T s, const std::vector<E>& d) : op(o), a(x), b(y), scalar(s), shape(d), source()
+        {
+        }
+
+        size_t numel(void) const
+        {
+            size_t count = 1;
+
+            for (size_t i = 0; i < this->shape.size(); i++)
+            {
+                count = count * this->shape[i];
+            }
+
+            return count;
+        }
+
+        size_t columns(void) const
+        {
+            return this->shape.back();
+        }
+    };
+
+    /*
+        One loop of a compiled program
+        ├─► root     — the node this loop materializes
+        ├─► steps    — the nodes computed tile by tile inside the loop, in order, an elementwise root
+        │              is the last of them, a reduction root folds the last one (or its operand)
+        ├─► access_a / access_b — per step, how its operands are read
+        └─► rows x columns — the iteration space
+     */
+    struct Kernel
+    {
+        size_t root;
+        std::vector<size_t> steps;
+        std::vector<Access> access_a;
+        std::vector<Access> access_b;
+        Access reduce_access;
+        size_t rows;
+        size_t columns;
+
+        Kernel(size_t node) : root(node), steps(), access_a(), access_b(), reduce_access(Access::Full), rows(0), columns(0)
+        {
+        }
+    };
+
+    template <typename T, typename E>
+    class Graph;
+
+    /*
+        Program
+        -------
+        What Graph::compile() returns, run() may be called any number of times, it reads the input
+        collectives as they are at that moment. Every intermediate buffer is allocated once, here,
+        and shared between intermediates whose lifetimes do not overlap.
+
+        A copy-on-write input (see Collective::setCopyOnWrite()) is captured as it was when
+        Graph::input() took it: the graph holds a handle of its own, a later write through the
+        caller's handle detaches the caller's, and run() keeps reading the values input() saw.
+        run() never writes to an input and never copies one.
+
+        getNumberOfKernels()  — loops run per run(), after fusion
+        getPlannedBytes()     — bytes of intermediate buffers after memory planning
+        getUnplannedBytes()   — bytes eager execution would allocate for the same intermediates
+     */
+    template <typename T = double, typename E = size_t>
+    class Program
+    {
+        friend class Graph<T, E>;
+
+        std::vector<Node<T, E>> nodes;
+        std::vector<Kernel> kernels;
+        std::vector<size_t> outputs;
+        std::vector<size_t> slot_of;          // node → slot, NONE when the node has no planned buffer
+        std::vector<std::vector<T>> slots;
+        size_t unplanned_bytes;
+
+        static const T* _fetch(Access access, const T* buffer, const T* inlined, size_t r, size_t c0, size_t count, size_t columns, T* scratch)
+        {
+            switch (access)
+            {
+                case Access::Inline:
+                    return inlined;
+                case Access::Full:
+                    return buffer + r * columns + c0;
+                case Access::Row:
+                    return buffer + c0;
+                case Access::Column:
+                    std::fill(scratch, scratch + count, buffer[r]);
+                    return scratch;
+                case Access::Scalar:
+                    std::fill(scratch, scratch + count, buffer[0]);
+                    return scratch;
+            }
+
+            return nullptr;
+        }
+
+        static void _apply(Op op, T s, const T* x, const T* y, T* out, size_t count)
+        {
+            switch (op)
+            {
+                case Op::Add:   for (size_t i = 0; i < count; i++) out[i] = x[i] + y[i]; break;
+                case Op::Sub:   for (size_t i = 0; i < count; i++) out[i] = x[i] - y[i]; break;
+                case Op::Mul:   for (size_t i = 0; i < count; i++) out[i] = x[i] * y[i]; break;
+                case Op::Div:   for (size_t i = 0; i < count; i++) out[i] = x[i] / y[i]; break;
+                case Op::Neg:   for (size_t i = 0; i < count; i++) out[i] = -x[i]; break;
+                case Op::Exp:   for (size_t i = 0; i < count; i++) out[i] = std::exp(x[i]); break;
+                case Op::Log:   for (size_t i = 0; i < count; i++) out[i] = std::log(x[i]); break;
+                case Op::Sqrt:  for (size_t i = 0; i < count; i++) out[i] = std::sqrt(x[i]); break;
+                case Op::Relu:  for (size_t i = 0; i < count; i++) out[i] = x[i] > T(0) ? x[i] : T(0); break;
+                case Op::Scale: for (size_t i = 0; i < count; i++) out[i] = x[i] * s; break;
+                case Op::Shift: for (size_t i = 0; i < count; i++) out[i] = x[i] + s; break;
+                default: break;
+            }
+        }
+
+        /*
+            One fused loop: every row of the iteration space, TILE columns at a time, each step
+            computed into its own tile, the last one written out (or folded, for a reduction)
+         */
+        void _runFused(const Kernel& kernel, const std::vector<T*>& buffers) const
+        {
+            const Node<T, E>& root = this->nodes[kernel.root];
+            size_t rows = kernel.rows, columns = kernel.columns;
+            size_t steps = kernel.steps.size();
+            size_t grain = std::max(size_t(1), NumcyThreads::ThreadPool::global().getSerialThreshold() / columns);
+
+            NumcyThreads::parallel_for(0, rows, grain, [&, rows, columns, steps](size_t first, size_t last)
+            {
+                // Per step: its output tile and two tiles for broadcast operands
+                std::vector<T> scratch(3 * TILE * (steps + 1));
+                std::vector<size_t> step_of(this->nodes.size(), NONE);
+
+                for (size_t i = 0; i < steps; i++)
+                {
+                    step_of[kernel.steps[i]] = i;
+                }
+
+                auto tile = [&scratch](size_t step, size_t which) { return scratch.data() + (3 * step + which) * TILE; };
+
+                for (size_t r = first; r < last; r++)
+                {
+                    T accumulator = root.op == Op::Max ? -std::numeric_limits<T>::infinity() : T(0);
+
+                    for (size_t c0 = 0; c0 < columns; c0 += TILE)
+                    {
+                        size_t count = std::min(TILE, columns - c0);
+
+                        for (size_t i = 0; i < steps; i++)
+                        {
+                            const Node<T, E>& node = this->nodes[kernel.steps[i]];
+
+                            const T* x = _fetch(kernel.access_a[i], buffers[node.a], node.a != NONE && step_of[node.a] != NONE ? tile(step_of[node.a], 0) : nullptr, r, c0, count, columns, tile(i, 1));
+                            const T* y = node.b == NONE ? nullptr : _fetch(kernel.access_b[i], buffers[node.b], step_of[node.b] != NONE ? tile(step_of[node.b], 0) : nullptr, r, c0, count, columns, tile(i, 2));
+
+                            // The root of an elementwise loop is written straight into its buffer
+                            T* out = kernel.steps[i] == kernel.root ? buffers[kernel.root] + r * columns + c0 : tile(i, 0);
+
+                            _apply(node.op, node.scalar, x, y, out, count);
+                        }
+
+                        if (isReduction(root.op))
+                        {
+                            const T* v = _fetch(kernel.reduce_access, buffers[root.a], step_of[root.a] != NONE ? tile(step_of[root.a], 0) : nullptr, r, c0, count, columns, tile(steps, 1));
+
+                            if (root.op == Op::Max)
+                            {
+                                for (size_t i = 0; i < count; i++)
+                                {
+                                    accumulator = v[i] > accumulator ? v[i] : accumulator;
+                                }
+                            }
+                            else
+                            {
+                                for (size_t i = 0; i < count; i++)
+                                {
+                                    accumulator = accumulator + v[i];
+                                }
+                            }
+                        }
+                    }
+
+                    if (root.op == Op::Mean)
+                    {
+                        accumulator = accumulator / static_cast<T>(columns);
+                    }
+
+                    if (isReduction(root.op))
+                    {
+                        buffers[kernel.root][r] = accumulator;
+                    }
+                }
+            });
+        }
+
+        Program(void) : nodes(), kernels(), outputs(), slot_of(), slots(), unplanned_bytes(0)
+        {
+        }
+
+        public:
+            size_t getNumberOfKernels(void) const
+            {
+                return this->kernels.size();
+            }
+
+            size_t getPlannedBytes(void) const
+            {
+                size_t bytes = 0;
+
+                for (size_t i = 0; i < this->slots.size(); i++)
+                {
+                    bytes = bytes + this->slots[i].size() * sizeof(T);
+                }
+
+                return bytes;
+            }
+
+            size_t getUnplannedBytes(void) const
+            {
+                return this->unplanned_bytes;
+            }
+
+            /*
+                run()
+                ├─► outputs are fresh host collectives, in the order given to compile() (an output
+                │   that is an input is that input collective itself)
+                └─► kernels run in order, each fused loop and each matmul parallel on the thread pool
+             */
+            std::vector<Collective<T, E>> run(void)
+            {
+                NUMCY_TRACE_OP("Graph::run");
+                NUMCY_MEMORY_SITE("Graph::run");
+
+                std::vector<Collective<T, E>> results;
+                std::vector<T*> buffers(this->nodes.size(), nullptr);
+
+                for (size_t i = 0; i < this->nodes.size(); i++)
+                {
+                    if (this->nodes[i].op == Op::Input)
+                    {
+                        // Read through a const handle, the non-const getData() would detach a copy-on-write input
+                        const Collective<T, E>& source = this->nodes[i].source;
+
+                        buffers[i] = source.getData();
+                    }
+                    else if (this->slot_of[i] != NONE)
+                    {
+                        buffers[i] = this->slots[this->slot_of[i]].data();
+                    }
+                }
+
+                for (size_t i = 0; i < this->outputs.size(); i++)
+                {
+                    const Node<T, E>& node = this->nodes[this->outputs[i]];
+
+                    if (node.op == Op::Input)
+                    {
+                        results.push_back(node.source);
+
+                        continue;
+                    }
+
+                    Dimensions<E> d;
+                    d.fromVector(node.shape);
+
+                    results.push_back(Collective<T, E>(d, MemoryLocation::Host));
+                    buffers[this->outputs[i]] = results.back().getData();
+                }
+
+                for (size_t k = 0; k < this->kernels.size(); k++)
+                {
+                    const Kernel& kernel = this->kernels[k];
+                    const Node<T, E>& root = this->nodes[kernel.root];
+
+                    if (root.op == Op::MatMul)
+                    {
+                        const Node<T, E>& a = this->nodes[root.a];
+                        size_t m = a.numel() / a.columns(), kk = a.columns(), n = root.columns();
+
+                        NumcyGemm::gemm_host(m, n, kk, T(1), buffers[root.a], kk, buffers[root.b], n, T(0), buffers[kernel.root], n);
+                    }
+                    else
+                    {
+                        this->_runFused(kernel, buffers);
+                    }
+                }
+
+                return results;
+            }
+    };
+
+    /*
+        Graph
+        -----
+        Records ops on Collectives, nothing is computed until evaluate() (or compile() and run()).
+        Every method returns the id of the value it records, ids are what later ops and the output
+        list take.
+
+            NumcyLazy::Graph<float> g;
+            size_t x = g.input(activations), w = g.input(weights), b = g.input(bias);
+            size_t h = g.relu(g.add(g.matmul(x, w), b));                 // one matmul, one fused loop
+            size_t p = g.exp(g.sub(h, g.max(h)));
+            std::vector<Collective<float>> out = g.evaluate({g.div(p, g.sum(p))});
+
+        compile(outputs)
+        ├─► dead code elimination, only what the outputs depend on is kept
+        ├─► fusion, an elementwise value with exactly one consumer, which is elementwise or a
+        │   reduction over the same iteration space, and which is not an output, is never stored:
+        │   it is computed tile by tile inside its consumer's loop. A chain like relu(x * s + b)
+        │   followed by sum() is one read of x and one write of the row sums.
+        ├─► memory planning, every value that still needs a buffer and is not an output gets one of
+        │   a set of slots; a slot is handed back after the last loop that reads its value, and the
+        │   next value that fits takes it over
+        └─► a Program, run() as often as needed
+     */
+    template <typename T = double, typename E = size_t>
+    class Graph
+    {
+        std::vector<Node<T, E>> nodes;
+
+        size_t _record(Op op, size_t a, size_t b, T scalar, const std::vector<E>& shape)
+        {
+            this->nodes.push_back(Node<T, E>(op, a, b, scalar, shape));
+
+            return this->nodes.size() - 1;
+        }
+
+        const Node<T, E>& _at(size_t id, const char* caller) const
+        {
+            if (id >= this->nodes.size())
+            {
+                throw std::runtime_error(std::string("NumcyLazy::Graph<T, E>::") + caller + " Error: unknown value id");
+            }
+
+            return this->nodes[id];
+        }
+
+        /*
+            How an operand of the given shape is read over an iteration space of rows x columns
+         */
+        static Access _accessFor(const Node<T, E>& operand, size_t rows, size_t columns)
+        {
+            size_t numel = operand.numel();
+
+            if (numel == rows * columns)
+            {
+                return Access::Full;
+            }
+            if (numel == 1)
+            {
+                return Access::Scalar;
+            }
+            if (numel == columns && operand.columns() == columns)
+            {
+                return Access::Row;
+            }
+            if (numel == rows && operand.columns() == 1)
+            {
+                return Access::Column;
+            }
+
+            throw std::runtime_error("NumcyLazy::Graph<T, E> Error: operand does not broadcast over the iteration space");
+        }
+
+        size_t _binary(Op op, size_t a, size_t b, const char* caller)
+        {
+            const Node<T, E>& x = this->_at(a, caller);
+            const Node<T, E>& y = this->_at(b, caller);
+            const std::vector<E>& shape = x.numel() >= y.numel() ? x.shape : y.shape;
+
+            size_t columns = shape.back();
+            size_t rows = x.numel() >= y.numel() ? x.numel() / columns : y.numel() / columns;
+
+            try
+            {
+                if (x.numel() == y.numel() && x.shape != y.shape)
+                {
+                    throw std::runtime_error("Error: operands have the same number of elements but different shapes");
+                }
+
+                _accessFor(x, rows, columns);
+                _accessFor(y, rows, columns);
+            }
+            catch (std::runtime_error& e)
+            {
+                throw std::runtime_error(std::string("NumcyLazy::Graph<T, E>::") + caller + " -> " + e.what());
+            }
+
+            return this->_record(op, a, b, T(0), shape);
+        }
+
+        size_t _unary(Op op, size_t a, T scalar, const char* caller)
+        {
+            std::vector<E> shape = this->_at(a, caller).shape;
+
+            return this->_record(op, a, NONE, scalar, shape);
+        }
+
+        size_t _reduction(Op op, size_t a, const char* caller)
+        {
+            std::vector<E> shape = this->_at(a, caller).shape;
+
+            shape.back() = E(1);
+
+            return this->_record(op, a, NONE, T(0), shape);
+        }
+
+        public:
+            Graph(void) : nodes()
+            {
+            }
+
+            size_t input(const Collective<T, E>& c)
+            {
+                if (c.getMemoryLocation() != MemoryLocation::Host)
+                {
+                    throw std::runtime_error("NumcyLazy::Graph<T, E>::input(const Collective<T, E>&) Error: only host collectives are supported");
+                }
+
+                size_t id = this->_record(Op::Input, NONE, NONE, T(0), c.getShape().toVector());
+                this->nodes[id].source = c;
+
+                return id;
+            }
+
+            size_t add(size_t a, size_t b) { return this->_binary(Op::Add, a, b, "add(size_t, size_t)"); }
+            size_t sub(size_t a, size_t b) { return this->_binary(Op::Sub, a, b, "sub(size_t, size_t)"); }
+            size_t mul(size_t a, size_t b) { return this->_binary(Op::Mul, a, b, "mul(size_t, size_t)"); }
+            size_t div(size_t a, size_t b) { return this->_binary(Op::Div, a, b, "div(size_t, size_t)"); }
+
+            size_t neg(size_t a) { return this->_unary(Op::Neg, a, T(0), "neg(size_t)"); }
+            size_t exp(size_t a) { return this->_unary(Op::Exp, a, T(0), "exp(size_t)"); }
+            size_t log(size_t a) { return this->_unary(Op::Log, a, T(0), "log(size_t)"); }
+            size_t sqrt(size_t a) { return this->_unary(Op::Sqrt, a, T(0), "sqrt(size_t)"); }
+            size_t relu(size_t a) { return this->_unary(Op::Relu, a, T(0), "relu(size_t)"); }
+            size_t scale(size_t a, T s) { return this->_unary(Op::Scale, a, s, "scale(size_t, T)"); }
+            size_t shift(size_t a, T s) { return this->_unary(Op::Shift, a, s, "shift(size_t, T)"); }
+
+            size_t sum(size_t a) { return this->_reduction(Op::Sum, a, "sum(size_t)"); }
+            size_t max(size_t a) { return this->_reduction(Op::Max, a, "max(size_t)"); }
+            size_t mean(size_t a) { return this->_reduction(Op::Mean, a, "mean(size_t)"); }
+
+            size_t matmul(size_t a, size_t b)
+            {
+                const Node<T, E>& x = this->_at(a, "matmul(size_t, size_t)");
+                const Node<T, E>& y = this->_at(b, "matmul(size_t, size_t)");
+
+                if (y.shape.size() != 2 || x.columns() != y.shape[0])
+                {
+                    throw std::runtime_error("NumcyLazy::Graph<T, E>::matmul(size_t, size_t) Error: shapes do not match, A is [..., m, k] and B must be [k, n]");
+                }
+
+                std::vector<E> shape = x.shape;
+                shape.back() = y.shape[1];
+
+                return this->_record(Op::MatMul, a, b, T(0), shape);
+            }
+
+            size_t getNumberOfNodes(void) const
+            {
+                return this->nodes.size();
+            }
+
+            Program<T, E> compile(const std::vector<size_t>& outputs) const
+            {
+                size_t n = this->nodes.size();
+                Program<T, E> program;
+
+                program.nodes = this->nodes;
+                program.outputs = outputs;
+
+                // Dead code elimination, ids are in topological order so one backward sweep marks everything needed
+                std::vector<bool> live(n, false), is_output(n, false);
+                std::vector<size_t> consumers(n, 0), consumer(n, NONE);
+
+                for (size_t i = 0; i < outputs.size(); i++)
+                {
+                    this->_at(outputs[i], "compile(const std::vector<size_t>&)");
+
+                    live[outputs[i]] = true;
+                    is_output[outputs[i]] = true;
+                }
+
+                for (size_t i = n; i-- > 0;)
+                {
+                    if (!live[i])
+                    {
+                        continue;
+                    }
+
+                    const Node<T, E>& node = this->nodes[i];
+
+                    if (node.a != NONE)
+                    {
+                        live[node.a] = true;
+                        consumers[node.a]++;
+                        consumer[node.a] = i;
+                    }
+                    if (node.b != NONE && node.b != node.a)
+                    {
+                        live[node.b] = true;
+                        consumers[node.b]++;
+                        consumer[node.b] = i;
+                    }
+                }
+
+                // Fusion, which values are computed inside their consumer's loop
+                std::vector<bool> inlined(n, false);
+
+                for (size_t i = 0; i < n; i++)
+                {
+                    if (!live[i] || is_output[i] || !isElementwise(this->nodes[i].op) || consumers[i] != 1)
+                    {
+                        continue;
+                    }
+
+                    const Node<T, E>& next = this->nodes[consumer[i]];
+                    size_t space = isReduction(next.op) ? this->nodes[next.a].numel() : next.numel();
+
+                    inlined[i] = (isElementwise(next.op) || isReduction(next.op)) && this->nodes[i].numel() == space;
+                }
+
+                // One kernel per value that is stored, its inlined producers become its steps
+                std::vector<size_t> last_use(n, 0);
+
+                for (size_t i = 0; i < n; i++)
+                {
+                    const Node<T, E>& root = this->nodes[i];
+
+                    if (!live[i] || inlined[i] || root.op == Op::Input)
+                    {
+                        continue;
+                    }
+
+                    Kernel kernel(i);
+
+                    if (root.op != Op::MatMul)
+                    {
+                        const Node<T, E>& space = isReduction(root.op) ? this->nodes[root.a] : root;
+
+                        kernel.columns = space.columns();
+                        kernel.rows = space.numel() / kernel.columns;
+
+                        // Inlined producers, found depth first, run in id (topological) order
+                        std::vector<size_t> pending(1, i);
+
+                        while (!pending.empty())
+                        {
+                            size_t id = pending.back();
+                            pending.pop_back();
+
+                            const Node<T, E>& node = this->nodes[id];
+
+                            if (id == i ? isElementwise(node.op) : true)
+                            {
+                                kernel.steps.push_back(id);
+                            }
+                            if (node.a != NONE && inlined[node.a])
+                            {
+                                pending.push_back(node.a);
+                            }
+                            if (node.b != NONE && node.b != node.a && inlined[node.b])
+                            {
+                                pending.push_back(node.b);
+                            }
+                        }
+
+                        std::sort(kernel.steps.begin(), kernel.steps.end());
+
+                        for (size_t s = 0; s < kernel.steps.size(); s++)
+                        {
+                            const Node<T, E>& node = this->nodes[kernel.steps[s]];
+
+                            kernel.access_a.push_back(inlined[node.a] ? Access::Inline : _accessFor(this->nodes[node.a], kernel.rows, kernel.columns));
+                            kernel.access_b.push_back(node.b == NONE ? Access::Full : (inlined[node.b] ? Access::Inline : _accessFor(this->nodes[node.b], kernel.rows, kernel.columns)));
+                        }
+
+                        if (isReduction(root.op))
+                        {
+                            kernel.reduce_access = inlined[root.a] ? Access::Inline : Access::Full;
+                        }
+                    }
+
+                    program.kernels.push_back(kernel);
+
+                    // Every stored value a step (or the matmul) reads is in use until this kernel is done
+                    size_t index = program.kernels.size() - 1;
+                    std::vector<size_t> readers = kernel.steps;
+
+                    readers.push_back(i);
+
+                    for (size_t s = 0; s < readers.size(); s++)
+                    {
+                        const Node<T, E>& node = this->nodes[readers[s]];
+
+                        if (node.a != NONE && !inlined[node.a])
+                        {
+                            last_use[node.a] = index;
+                        }
+                        if (node.b != NONE && !inlined[node.b])
+                        {
+                            last_use[node.b] = index;
+                        }
+                    }
+                }
+
+                // Memory planning, greedy best fit over the kernels in execution order
+                program.slot_of.assign(n, NONE);
+
+                std::vector<size_t> free_slots;
+
+                for (size_t k = 0; k < program.kernels.size(); k++)
+                {
+                    size_t root = program.kernels[k].root;
+
+                    if (!is_output[root])
+                    {
+                        size_t need = this->nodes[root].numel();
+                        size_t best = NONE;
+
+                        for (size_t f = 0; f < free_slots.size(); f++)
+                        {
+                            size_t capacity = program.slots[free_slots[f]].size();
+
+                            if (capacity >= need && (best == NONE || capacity < program.slots[free_slots[best]].size()))
+                            {
+                                best = f;
+                            }
+                        }
+
+                        if (best == NONE)
+                        {
+                            program.slots.push_back(std::vector<T>(need));
+                            program.slot_of[root] = program.slots.size() - 1;
+                        }
+                        else
+                        {
+                            program.slot_of[root] = free_slots[best];
+                            free_slots.erase(free_slots.begin() + static_cast<std::ptrdiff_t>(best));
+                        }
+
+                        program.unplanned_bytes = program.unplanned_bytes + need * sizeof(T);
+                    }
+
+                    // Values whose last reader was this kernel give their slots back
+                    for (size_t i = 0; i < n; i++)
+                    {
+                        if (program.slot_of[i] != NONE && last_use[i] == k && i != root)
+                        {
+                            free_slots.push_back(program.slot_of[i]);
+                        }
+                    }
+                }
+
+                for (size_t i = 0; i < n; i++)
+                {
+                    if (inlined[i])
+                    {
+                        program.unplanned_bytes = program.unplanned_bytes + this->nodes[i].numel() * sizeof(T);
+                    }
+                }
+
+                return program;
+            }
+
+            /*
+                compile(outputs).run(), for graphs that are built and evaluated once
+             */
+            std::vector<Collective<T, E>> evaluate(const std::vector<size_t>& outputs) const
+            {
+                return this->compile(outputs).run();
+            }
+    };
+}
+
+#endif
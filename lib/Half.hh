@@ -0,0 +1,501 @@
+/*
+ * Numcy/lib/Half.hh
+ *
+ * 16 bit floating point element types, numcy::bfloat16 and numcy::float16, usable as T of a
+ * Collective<T, E>. They only store, every operation converts to float and computes there, the
+ * kernels that matter (GEMM, dot products) widen whole panels at once and accumulate in float.
+ *
+ * Q@hackers.pk
+ */
+
+#ifndef NUMCY_HALF_HH
+#define NUMCY_HALF_HH
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace NumcyHalf
+{
+    inline uint32_t bitsOf(float value)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+
+        return bits;
+    }
+
+    inline float floatOf(uint32_t bits)
+    {
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+
+        return value;
+    }
+
+    /*
+        float → bfloat16, the upper half of the float rounded to nearest even, NaN stays a (quiet) NaN
+     */
+    inline uint16_t toBFloat16(float value)
+    {
+        uint32_t bits = bitsOf(value);
+
+        if ((bits & 0x7FFFFFFFU) > 0x7F800000U)
+        {
+            return static_cast<uint16_t>((bits >> 16) | 0x0040U);
+        }
+
+        bits = bits + 0x7FFFU + ((bits >> 16) & 1U);
+
+        return static_cast<uint16_t>(bits >> 16);
+    }
+
+    inline float fromBFloat16(uint16_t bits)
+    {
+        return floatOf(uint32_t(bits) << 16);
+    }
+
+    /*
+        float → IEEE 754 binary16, rounded to nearest even
+        ├─► too large            → infinity
+        ├─► below the normals    → subnormal, too small even for that → signed zero
+        └─► NaN                  → quiet NaN, infinity → infinity
+     */
+    inline uint16_t toFloat16(float value)
+    {
+#if defined(__F16C__)
+        return _cvtss_sh(value, _MM_FROUND_TO_NEAREST_INT);
+#else
+        uint32_t bits = bitsOf(value);
+        uint32_t sign = (bits >> 16) & 0x8000U;
+        uint32_t exponent = (bits >> 23) & 0xFFU;
+        uint32_t mantissa = bits & 0x7FFFFFU;
+
+        if (exponent == 0xFFU)
+        {
+            return static_cast<uint16_t>(sign | 0x7C00U | (mantissa != 0 ? 0x0200U | (mantissa >> 13) : 0U));
+        }
+
+        int e = int(exponent) - 127 + 15;
+
+        if (e >= 0x1F)
+        {
+            return static_cast<uint16_t>(sign | 0x7C00U);
+        }
+
+        if (e <= 0)
+        {
+            if (e < -10)
+            {
+                return static_cast<uint16_t>(sign);
+            }
+
+            mantissa = mantissa | 0x800000U;
+
+            uint32_t shift = uint32_t(14 - e);
+            uint32_t half = mantissa >> shift;
+            uint32_t rest = mantissa & ((1U << shift) - 1U);
+            uint32_t halfway = 1U << (shift - 1U);
+
+            if (rest > halfway || (rest == halfway && (half & 1U) != 0))
+            {
+                half++;
+            }
+
+            return static_cast<uint16_t>(sign | half);
+        }
+
+        uint32_t half = sign | (uint32_t(e) << 10) | (mantissa >> 13);
+        uint32_t rest = mantissa & 0x1FFFU;
+
+        // A carry out of the mantissa bumps the exponent, the largest finite value rounds up to infinity
+        if (rest > 0x1000U || (rest == 0x1000U && (half & 1U) != 0))
+        {
+            half++;
+        }
+
+        return static_cast<uint16_t>(half);
+#endif
+    }
+
+    inline float fromFloat16(uint16_t bits)
+    {
+#if defined(__F16C__)
+        return _cvtsh_ss(bits);
+#else
+        uint32_t sign = (bits & 0x8000U) << 16;
+        uint32_t exponent = (bits >> 10) & 0x1FU;
+        uint32_t mantissa = bits & 0x3FFU;
+
+        if (exponent == 0)
+        {
+            if (mantissa == 0)
+            {
+                return floatOf(sign);
+            }
+
+            // Subnormal, normalized into a float
+            uint32_t e = 127 - 15 + 1;
+
+            while ((mantissa & 0x400U) == 0)
+            {
+                mantissa = mantissa << 1;
+                e--;
+            }
+
+            return floatOf(sign | (e << 23) | ((mantissa & 0x3FFU) << 13));
+        }
+
+        if (exponent == 0x1F)
+        {
+            return floatOf(sign | 0x7F800000U | (mantissa << 13));
+        }
+
+        return floatOf(sign | ((exponent + 127 - 15) << 23) | (mantissa << 13));
+#endif
+    }
+}
+
+namespace numcy {
+
+    /*
+        bfloat16 — 8 bit exponent, 7 bit mantissa. The range of float at a quarter of its
+        precision, the truncated top half of a float, conversion is a shift.
+     */
+    struct bfloat16
+    {
+        uint16_t bits;
+
+        // Uninitialized, as a double would be, new bfloat16[n] does not touch the memory
+        bfloat16(void) = default;
+
+        bfloat16(float value) : bits(NumcyHalf::toBFloat16(value))
+        {
+        }
+
+        template <typename U, typename = typename std::enable_if<std::is_arithmetic<U>::value>::type>
+        bfloat16(U value) : bits(NumcyHalf::toBFloat16(static_cast<float>(value)))
+        {
+        }
+
+        static bfloat16 fromBits(uint16_t b)
+        {
+            bfloat16 value;
+            value.bits = b;
+
+            return value;
+        }
+
+        operator float(void) const
+        {
+            return NumcyHalf::fromBFloat16(this->bits);
+        }
+
+        bfloat16& operator+=(float other) { return *this = float(*this) + other; }
+        bfloat16& operator-=(float other) { return *this = float(*this) - other; }
+        bfloat16& operator*=(float other) { return *this = float(*this) * other; }
+        bfloat16& operator/=(float other) { return *this = float(*this) / other; }
+    };
+
+    /*
+        float16 — IEEE 754 binary16, 5 bit exponent, 10 bit mantissa. More precision than
+        bfloat16 but a range of only about ±65504, values beyond it become infinity.
+     */
+    struct float16
+    {
+        uint16_t bits;
+
+        float16(void) = default;
+
+        float16(float value) : bits(NumcyHalf::toFloat16(value))
+        {
+        }
+
+        template <typename U, typename = typename std::enable_if<std::is_arithmetic<U>::value>::type>
+        float16(U value) : bits(NumcyHalf::toFloat16(static_cast<float>(value)))
+        {
+        }
+
+        static float16 fromBits(uint16_t b)
+        {
+            float16 value;
+            value.bits = b;
+
+            return value;
+        }
+
+        operator float(void) const
+        {
+            return NumcyHalf::fromFloat16(this->bits);
+        }
+
+        float16& operator+=(float other) { return *this = float(*this) + other; }
+        float16& operator-=(float other) { return *this = float(*this) - other; }
+        float16& operator*=(float other) { return *this = float(*this) * other; }
+        float16& operator/=(float other) { return *this = float(*this) / other; }
+    };
+}
+
+namespace NumcyHalf
+{
+    /*
+        The type a kernel computes and accumulates T in, float for the 16 bit types, T itself otherwise
+     */
+    template <typename T>
+    struct Accumulate
+    {
+        typedef T type;
+    };
+
+    template <>
+    struct Accumulate<numcy::bfloat16>
+    {
+        typedef float type;
+    };
+
+    template <>
+    struct Accumulate<numcy::float16>
+    {
+        typedef float type;
+    };
+
+    /*
+        convert(in, out, n)
+        ├─► out[i] = in[i] for i in [0, n), any pair of element types
+        ├─► float ↔ bfloat16 / float16 are vectorized, 8 or 16 values per instruction, the variant
+        │   is picked on the first call from what the CPU has:
+        │     float16  — F16C vcvtps2ph / vcvtph2ps
+        │     bfloat16 — AVX512-BF16 vcvtneps2bf16 when available, AVX2 integer rounding otherwise,
+        │                the way back is a zero extend and a shift
+        └─► without those instruction sets (or for the tail) the scalar conversions above
+     */
+    template <typename S, typename D>
+    void convert(const S* in, D* out, size_t n)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            out[i] = static_cast<D>(in[i]);
+        }
+    }
+
+    template <typename T>
+    void convert(const T* in, T* out, size_t n)
+    {
+        std::memcpy(out, in, n * sizeof(T));
+    }
+
+    inline void narrow_portable(const float* in, numcy::bfloat16* out, size_t i, size_t n)
+    {
+        for (; i < n; i++)
+        {
+            out[i] = numcy::bfloat16::fromBits(toBFloat16(in[i]));
+        }
+    }
+
+    inline void widen_portable(const numcy::bfloat16* in, float* out, size_t i, size_t n)
+    {
+        for (; i < n; i++)
+        {
+            out[i] = fromBFloat16(in[i].bits);
+        }
+    }
+
+    inline void narrow_portable(const float* in, numcy::float16* out, size_t i, size_t n)
+    {
+        for (; i < n; i++)
+        {
+            out[i] = numcy::float16::fromBits(toFloat16(in[i]));
+        }
+    }
+
+    inline void widen_portable(const numcy::float16* in, float* out, size_t i, size_t n)
+    {
+        for (; i < n; i++)
+        {
+            out[i] = fromFloat16(in[i].bits);
+        }
+    }
+
+    template <typename S, typename D>
+    void convert_portable(const S* in, D* out, size_t n)
+    {
+        if constexpr (std::is_same<S, float>::value)
+        {
+            narrow_portable(in, out, 0, n);
+        }
+        else
+        {
+            widen_portable(in, out, 0, n);
+        }
+    }
+
+#if defined(NUMCY_X86)
+    /*
+        vcvtneps2bf16 treats a subnormal float as zero, a block of sixteen that holds one is
+        rounded by narrow_portable() instead, as toBFloat16() would
+     */
+    NUMCY_TARGET("avx512bf16,avx512f,avx512vl")
+    inline void convert_avx512bf16(const float* in, numcy::bfloat16* out, size_t n)
+    {
+        const __m512i exponent = _mm512_set1_epi32(0x7F800000);
+        const __m512i mantissa = _mm512_set1_epi32(0x007FFFFF);
+
+        size_t i = 0;
+
+        for (; i + 16 <= n; i += 16)
+        {
+            __m512 x = _mm512_loadu_ps(in + i);
+            __m512i bits = _mm512_castps_si512(x);
+
+            if ((_mm512_testn_epi32_mask(bits, exponent) & _mm512_test_epi32_mask(bits, mantissa)) != 0)
+            {
+                narrow_portable(in, out, i, i + 16);
+
+                continue;
+            }
+
+            __m256bh packed = _mm512_cvtneps_pbh(x);
+            std::memcpy(static_cast<void*>(out + i), &packed, sizeof(packed));
+        }
+
+        narrow_portable(in, out, i, n);
+    }
+
+    /*
+        Same rounding as toBFloat16(), eight lanes at a time
+     */
+    NUMCY_TARGET("avx2")
+    inline __m256i narrow_lanes(__m256 x)
+    {
+        const __m256i one = _mm256_set1_epi32(1);
+        const __m256i round = _mm256_set1_epi32(0x7FFF);
+        const __m256i quiet = _mm256_set1_epi32(0x0040);
+
+        __m256i bits = _mm256_castps_si256(x);
+        __m256i odd = _mm256_and_si256(_mm256_srli_epi32(bits, 16), one);
+        __m256i rounded = _mm256_srli_epi32(_mm256_add_epi32(bits, _mm256_add_epi32(round, odd)), 16);
+        __m256i nan = _mm256_or_si256(_mm256_srli_epi32(bits, 16), quiet);
+
+        return _mm256_blendv_epi8(rounded, nan, _mm256_castps_si256(_mm256_cmp_ps(x, x, _CMP_UNORD_Q)));
+    }
+
+    NUMCY_TARGET("avx2")
+    inline void convert_avx2(const float* in, numcy::bfloat16* out, size_t n)
+    {
+        size_t i = 0;
+
+        // Two results packed into one store
+        for (; i + 16 <= n; i += 16)
+        {
+            __m256i packed = _mm256_packus_epi32(narrow_lanes(_mm256_loadu_ps(in + i)), narrow_lanes(_mm256_loadu_ps(in + i + 8)));
+            packed = _mm256_permute4x64_epi64(packed, 0xD8);
+
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), packed);
+        }
+
+        narrow_portable(in, out, i, n);
+    }
+
+    NUMCY_TARGET("avx2")
+    inline void convert_avx2(const numcy::bfloat16* in, float* out, size_t n)
+    {
+        size_t i = 0;
+
+        for (; i + 8 <= n; i += 8)
+        {
+            __m256i wide = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i)));
+
+            _mm256_storeu_ps(out + i, _mm256_castsi256_ps(_mm256_slli_epi32(wide, 16)));
+        }
+
+        widen_portable(in, out, i, n);
+    }
+
+    NUMCY_TARGET("avx2,f16c")
+    inline void convert_f16c(const float* in, numcy::float16* out, size_t n)
+    {
+        size_t i = 0;
+
+        for (; i + 8 <= n; i += 8)
+        {
+            __m128i packed = _mm256_cvtps_ph(_mm256_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), packed);
+        }
+
+        narrow_portable(in, out, i, n);
+    }
+
+    NUMCY_TARGET("avx2,f16c")
+    inline void convert_f16c(const numcy::float16* in, float* out, size_t n)
+    {
+        size_t i = 0;
+
+        for (; i + 8 <= n; i += 8)
+        {
+            _mm256_storeu_ps(out + i, _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i))));
+        }
+
+        widen_portable(in, out, i, n);
+    }
+#endif
+
+    inline void convert(const float* in, numcy::bfloat16* out, size_t n)
+    {
+        typedef void (*Kernel)(const float*, numcy::bfloat16*, size_t);
+
+        static const Kernel kernel = NumcyCpu::select<Kernel>("convert<float, bfloat16>", {
+#if defined(NUMCY_X86)
+            {NumcyCpu::features().avx512bf16, "avx512bf16", &convert_avx512bf16},
+            {NumcyCpu::features().avx2, "avx2", &convert_avx2},
+#endif
+            {true, "portable", &convert_portable<float, numcy::bfloat16>}
+        });
+
+        kernel(in, out, n);
+    }
+
+    inline void convert(const numcy::bfloat16* in, float* out, size_t n)
+    {
+        typedef void (*Kernel)(const numcy::bfloat16*, float*, size_t);
+
+        static const Kernel kernel = NumcyCpu::select<Kernel>("convert<bfloat16, float>", {
+#if defined(NUMCY_X86)
+            {NumcyCpu::features().avx2, "avx2", &convert_avx2},
+#endif
+            {true, "portable", &convert_portable<numcy::bfloat16, float>}
+        });
+
+        kernel(in, out, n);
+    }
+
+    inline void convert(const float* in, numcy::float16* out, size_t n)
+    {
+        typedef void (*Kernel)(const float*, numcy::float16*, size_t);
+
+        static const Kernel kernel = NumcyCpu::select<Kernel>("convert<float, float16>", {
+#if defined(NUMCY_X86)
+            {NumcyCpu::features().f16c, "f16c", &convert_f16c},
+#endif
+            {true, "portable", &convert_portable<float, numcy::float16>}
+        });
+
+        kernel(in, out, n);
+    }
+
+    inline void convert(const numcy::float16* in, float* out, size_t n)
+    {
+        typedef void (*Kernel)(const numcy::float16*, float*, size_t);
+
+        static const Kernel kernel = NumcyCpu::select<Kernel>("convert<float16, float>", {
+#if defined(NUMCY_X86)
+            {NumcyCpu::features().f16c, "f16c", &convert_f16c},
+#endif
+            {true, "portable", &convert_portable<numcy::float16, float>}
+        });
+
+        kernel(in, out, n);
+    }
+}
+
+#endif
@@ -0,0 +1,336 @@
+/*
+ * Numcy/lib/Memory.hh
+ *
+ * Memory accounting of collectives. Every buffer a CollectiveProperties owns is counted while it
+ * lives, live and peak bytes per MemoryLocation are always kept (two relaxed atomic adds per
+ * allocation). With allocation sites tracked (NUMCY_MEMORY_SITES=1 or setTracking(true)) every
+ * live buffer also has a record of its size, shape and the site it was allocated at, and the
+ * largest of them can be listed, on demand or when an allocation fails.
+ *
+ * A site is the chain of NumcyMemory::Site scopes of the allocating thread, every Numcy op opens
+ * one with its name, code around it can add its own:
+ *
+ *     {
+ *         Numcy::MemorySite site("encoder");
+ *
+ *         h = Numcy::matmul(x, w);   // site "encoder/matmul"
+ *     }
+ *
+ * Q@hackers.pk
+ */
+
+#ifndef NUMCY_MEMORY_HH
+#define NUMCY_MEMORY_HH
+
+#include "./Dimensions.hh"
+#include "./MemoryLocation.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace NumcyMemory
+{
+    struct Usage
+    {
+        size_t live;         // Bytes held right now
+        size_t peak;         // Most bytes ever held at once (since resetPeak())
+        size_t allocations;  // Buffers allocated so far
+
+        Usage(void) : live(0), peak(0), allocations(0)
+        {
+        }
+    };
+
+    struct Stats
+    {
+        Usage host;
+        Usage device;
+
+        Stats(void) : host(), device()
+        {
+        }
+    };
+
+    /*
+        One live buffer, kept while allocation sites are tracked
+     */
+    struct Record
+    {
+        size_t bytes;
+        MemoryLocation location;
+        std::string site;          // "" when allocated outside of every Site
+        std::vector<size_t> shape;
+        size_t sequence;           // Order of allocation, the oldest first
+
+        Record(void) : bytes(0), location(MemoryLocation::None), site(), shape(), sequence(0)
+        {
+        }
+    };
+
+    /*
+        Site
+        ----
+        Names what is allocated on this thread while it is in scope, nested sites are joined with
+        '/'. name must outlive the scope (a string literal). A Numcy op opens its own with
+        NUMCY_MEMORY_SITE(), below.
+     */
+    class Site
+    {
+        const char* name;
+        const Site* parent;
+
+        static const Site*& _current(void)
+        {
+            thread_local const Site* current = nullptr;
+
+            return current;
+        }
+
+        public:
+            explicit Site(const char* site_name) : name(site_name), parent(_current())
+            {
+                _current() = this;
+            }
+
+            Site(const Site&) = delete;
+            Site& operator=(const Site&) = delete;
+
+            ~Site()
+            {
+                _current() = this->parent;
+            }
+
+            /*
+                The chain of sites open on the calling thread, outermost first
+             */
+            static std::string path(void)
+            {
+                std::string path;
+
+                for (const Site* site = _current(); site != nullptr; site = site->parent)
+                {
+                    path = path.empty() ? std::string(site->name) : std::string(site->name) + "/" + path;
+                }
+
+                return path;
+            }
+    };
+
+    /*
+        Accounting
+        ----------
+        allocated(data, bytes, location, shape) — a buffer that now belongs to a collective
+        released(data, bytes, location)         — that buffer given back
+        stats()                                 — live, peak and allocations per location
+        resetPeak()                             — peak back to what is live now
+        setTracking(on)                         — records of live buffers and their sites, off by
+                                                  default unless NUMCY_MEMORY_SITES=1, buffers
+                                                  allocated while it is off have no record
+        largest(count)                          — the count largest live buffers with a record
+        dump(out, count)                        — them as a table
+     */
+    class Accounting
+    {
+        std::atomic<size_t> live[2];
+        std::atomic<size_t> peak[2];
+        std::atomic<size_t> allocations[2];
+
+        std::atomic<bool> tracking;
+        std::mutex lock;
+        std::unordered_map<const void*, Record> records;
+        size_t sequence;
+
+        Accounting(void) : live(), peak(), allocations(), tracking(false), lock(), records(), sequence(0)
+        {
+            const char* env = std::getenv("NUMCY_MEMORY_SITES");
+
+            this->tracking.store(env != nullptr && std::string(env) != "0" && std::string(env) != "");
+        }
+
+        static size_t _index(MemoryLocation location)
+        {
+            return location == MemoryLocation::Device ? 1 : 0;
+        }
+
+        public:
+            Accounting(const Accounting&) = delete;
+            Accounting& operator=(const Accounting&) = delete;
+
+            static Accounting& global(void)
+            {
+                static Accounting accounting;
+
+                return accounting;
+            }
+
+            template <typename E>
+            void allocated(const void* data, size_t bytes, MemoryLocation location, const Dimensions<E>& shape)
+            {
+                size_t i = _index(location);
+                size_t now = this->live[i].fetch_add(bytes, std::memory_order_relaxed) + bytes;
+                size_t peak_now = this->peak[i].load(std::memory_order_relaxed);
+
+                while (now > peak_now && !this->peak[i].compare_exchange_weak(peak_now, now, std::memory_order_relaxed))
+                {
+                }
+
+                this->allocations[i].fetch_add(1, std::memory_order_relaxed);
+
+                if (!this->tracking.load(std::memory_order_relaxed))
+                {
+                    return;
+                }
+
+                Record record;
+                std::vector<E> dims = shape.toVector();
+
+                record.bytes = bytes;
+                record.location = location;
+                record.site = Site::path();
+                record.shape.assign(dims.begin(), dims.end());
+
+                std::lock_guard<std::mutex> guard(this->lock);
+
+                record.sequence = this->sequence++;
+                this->records[data] = record;
+            }
+
+            void released(const void* data, size_t bytes, MemoryLocation location)
+            {
+                this->live[_index(location)].fetch_sub(bytes, std::memory_order_relaxed);
+
+                if (!this->tracking.load(std::memory_order_relaxed))
+                {
+                    return;
+                }
+
+                std::lock_guard<std::mutex> guard(this->lock);
+
+                this->records.erase(data);
+            }
+
+            Stats stats(void) const
+            {
+                Stats stats;
+                Usage* usage[2] = {&stats.host, &stats.device};
+
+                for (size_t i = 0; i < 2; i++)
+                {
+                    usage[i]->live = this->live[i].load(std::memory_order_relaxed);
+                    usage[i]->peak = this->peak[i].load(std::memory_order_relaxed);
+                    usage[i]->allocations = this->allocations[i].load(std::memory_order_relaxed);
+                }
+
+                return stats;
+            }
+
+            void resetPeak(void)
+            {
+                for (size_t i = 0; i < 2; i++)
+                {
+                    this->peak[i].store(this->live[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+                }
+            }
+
+            /*
+                Turning it off forgets every record
+             */
+            void setTracking(bool on)
+            {
+                std::lock_guard<std::mutex> guard(this->lock);
+
+                this->tracking.store(on);
+
+                if (!on)
+                {
+                    this->records.clear();
+                }
+            }
+
+            bool isTracking(void) const
+            {
+                return this->tracking.load(std::memory_order_relaxed);
+            }
+
+            std::vector<Record> largest(size_t count)
+            {
+                std::vector<Record> largest;
+
+                {
+                    std::lock_guard<std::mutex> guard(this->lock);
+
+                    largest.reserve(this->records.size());
+
+                    for (const auto& entry : this->records)
+                    {
+                        largest.push_back(entry.second);
+                    }
+                }
+
+                std::sort(largest.begin(), largest.end(), [](const Record& a, const Record& b) { return a.bytes != b.bytes ? a.bytes > b.bytes : a.sequence < b.sequence; });
+
+                largest.resize(std::min(count, largest.size()));
+
+                return largest;
+            }
+
+            void dump(std::ostream& out, size_t count)
+            {
+                Stats now = this->stats();
+
+                out << "numcy memory: host " << now.host.live << " bytes live, " << now.host.peak << " peak, device " << now.device.live << " live, " << now.device.peak << " peak" << std::endl;
+
+                if (!this->isTracking())
+                {
+                    out << "numcy memory: allocation sites are not tracked (NUMCY_MEMORY_SITES=1)" << std::endl;
+
+                    return;
+                }
+
+                std::vector<Record> buffers = this->largest(count);
+
+                for (size_t i = 0; i < buffers.size(); i++)
+                {
+                    std::ostringstream shape;
+
+                    for (size_t d = 0; d < buffers[i].shape.size(); d++)
+                    {
+                        shape << (d == 0 ? "" : ", ") << buffers[i].shape[d];
+                    }
+
+                    out << std::right << std::setw(16) << buffers[i].bytes << "  " << std::left << std::setw(8) << (buffers[i].location == MemoryLocation::Device ? "device" : "host") << std::setw(24) << ("[" + shape.str() + "]") << (buffers[i].site.empty() ? "-" : buffers[i].site) << std::right << std::endl;
+                }
+            }
+
+            /*
+                What an allocation of bytes that failed adds to its error, the largest live buffers
+                are written to std::cerr as well while sites are tracked
+             */
+            std::string outOfMemory(size_t bytes, MemoryLocation location)
+            {
+                if (this->isTracking())
+                {
+                    std::cerr << "numcy memory: allocating " << bytes << " bytes failed" << std::endl;
+                    this->dump(std::cerr, 10);
+                }
+
+                return " (" + std::to_string(bytes) + " bytes requested, " + std::to_string(this->live[_index(location)].load(std::memory_order_relaxed)) + " live)";
+            }
+    };
+}
+
+/*
+    NUMCY_MEMORY_SITE("matmul") at the top of an op, what it allocates is named after it. Always
+    compiled, independent of NUMCY_TRACE and NUMCY_TRACE_OP().
+ */
+#define NUMCY_MEMORY_SITE(name) NumcyMemory::Site numcy_memory_site(name)
+
+#endif
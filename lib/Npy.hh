@@ -0,0 +1,992 @@
+/*
+ * Numcy/lib/Npy.hh
+ *
+ * NumPy's .npy and (uncompressed) .npz files, the arrays Python data prep hands over. A C order,
+ * little-endian array is the mmap()ed file itself, a Fortran order one is transposed into C order
+ * while it is copied out of the mapping, a big-endian one is byte swapped.
+ *
+ * Q@hackers.pk
+ */
+
+#ifndef NUMCY_NPY_HH
+#define NUMCY_NPY_HH
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace NumcyNpy
+{
+    /*
+        The descr of numcy::DType, "<f4" and so on, nullptr for bfloat16 which NumPy has no
+        builtin type for (save it as float32 or with Numcy::save())
+     */
+    inline const char* descrOf(numcy::DType dtype)
+    {
+        switch (dtype)
+        {
+            case numcy::DType::Float64:  return "<f8";
+            case numcy::DType::Float32:  return "<f4";
+            case numcy::DType::Float16:  return "<f2";
+            case numcy::DType::Int8:     return "|i1";
+            case numcy::DType::UInt8:    return "|u1";
+            case numcy::DType::Int16:    return "<i2";
+            case numcy::DType::UInt16:   return "<u2";
+            case numcy::DType::Int32:    return "<i4";
+            case numcy::DType::UInt32:   return "<u4";
+            case numcy::DType::Int64:    return "<i8";
+            case numcy::DType::UInt64:   return "<u8";
+            case numcy::DType::Bool:     return "|b1";
+            default:                     return nullptr;
+        }
+    }
+
+    /*
+        MappedFile
+        ----------
+        length bytes of a file from offset, mmap()ed from the page boundary at or below offset
+        (read into NumcyNuma::allocate()d memory where there is no mmap()). Unmapped by the
+        destructor unless release() handed the pages to a collective.
+     */
+    class MappedFile
+    {
+        void* base;
+        size_t bytes;  // From base, what NumcyNuma::release() gives back
+        size_t delta;  // From base to offset
+
+        public:
+            MappedFile(const std::string& path, numcy::Mapping mapping, size_t offset, size_t length) : base(nullptr), bytes(0), delta(0)
+            {
+                if (length == 0)
+                {
+                    throw std::runtime_error(path + " is empty");
+                }
+
+#if defined(NUMCY_MMAP)
+                int fd = open(path.c_str(), O_RDONLY);
+
+                if (fd < 0)
+                {
+                    throw std::runtime_error("cannot open " + path);
+                }
+
+                size_t page = size_t(sysconf(_SC_PAGESIZE));
+
+                this->delta = offset % page;
+                this->bytes = this->delta + length;
+
+                int protection = mapping == numcy::Mapping::CopyOnWrite ? PROT_READ | PROT_WRITE : PROT_READ;
+                int flags = mapping == numcy::Mapping::CopyOnWrite ? MAP_PRIVATE : MAP_SHARED;
+
+                void* address = mmap(nullptr, this->bytes, protection, flags, fd, off_t(offset - this->delta));
+
+                close(fd);
+
+                if (address == MAP_FAILED)
+                {
+                    throw std::runtime_error("mmap() of " + path + " failed");
+                }
+
+                this->base = address;
+#else
+                (void)mapping;
+
+                std::ifstream file(path, std::ios::binary);
+
+                if (!file)
+                {
+                    throw std::runtime_error("cannot open " + path);
+                }
+
+                this->bytes = length;
+                this->base = NumcyNuma::allocate(length, numcy::NumaPolicy::FirstTouch);
+
+                file.seekg(std::streamoff(offset));
+
+                if (!file.read(static_cast<char*>(this->base), std::streamsize(length)))
+                {
+                    NumcyNuma::release(this->base, this->bytes);
+                    throw std::runtime_error("read of " + path + " failed");
+                }
+#endif
+            }
+
+            MappedFile(const MappedFile&) = delete;
+            MappedFile& operator=(const MappedFile&) = delete;
+
+            ~MappedFile()
+            {
+                if (this->base != nullptr)
+                {
+                    NumcyNuma::release(this->base, this->bytes);
+                }
+            }
+
+            const unsigned char* data(void) const
+            {
+                return static_cast<const unsigned char*>(this->base) + this->delta;
+            }
+
+            unsigned char* writable(void) const
+            {
+                return static_cast<unsigned char*>(this->base) + this->delta;
+            }
+
+            size_t mappedBytes(void) const
+            {
+                return this->bytes;
+            }
+
+            size_t offset(void) const
+            {
+                return this->delta;
+            }
+
+            void release(void)
+            {
+                this->base = nullptr;
+            }
+    };
+
+    inline size_t fileSize(const std::string& path)
+    {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+
+        if (!file)
+        {
+            throw std::runtime_error("cannot open " + path);
+        }
+
+        return size_t(file.tellg());
+    }
+
+    /*
+        What the header of a .npy says
+     */
+    struct Header
+    {
+        std::string descr;
+        bool fortran_order;
+        std::vector<size_t> shape;
+        size_t data_offset; // From the start of the .npy
+
+        Header(void) : descr(), fortran_order(false), shape(), data_offset(0)
+        {
+        }
+    };
+
+    /*
+        The value of 'key' in the header dictionary, from after its colon
+     */
+    inline size_t _valueOf(const std::string& dictionary, const std::string& key)
+    {
+        size_t at = dictionary.find("'" + key + "'");
+
+        if (at == std::string::npos)
+        {
+            throw std::runtime_error(".npy header has no '" + key + "'");
+        }
+
+        at = dictionary.find(':', at);
+
+        if (at == std::string::npos)
+        {
+            throw std::runtime_error(".npy header is malformed at '" + key + "'");
+        }
+
+        return dictionary.find_first_not_of(' ', at + 1);
+    }
+
+    /*
+        parseHeader(p, length)
+        ├─► "\x93NUMPY", version 1.0 (2 byte header length) or 2.0 / 3.0 (4 byte header length)
+        └─► the Python dictionary literal that follows, {'descr': '<f4', 'fortran_order': False, 'shape': (3, 4), }
+     */
+    inline Header parseHeader(const unsigned char* p, size_t length)
+    {
+        static const unsigned char MAGIC[6] = {0x93, 'N', 'U', 'M', 'P', 'Y'};
+
+        if (length < 10 || std::memcmp(p, MAGIC, sizeof(MAGIC)) != 0)
+        {
+            throw std::runtime_error("not a .npy file");
+        }
+
+        size_t size = 0, start = 0;
+
+        if (p[6] == 1)
+        {
+            size = size_t(p[8]) | (size_t(p[9]) << 8);
+            start = 10;
+        }
+        else if ((p[6] == 2 || p[6] == 3) && length >= 12)
+        {
+            size = size_t(p[8]) | (size_t(p[9]) << 8) | (size_t(p[10]) << 16) | (size_t(p[11]) << 24);
+            start = 12;
+        }
+        else
+        {
+            throw std::runtime_error("unsupported .npy version " + std::to_string(p[6]) + "." + std::to_string(p[7]));
+        }
+
+        if (start + size > length)
+        {
+            throw std::runtime_error(".npy header is truncated");
+        }
+
+        std::string dictionary(reinterpret_cast<const char*>(p + start), size);
+        Header header;
+
+        size_t at = _valueOf(dictionary, "descr");
+        size_t end = at == std::string::npos ? std::string::npos : dictionary.find(dictionary[at], at + 1);
+
+        if (end == std::string::npos)
+        {
+            throw std::runtime_error(".npy header is malformed at 'descr'");
+        }
+
+        header.descr = dictionary.substr(at + 1, end - at - 1);
+
+        at = _valueOf(dictionary, "fortran_order");
+        header.fortran_order = dictionary.compare(at, 4, "True") == 0;
+
+        at = _valueOf(dictionary, "shape");
+        end = dictionary.find(')', at);
+
+        if (at == std::string::npos || dictionary[at] != '(' || end == std::string::npos)
+        {
+            throw std::runtime_error(".npy header is malformed at 'shape'");
+        }
+
+        for (size_t i = at + 1; i < end; )
+        {
+            if (dictionary[i] >= '0' && dictionary[i] <= '9')
+            {
+                size_t value = 0;
+
+                for (; i < end && dictionary[i] >= '0' && dictionary[i] <= '9'; i++)
+                {
+                    value = value * 10 + size_t(dictionary[i] - '0');
+                }
+
+                header.shape.push_back(value);
+            }
+            else
+            {
+                i++;
+            }
+        }
+
+        header.data_offset = start + size;
+
+        return header;
+    }
+
+    /*
+        The .npy header of an array of descr and shape, padded with spaces so that the data that
+        follows starts at a multiple of 64 bytes, as NumPy writes it
+     */
+    inline std::string makeHeader(const char* descr, const std::vector<size_t>& shape)
+    {
+        std::string dictionary = "{'descr': '" + std::string(descr) + "', 'fortran_order': False, 'shape': (";
+
+        for (size_t i = 0; i < shape.size(); i++)
+        {
+            dictionary += std::to_string(shape[i]) + (shape.size() == 1 || i + 1 < shape.size() ? ", " : "");
+        }
+
+        dictionary += "), }";
+
+        size_t prefix = dictionary.size() + 1 + 10 > 65535 ? 12 : 10;
+        size_t total = (prefix + dictionary.size() + 1 + 63) / 64 * 64;
+
+        dictionary.append(total - prefix - dictionary.size() - 1, ' ');
+        dictionary += '\n';
+
+        std::string header("\x93NUMPY", 6);
+        size_t size = dictionary.size();
+
+        header += char(prefix == 10 ? 1 : 2);
+        header += char(0);
+
+        for (size_t i = 0; i < prefix - 8; i++)
+        {
+            header += char((size >> (8 * i)) & 0xFF);
+        }
+
+        return header + dictionary;
+    }
+
+    /*
+        toCOrder<T>()
+        ├─► to[] = from[] in C order, from is in Fortran order of the same shape
+        └─► element (i0, ..., in-1) is from[i0 + d0 * (i1 + d1 * (...))], for every combination of
+            the middle axes a d0 x dn-1 matrix is copied transposed TILE x TILE at a time, the
+            (middle, tile) pairs spread over the thread pool
+     */
+    template <typename T>
+    void toCOrder(const T* from, T* to, const std::vector<size_t>& shape)
+    {
+        constexpr size_t TILE = 32;
+
+        size_t rank = shape.size();
+        size_t first = shape[0], last = shape[rank - 1];
+        size_t middle = 1;
+
+        for (size_t k = 1; k + 1 < rank; k++)
+        {
+            middle = middle * shape[k];
+        }
+
+        size_t row = middle * last;        // C stride of axis 0
+        size_t column = first * middle;    // Fortran stride of axis n-1
+        size_t tiles = (first + TILE - 1) / TILE;
+        size_t grain = std::max(size_t(1), NumcyThreads::ThreadPool::global().getSerialThreshold() / (TILE * last));
+
+        NumcyThreads::parallel_for(0, middle * tiles, grain, [=, &shape](size_t begin, size_t end)
+        {
+            for (size_t job = begin; job < end; job++)
+            {
+                size_t m = job / tiles;
+
+                // The middle index m is C order over axes 1..n-2, its offset in Fortran order
+                size_t rest = m, in_middle = 0, stride = first * middle;
+
+                for (size_t k = rank - 2; k >= 1; k--)
+                {
+                    stride = stride / shape[k];
+                    in_middle = in_middle + (rest % shape[k]) * stride;
+                    rest = rest / shape[k];
+                }
+
+                const T* source = from + in_middle;
+                T* destination = to + m * last;
+
+                size_t i0 = (job % tiles) * TILE;
+                size_t i1 = std::min(first, i0 + TILE);
+
+                for (size_t j0 = 0; j0 < last; j0 += TILE)
+                {
+                    size_t j1 = std::min(last, j0 + TILE);
+
+                    for (size_t i = i0; i < i1; i++)
+                    {
+                        for (size_t j = j0; j < j1; j++)
+                        {
+                            destination[i * row + j] = source[i + j * column];
+                        }
+                    }
+                }
+            }
+        });
+    }
+
+    /*
+        Reverses the bytes of every element, for a big-endian ('>') file
+     */
+    template <typename T>
+    void swapBytes(T* data, size_t n)
+    {
+        NumcyThreads::parallel_for(0, n, NumcyThreads::ThreadPool::global().getSerialThreshold(), [data](size_t first, size_t last)
+        {
+            for (size_t i = first; i < last; i++)
+            {
+                unsigned char* p = static_cast<unsigned char*>(static_cast<void*>(data + i));
+
+                std::reverse(p, p + sizeof(T));
+            }
+        });
+    }
+
+    /*
+        Throws unless the descr of header is T's, true when the elements are big-endian ('>') and
+        need their bytes swapped
+     */
+    template <typename T>
+    bool bigEndian(const Header& header)
+    {
+        const char* expected = descrOf(NumcySerialize::TypeOf<T>::value);
+
+        if (expected == nullptr)
+        {
+            throw std::runtime_error("the element type has no .npy descr");
+        }
+
+        if (header.descr.size() != 3 || header.descr.compare(1, 2, expected + 1) != 0 || (header.descr[0] != '<' && header.descr[0] != '>' && header.descr[0] != '|' && header.descr[0] != '='))
+        {
+            throw std::runtime_error("descr '" + header.descr + "' of the file is not '" + std::string(expected) + "'");
+        }
+
+        return header.descr[0] == '>' && sizeof(T) > 1;
+    }
+
+    /*
+        read<T, E>(path, offset, length, mapping)
+        ├─► the .npy that is length bytes of the file from offset (all of a .npy file, one entry
+        │   of a .npz), mmap()ed, header parsed and checked against T
+        ├─► C order, little-endian (or single byte) and mapping ReadOnly / CopyOnWrite
+        │     └─► the collective is the mapping itself, nothing is read until a page is touched
+        ├─► otherwise the elements are copied out of the mapping into new T[], transposed on the way
+        │   for Fortran order, byte swapped afterwards for big-endian
+        └─► shape () loads as [1, 1] and (n,) as [1, n], a Collective has at least two axes
+     */
+    template <typename T, typename E>
+    Collective<T, E> read(const std::string& path, size_t offset, size_t length, numcy::Mapping mapping)
+    {
+        MappedFile file(path, mapping == numcy::Mapping::CopyOnWrite ? numcy::Mapping::CopyOnWrite : numcy::Mapping::ReadOnly, offset, length);
+        Header header = parseHeader(file.data(), length);
+
+        bool swap = bigEndian<T>(header);
+
+        std::vector<size_t> shape = header.shape;
+
+        while (shape.size() < 2)
+        {
+            shape.insert(shape.begin(), 1);
+        }
+
+        size_t numel = 1;
+
+        for (size_t i = 0; i < shape.size(); i++)
+        {
+            numel = numel * shape[i];
+        }
+
+        if (numel == 0 || header.data_offset + numel * sizeof(T) > length)
+        {
+            throw std::runtime_error("file is truncated or its shape is empty");
+        }
+
+        Dimensions<E> dims;
+        dims.fromVector(std::vector<E>(shape.begin(), shape.end()));
+
+        const unsigned char* payload = file.data() + header.data_offset;
+        bool aligned = reinterpret_cast<uintptr_t>(payload) % alignof(T) == 0;
+
+        if (mapping != numcy::Mapping::Copy && !header.fortran_order && !swap && aligned)
+        {
+            Collective<T, E> c = Collective<T, E>::mapped(reinterpret_cast<T*>(file.writable() + header.data_offset), dims, file.mappedBytes(), file.offset() + header.data_offset);
+            file.release(); // Unmapped by c from here on
+
+            return c;
+        }
+
+        T* data = new T[numel];
+
+        try
+        {
+            if (header.fortran_order && shape.size() >= 2)
+            {
+                std::vector<T> aligned_copy;
+                const T* source = reinterpret_cast<const T*>(payload);
+
+                if (!aligned)
+                {
+                    aligned_copy.resize(numel);
+                    std::memcpy(static_cast<void*>(aligned_copy.data()), payload, numel * sizeof(T));
+                    source = aligned_copy.data();
+                }
+
+                toCOrder(source, data, header.shape.size() >= 2 ? header.shape : shape);
+            }
+            else
+            {
+                std::memcpy(static_cast<void*>(data), payload, numel * sizeof(T));
+            }
+
+            if (swap)
+            {
+                swapBytes(data, numel);
+            }
+
+            return Collective<T, E>(data, dims, MemoryLocation::Host);
+        }
+        catch (...)
+        {
+            delete[] data;
+            throw;
+        }
+    }
+
+    /*
+        write(file, c)
+        └─► header and the elements of a host collective to file, what is written is returned so
+            that a .npz entry can be sized (and checksummed) without reading it back
+     */
+    template <typename T, typename E>
+    std::string header(const Collective<T, E>& c)
+    {
+        const char* descr = descrOf(NumcySerialize::TypeOf<T>::value);
+
+        if (descr == nullptr)
+        {
+            throw std::runtime_error("the element type has no .npy descr");
+        }
+
+        if (c.isEmpty() || c.getMemoryLocation() != MemoryLocation::Host)
+        {
+            throw std::runtime_error("only host collectives are supported");
+        }
+
+        std::vector<E> dims = c.getShape().toVector();
+
+        return makeHeader(descr, std::vector<size_t>(dims.begin(), dims.end()));
+    }
+
+    template <typename T, typename E>
+    void save(const std::string& path, const Collective<T, E>& c)
+    {
+        std::string prefix = header(c);
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+
+        if (!file)
+        {
+            throw std::runtime_error("cannot open " + path + " for writing");
+        }
+
+        file.write(prefix.data(), std::streamsize(prefix.size()));
+        file.write(reinterpret_cast<const char*>(c.getData()), std::streamsize(c.getShape().numel() * sizeof(T)));
+        file.flush();
+
+        if (!file)
+        {
+            throw std::runtime_error("write to " + path + " failed");
+        }
+    }
+
+    template <typename T, typename E>
+    Collective<T, E> load(const std::string& path, numcy::Mapping mapping)
+    {
+        return read<T, E>(path, 0, fileSize(path), mapping);
+    }
+
+    /*
+        CRC-32 (IEEE 802.3, what zip stores), slicing by 8 bytes, eight 256 entry tables
+     */
+    inline const uint32_t* crcTables(void)
+    {
+        static const std::vector<uint32_t> tables = []()
+        {
+            std::vector<uint32_t> t(8 * 256);
+
+            for (uint32_t i = 0; i < 256; i++)
+            {
+                uint32_t c = i;
+
+                for (int k = 0; k < 8; k++)
+                {
+                    c = (c & 1U) != 0 ? 0xEDB88320U ^ (c >> 1) : c >> 1;
+                }
+
+                t[i] = c;
+            }
+
+            for (size_t i = 0; i < 256; i++)
+            {
+                for (size_t slice = 1; slice < 8; slice++)
+                {
+                    t[slice * 256 + i] = (t[(slice - 1) * 256 + i] >> 8) ^ t[t[(slice - 1) * 256 + i] & 0xFFU];
+                }
+            }
+
+            return t;
+        }();
+
+        return tables.data();
+    }
+
+    inline uint32_t crc32(uint32_t crc, const void* data, size_t n)
+    {
+        const uint32_t* t = crcTables();
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+
+        crc = ~crc;
+
+        for (; n >= 8; n -= 8, p += 8)
+        {
+            uint32_t lo, hi;
+            std::memcpy(&lo, p, 4);
+            std::memcpy(&hi, p + 4, 4);
+
+            lo = lo ^ crc;
+
+            crc = t[7 * 256 + (lo & 0xFFU)] ^ t[6 * 256 + ((lo >> 8) & 0xFFU)] ^ t[5 * 256 + ((lo >> 16) & 0xFFU)] ^ t[4 * 256 + (lo >> 24)] ^
+                  t[3 * 256 + (hi & 0xFFU)] ^ t[2 * 256 + ((hi >> 8) & 0xFFU)] ^ t[1 * 256 + ((hi >> 16) & 0xFFU)] ^ t[hi >> 24];
+        }
+
+        for (; n > 0; n--, p++)
+        {
+            crc = t[(crc ^ *p) & 0xFFU] ^ (crc >> 8);
+        }
+
+        return ~crc;
+    }
+
+    inline void _put(std::string& out, uint64_t value, size_t bytes)
+    {
+        for (size_t i = 0; i < bytes; i++)
+        {
+            out += char((value >> (8 * i)) & 0xFF);
+        }
+    }
+
+    inline size_t _get(const unsigned char* p, size_t bytes)
+    {
+        size_t value = 0;
+
+        for (size_t i = 0; i < bytes; i++)
+        {
+            value = value | (size_t(p[i]) << (8 * i));
+        }
+
+        return value;
+    }
+
+    /*
+        NpzWriter
+        ---------
+        An uncompressed .npz (a zip of "name.npy" entries, stored), what numpy.savez() writes and
+        numpy.load() reads:
+
+            NumcyNpy::NpzWriter npz("model.npz");
+            npz.add("weights", weights);
+            npz.add("ids", ids);             // any element type per entry
+            npz.close();                     // central directory, also done by the destructor
+
+        Every entry is padded (a zipalign style extra field) so that its array data starts at a
+        multiple of 64 bytes in the file, which NpzReader maps without a copy. No zip64, an entry
+        and the archive stay below 4 GB.
+     */
+    class NpzWriter
+    {
+        struct Entry
+        {
+            std::string name;
+            uint32_t crc;
+            uint64_t size;
+            uint64_t offset;
+        };
+
+        std::ofstream file;
+        std::string path;
+        std::vector<Entry> entries;
+        uint64_t written;
+        bool closed;
+
+        void _write(const void* data, size_t n)
+        {
+            this->file.write(static_cast<const char*>(data), std::streamsize(n));
+            this->written = this->written + n;
+        }
+
+        public:
+            explicit NpzWriter(const std::string& p) : file(p, std::ios::binary | std::ios::trunc), path(p), entries(), written(0), closed(false)
+            {
+                if (!this->file)
+                {
+                    throw std::runtime_error("NumcyNpy::NpzWriter::NpzWriter(const std::string&) Error: cannot open " + p + " for writing");
+                }
+            }
+
+            NpzWriter(const NpzWriter&) = delete;
+            NpzWriter& operator=(const NpzWriter&) = delete;
+
+            ~NpzWriter()
+            {
+                try
+                {
+                    this->close();
+                }
+                catch (...)
+                {
+                }
+            }
+
+            template <typename T, typename E>
+            void add(const std::string& name, const Collective<T, E>& c)
+            {
+                if (this->closed)
+                {
+                    throw std::runtime_error("NumcyNpy::NpzWriter::add() Error: already closed");
+                }
+
+                std::string prefix = header(c);
+                std::string entry_name = name + ".npy";
+                size_t payload = c.getShape().numel() * sizeof(T);
+                uint64_t size = prefix.size() + payload;
+
+                if (size >= 0xFFFFFFFFULL || this->written + size + 4096 >= 0xFFFFFFFFULL)
+                {
+                    throw std::runtime_error("NumcyNpy::NpzWriter::add() Error: " + name + " would take the archive past 4 GB, which needs zip64");
+                }
+
+                Entry entry = {entry_name, crc32(crc32(0, prefix.data(), prefix.size()), c.getData(), payload), size, this->written};
+
+                // 30 byte local header, the name, then an extra field padding the .npy data to 64 bytes
+                size_t unpadded = this->written + 30 + entry_name.size() + 4 + prefix.size();
+                size_t padding = (64 - unpadded % 64) % 64;
+
+                std::string local;
+                _put(local, 0x04034B50U, 4);     // Local file header signature
+                _put(local, 20, 2);              // Version needed, 2.0
+                _put(local, 0, 2);               // Flags
+                _put(local, 0, 2);               // Stored
+                _put(local, 0, 2);               // Time
+                _put(local, 0x21, 2);            // Date, 1980-01-01
+                _put(local, entry.crc, 4);
+                _put(local, size, 4);            // Compressed size
+                _put(local, size, 4);            // Uncompressed size
+                _put(local, entry_name.size(), 2);
+                _put(local, 4 + padding, 2);     // Extra field length
+                local += entry_name;
+                _put(local, 0xD935U, 2);         // Alignment extra field (as zipalign writes it)
+                _put(local, padding, 2);
+                local.append(padding, '\0');
+                local += prefix;
+
+                this->_write(local.data(), local.size());
+                this->_write(c.getData(), payload);
+
+                if (!this->file)
+                {
+                    throw std::runtime_error("NumcyNpy::NpzWriter::add() Error: write to " + this->path + " failed");
+                }
+
+                this->entries.push_back(entry);
+            }
+
+            void close(void)
+            {
+                if (this->closed)
+                {
+                    return;
+                }
+
+                this->closed = true;
+
+                std::string directory;
+
+                for (size_t i = 0; i < this->entries.size(); i++)
+                {
+                    const Entry& e = this->entries[i];
+
+                    _put(directory, 0x02014B50U, 4); // Central directory header signature
+                    _put(directory, 20, 2);          // Version made by
+                    _put(directory, 20, 2);          // Version needed
+                    _put(directory, 0, 2);           // Flags
+                    _put(directory, 0, 2);           // Stored
+                    _put(directory, 0, 2);           // Time
+                    _put(directory, 0x21, 2);        // Date
+                    _put(directory, e.crc, 4);
+                    _put(directory, e.size, 4);
+                    _put(directory, e.size, 4);
+                    _put(directory, e.name.size(), 2);
+                    _put(directory, 0, 2);           // Extra field length
+                    _put(directory, 0, 2);           // Comment length
+                    _put(directory, 0, 2);           // Disk number
+                    _put(directory, 0, 2);           // Internal attributes
+                    _put(directory, 0, 4);           // External attributes
+                    _put(directory, e.offset, 4);
+                    directory += e.name;
+                }
+
+                std::string end;
+                _put(end, 0x06054B50U, 4);           // End of central directory signature
+                _put(end, 0, 2);
+                _put(end, 0, 2);
+                _put(end, this->entries.size(), 2);
+                _put(end, this->entries.size(), 2);
+                _put(end, directory.size(), 4);
+                _put(end, this->written, 4);         // Central directory offset
+                _put(end, 0, 2);                     // Comment length
+
+                this->_write(directory.data(), directory.size());
+                this->_write(end.data(), end.size());
+                this->file.flush();
+                this->file.close();
+
+                if (!this->file)
+                {
+                    throw std::runtime_error("NumcyNpy::NpzWriter::close() Error: write to " + this->path + " failed");
+                }
+            }
+    };
+
+    /*
+        NpzReader
+        ---------
+        The entries of an uncompressed .npz, from its central directory (zip64 sizes included).
+        get<T>(name, mapping) reads one entry the way load() reads a .npy, mapping only the pages
+        of that entry.
+     */
+    class NpzReader
+    {
+        struct Entry
+        {
+            std::string name;
+            size_t offset; // Of the .npy in the file
+            size_t size;
+        };
+
+        std::string path;
+        std::vector<Entry> entries;
+
+        public:
+            explicit NpzReader(const std::string& p) : path(p), entries()
+            {
+                size_t size = fileSize(p);
+
+                if (size < 22)
+                {
+                    throw std::runtime_error("NumcyNpy::NpzReader::NpzReader(const std::string&) Error: " + p + " is not a zip archive");
+                }
+
+                MappedFile file(p, numcy::Mapping::ReadOnly, 0, size);
+                const unsigned char* z = file.data();
+
+                // The end of central directory record, followed by a comment of at most 64 KB
+                size_t end = size - 22;
+
+                while (_get(z + end, 4) != 0x06054B50U)
+                {
+                    if (end == 0 || size - end > 22 + 65535)
+                    {
+                        throw std::runtime_error("NumcyNpy::NpzReader::NpzReader(const std::string&) Error: " + p + " is not a zip archive");
+                    }
+
+                    end--;
+                }
+
+                size_t count = _get(z + end + 10, 2);
+                size_t at = _get(z + end + 16, 4);
+
+                for (size_t i = 0; i < count; i++)
+                {
+                    if (at + 46 > size || _get(z + at, 4) != 0x02014B50U)
+                    {
+                        throw std::runtime_error("NumcyNpy::NpzReader::NpzReader(const std::string&) Error: central directory of " + p + " is corrupt");
+                    }
+
+                    size_t method = _get(z + at + 10, 2);
+                    size_t stored = _get(z + at + 24, 4);
+                    size_t local = _get(z + at + 42, 4);
+                    size_t name_length = _get(z + at + 28, 2);
+                    size_t extra_length = _get(z + at + 30, 2);
+                    size_t comment_length = _get(z + at + 32, 2);
+
+                    // The name, extra field and comment of the entry, all inside the archive
+                    if (at + 46 + name_length + extra_length + comment_length > size)
+                    {
+                        throw std::runtime_error("NumcyNpy::NpzReader::NpzReader(const std::string&) Error: central directory of " + p + " is corrupt");
+                    }
+
+                    std::string name(reinterpret_cast<const char*>(z + at + 46), name_length);
+
+                    // zip64 extended information, the sizes and offset that did not fit in 32 bits
+                    const unsigned char* extra = z + at + 46 + name_length;
+
+                    for (size_t x = 0; x + 4 <= extra_length; )
+                    {
+                        size_t id = _get(extra + x, 2), length = _get(extra + x + 2, 2);
+
+                        if (x + 4 + length > extra_length)
+                        {
+                            throw std::runtime_error("NumcyNpy::NpzReader::NpzReader(const std::string&) Error: extra field of " + name + " is corrupt");
+                        }
+
+                        if (id == 0x0001)
+                        {
+                            // Only the fields whose 32 bit value is 0xFFFFFFFF are present, in this order
+                            size_t wide = 8 * (size_t(stored == 0xFFFFFFFFULL) + size_t(_get(z + at + 20, 4) == 0xFFFFFFFFULL) + size_t(local == 0xFFFFFFFFULL));
+                            const unsigned char* field = extra + x + 4;
+
+                            if (wide > length)
+                            {
+                                throw std::runtime_error("NumcyNpy::NpzReader::NpzReader(const std::string&) Error: zip64 field of " + name + " is corrupt");
+                            }
+
+                            if (stored == 0xFFFFFFFFULL)
+                            {
+                                stored = _get(field, 8);
+                                field = field + 8;
+                            }
+                            if (_get(z + at + 20, 4) == 0xFFFFFFFFULL)
+                            {
+                                field = field + 8;
+                            }
+                            if (local == 0xFFFFFFFFULL)
+                            {
+                                local = _get(field, 8);
+                            }
+                        }
+
+                        x = x + 4 + length;
+                    }
+
+                    if (method != 0)
+                    {
+                        throw std::runtime_error("NumcyNpy::NpzReader::NpzReader(const std::string&) Error: " + name + " is compressed, only numpy.savez() (stored) archives are supported");
+                    }
+
+                    if (size < 30 || local > size - 30 || _get(z + local, 4) != 0x04034B50U)
+                    {
+                        throw std::runtime_error("NumcyNpy::NpzReader::NpzReader(const std::string&) Error: local header of " + name + " is corrupt");
+                    }
+
+                    size_t data = local + 30 + _get(z + local + 26, 2) + _get(z + local + 28, 2);
+
+                    if (data > size || stored > size - data)
+                    {
+                        throw std::runtime_error("NumcyNpy::NpzReader::NpzReader(const std::string&) Error: " + name + " is truncated");
+                    }
+
+                    if (name.size() > 4 && name.compare(name.size() - 4, 4, ".npy") == 0)
+                    {
+                        name = name.substr(0, name.size() - 4);
+                    }
+
+                    this->entries.push_back(Entry{name, data, stored});
+
+                    at = at + 46 + name_length + extra_length + comment_length;
+                }
+            }
+
+            std::vector<std::string> names(void) const
+            {
+                std::vector<std::string> all;
+
+                for (size_t i = 0; i < this->entries.size(); i++)
+                {
+                    all.push_back(this->entries[i].name);
+                }
+
+                return all;
+            }
+
+            template <typename T, typename E = size_t>
+            Collective<T, E> get(const std::string& name, numcy::Mapping mapping = numcy::Mapping::ReadOnly) const
+            {
+                for (size_t i = 0; i < this->entries.size(); i++)
+                {
+                    if (this->entries[i].name == name)
+                    {
+                        try
+                        {
+                            return read<T, E>(this->path, this->entries[i].offset, this->entries[i].size, mapping);
+                        }
+                        catch (std::runtime_error& e)
+                        {
+                            throw std::runtime_error("NumcyNpy::NpzReader::get(const std::string&, numcy::Mapping) -> " + name + ": " + std::string(e.what()));
+                        }
+                    }
+                }
+
+                throw std::runtime_error("NumcyNpy::NpzReader::get(const std::string&, numcy::Mapping) Error: no entry " + name + " in " + this->path);
+            }
+    };
+}
+
+#endif
@@ -0,0 +1,307 @@
+/*
+ * Numcy/lib/Numa.hh
+ *
+ * NUMA topology, page placement and thread pinning for host buffers. Linux only, talks to the
+ * kernel directly (sysfs, mbind, sched affinity), libnuma is not needed. Everywhere else, and on
+ * machines with one node, every function degrades to plain allocation and does nothing.
+ *
+ * Q@hackers.pk
+ */
+
+#ifndef NUMCY_NUMA_HH
+#define NUMCY_NUMA_HH
+
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+    #include <pthread.h>
+    #include <sched.h>
+    #include <sys/mman.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
+namespace numcy {
+
+    /*
+        Where the pages of a host buffer end up on a machine with several NUMA nodes
+     */
+    enum class NumaPolicy : int {
+        FirstTouch  = 0, // Page goes to the node of the thread that first writes it, the buffer is first written by the pinned thread pool, each worker its own slice
+        Interleaved = 1, // Pages round-robin over all nodes, bandwidth of every socket for buffers every thread reads all of
+        Local       = 2  // Every page on the node of the allocating thread
+    };
+}
+
+namespace NumcyNuma
+{
+    /*
+        Memory policy modes of mbind(2), from <linux/mempolicy.h>
+     */
+    constexpr int MPOL_PREFERRED_MODE = 1;
+    constexpr int MPOL_INTERLEAVE_MODE = 3;
+
+    /*
+        Parses a sysfs cpu/node list, "0-3,8-11" → {0, 1, 2, 3, 8, 9, 10, 11}
+     */
+    inline std::vector<size_t> parseList(const std::string& list)
+    {
+        std::vector<size_t> result;
+        size_t i = 0;
+
+        while (i < list.size())
+        {
+            if (list[i] < '0' || list[i] > '9')
+            {
+                i++;
+
+                continue;
+            }
+
+            size_t first = 0, last = 0;
+
+            for (; i < list.size() && list[i] >= '0' && list[i] <= '9'; i++)
+            {
+                first = first * 10 + static_cast<size_t>(list[i] - '0');
+            }
+
+            last = first;
+
+            if (i < list.size() && list[i] == '-')
+            {
+                last = 0;
+
+                for (i++; i < list.size() && list[i] >= '0' && list[i] <= '9'; i++)
+                {
+                    last = last * 10 + static_cast<size_t>(list[i] - '0');
+                }
+            }
+
+            for (size_t value = first; value <= last; value++)
+            {
+                result.push_back(value);
+            }
+        }
+
+        return result;
+    }
+
+    /*
+        Topology
+        ├─► nodes[i] — the node id of the i-th online node
+        └─► cpus[i]  — the cpus of that node
+     */
+    struct Topology
+    {
+        std::vector<size_t> nodes;
+        std::vector<std::vector<size_t>> cpus;
+
+        Topology(void) : nodes(), cpus()
+        {
+        }
+    };
+
+    /*
+        topology()
+        ├─► read once, from /sys/devices/system/node
+        └─► no sysfs (or not Linux) → a single node holding every cpu
+     */
+    inline const Topology& topology(void)
+    {
+        static const Topology machine = []()
+        {
+            Topology t;
+
+            std::ifstream online("/sys/devices/system/node/online");
+            std::string line;
+
+            if (online && std::getline(online, line))
+            {
+                std::vector<size_t> ids = parseList(line);
+
+                for (size_t i = 0; i < ids.size(); i++)
+                {
+                    std::ifstream cpulist("/sys/devices/system/node/node" + std::to_string(ids[i]) + "/cpulist");
+                    std::string cpus;
+
+                    if (cpulist && std::getline(cpulist, cpus) && !parseList(cpus).empty())
+                    {
+                        t.nodes.push_back(ids[i]);
+                        t.cpus.push_back(parseList(cpus));
+                    }
+                }
+            }
+
+            if (t.nodes.empty())
+            {
+                size_t count = std::thread::hardware_concurrency();
+
+                t.nodes.push_back(0);
+                t.cpus.push_back(std::vector<size_t>());
+
+                for (size_t cpu = 0; cpu < (count == 0 ? 1 : count); cpu++)
+                {
+                    t.cpus[0].push_back(cpu);
+                }
+            }
+
+            return t;
+        }();
+
+        return machine;
+    }
+
+    inline size_t numberOfNodes(void)
+    {
+        return topology().nodes.size();
+    }
+
+    /*
+        Index (into topology().nodes) of the node the calling thread is running on
+     */
+    inline size_t currentNode(void)
+    {
+#if defined(__linux__)
+        int cpu = sched_getcpu();
+        const Topology& t = topology();
+
+        for (size_t i = 0; cpu >= 0 && i < t.cpus.size(); i++)
+        {
+            for (size_t j = 0; j < t.cpus[i].size(); j++)
+            {
+                if (t.cpus[i][j] == static_cast<size_t>(cpu))
+                {
+                    return i;
+                }
+            }
+        }
+#endif
+        return 0;
+    }
+
+    /*
+        Restricts the calling thread to the cpus of node index node, false when the kernel refused
+     */
+    inline bool pinCurrentThread(size_t node)
+    {
+#if defined(__linux__)
+        const Topology& t = topology();
+
+        if (node >= t.cpus.size())
+        {
+            return false;
+        }
+
+        cpu_set_t set;
+        CPU_ZERO(&set);
+
+        for (size_t i = 0; i < t.cpus[node].size(); i++)
+        {
+            if (t.cpus[node][i] < CPU_SETSIZE)
+            {
+                CPU_SET(t.cpus[node][i], &set);
+            }
+        }
+
+        return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+        (void)node;
+
+        return false;
+#endif
+    }
+
+#if defined(__linux__)
+    /*
+        mbind(2) through syscall(2), a failure (no NUMA support in the kernel, a container without
+        the capability) only loses the placement, never the memory
+     */
+    inline void bind(void* address, size_t bytes, int mode, const std::vector<size_t>& node_ids)
+    {
+        constexpr size_t BITS = 8 * sizeof(unsigned long);
+
+        size_t max_node = 0;
+
+        for (size_t i = 0; i < node_ids.size(); i++)
+        {
+            max_node = node_ids[i] > max_node ? node_ids[i] : max_node;
+        }
+
+        std::vector<unsigned long> mask(max_node / BITS + 1, 0UL);
+
+        for (size_t i = 0; i < node_ids.size(); i++)
+        {
+            mask[node_ids[i] / BITS] |= 1UL << (node_ids[i] % BITS);
+        }
+
+        syscall(SYS_mbind, address, bytes, mode, mask.data(), mask.size() * BITS + 1, 0U);
+    }
+#endif
+
+    /*
+        allocate()
+        ├─► bytes of page aligned, not yet touched memory, release() frees it
+        ├─► Interleaved → pages spread round-robin over every node
+        ├─► Local       → pages on the node of the calling thread (preferred, falls back when full)
+        └─► FirstTouch  → no policy, the first thread to write a page decides where it lives
+     */
+    inline void* allocate(size_t bytes, numcy::NumaPolicy policy)
+    {
+        if (bytes == 0)
+        {
+            bytes = 1;
+        }
+
+#if defined(__linux__)
+        void* address = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+        if (address == MAP_FAILED)
+        {
+            throw std::bad_alloc();
+        }
+
+        if (numberOfNodes() > 1)
+        {
+            if (policy == numcy::NumaPolicy::Interleaved)
+            {
+                bind(address, bytes, MPOL_INTERLEAVE_MODE, topology().nodes);
+            }
+            else if (policy == numcy::NumaPolicy::Local)
+            {
+                bind(address, bytes, MPOL_PREFERRED_MODE, std::vector<size_t>(1, topology().nodes[currentNode()]));
+            }
+        }
+
+        return address;
+#else
+        (void)policy;
+
+        void* address = std::malloc(bytes);
+
+        if (address == nullptr)
+        {
+            throw std::bad_alloc();
+        }
+
+        return address;
+#endif
+    }
+
+    inline void release(void* address, size_t bytes)
+    {
+#if defined(__linux__)
+        munmap(address, bytes == 0 ? 1 : bytes);
+#else
+        (void)bytes;
+
+        std::free(address);
+#endif
+    }
+}
+
+#endif
@@ -6,12 +6,47 @@
 #ifndef NUMCY_NUMCY_HH
 #define NUMCY_NUMCY_HH
 
+#include <cmath>
+#include <vector>
+
 class Numcy
 {
     public:
+        /*
+            The worker threads behind every host kernel, see lib/ThreadPool.hh.
+            Numcy::ThreadPool::global().setNumberOfThreads(n) or NUMCY_NUM_THREADS=n to resize it.
+         */
+        typedef NumcyThreads::ThreadPool ThreadPool;
+
+        /*
+            Deferred execution, ops are recorded and run later as fused loops, see lib/Graph.hh
+         */
+        template <typename T = double, typename E = size_t>
+        using Graph = NumcyLazy::Graph<T, E>;
+
+        /*
+            Batches of an on-disk array larger than memory, read ahead on a background thread, see lib/Stream.hh
+         */
+        template <typename T = double, typename E = size_t>
+        using StreamReader = NumcyStream::StreamReader<T, E>;
+
+        /*
+            Sharded checkpoints written in parallel and committed by renaming the index, see lib/Checkpoint.hh
+         */
+        typedef NumcyCheckpoint::Writer CheckpointWriter;
+        typedef NumcyCheckpoint::Reader CheckpointReader;
+
+        /*
+            Names the allocation site of the collectives made in its scope, see lib/Memory.hh
+         */
+        typedef NumcyMemory::Site MemorySite;
+
         template <typename T = double, typename E = size_t>
         static Collective<T, E> randn(const Dimensions<E>& d, uint64_t seed = 0)
         {
+            NUMCY_TRACE_OP("randn", d);
+            NUMCY_MEMORY_SITE("randn");
+
 #ifdef COMPILE_FOR_DEVICE
             return NumcyUtils::randn_device(d, seed);
 #else
@@ -38,6 +73,9 @@ class Numcy
         template <typename T = double, typename E = size_t>
         static Collective<T, E> randn_bert(const Dimensions<E>& d, uint64_t seed = 0)
         {
+            NUMCY_TRACE_OP("randn_bert", d);
+            NUMCY_MEMORY_SITE("randn_bert");
+
             Collective<T, E> c;
 #ifdef COMPILE_FOR_DEVICE
             c = NumcyUtils::randn_device<T, E>(d, seed); // Standard Normal (mean=0, std=1)
@@ -52,6 +90,9 @@ class Numcy
         template <typename T = double, typename E = size_t>
         static Collective<T, E> transpose(const Collective<T, E>& c, numcy::Axis axis1 = numcy::Axis::Last, numcy::Axis axis2 = numcy::Axis::SecondLast)        
         {
+            NUMCY_TRACE_OP("transpose", c);
+            NUMCY_MEMORY_SITE("transpose");
+
             Dimensions<E> d_transposed;
             T* data_transposed = nullptr;
 
@@ -112,13 +153,48 @@ class Numcy
 
                     /* A physical transpose; actually shuffle the bytes. */
 
-                    for (E i = 0; i < d_transposed.getNumberOfRows(); i++)
+                    /*
+                        Every [rows, cols] matrix of the batch becomes a [cols, rows] matrix. The copy
+                        goes TRANSPOSE_TILE x TRANSPOSE_TILE tiles at a time, so both the rows read and
+                        the rows written stay in cache, and the (batch, tile row) pairs are spread over
+                        the thread pool.
+                     */
+                    constexpr size_t TRANSPOSE_TILE = 32;
+
+                    std::vector<E> shape = c.getShape().toVector();
+                    size_t rows = shape[shape.size() - 2];
+                    size_t cols = shape[shape.size() - 1];
+                    size_t batches = c.getShape().numel() / (rows * cols);
+                    size_t tile_rows = (rows + TRANSPOSE_TILE - 1) / TRANSPOSE_TILE;
+                    size_t grain = std::max(size_t(1), NumcyThreads::ThreadPool::global().getSerialThreshold() / (TRANSPOSE_TILE * cols));
+
+                    const T* source = c.getData();
+                    T* destination = data_transposed;
+
+                    NumcyThreads::parallel_for(0, batches * tile_rows, grain, [=](size_t first, size_t last)
                     {
-                        for (E j = 0; j < d_transposed.getNumberOfColumns(); j++)
+                        for (size_t job = first; job < last; job++)
                         {
-                            data_transposed[j * d_transposed.getNumberOfColumns() + i] = c.getData()[i * c.getShape().getNumberOfColumns() + j];
+                            const T* from = source + (job / tile_rows) * rows * cols;
+                            T* to = destination + (job / tile_rows) * rows * cols;
+
+                            size_t i0 = (job % tile_rows) * TRANSPOSE_TILE;
+                            size_t i1 = std::min(rows, i0 + TRANSPOSE_TILE);
+
+                            for (size_t j0 = 0; j0 < cols; j0 += TRANSPOSE_TILE)
+                            {
+                                size_t j1 = std::min(cols, j0 + TRANSPOSE_TILE);
+
+                                for (size_t i = i0; i < i1; i++)
+                                {
+                                    for (size_t j = j0; j < j1; j++)
+                                    {
+                                        to[j * rows + i] = from[i * cols + j];
+                                    }
+                                }
+                            }
                         }
-                    }
+                    });
 
                     return Collective<T, E>(data_transposed, d_transposed, /*c.getMemoryLocation()*/ MemoryLocation::Host);
                 }
@@ -176,6 +252,1560 @@ class Numcy
             // Should never reach heres
             return Collective<T, E> (nullptr, Dimensions<E>(), MemoryLocation::None);        
         }
+
+        /*
+            Element type conversion, Numcy::astype<numcy::bfloat16>(table)
+            --------------------------------------------------------------
+            A new host collective of the same shape with every element converted to U. Conversions
+            between float and numcy::bfloat16 / numcy::float16 are vectorized (NumcyHalf::convert()),
+            others convert element by element. A bfloat16 copy of a double table is a quarter of its size.
+         */
+        template <typename U, typename T = double, typename E = size_t>
+        static Collective<U, E> astype(const Collective<T, E>& c)
+        {
+            NUMCY_TRACE_OP("astype", c);
+            NUMCY_MEMORY_SITE("astype");
+
+            U* data = nullptr;
+
+            try
+            {
+                if (c.getMemoryLocation() != MemoryLocation::Host)
+                {
+                    throw std::runtime_error("Error: only host collectives are supported");
+                }
+
+                size_t numel = c.getShape().numel();
+                const T* from = c.getData();
+
+                data = new U[numel];
+
+                U* to = data;
+
+                NumcyThreads::parallel_for_static(0, numel, NumcyThreads::ThreadPool::global().getSerialThreshold(), [=](size_t first, size_t last)
+                {
+                    NumcyHalf::convert(from + first, to + first, last - first);
+                });
+
+                return Collective<U, E>(data, c.getShape(), MemoryLocation::Host);
+            }
+            catch (const std::bad_alloc& e)
+            {
+                delete[] data;
+                throw std::runtime_error("Numcy::astype(const Collective<T, E>&) -> " + std::string(e.what()));
+            }
+            catch (std::runtime_error& e)
+            {
+                delete[] data;
+                throw std::runtime_error("Numcy::astype(const Collective<T, E>&) -> " + std::string(e.what()));
+            }
+            catch (...)
+            {
+                delete[] data;
+                throw std::runtime_error("Numcy::astype(const Collective<T, E>&) Error: Unknown exception");
+            }
+        }
+
+        /*
+            Matrix product of two host collectives, C = A * B
+            -------------------------------------------------
+            A is [..., m, k], every leading axis of A is folded into m (A.getShape().getNumberOfRows()).
+            B must be 2D, [k, n].
+            C has the shape of A with the last axis replaced by n, i.e. [..., m, n].
+
+            Numcy::matmul(a, b)
+            ├─► validate shapes, A's last axis must equal B's rows
+            ├─► allocate C on host (no zeroing, the GEMM engine writes every element with beta = 0)
+            └─► NumcyGemm::gemm_host(), packed, cache blocked, SIMD micro-kernels, parallel over M/N blocks
+         */
+        template <typename T = double, typename E = size_t>
+        static Collective<T, E> matmul(const Collective<T, E>& a, const Collective<T, E>& b)
+        {
+            NUMCY_TRACE_OP("matmul", a, b);
+            NUMCY_MEMORY_SITE("matmul");
+
+            T* data = nullptr;
+
+            try
+            {
+                if (a.getMemoryLocation() != MemoryLocation::Host || b.getMemoryLocation() != MemoryLocation::Host)
+                {
+                    throw std::runtime_error("Error: only host collectives are supported");
+                }
+
+                if (b.getShape().size() != 1)
+                {
+                    throw std::runtime_error("Error: B must be a 2D collective");
+                }
+
+                E m = a.getShape().getNumberOfRows();
+                E k = a.getShape().getNumberOfColumns();
+                E n = b.getShape().getNumberOfColumns();
+
+                if (k != b.getShape().getNumberOfRows())
+                {
+                    throw std::runtime_error("Error: Incompatible shapes for matrix product, last dimension of A must match the rows of B");
+                }
+
+                std::vector<E> shape = a.getShape().toVector();
+                shape.back() = n;
+
+                Dimensions<E> d;
+                d.fromVector(shape);
+
+                data = new T[d.numel()];
+
+                NumcyGemm::gemm_host<T>(m, n, k, T(1), a.getData(), k, b.getData(), n, T(0), data, n);
+
+                return Collective<T, E>(data, d, MemoryLocation::Host);
+            }
+            catch (const std::bad_alloc& e)
+            {
+                delete[] data;
+                throw std::runtime_error("Numcy::matmul(const Collective<T, E>&, const Collective<T, E>&) -> " + std::string(e.what()));
+            }
+            catch (std::runtime_error& e)
+            {
+                delete[] data;
+                throw std::runtime_error("Numcy::matmul(const Collective<T, E>&, const Collective<T, E>&) -> " + std::string(e.what()));
+            }
+            catch (...)
+            {
+                delete[] data;
+                throw std::runtime_error("Numcy::matmul(const Collective<T, E>&, const Collective<T, E>&) Error: Unknown exception");
+            }
+        }
+
+        /*
+            General matrix product, out = alpha * (op(A) * op(B)) + beta * out
+            --------------------------------------------------------------------
+            op(X) is X when the flag is false and X^T when it is true. A and B are read as the row-major
+            matrices their buffers hold, every leading axis folded into the rows (getNumberOfRows() x
+            getNumberOfColumns()). The transposition is absorbed by the packing stage of the GEMM engine,
+            no transposed copy is ever made.
+
+            out
+            ├─► already allocated → must be a host [m, n] collective (leading axes folded into m),
+            │                         written in place, beta = 1 accumulates into it
+            └─► empty (default constructed) → allocated here, [..., m, n] when A is not transposed and
+                                              has leading axes, [m, n] otherwise. beta must be 0, there is
+                                              nothing to accumulate into.
+
+            Backward pass of C = A * B without transposed copies:
+
+                Numcy::matmul(dc, b, false, true, T(1), T(0), da);  // dA = dC * B^T
+                Numcy::matmul(a, dc, true, false, T(1), T(0), db);  // dB = A^T * dC
+         */
+        template <typename T = double, typename E = size_t>
+        static void matmul(const Collective<T, E>& a, const Collective<T, E>& b, bool transA, bool transB, T alpha, T beta, Collective<T, E>& out)
+        {
+            NUMCY_TRACE_OP("matmul", a, b, out);
+            NUMCY_MEMORY_SITE("matmul");
+
+            T* data = nullptr;
+
+            try
+            {
+                if (a.getMemoryLocation() != MemoryLocation::Host || b.getMemoryLocation() != MemoryLocation::Host)
+                {
+                    throw std::runtime_error("Error: only host collectives are supported");
+                }
+
+                E rows_a = a.getShape().getNumberOfRows(), cols_a = a.getShape().getNumberOfColumns();
+                E rows_b = b.getShape().getNumberOfRows(), cols_b = b.getShape().getNumberOfColumns();
+
+                E m = transA ? cols_a : rows_a;
+                E k = transA ? rows_a : cols_a;
+                E n = transB ? rows_b : cols_b;
+
+                if (k != (transB ? cols_b : rows_b))
+                {
+                    throw std::runtime_error("Error: Incompatible shapes for matrix product, columns of op(A) must match the rows of op(B)");
+                }
+
+                if (!out.isEmpty())
+                {
+                    if (out.getMemoryLocation() != MemoryLocation::Host)
+                    {
+                        throw std::runtime_error("Error: only host collectives are supported");
+                    }
+
+                    if (out.getShape().getNumberOfRows() != m || out.getShape().getNumberOfColumns() != n)
+                    {
+                        throw std::runtime_error("Error: out does not have the shape of op(A) * op(B)");
+                    }
+                }
+                else
+                {
+                    if (beta != T(0))
+                    {
+                        throw std::runtime_error("Error: out is empty, beta must be zero");
+                    }
+
+                    std::vector<E> shape = {m, n};
+
+                    if (!transA && a.getShape().size() > 1)
+                    {
+                        shape = a.getShape().toVector();
+                        shape.back() = n;
+                    }
+
+                    Dimensions<E> d;
+                    d.fromVector(shape);
+
+                    data = new T[d.numel()];
+                    out = Collective<T, E>(data, d, MemoryLocation::Host);
+                    data = nullptr; // Owned by out from here on
+                }
+
+                NumcyGemm::gemm_host<T>(transA, transB, m, n, k, alpha, a.getData(), cols_a, b.getData(), cols_b, beta, out.getData(), n);
+            }
+            catch (const std::bad_alloc& e)
+            {
+                delete[] data;
+                throw std::runtime_error("Numcy::matmul(const Collective<T, E>&, const Collective<T, E>&, bool, bool, T, T, Collective<T, E>&) -> " + std::string(e.what()));
+            }
+            catch (std::runtime_error& e)
+            {
+                delete[] data;
+                throw std::runtime_error("Numcy::matmul(const Collective<T, E>&, const Collective<T, E>&, bool, bool, T, T, Collective<T, E>&) -> " + std::string(e.what()));
+            }
+            catch (...)
+            {
+                delete[] data;
+                throw std::runtime_error("Numcy::matmul(const Collective<T, E>&, const Collective<T, E>&, bool, bool, T, T, Collective<T, E>&) Error: Unknown exception");
+            }
+        }
+
+        /*
+            Backward pass of C = A * B
+            --------------------------
+                dA = dC * B^T
+                dB = A^T * dC
+
+            The legacy implementation called transpose() on B and A first, allocating and copying both.
+            Here the transpositions are GEMM flags. With accumulate = true, da and db must already hold
+            gradients of the right shape and the new gradients are added to them in place (beta = 1),
+            which is what a parameter used in more than one place needs.
+         */
+        template <typename T = double, typename E = size_t>
+        static void matmul_backward(const Collective<T, E>& a, const Collective<T, E>& b, Collective<T, E>& da, Collective<T, E>& db, const Collective<T, E>& dc, bool accumulate = false)
+        {
+            NUMCY_TRACE_OP("matmul_backward", a, b, dc);
+            NUMCY_MEMORY_SITE("matmul_backward");
+
+            try
+            {
+                T beta = accumulate ? T(1) : T(0);
+
+                if (!accumulate)
+                {
+                    // Fresh buffers, never overwrite a gradient buffer some other Collective still shares
+                    da = Collective<T, E>();
+                    db = Collective<T, E>();
+                }
+
+                Numcy::matmul(dc, b, false, true, T(1), beta, da);
+                Numcy::matmul(a, dc, true, false, T(1), beta, db);
+            }
+            catch (std::runtime_error& e)
+            {
+                throw std::runtime_error("Numcy::matmul_backward(const Collective<T, E>&, const Collective<T, E>&, Collective<T, E>&, Collective<T, E>&, const Collective<T, E>&, bool) -> " + std::string(e.what()));
+            }
+        }
+
+        /*
+            Batched matrix product, C[..., m, n] = A[..., m, k] * B[..., k, n]
+            -----------------------------------------------------------------
+            The last two axes of each operand are the matrices, every axis before them is a batch axis.
+            Batch axes broadcast the NumPy way: shapes are aligned from the right, a missing axis counts
+            as 1, and an axis of size 1 is repeated to match the other operand.
+
+                A [batch, heads, seq, d] * B [batch, heads, d, seq] → C [batch, heads, seq, seq]
+                A [batch, heads, seq, d] * B [d, seq]               → C [batch, heads, seq, seq]   (B broadcast)
+                A [batch, 1, seq, d]     * B [1, heads, d, seq]     → C [batch, heads, seq, seq]
+
+            Numcy::bmatmul(a, b)
+            ├─► validate shapes, broadcast the batch axes
+            ├─► one (A_i, B_i, C_i) pointer triple per output matrix, a broadcast axis has stride 0
+            └─► NumcyGemm::bgemm_host()
+                  ├─► batches that share the same B matrix pack it once
+                  └─► parallel over batches or inside each GEMM, whichever the shape favours
+         */
+        template <typename T = double, typename E = size_t>
+        static Collective<T, E> bmatmul(const Collective<T, E>& a, const Collective<T, E>& b)
+        {
+            NUMCY_TRACE_OP("bmatmul", a, b);
+            NUMCY_MEMORY_SITE("bmatmul");
+
+            T* data = nullptr;
+
+            try
+            {
+                if (a.getMemoryLocation() != MemoryLocation::Host || b.getMemoryLocation() != MemoryLocation::Host)
+                {
+                    throw std::runtime_error("Error: only host collectives are supported");
+                }
+
+                std::vector<E> shape_a = a.getShape().toVector();
+                std::vector<E> shape_b = b.getShape().toVector();
+
+                E m = shape_a[shape_a.size() - 2];
+                E k = shape_a[shape_a.size() - 1];
+                E n = shape_b[shape_b.size() - 1];
+
+                if (k != shape_b[shape_b.size() - 2])
+                {
+                    throw std::runtime_error("Error: Incompatible shapes for matrix product, last dimension of A must match the second-to-last dimension of B");
+                }
+
+                size_t batch_axes_a = shape_a.size() - 2;
+                size_t batch_axes_b = shape_b.size() - 2;
+                size_t batch_axes = std::max(batch_axes_a, batch_axes_b);
+
+                // Right aligned batch extents, a missing axis counts as 1
+                std::vector<E> extent_a(batch_axes, E(1)), extent_b(batch_axes, E(1)), extent_c(batch_axes, E(1));
+
+                for (size_t i = 0; i < batch_axes_a; i++)
+                {
+                    extent_a[batch_axes - batch_axes_a + i] = shape_a[i];
+                }
+                for (size_t i = 0; i < batch_axes_b; i++)
+                {
+                    extent_b[batch_axes - batch_axes_b + i] = shape_b[i];
+                }
+
+                for (size_t i = 0; i < batch_axes; i++)
+                {
+                    if (extent_a[i] != extent_b[i] && extent_a[i] != E(1) && extent_b[i] != E(1))
+                    {
+                        throw std::runtime_error("Error: batch axes of A and B can not be broadcast together");
+                    }
+
+                    extent_c[i] = std::max(extent_a[i], extent_b[i]);
+                }
+
+                // Strides in whole matrices, a broadcast axis (extent 1) has stride 0
+                std::vector<size_t> stride_a(batch_axes, 0), stride_b(batch_axes, 0);
+                size_t matrices_a = 1, matrices_b = 1, count = 1;
+
+                for (size_t i = batch_axes; i > 0; i--)
+                {
+                    stride_a[i - 1] = (extent_a[i - 1] == E(1)) ? 0 : matrices_a;
+                    stride_b[i - 1] = (extent_b[i - 1] == E(1)) ? 0 : matrices_b;
+
+                    matrices_a = matrices_a * extent_a[i - 1];
+                    matrices_b = matrices_b * extent_b[i - 1];
+                    count = count * extent_c[i - 1];
+                }
+
+                std::vector<E> shape_c(extent_c);
+                shape_c.push_back(m);
+                shape_c.push_back(n);
+
+                Dimensions<E> d;
+                d.fromVector(shape_c);
+
+                data = new T[d.numel()];
+
+                std::vector<const T*> a_list(count);
+                std::vector<const T*> b_list(count);
+                std::vector<T*> c_list(count);
+
+                for (size_t batch = 0; batch < count; batch++)
+                {
+                    size_t remainder = batch, offset_a = 0, offset_b = 0;
+
+                    for (size_t i = batch_axes; i > 0; i--)
+                    {
+                        size_t coordinate = remainder % extent_c[i - 1];
+                        remainder = remainder / extent_c[i - 1];
+
+                        offset_a = offset_a + coordinate * stride_a[i - 1];
+                        offset_b = offset_b + coordinate * stride_b[i - 1];
+                    }
+
+                    a_list[batch] = a.getData() + offset_a * m * k;
+                    b_list[batch] = b.getData() + offset_b * k * n;
+                    c_list[batch] = data + batch * m * n;
+                }
+
+                NumcyGemm::bgemm_host<T>(m, n, k, T(1), a_list.data(), k, b_list.data(), n, T(0), c_list.data(), n, count);
+
+                return Collective<T, E>(data, d, MemoryLocation::Host);
+            }
+            catch (const std::bad_alloc& e)
+            {
+                delete[] data;
+                throw std::runtime_error("Numcy::bmatmul(const Collective<T, E>&, const Collective<T, E>&) -> " + std::string(e.what()));
+            }
+            catch (std::runtime_error& e)
+            {
+                delete[] data;
+                throw std::runtime_error("Numcy::bmatmul(const Collective<T, E>&, const Collective<T, E>&) -> " + std::string(e.what()));
+            }
+            catch (...)
+            {
+                delete[] data;
+                throw std::runtime_error("Numcy::bmatmul(const Collective<T, E>&, const Collective<T, E>&) Error: Unknown exception");
+            }
+        }
+
+        /*
+            Matrix-vector product, y = A * x
+            --------------------------------
+            A is [..., m, n] with every leading axis folded into m, x is any collective with n elements.
+            y is [m, 1]. Memory bound, see NumcyGemm::gemv_host().
+         */
+        template <typename T = double, typename E = size_t>
+        static Collective<T, E> gemv(const Collective<T, E>& a, const Collective<T, E>& x)
+        {
+            NUMCY_TRACE_OP("gemv", a, x);
+            NUMCY_MEMORY_SITE("gemv");
+
+            T* data = nullptr;
+
+            try
+            {
+                if (a.getMemoryLocation() != MemoryLocation::Host || x.getMemoryLocation() != MemoryLocation::Host)
+                {
+                    throw std::runtime_error("Error: only host collectives are supported");
+                }
+
+                E m = a.getShape().getNumberOfRows();
+                E n = a.getShape().getNumberOfColumns();
+
+                if (x.getShape().numel() != n)
+                {
+                    throw std::runtime_error("Error: number of elements of x must match the columns of A");
+                }
+
+                data = new T[m];
+
+                NumcyGemm::gemv_host<T>(m, n, T(1), a.getData(), n, x.getData(), T(0), data);
+
+                return Collective<T, E>(data, Dimensions<E>(E(1), m), MemoryLocation::Host);
+            }
+            catch (const std::bad_alloc& e)
+            {
+                delete[] data;
+                throw std::runtime_error("Numcy::gemv(const Collective<T, E>&, const Collective<T, E>&) -> " + std::string(e.what()));
+            }
+            catch (std::runtime_error& e)
+            {
+                delete[] data;
+                throw std::runtime_error("Numcy::gemv(const Collective<T, E>&, const Collective<T, E>&) -> " + std::string(e.what()));
+            }
+            catch (...)
+            {
+                delete[] data;
+                throw std::runtime_error("Numcy::gemv(const Collective<T, E>&, const Collective<T, E>&) Error: Unknown exception");
+            }
+        }
+
+        /*
+            Euclidean norm of every row, [..., N, d] → [N, 1]
+            -------------------------------------------------
+            Compute this once for an embedding table and pass it to cosine_similarity(), the table
+            then does not have to be normalized (or re-read for its norms) on every query.
+         */
+        template <typename T = double, typename E = size_t>
+        static Collective<T, E> row_norms(const Collective<T, E>& table)
+        {
+            NUMCY_TRACE_OP("row_norms", table);
+            NUMCY_MEMORY_SITE("row_norms");
+
+            T* data = nullptr;
+
+            try
+            {
+                if (table.getMemoryLocation() != MemoryLocation::Host)
+                {
+                    throw std::runtime_error("Error: only host collectives are supported");
+                }
+
+                E rows = table.getShape().getNumberOfRows();
+                E d = table.getShape().getNumberOfColumns();
+                const T* t = table.getData();
+
+                data = new T[rows];
+                T* norms = data;
+
+                size_t threads = std::max(size_t(1), std::min(NumcyGemm::gemv_threads(rows * d), rows)); // At least one, there may be no rows
+                size_t per_thread = (rows + threads - 1) / threads;
+
+                NumcyGemm::run_parallel(threads, [=](size_t thread)
+                {
+                    size_t last = std::min(rows, (thread + 1) * per_thread);
+
+                    for (size_t i = thread * per_thread; i < last; i++)
+                    {
+                        norms[i] = std::sqrt(NumcyGemm::dot(d, t + i * d, t + i * d));
+                    }
+                });
+
+                return Collective<T, E>(data, Dimensions<E>(E(1), rows), MemoryLocation::Host);
+            }
+            catch (const std::bad_alloc& e)
+            {
+                delete[] data;
+                throw std::runtime_error("Numcy::row_norms(const Collective<T, E>&) -> " + std::string(e.what()));
+            }
+            catch (std::runtime_error& e)
+            {
+                delete[] data;
+                throw std::runtime_error("Numcy::row_norms(const Collective<T, E>&) -> " + std::string(e.what()));
+            }
+            catch (...)
+            {
+                delete[] data;
+                throw std::runtime_error("Numcy::row_norms(const Collective<T, E>&) Error: Unknown exception");
+            }
+        }
+
+        /*
+            Batched cosine similarity, query [q, d] against table [N, d] → scores [q, N]
+            ----------------------------------------------------------------------------
+                scores[i][j] = (query_i . table_j) / (|query_i| * |table_j|)     (0 when either norm is 0)
+
+            table_norms is row_norms(table), cached by the caller. The two argument overload computes it.
+
+            q == 1 → one streaming pass over the table, a SIMD dot per row with the scaling fused in
+            q >  1 → a GEMM against the transposed table (no transposed copy), then one scaling pass
+         */
+        template <typename T = double, typename E = size_t>
+        static Collective<T, E> cosine_similarity(const Collective<T, E>& query, const Collective<T, E>& table, const Collective<T, E>& table_norms)
+        {
+            NUMCY_TRACE_OP("cosine_similarity", query, table);
+            NUMCY_MEMORY_SITE("cosine_similarity");
+
+            T* data = nullptr;
+
+            try
+            {
+                E q = 0, n = 0, d = 0;
+                std::vector<T> inverse_query_norms = _cosineValidate(query, table, table_norms, q, n, d);
+
+                const T* qv = query.getData();
+                const T* t = table.getData();
+                const T* norms = table_norms.getData();
+
+                data = new T[q * n];
+                T* scores = data;
+
+                size_t threads = std::max(size_t(1), std::min(NumcyGemm::gemv_threads(n * d), n)); // At least one, there may be no rows
+                size_t per_thread = (n + threads - 1) / threads;
+
+                if (q == 1)
+                {
+                    T inverse_query_norm = inverse_query_norms[0];
+
+                    NumcyGemm::run_parallel(threads, [=](size_t thread)
+                    {
+                        size_t last = std::min(n, (thread + 1) * per_thread);
+
+                        for (size_t j = thread * per_thread; j < last; j++)
+                        {
+                            // if/else rather than ?:, for bfloat16/float16 the quotient is a float
+                            if (norms[j] == T(0))
+                            {
+                                scores[j] = T(0);
+                            }
+                            else
+                            {
+                                scores[j] = NumcyGemm::dot(d, qv, t + j * d) * inverse_query_norm / norms[j];
+                            }
+                        }
+                    });
+                }
+                else
+                {
+                    NumcyGemm::gemm_host<T>(false, true, q, n, d, T(1), qv, d, t, d, T(0), scores, n);
+
+                    const T* inverse = inverse_query_norms.data();
+
+                    NumcyGemm::run_parallel(threads, [=](size_t thread)
+                    {
+                        size_t last = std::min(n, (thread + 1) * per_thread);
+
+                        for (size_t i = 0; i < q; i++)
+                        {
+                            for (size_t j = thread * per_thread; j < last; j++)
+                            {
+                                if (norms[j] == T(0))
+                                {
+                                    scores[i * n + j] = T(0);
+                                }
+                                else
+                                {
+                                    scores[i * n + j] = scores[i * n + j] * inverse[i] / norms[j];
+                                }
+                            }
+                        }
+                    });
+                }
+
+                return Collective<T, E>(data, Dimensions<E>(n, q), MemoryLocation::Host);
+            }
+            catch (const std::bad_alloc& e)
+            {
+                delete[] data;
+                throw std::runtime_error("Numcy::cosine_similarity(const Collective<T, E>&, const Collective<T, E>&, const Collective<T, E>&) -> " + std::string(e.what()));
+            }
+            catch (std::runtime_error& e)
+            {
+                delete[] data;
+                throw std::runtime_error("Numcy::cosine_similarity(const Collective<T, E>&, const Collective<T, E>&, const Collective<T, E>&) -> " + std::string(e.what()));
+            }
+            catch (...)
+            {
+                delete[] data;
+                throw std::runtime_error("Numcy::cosine_similarity(const Collective<T, E>&, const Collective<T, E>&, const Collective<T, E>&) Error: Unknown exception");
+            }
+        }
+
+        template <typename T = double, typename E = size_t>
+        static Collective<T, E> cosine_similarity(const Collective<T, E>& query, const Collective<T, E>& table)
+        {
+            return Numcy::cosine_similarity(query, table, Numcy::row_norms(table));
+        }
+
+        /*
+            Top-k cosine similarity, query [q, d] against table [N, d]
+            ----------------------------------------------------------
+            Same scores as above, but the [q, N] score matrix is never materialized. Every thread takes
+            a contiguous range of table rows, scores it in blocks of COSINE_TOPK_BLOCK rows (a SIMD dot
+            per row for q == 1, a small GEMM per block for q > 1) and keeps one BoundedHeap per query.
+            The per-thread heaps are merged at the end.
+
+            values  → [q, k], best score first
+            indices → [q, k], the matching table rows
+         */
+        template <typename T = double, typename E = size_t>
+        static void cosine_similarity(const Collective<T, E>& query, const Collective<T, E>& table, const Collective<T, E>& table_norms, E k, Collective<T, E>& values, Collective<E, E>& indices)
+        {
+            NUMCY_TRACE_OP("cosine_similarity", query, table);
+            NUMCY_MEMORY_SITE("cosine_similarity");
+
+            constexpr size_t COSINE_TOPK_BLOCK = 256;
+
+            T* value_data = nullptr;
+            E* index_data = nullptr;
+
+            try
+            {
+                E q = 0, n = 0, d = 0;
+                std::vector<T> inverse_query_norms = _cosineValidate(query, table, table_norms, q, n, d);
+
+                if (k == E(0) || k > n)
+                {
+                    throw std::runtime_error("Error: k must be in [1, N]");
+                }
+
+                const T* qv = query.getData();
+                const T* t = table.getData();
+                const T* norms = table_norms.getData();
+                const T* inverse = inverse_query_norms.data();
+
+                size_t threads = std::max(size_t(1), std::min(NumcyGemm::gemv_threads(n * d), (n + COSINE_TOPK_BLOCK - 1) / COSINE_TOPK_BLOCK)); // At least one, there may be no rows
+                size_t per_thread = (n + threads - 1) / threads;
+
+                std::vector<std::vector<NumcyUtils::BoundedHeap<T, E>>> heaps(threads, std::vector<NumcyUtils::BoundedHeap<T, E>>(q, NumcyUtils::BoundedHeap<T, E>(k)));
+                std::vector<NumcyUtils::BoundedHeap<T, E>>* thread_heaps = heaps.data();
+
+                NumcyGemm::run_parallel(threads, [=](size_t thread)
+                {
+                    std::vector<NumcyUtils::BoundedHeap<T, E>>& mine = thread_heaps[thread];
+                    std::vector<T> block(q * COSINE_TOPK_BLOCK);
+
+                    size_t last = std::min(n, (thread + 1) * per_thread);
+
+                    for (size_t r0 = thread * per_thread; r0 < last; r0 += COSINE_TOPK_BLOCK)
+                    {
+                        size_t rows = std::min(COSINE_TOPK_BLOCK, last - r0);
+
+                        if (q == 1)
+                        {
+                            for (size_t j = 0; j < rows; j++)
+                            {
+                                block[j] = NumcyGemm::dot(d, qv, t + (r0 + j) * d);
+                            }
+                        }
+                        else
+                        {
+                            // block[q x rows] = query * table[r0:r0+rows]^T
+                            NumcyGemm::gemm_serial<T>(q, rows, d, T(1), qv, d, 1, t + r0 * d, 1, d, T(0), block.data(), rows);
+                        }
+
+                        for (size_t i = 0; i < q; i++)
+                        {
+                            for (size_t j = 0; j < rows; j++)
+                            {
+                                T score = (norms[r0 + j] == T(0)) ? T(0) : block[i * rows + j] * inverse[i] / norms[r0 + j];
+
+                                if (!mine[i].full() || score >= mine[i].threshold())
+                                {
+                                    mine[i].push(score, r0 + j);
+                                }
+                            }
+                        }
+                    }
+                });
+
+                value_data = new T[q * k];
+                index_data = new E[q * k];
+
+                for (size_t i = 0; i < q; i++)
+                {
+                    for (size_t thread = 1; thread < threads; thread++)
+                    {
+                        heaps[0][i].merge(heaps[thread][i]);
+                    }
+
+                    std::vector<std::pair<T, E>> best = heaps[0][i].sorted();
+
+                    for (size_t j = 0; j < k; j++)
+                    {
+                        value_data[i * k + j] = j < best.size() ? best[j].first : T(0);
+                        index_data[i * k + j] = j < best.size() ? best[j].second : E(0);
+                    }
+                }
+
+                values = Collective<T, E>(value_data, Dimensions<E>(k, q), MemoryLocation::Host);
+                value_data = nullptr; // Owned by values from here on
+                indices = Collective<E, E>(index_data, Dimensions<E>(k, q), MemoryLocation::Host);
+                index_data = nullptr; // Owned by indices from here on
+            }
+            catch (const std::bad_alloc& e)
+            {
+                delete[] value_data;
+                delete[] index_data;
+                throw std::runtime_error("Numcy::cosine_similarity(const Collective<T, E>&, const Collective<T, E>&, const Collective<T, E>&, E, Collective<T, E>&, Collective<E, E>&) -> " + std::string(e.what()));
+            }
+            catch (std::runtime_error& e)
+            {
+                delete[] value_data;
+                delete[] index_data;
+                throw std::runtime_error("Numcy::cosine_similarity(const Collective<T, E>&, const Collective<T, E>&, const Collective<T, E>&, E, Collective<T, E>&, Collective<E, E>&) -> " + std::string(e.what()));
+            }
+            catch (...)
+            {
+                delete[] value_data;
+                delete[] index_data;
+                throw std::runtime_error("Numcy::cosine_similarity(const Collective<T, E>&, const Collective<T, E>&, const Collective<T, E>&, E, Collective<T, E>&, Collective<E, E>&) Error: Unknown exception");
+            }
+        }
+
+        /*
+            Top-k along an axis
+            -------------------
+            Returns (values, indices), both shaped like c with the selected axis reduced to k. Along
+            every line of that axis the k largest values are kept, best first, ties go to the smaller
+            index. indices holds positions along the axis. No line is ever sorted in full. NaN ranks
+            below every number, a line with fewer than k numbers is completed with its NaNs.
+
+                scores [queries, N] → topk(scores, 10) → ([queries, 10], [queries, 10])
+
+            Numcy::topk(c, k, axis)
+            ├─► one BoundedHeap per line, O(len * log k) worst case and O(len) once the heap is full
+            ├─► once a heap is full, contiguous lines are filtered a block at a time: a block whose
+            │   maximum does not beat the heap's threshold is skipped without touching the heap
+            └─► parallel
+                  ├─► many lines → each thread takes a range of lines
+                  └─► few long lines → each line is split in one chunk per thread, per-thread heaps
+                                       are merged
+         */
+        template <typename T = double, typename E = size_t>
+        static std::pair<Collective<T, E>, Collective<E, E>> topk(const Collective<T, E>& c, E k, numcy::Axis axis = numcy::Axis::Last)
+        {
+            NUMCY_TRACE_OP("topk", c);
+            NUMCY_MEMORY_SITE("topk");
+
+            T* value_data = nullptr;
+            E* index_data = nullptr;
+
+            try
+            {
+                if (c.getMemoryLocation() != MemoryLocation::Host)
+                {
+                    throw std::runtime_error("Error: only host collectives are supported");
+                }
+
+                std::vector<E> shape = c.getShape().toVector();
+
+                int ndim = static_cast<int>(shape.size());
+                int a = static_cast<int>(axis);
+
+                if (a < 0)
+                {
+                    a += ndim;
+                }
+                if (a < 0 || a >= ndim)
+                {
+                    throw std::runtime_error("Error: axis out of range");
+                }
+
+                size_t ua = static_cast<size_t>(a);
+                size_t len = shape[ua], outer = 1, inner = 1;
+
+                for (size_t i = 0; i < ua; i++)
+                {
+                    outer = outer * shape[i];
+                }
+                for (size_t i = ua + 1; i < shape.size(); i++)
+                {
+                    inner = inner * shape[i];
+                }
+
+                if (k == E(0) || k > len)
+                {
+                    throw std::runtime_error("Error: k must be in [1, length of the axis]");
+                }
+
+                shape[ua] = k;
+
+                Dimensions<E> d;
+                d.fromVector(shape);
+
+                value_data = new T[d.numel()];
+                index_data = new E[d.numel()];
+
+                const T* data = c.getData();
+                T* values = value_data;
+                E* indices = index_data;
+
+                size_t lines = outer * inner;
+                size_t threads = NumcyGemm::gemv_threads(c.getShape().numel());
+
+                /*
+                    Feeds elements [first, last) of the line starting at base (stride inner) into heap
+                 */
+                auto scan = [inner](const T* base, size_t first, size_t last, NumcyUtils::BoundedHeap<T, E>& heap)
+                {
+                    constexpr size_t BLOCK = 16;
+
+                    size_t j = first;
+
+                    // Fill the heap, there is no threshold to filter against until it is full
+                    for (; j < last && !heap.full(); j++)
+                    {
+                        heap.push(base[j * inner], j);
+                    }
+
+                    if (inner == 1)
+                    {
+                        for (; j + BLOCK <= last; j += BLOCK)
+                        {
+                            // Starts from the threshold, a NaN never replaces it
+                            T block_max = heap.threshold();
+
+                            for (size_t i = 0; i < BLOCK; i++)
+                            {
+                                block_max = base[j + i] > block_max ? base[j + i] : block_max;
+                            }
+
+                            if (!(block_max > heap.threshold()))
+                            {
+                                continue;
+                            }
+
+                            for (size_t i = 0; i < BLOCK; i++)
+                            {
+                                if (base[j + i] > heap.threshold())
+                                {
+                                    heap.push(base[j + i], j + i);
+                                }
+                            }
+                        }
+                    }
+
+                    for (; j < last; j++)
+                    {
+                        if (base[j * inner] > heap.threshold())
+                        {
+                            heap.push(base[j * inner], j);
+                        }
+                    }
+                };
+
+                /*
+                    Writes the kept pairs of the line (o, i) to the outputs. The heaps never keep NaN,
+                    when one holds fewer than k pairs the rest of the line is NaN and the first of
+                    them, by index, complete it.
+                 */
+                auto store = [values, indices, inner, k, data, len](size_t line, const NumcyUtils::BoundedHeap<T, E>& heap)
+                {
+                    size_t o = line / inner, i = line % inner;
+                    std::vector<std::pair<T, E>> best = heap.sorted();
+                    const T* base = data + o * len * inner + i;
+
+                    for (size_t j = 0; j < len && best.size() < k; j++)
+                    {
+                        if (base[j * inner] != base[j * inner])
+                        {
+                            best.push_back(std::pair<T, E>(base[j * inner], j));
+                        }
+                    }
+
+                    for (size_t r = 0; r < k; r++)
+                    {
+                        values[o * k * inner + r * inner + i] = best[r].first;
+                        indices[o * k * inner + r * inner + i] = best[r].second;
+                    }
+                };
+
+                if (threads <= 1 || lines >= threads)
+                {
+                    threads = std::min(threads, lines);
+
+                    size_t per_thread = (lines + threads - 1) / threads;
+
+                    NumcyGemm::run_parallel(threads, [=](size_t thread)
+                    {
+                        NumcyUtils::BoundedHeap<T, E> heap(k);
+                        size_t last = std::min(lines, (thread + 1) * per_thread);
+
+                        for (size_t line = thread * per_thread; line < last; line++)
+                        {
+                            heap.clear();
+                            scan(data + (line / inner) * len * inner + line % inner, 0, len, heap);
+                            store(line, heap);
+                        }
+                    });
+                }
+                else
+                {
+                    // Few long lines, split each one across the threads
+                    threads = std::min(threads, (len + k - 1) / k);
+
+                    size_t per_thread = (len + threads - 1) / threads;
+                    std::vector<NumcyUtils::BoundedHeap<T, E>> heaps(threads, NumcyUtils::BoundedHeap<T, E>(k));
+                    NumcyUtils::BoundedHeap<T, E>* thread_heaps = heaps.data();
+
+                    for (size_t line = 0; line < lines; line++)
+                    {
+                        const T* base = data + (line / inner) * len * inner + line % inner;
+
+                        NumcyGemm::run_parallel(threads, [=](size_t thread)
+                        {
+                            thread_heaps[thread].clear();
+                            scan(base, thread * per_thread, std::min(len, (thread + 1) * per_thread), thread_heaps[thread]);
+                        });
+
+                        for (size_t thread = 1; thread < threads; thread++)
+                        {
+                            heaps[0].merge(heaps[thread]);
+                        }
+
+                        store(line, heaps[0]);
+                    }
+                }
+
+                std::pair<Collective<T, E>, Collective<E, E>> result(Collective<T, E>(value_data, d, MemoryLocation::Host), Collective<E, E>());
+                value_data = nullptr; // Owned by result.first from here on
+                result.second = Collective<E, E>(index_data, d, MemoryLocation::Host);
+                index_data = nullptr; // Owned by result.second from here on
+
+                return result;
+            }
+            catch (const std::bad_alloc& e)
+            {
+                delete[] value_data;
+                delete[] index_data;
+                throw std::runtime_error("Numcy::topk(const Collective<T, E>&, E, Axis) -> " + std::string(e.what()));
+            }
+            catch (std::runtime_error& e)
+            {
+                delete[] value_data;
+                delete[] index_data;
+                throw std::runtime_error("Numcy::topk(const Collective<T, E>&, E, Axis) -> " + std::string(e.what()));
+            }
+            catch (...)
+            {
+                delete[] value_data;
+                delete[] index_data;
+                throw std::runtime_error("Numcy::topk(const Collective<T, E>&, E, Axis) Error: Unknown exception");
+            }
+        }
+
+        /*
+            8 bit quantization, Numcy::quantize(weights, numcy::Quantization::PerRow)
+            -----------------------------------------------------------------------
+            Every element becomes q = round(x / scale) + zero_point clamped to [-128, 127], with one
+            (scale, zero_point) for the whole collective or one per row (last axis). The range of a
+            row (or of the collective) is mapped onto the full int8 range, widened to include 0.
+
+            Numcy::quantize(c, granularity)
+            ├─► min/max per row, or over everything, in parallel
+            ├─► scales, zero points, then the int8 values and their row sums (for qmatmul())
+            └─► NumcyQuant::Quantized<E>, values are an int8 Collective of the shape of c
+         */
+        template <typename T = double, typename E = size_t>
+        static NumcyQuant::Quantized<E> quantize(const Collective<T, E>& c, numcy::Quantization granularity = numcy::Quantization::PerRow)
+        {
+            NUMCY_TRACE_OP("quantize", c);
+            NUMCY_MEMORY_SITE("quantize");
+
+            int8_t* data = nullptr;
+
+            try
+            {
+                if (c.getMemoryLocation() != MemoryLocation::Host)
+                {
+                    throw std::runtime_error("Error: only host collectives are supported");
+                }
+
+                size_t rows = c.getShape().getNumberOfRows();
+                size_t columns = c.getShape().getNumberOfColumns();
+
+                // Every row's range starts from its first element
+                if (rows == 0 || columns == 0)
+                {
+                    throw std::runtime_error("Error: nothing to quantize, the collective has no elements");
+                }
+
+                size_t groups = granularity == numcy::Quantization::PerRow ? rows : 1;
+                size_t grain = std::max(size_t(1), NumcyThreads::ThreadPool::global().getSerialThreshold() / std::max(size_t(1), columns));
+                const T* from = c.getData();
+
+                NumcyQuant::Quantized<E> result;
+                result.granularity = granularity;
+                result.scales.resize(groups);
+                result.zero_points.resize(groups);
+                result.sums.resize(rows);
+
+                std::vector<float> lo(rows), hi(rows);
+                float* lo_row = lo.data();
+                float* hi_row = hi.data();
+
+                NumcyThreads::parallel_for(0, rows, grain, [=](size_t first, size_t last)
+                {
+                    for (size_t i = first; i < last; i++)
+                    {
+                        float low = static_cast<float>(from[i * columns]), high = low;
+
+                        for (size_t j = 1; j < columns; j++)
+                        {
+                            float x = static_cast<float>(from[i * columns + j]);
+
+                            low = std::min(low, x);
+                            high = std::max(high, x);
+                        }
+
+                        lo_row[i] = low;
+                        hi_row[i] = high;
+                    }
+                });
+
+                for (size_t g = 0; g < groups; g++)
+                {
+                    float low = lo[g], high = hi[g];
+
+                    for (size_t i = 1; groups == 1 && i < rows; i++)
+                    {
+                        low = std::min(low, lo[i]);
+                        high = std::max(high, hi[i]);
+                    }
+
+                    NumcyQuant::parameters(low, high, result.scales[g], result.zero_points[g]);
+                }
+
+                data = new int8_t[rows * columns];
+                result.values = Collective<int8_t, E>(data, c.getShape(), MemoryLocation::Host);
+
+                int8_t* to = data;
+                data = nullptr; // Owned by result.values from here on
+
+                const NumcyQuant::Quantized<E>& parameters = result;
+                int32_t* sums = result.sums.data();
+
+                NumcyThreads::parallel_for(0, rows, grain, [=, &parameters](size_t first, size_t last)
+                {
+                    for (size_t i = first; i < last; i++)
+                    {
+                        float inverse = 1.0f / parameters.scale(i);
+                        int32_t zero_point = parameters.zeroPoint(i);
+                        int32_t sum = 0;
+
+                        for (size_t j = 0; j < columns; j++)
+                        {
+                            to[i * columns + j] = NumcyQuant::quantizeValue(static_cast<float>(from[i * columns + j]), inverse, zero_point);
+                            sum += to[i * columns + j];
+                        }
+
+                        sums[i] = sum;
+                    }
+                });
+
+                return result;
+            }
+            catch (const std::bad_alloc& e)
+            {
+                delete[] data;
+                throw std::runtime_error("Numcy::quantize(const Collective<T, E>&, numcy::Quantization) -> " + std::string(e.what()));
+            }
+            catch (std::runtime_error& e)
+            {
+                delete[] data;
+                throw std::runtime_error("Numcy::quantize(const Collective<T, E>&, numcy::Quantization) -> " + std::string(e.what()));
+            }
+            catch (...)
+            {
+                delete[] data;
+                throw std::runtime_error("Numcy::quantize(const Collective<T, E>&, numcy::Quantization) Error: Unknown exception");
+            }
+        }
+
+        /*
+            The float collective a quantized one stands for, scale * (q - zero_point) per element
+         */
+        template <typename E = size_t>
+        static Collective<float, E> dequantize(const NumcyQuant::Quantized<E>& q)
+        {
+            NUMCY_TRACE_OP("dequantize", q.values);
+            NUMCY_MEMORY_SITE("dequantize");
+
+            float* data = nullptr;
+
+            try
+            {
+                size_t rows = q.values.getShape().getNumberOfRows();
+                size_t columns = q.values.getShape().getNumberOfColumns();
+                const int8_t* from = q.values.getData();
+
+                data = new float[rows * columns];
+
+                for (size_t i = 0; i < rows; i++)
+                {
+                    float scale = q.scale(i);
+                    int32_t zero_point = q.zeroPoint(i);
+
+                    for (size_t j = 0; j < columns; j++)
+                    {
+                        data[i * columns + j] = scale * float(int32_t(from[i * columns + j]) - zero_point);
+                    }
+                }
+
+                return Collective<float, E>(data, q.values.getShape(), MemoryLocation::Host);
+            }
+            catch (const std::bad_alloc& e)
+            {
+                delete[] data;
+                throw std::runtime_error("Numcy::dequantize(const NumcyQuant::Quantized<E>&) -> " + std::string(e.what()));
+            }
+            catch (...)
+            {
+                delete[] data;
+                throw std::runtime_error("Numcy::dequantize(const NumcyQuant::Quantized<E>&) Error: Unknown exception");
+            }
+        }
+
+        /*
+            Quantized matrix product, C = A * B^T
+            -------------------------------------
+            A is [..., m, k] (activations, leading axes folded into m), B is [n, k], a weight matrix
+            stored the way a linear layer reads it, one output feature per row, so that both operands
+            are read along contiguous rows of k bytes. C is a float [..., m, n].
+
+            Numcy::qmatmul(a, b)
+            ├─► validate shapes, k must be below 2^16 so that the int32 dot products (up to
+            │   255 * 128 * k) cannot overflow
+            └─► NumcyQuant::qmatmul_host()
+                  ├─► int8 x int8 dot products with int32 accumulation (VNNI, or AVX2 vpmaddwd)
+                  └─► zero points and scales applied to each int32 result as it is stored, float C
+         */
+        template <typename E = size_t>
+        static Collective<float, E> qmatmul(const NumcyQuant::Quantized<E>& a, const NumcyQuant::Quantized<E>& b)
+        {
+            NUMCY_TRACE_OP("qmatmul", a.values, b.values);
+            NUMCY_MEMORY_SITE("qmatmul");
+
+            float* data = nullptr;
+
+            try
+            {
+                if (b.values.getShape().size() != 1)
+                {
+                    throw std::runtime_error("Error: B must be a 2D collective");
+                }
+
+                size_t m = a.values.getShape().getNumberOfRows();
+                size_t k = a.values.getShape().getNumberOfColumns();
+                size_t n = b.values.getShape().getNumberOfRows();
+
+                if (k != b.values.getShape().getNumberOfColumns())
+                {
+                    throw std::runtime_error("Error: Incompatible shapes for quantized matrix product, the last axes of A and B must match");
+                }
+
+                if (k >= (size_t(1) << 16))
+                {
+                    throw std::runtime_error("Error: inner dimension must be below 65536");
+                }
+
+                std::vector<E> shape = a.values.getShape().toVector();
+                shape.back() = E(n);
+
+                Dimensions<E> d;
+                d.fromVector(shape);
+
+                data = new float[m * n];
+
+                NumcyQuant::qmatmul_host(m, n, k, a, b, data);
+
+                return Collective<float, E>(data, d, MemoryLocation::Host);
+            }
+            catch (const std::bad_alloc& e)
+            {
+                delete[] data;
+                throw std::runtime_error("Numcy::qmatmul(const NumcyQuant::Quantized<E>&, const NumcyQuant::Quantized<E>&) -> " + std::string(e.what()));
+            }
+            catch (std::runtime_error& e)
+            {
+                delete[] data;
+                throw std::runtime_error("Numcy::qmatmul(const NumcyQuant::Quantized<E>&, const NumcyQuant::Quantized<E>&) -> " + std::string(e.what()));
+            }
+            catch (...)
+            {
+                delete[] data;
+                throw std::runtime_error("Numcy::qmatmul(const NumcyQuant::Quantized<E>&, const NumcyQuant::Quantized<E>&) Error: Unknown exception");
+            }
+        }
+
+        /*
+            Saving and loading, see lib/Serialize.hh for the file layout
+            -------------------------------------------------------------
+            Numcy::save("table.ncy", table);
+            Collective<float> table = Numcy::load<float>("table.ncy");                                  // mmap, O(1)
+            Collective<float> scratch = Numcy::load<float>("table.ncy", numcy::Mapping::CopyOnWrite);   // writable, file untouched
+
+            save(path, c, alignment)
+            └─► header (element type, shape, alignment, checksums) and the elements at an offset that
+                is a multiple of alignment (4096 by default)
+
+            load<T, E>(path, mapping, verify)
+            ├─► ReadOnly (default) / CopyOnWrite → the elements are the mmap()ed file, nothing is read
+            │   until a page is touched, the collective unmaps it when its last handle goes
+            ├─► Copy → read into memory of its own
+            └─► verify → recompute the checksum of the elements, which reads them all
+         */
+        template <typename T = double, typename E = size_t>
+        static void save(const std::string& path, const Collective<T, E>& c, size_t alignment = NumcySerialize::DEFAULT_ALIGNMENT)
+        {
+            NUMCY_TRACE_OP("save", c);
+            NUMCY_MEMORY_SITE("save");
+
+            try
+            {
+                NumcySerialize::save(path, c, alignment);
+            }
+            catch (std::runtime_error& e)
+            {
+                throw std::runtime_error("Numcy::save(const std::string&, const Collective<T, E>&, size_t) -> " + std::string(e.what()));
+            }
+            catch (...)
+            {
+                throw std::runtime_error("Numcy::save(const std::string&, const Collective<T, E>&, size_t) Error: Unknown exception");
+            }
+        }
+
+        template <typename T = double, typename E = size_t>
+        static Collective<T, E> load(const std::string& path, numcy::Mapping mapping = numcy::Mapping::ReadOnly, bool verify = false)
+        {
+            NUMCY_TRACE_OP("load");
+            NUMCY_MEMORY_SITE("load");
+
+            try
+            {
+                return NumcySerialize::load<T, E>(path, mapping, verify);
+            }
+            catch (std::runtime_error& e)
+            {
+                throw std::runtime_error("Numcy::load(const std::string&, numcy::Mapping, bool) -> " + std::string(e.what()));
+            }
+            catch (...)
+            {
+                throw std::runtime_error("Numcy::load(const std::string&, numcy::Mapping, bool) Error: Unknown exception");
+            }
+        }
+
+        /*
+            NumPy files, see lib/Npy.hh
+            ---------------------------
+            Numcy::save_npy("embeddings.npy", embeddings);                       // numpy.load() reads it
+            Collective<float> e = Numcy::load_npy<float>("embeddings.npy");        // mmap, O(1) for C order
+            Collective<int64_t> ids = Numcy::load_npz<int64_t>("batch.npz", "ids");
+
+            load_npy<T, E>(path, mapping)
+            ├─► C order, little-endian → the mmap()ed file, as Numcy::load()
+            ├─► Fortran order → transposed into C order as it is copied, big-endian → byte swapped
+            └─► (n,) loads as [1, n], () as [1, 1]
+
+            savez(path, {{"weights", w}, {"bias", b}}) writes an uncompressed .npz (numpy.savez()),
+            for entries of different element types use NumcyNpy::NpzWriter directly
+         */
+        template <typename T = double, typename E = size_t>
+        static void save_npy(const std::string& path, const Collective<T, E>& c)
+        {
+            NUMCY_TRACE_OP("save_npy", c);
+            NUMCY_MEMORY_SITE("save_npy");
+
+            try
+            {
+                NumcyNpy::save(path, c);
+            }
+            catch (std::runtime_error& e)
+            {
+                throw std::runtime_error("Numcy::save_npy(const std::string&, const Collective<T, E>&) -> " + std::string(e.what()));
+            }
+            catch (...)
+            {
+                throw std::runtime_error("Numcy::save_npy(const std::string&, const Collective<T, E>&) Error: Unknown exception");
+            }
+        }
+
+        template <typename T = double, typename E = size_t>
+        static Collective<T, E> load_npy(const std::string& path, numcy::Mapping mapping = numcy::Mapping::ReadOnly)
+        {
+            NUMCY_TRACE_OP("load_npy");
+            NUMCY_MEMORY_SITE("load_npy");
+
+            try
+            {
+                return NumcyNpy::load<T, E>(path, mapping);
+            }
+            catch (std::runtime_error& e)
+            {
+                throw std::runtime_error("Numcy::load_npy(const std::string&, numcy::Mapping) -> " + std::string(e.what()));
+            }
+            catch (...)
+            {
+                throw std::runtime_error("Numcy::load_npy(const std::string&, numcy::Mapping) Error: Unknown exception");
+            }
+        }
+
+        template <typename T = double, typename E = size_t>
+        static void savez(const std::string& path, const std::vector<std::pair<std::string, Collective<T, E>>>& entries)
+        {
+            NUMCY_TRACE_OP("savez");
+            NUMCY_MEMORY_SITE("savez");
+
+            try
+            {
+                NumcyNpy::NpzWriter npz(path);
+
+                for (size_t i = 0; i < entries.size(); i++)
+                {
+                    npz.add(entries[i].first, entries[i].second);
+                }
+
+                npz.close();
+            }
+            catch (std::runtime_error& e)
+            {
+                throw std::runtime_error("Numcy::savez(const std::string&, const std::vector<std::pair<std::string, Collective<T, E>>>&) -> " + std::string(e.what()));
+            }
+            catch (...)
+            {
+                throw std::runtime_error("Numcy::savez(const std::string&, const std::vector<std::pair<std::string, Collective<T, E>>>&) Error: Unknown exception");
+            }
+        }
+
+        template <typename T = double, typename E = size_t>
+        static Collective<T, E> load_npz(const std::string& path, const std::string& name, numcy::Mapping mapping = numcy::Mapping::ReadOnly)
+        {
+            NUMCY_TRACE_OP("load_npz");
+            NUMCY_MEMORY_SITE("load_npz");
+
+            try
+            {
+                return NumcyNpy::NpzReader(path).get<T, E>(name, mapping);
+            }
+            catch (std::runtime_error& e)
+            {
+                throw std::runtime_error("Numcy::load_npz(const std::string&, const std::string&, numcy::Mapping) -> " + std::string(e.what()));
+            }
+            catch (...)
+            {
+                throw std::runtime_error("Numcy::load_npz(const std::string&, const std::string&, numcy::Mapping) Error: Unknown exception");
+            }
+        }
+
+        /*
+            from_csv<T, E>(path, delimiter)
+            ├─► a numeric CSV / TSV file as a [rows, columns] collective of T, see lib/Csv.hh
+            ├─► delimiter 0 (default) — tab or comma, whichever the first line has
+            └─► a header line is skipped, a line with a missing or extra field or a field that is
+                not a number throws with its row
+         */
+        template <typename T = double, typename E = size_t>
+        static Collective<T, E> from_csv(const std::string& path, char delimiter = 0)
+        {
+            NUMCY_TRACE_OP("from_csv");
+            NUMCY_MEMORY_SITE("from_csv");
+
+            try
+            {
+                return NumcyCsv::read<T, E>(path, delimiter);
+            }
+            catch (std::bad_alloc& e)
+            {
+                throw std::runtime_error("Numcy::from_csv(const std::string&, char) Error: " + std::string(e.what()));
+            }
+            catch (std::runtime_error& e)
+            {
+                throw std::runtime_error("Numcy::from_csv(const std::string&, char) -> " + std::string(e.what()));
+            }
+            catch (...)
+            {
+                throw std::runtime_error("Numcy::from_csv(const std::string&, char) Error: Unknown exception");
+            }
+        }
+
+        /*
+            write_trace(path)
+            ├─► every op traced so far as a Chrome trace JSON file, see lib/Trace.hh
+            └─► built without -DNUMCY_TRACE nothing is traced, the file has no events
+         */
+        static void write_trace(const std::string& path)
+        {
+            try
+            {
+#ifdef NUMCY_TRACE
+                NumcyTrace::write(path);
+#else
+                std::ofstream file(path);
+
+                file << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": []}\n";
+
+                if (!file)
+                {
+                    throw std::runtime_error("cannot write " + path);
+                }
+#endif
+            }
+            catch (std::runtime_error& e)
+            {
+                throw std::runtime_error("Numcy::write_trace(const std::string&) -> " + std::string(e.what()));
+            }
+        }
+
+        /*
+            Memory accounting, see lib/Memory.hh
+            ├─► memory_stats()             — live and peak bytes and allocations, host and device
+            ├─► track_allocations(on)      — records the size, shape and site of every live buffer
+            │                                (NUMCY_MEMORY_SITES=1 does so from the start)
+            └─► memory_dump(out, count)    — the count largest live buffers with their sites, an
+                                             allocation that fails writes them to std::cerr too
+         */
+        static NumcyMemory::Stats memory_stats(void)
+        {
+            return NumcyMemory::Accounting::global().stats();
+        }
+
+        static void track_allocations(bool on = true)
+        {
+            NumcyMemory::Accounting::global().setTracking(on);
+        }
+
+        static void memory_dump(std::ostream& out = std::cerr, size_t count = 10)
+        {
+            NumcyMemory::Accounting::global().dump(out, count);
+        }
+
+        /*
+            Static shapes, see lib/StaticCollective.hh
+            ├─► matmul(a, b)    — [M, K] x [K, N] of StaticCollectives, unrolled, no allocation
+            └─► transpose(a)    — [M, N] -> [N, M]
+         */
+        template <typename T, size_t M, size_t K, size_t N>
+        static StaticCollective<T, M, N> matmul(const StaticCollective<T, M, K>& a, const StaticCollective<T, K, N>& b)
+        {
+            return NumcyStatic::matmul(a, b);
+        }
+
+        template <typename T, size_t M, size_t N>
+        static StaticCollective<T, N, M> transpose(const StaticCollective<T, M, N>& a)
+        {
+            return NumcyStatic::transpose(a);
+        }
+
+        /*
+            Asynchronous ops
+            ----------------
+            Numcy::async(op, dependencies...) returns at once with a pending Collective, op() runs on
+            the thread pool once every dependency is ready and its result becomes that Collective.
+            Nothing blocks until the data is actually used, getData(), operator[] and getShape() wait
+            for it (helping the pool meanwhile). If op throws, every access rethrows.
+
+                Collective<float> h = Numcy::async_matmul(x, w1);                               // queued
+                Collective<float> w2 = Numcy::async([d]() { return Numcy::randn_bert<float>(d, 7); }); // runs next to it
+                Collective<float> y = Numcy::async_matmul(h, w2);                               // waits for both
+
+            op must capture what it reads by value (Collective copies are cheap handles), the caller's
+            stack may be gone by the time it runs. A dependency only orders the ops, op still has to
+            capture the dependency to read it.
+         */
+        template <typename F, typename... Dependencies>
+        static auto async(F op, const Dependencies&... dependencies) -> typename std::decay<decltype(op())>::type
+        {
+            return NumcyAsync::schedule(op, dependencies...);
+        }
+
+        /*
+            Numcy::matmul(a, b) once a and b are ready, see async()
+         */
+        template <typename T = double, typename E = size_t>
+        static Collective<T, E> async_matmul(const Collective<T, E>& a, const Collective<T, E>& b)
+        {
+            return NumcyAsync::schedule([a, b]() { return Numcy::matmul(a, b); }, a, b);
+        }
+
+    private:
+        /*
+            Shape checks shared by the cosine_similarity() overloads.
+            Returns 1 / |query_i| for every query row (0 for a zero query).
+         */
+        template <typename T, typename E>
+        static std::vector<T> _cosineValidate(const Collective<T, E>& query, const Collective<T, E>& table, const Collective<T, E>& table_norms, E& q, E& n, E& d)
+        {
+            if (query.getMemoryLocation() != MemoryLocation::Host || table.getMemoryLocation() != MemoryLocation::Host || table_norms.getMemoryLocation() != MemoryLocation::Host)
+            {
+                throw std::runtime_error("Error: only host collectives are supported");
+            }
+
+            q = query.getShape().getNumberOfRows();
+            d = query.getShape().getNumberOfColumns();
+            n = table.getShape().getNumberOfRows();
+
+            if (table.getShape().getNumberOfColumns() != d)
+            {
+                throw std::runtime_error("Error: query and table rows must have the same number of columns");
+            }
+
+            if (table_norms.getShape().numel() != n)
+            {
+                throw std::runtime_error("Error: table_norms must have one element per table row");
+            }
+
+            std::vector<T> inverse(q);
+
+            for (size_t i = 0; i < q; i++)
+            {
+                T norm = std::sqrt(NumcyGemm::dot(d, query.getData() + i * d, query.getData() + i * d));
+
+                if (norm == T(0))
+                {
+                    inverse[i] = T(0);
+                }
+                else
+                {
+                    inverse[i] = T(1) / norm;
+                }
+            }
+
+            return inverse;
+        }
 };
 
 #endif
\ No newline at end of file
@@ -133,13 +133,34 @@ namespace NumcyUtils
 
         // Matches device: standard normal mean=0, std=1
         // Caller scales for their specific init scheme (Xavier, He, Word2Vec etc.)
-        std::mt19937_64 gen(seed ? seed : std::random_device{}());
-        std::normal_distribution<T> dis(static_cast<T>(0), static_cast<T>(1));
-
-        for (E i = 0; i < numel; i++)
+        /*
+            Filled in blocks of RANDN_BLOCK elements, each block from its own generator seeded with
+            seed + block * golden ratio, so the blocks can be filled in parallel and the result does
+            not depend on the number of threads. Block 0 is seeded with seed itself, a Collective of
+            at most RANDN_BLOCK elements gets the same numbers it always did. The blocks are handed
+            out statically, which first-touches each slice of the buffer on its thread's NUMA node.
+         */
+        constexpr size_t RANDN_BLOCK = 1 << 16;
+
+        uint64_t base = seed ? seed : std::random_device{}();
+        size_t blocks = (numel + RANDN_BLOCK - 1) / RANDN_BLOCK;
+
+        NumcyThreads::parallel_for_static(0, blocks, 1, [=](size_t first, size_t last)
         {
-            data[i] = dis(gen);
-        }
+            for (size_t block = first; block < last; block++)
+            {
+                std::mt19937_64 gen(base + block * 0x9E3779B97F4A7C15ULL);
+                // bfloat16/float16 draw in float, std::normal_distribution only takes the built-in types
+                std::normal_distribution<typename NumcyHalf::Accumulate<T>::type> dis(0, 1);
+
+                size_t end = std::min<size_t>(numel, (block + 1) * RANDN_BLOCK);
+
+                for (size_t i = block * RANDN_BLOCK; i < end; i++)
+                {
+                    data[i] = dis(gen);
+                }
+            }
+        });
 
         return Collective<T, E>(data, d, MemoryLocation::Host);
     }
@@ -153,12 +174,17 @@ namespace NumcyUtils
     template <typename T = double, typename E = size_t>
     void scale_host(Collective<T, E>& c, T factor)
     {
-        E numel = c.getShape().numel();
+        size_t numel = c.getShape().numel();
+        T* data = c.getData();
 
-        for (E i = 0; i < numel; i++)
+        // Static slices, the same threads that first wrote the pages (randn_host) read them again
+        NumcyThreads::parallel_for_static(0, numel, NumcyThreads::ThreadPool::global().getSerialThreshold(), [=](size_t first, size_t last)
         {
-            c[i] *= factor;
-        }
+            for (size_t i = first; i < last; i++)
+            {
+                data[i] *= factor;
+            }
+        });
     }
 
 /*
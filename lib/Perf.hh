@@ -0,0 +1,368 @@
+/*
+ * Numcy/lib/Perf.hh
+ *
+ * Hardware performance counters around any piece of code, through Linux perf_event_open(), no
+ * libpfm or perf tool needed. Cycles, instructions, last level cache references and misses and
+ * branch misses, counted in user space on every thread of the process, give IPC and the LLC miss
+ * rate. With the bytes and FLOPs of the code and the measured peaks of the machine a Roofline
+ * says whether it is bound by memory or by compute and how close to that bound it runs.
+ *
+ *     NumcyPerf::Counters counters;
+ *     NumcyPerf::Sample s = counters.measure([&]() { c = Numcy::matmul(a, b); });
+ *
+ *     s.ipc(), s.llcMissRate(), s.seconds
+ *
+ * Where the counters cannot be opened (not Linux, a VM without a PMU, perf_event_paranoid too
+ * high) isAvailable() is false, getError() says why and every Sample has only its time.
+ *
+ * Q@hackers.pk
+ */
+
+#ifndef NUMCY_PERF_HH
+#define NUMCY_PERF_HH
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+    #include <dirent.h>
+    #include <linux/perf_event.h>
+    #include <sys/ioctl.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
+namespace NumcyPerf
+{
+    enum Event
+    {
+        Cycles,
+        Instructions,
+        CacheReferences,  // Last level cache
+        CacheMisses,      // Last level cache
+        BranchMisses,
+        EVENTS
+    };
+
+    inline const char* name(size_t event)
+    {
+        static const char* const names[EVENTS] = {"cycles", "instructions", "llc-references", "llc-misses", "branch-misses"};
+
+        return event < EVENTS ? names[event] : "";
+    }
+
+    /*
+        Counts of one measurement, summed over the threads and scaled up when the kernel had to
+        multiplex the counters (time enabled / time running)
+     */
+    struct Sample
+    {
+        double value[EVENTS];
+        bool counted[EVENTS];
+        double seconds;
+
+        Sample(void) : value(), counted(), seconds(0.0)
+        {
+        }
+
+        bool has(Event event) const
+        {
+            return this->counted[event];
+        }
+
+        /*
+            Instructions per cycle, 0 without both counts
+         */
+        double ipc(void) const
+        {
+            return this->has(Cycles) && this->has(Instructions) && this->value[Cycles] > 0.0 ? this->value[Instructions] / this->value[Cycles] : 0.0;
+        }
+
+        /*
+            LLC misses per LLC reference
+         */
+        double llcMissRate(void) const
+        {
+            return this->has(CacheReferences) && this->has(CacheMisses) && this->value[CacheReferences] > 0.0 ? this->value[CacheMisses] / this->value[CacheReferences] : 0.0;
+        }
+
+        /*
+            The sample of one of calls calls
+         */
+        Sample per(double calls) const
+        {
+            Sample one(*this);
+
+            for (size_t i = 0; i < EVENTS; i++)
+            {
+                one.value[i] = one.value[i] / calls;
+            }
+
+            one.seconds = one.seconds / calls;
+
+            return one;
+        }
+    };
+
+    /*
+        Counters
+        --------
+        One counter per event and thread, opened once by the constructor for the threads the process
+        has then (start the thread pool first, Numcy::ThreadPool::global()), reset and enabled by
+        start(), read by stop().
+        ├─► start() / stop()  — around any scope, stop() returns the counts since start()
+        ├─► measure(f)        — f() between the two
+        └─► an event the CPU does not have is left out, Sample::has() is false for it
+     */
+    class Counters
+    {
+        std::vector<int> descriptors;  // EVENTS per thread, -1 where not opened
+        std::string error;
+        std::chrono::steady_clock::time_point started;
+
+#if defined(__linux__)
+        static int _open(uint64_t config, long thread)
+        {
+            perf_event_attr attr;
+
+            std::memset(&attr, 0, sizeof(attr));
+
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.size = sizeof(attr);
+            attr.config = config;
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+            return int(syscall(__NR_perf_event_open, &attr, thread, -1, -1, 0UL));
+        }
+
+        static std::vector<long> _threads(void)
+        {
+            std::vector<long> threads;
+            DIR* tasks = opendir("/proc/self/task");
+
+            if (tasks == nullptr)
+            {
+                threads.push_back(0);
+
+                return threads;
+            }
+
+            for (dirent* entry = readdir(tasks); entry != nullptr; entry = readdir(tasks))
+            {
+                if (entry->d_name[0] != '.')
+                {
+                    threads.push_back(std::strtol(entry->d_name, nullptr, 10));
+                }
+            }
+
+            closedir(tasks);
+
+            return threads;
+        }
+
+        void _control(unsigned long request)
+        {
+            for (size_t i = 0; i < this->descriptors.size(); i++)
+            {
+                if (this->descriptors[i] >= 0)
+                {
+                    ioctl(this->descriptors[i], request, 0);
+                }
+            }
+        }
+#endif
+
+        public:
+            Counters(void) : descriptors(), error(), started()
+            {
+#if defined(__linux__)
+                static const uint64_t configs[EVENTS] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_REFERENCES, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+
+                std::vector<long> threads = _threads();
+                bool any = false;
+
+                for (size_t t = 0; t < threads.size(); t++)
+                {
+                    for (size_t e = 0; e < EVENTS; e++)
+                    {
+                        int fd = _open(configs[e], threads[t]);
+
+                        if (fd < 0 && this->error.empty())
+                        {
+                            this->error = std::string("perf_event_open(") + name(e) + "): " + std::strerror(errno);
+                        }
+
+                        any = any || fd >= 0;
+                        this->descriptors.push_back(fd);
+                    }
+                }
+
+                if (!any)
+                {
+                    this->error = this->error + ", see /proc/sys/kernel/perf_event_paranoid";
+
+                    for (size_t i = 0; i < this->descriptors.size(); i++)
+                    {
+                        this->descriptors[i] = -1;
+                    }
+                }
+                else
+                {
+                    this->error.clear();
+                }
+#else
+                this->error = "performance counters need Linux";
+#endif
+            }
+
+            Counters(const Counters&) = delete;
+            Counters& operator=(const Counters&) = delete;
+
+            ~Counters()
+            {
+#if defined(__linux__)
+                for (size_t i = 0; i < this->descriptors.size(); i++)
+                {
+                    if (this->descriptors[i] >= 0)
+                    {
+                        close(this->descriptors[i]);
+                    }
+                }
+#endif
+            }
+
+            bool isAvailable(void) const
+            {
+                return this->error.empty();
+            }
+
+            const std::string& getError(void) const
+            {
+                return this->error;
+            }
+
+            void start(void)
+            {
+#if defined(__linux__)
+                this->_control(PERF_EVENT_IOC_RESET);
+                this->_control(PERF_EVENT_IOC_ENABLE);
+#endif
+                this->started = std::chrono::steady_clock::now();
+            }
+
+            Sample stop(void)
+            {
+                Sample sample;
+
+                sample.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - this->started).count();
+
+#if defined(__linux__)
+                this->_control(PERF_EVENT_IOC_DISABLE);
+
+                for (size_t i = 0; i < this->descriptors.size(); i++)
+                {
+                    uint64_t counts[3] = {0, 0, 0};  // value, time enabled, time running
+
+                    if (this->descriptors[i] < 0 || read(this->descriptors[i], counts, sizeof(counts)) != ssize_t(sizeof(counts)))
+                    {
+                        continue;
+                    }
+
+                    size_t event = i % EVENTS;
+
+                    sample.counted[event] = true;
+                    sample.value[event] = sample.value[event] + (counts[2] == 0 ? 0.0 : double(counts[0]) * double(counts[1]) / double(counts[2]));
+                }
+#endif
+
+                return sample;
+            }
+
+            template <typename F>
+            Sample measure(F body)
+            {
+                this->start();
+                body();
+
+                return this->stop();
+            }
+    };
+
+    /*
+        Roofline
+        --------
+        The measured peaks of the machine, bytes / s from main memory and FLOP / s. Code of
+        intensity flops / bytes below the ridge (peak FLOP/s / peak bytes/s) can at best run at
+        intensity * bandwidth, it is memory bound, above the ridge it is compute bound.
+        ├─► attainable(intensity)            — FLOP/s the roof allows
+        ├─► bound(bytes, flops)              — "memory", "compute" or "" when there is nothing to say
+        └─► efficiency(bytes, flops, secs)   — fraction of the roof reached, by FLOP/s or, for code
+                                               without FLOPs, by bytes/s
+     */
+    struct Roofline
+    {
+        double bytes_per_s;
+        double flops_per_s;
+
+        Roofline(void) : bytes_per_s(0.0), flops_per_s(0.0)
+        {
+        }
+
+        Roofline(double bandwidth, double compute) : bytes_per_s(bandwidth), flops_per_s(compute)
+        {
+        }
+
+        bool isKnown(void) const
+        {
+            return this->bytes_per_s > 0.0 && this->flops_per_s > 0.0;
+        }
+
+        double ridge(void) const
+        {
+            return this->isKnown() ? this->flops_per_s / this->bytes_per_s : 0.0;
+        }
+
+        double attainable(double intensity) const
+        {
+            return std::min(this->flops_per_s, intensity * this->bytes_per_s);
+        }
+
+        std::string bound(double bytes, double flops) const
+        {
+            if (!this->isKnown() || (bytes <= 0.0 && flops <= 0.0))
+            {
+                return "";
+            }
+
+            return bytes > 0.0 && flops / bytes < this->ridge() ? "memory" : "compute";
+        }
+
+        double efficiency(double bytes, double flops, double seconds) const
+        {
+            if (!this->isKnown() || seconds <= 0.0)
+            {
+                return 0.0;
+            }
+
+            if (flops > 0.0)
+            {
+                double roof = bytes > 0.0 ? this->attainable(flops / bytes) : this->flops_per_s;
+
+                return flops / seconds / roof;
+            }
+
+            return bytes > 0.0 ? bytes / seconds / this->bytes_per_s : 0.0;
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,343 @@
+/*
+ * Numcy/lib/Quantize.hh
+ *
+ * 8 bit affine quantization for inference, real = scale * (q - zero_point), and the int8 matrix
+ * product behind Numcy::qmatmul(). A quantized matrix is a quarter of the bytes of the float
+ * one, the product streams it as bytes and accumulates in int32.
+ *
+ * Q@hackers.pk
+ */
+
+#ifndef NUMCY_QUANTIZE_HH
+#define NUMCY_QUANTIZE_HH
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace numcy {
+
+    /*
+        How many (scale, zero point) pairs a quantized collective carries
+     */
+    enum class Quantization : int {
+        PerTensor = 0, // One pair for every element
+        PerRow    = 1  // One pair per row (last axis), rows of very different magnitude keep their precision
+    };
+}
+
+namespace NumcyQuant
+{
+    /*
+        Quantized<E>
+        ├─► values      — int8 collective of the shape of the original
+        ├─► scales      — one per row (PerRow) or a single one (PerTensor)
+        ├─► zero_points — likewise, the int8 value real 0.0 maps to, exactly representable
+        ├─► sums        — sum of values over each row, int32, what qmatmul() needs to remove the
+        │                 zero points from a raw int8 dot product, computed once here
+        └─► granularity
+     */
+    template <typename E = size_t>
+    struct Quantized
+    {
+        Collective<int8_t, E> values;
+        std::vector<float> scales;
+        std::vector<int32_t> zero_points;
+        std::vector<int32_t> sums;
+        numcy::Quantization granularity;
+
+        Quantized(void) : values(), scales(), zero_points(), sums(), granularity(numcy::Quantization::PerTensor)
+        {
+        }
+
+        float scale(size_t row) const
+        {
+            return this->scales[this->granularity == numcy::Quantization::PerRow ? row : 0];
+        }
+
+        int32_t zeroPoint(size_t row) const
+        {
+            return this->zero_points[this->granularity == numcy::Quantization::PerRow ? row : 0];
+        }
+    };
+
+    /*
+        Scale and zero point mapping [lo, hi] onto [-128, 127]. The range is widened to include 0
+        so that 0.0 (padding, ReLU output) quantizes without error.
+     */
+    inline void parameters(float lo, float hi, float& scale, int32_t& zero_point)
+    {
+        lo = std::min(lo, 0.0f);
+        hi = std::max(hi, 0.0f);
+
+        scale = (hi - lo) / 255.0f;
+
+        if (!(scale > 0.0f))
+        {
+            scale = 1.0f;
+        }
+
+        zero_point = std::max(-128, std::min(127, int32_t(std::lround(-128.0f - lo / scale))));
+    }
+
+    inline int8_t quantizeValue(float value, float inverse_scale, int32_t zero_point)
+    {
+        int32_t q = int32_t(std::lround(value * inverse_scale)) + zero_point;
+
+        return static_cast<int8_t>(std::max(-128, std::min(127, q)));
+    }
+
+    /*
+        dot_biased<R>()
+        ├─► out[r] = sum((a[i] + 128) * b[r][i]) for i in [0, n), r in [0, R), exact in int32 for n < 2^16
+        ├─► one pass over a feeds R rows of B, every load of a is reused R times (R accumulators)
+        └─► the +128 makes a unsigned, which is what the u8 x s8 dot product instructions take,
+            the caller removes it again with 128 * sum(b), which it has precomputed
+              AVX512-VNNI → vpdpbusd, 64 byte products per instruction
+              AVX-512     → both sides widened to int16 and vpmaddwd on zmm, 32
+              AVX2        → the same on ymm, 16. vpmaddubsw would save the widening but saturates
+                            its int16 pair sums (255 * 127 * 2 > 32767)
+     */
+    template <size_t R>
+    void dot_biased_portable(size_t i, size_t n, const int8_t* a, const int8_t* const* b, int32_t* out)
+    {
+        for (; i < n; i++)
+        {
+            int32_t x = int32_t(a[i]) + 128;
+
+            for (size_t r = 0; r < R; r++)
+            {
+                out[r] += x * int32_t(b[r][i]);
+            }
+        }
+    }
+
+    template <size_t R>
+    void dot_biased_portable(size_t n, const int8_t* a, const int8_t* const* b, int32_t* out)
+    {
+        for (size_t r = 0; r < R; r++)
+        {
+            out[r] = 0;
+        }
+
+        dot_biased_portable<R>(0, n, a, b, out);
+    }
+
+#if defined(NUMCY_X86)
+    template <size_t R>
+    NUMCY_TARGET("avx512vnni,avx512f,avx512bw,avx512vl,avx2")
+    void dot_biased_avx512vnni(size_t n, const int8_t* a, const int8_t* const* b, int32_t* out)
+    {
+        const __m512i flip = _mm512_set1_epi8(static_cast<char>(0x80));
+        __m512i acc[R];
+        size_t i = 0;
+
+        for (size_t r = 0; r < R; r++)
+        {
+            acc[r] = _mm512_setzero_si512();
+        }
+
+        for (; i + 64 <= n; i += 64)
+        {
+            __m512i x = _mm512_xor_si512(_mm512_loadu_si512(a + i), flip);
+
+            for (size_t r = 0; r < R; r++)
+            {
+                acc[r] = _mm512_dpbusd_epi32(acc[r], x, _mm512_loadu_si512(b[r] + i));
+            }
+        }
+
+        for (size_t r = 0; r < R; r++)
+        {
+            int32_t lanes[16];
+            _mm512_storeu_si512(lanes, acc[r]);
+
+            out[r] = 0;
+
+            for (size_t lane = 0; lane < 16; lane++)
+            {
+                out[r] += lanes[lane];
+            }
+        }
+
+        dot_biased_portable<R>(i, n, a, b, out);
+    }
+
+    template <size_t R>
+    NUMCY_TARGET("avx512f,avx512bw,avx512vl,avx2")
+    void dot_biased_avx512(size_t n, const int8_t* a, const int8_t* const* b, int32_t* out)
+    {
+        const __m256i flip = _mm256_set1_epi8(static_cast<char>(0x80));
+        __m512i acc[R];
+        size_t i = 0;
+
+        for (size_t r = 0; r < R; r++)
+        {
+            acc[r] = _mm512_setzero_si512();
+        }
+
+        for (; i + 32 <= n; i += 32)
+        {
+            __m512i x = _mm512_cvtepu8_epi16(_mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)), flip));
+
+            for (size_t r = 0; r < R; r++)
+            {
+                __m512i y = _mm512_cvtepi8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(b[r] + i)));
+
+                acc[r] = _mm512_add_epi32(acc[r], _mm512_madd_epi16(x, y));
+            }
+        }
+
+        for (size_t r = 0; r < R; r++)
+        {
+            int32_t lanes[16];
+            _mm512_storeu_si512(lanes, acc[r]);
+
+            out[r] = 0;
+
+            for (size_t lane = 0; lane < 16; lane++)
+            {
+                out[r] += lanes[lane];
+            }
+        }
+
+        dot_biased_portable<R>(i, n, a, b, out);
+    }
+
+    template <size_t R>
+    NUMCY_TARGET("avx2")
+    void dot_biased_avx2(size_t n, const int8_t* a, const int8_t* const* b, int32_t* out)
+    {
+        const __m128i flip = _mm_set1_epi8(static_cast<char>(0x80));
+        __m256i acc[R];
+        size_t i = 0;
+
+        for (size_t r = 0; r < R; r++)
+        {
+            acc[r] = _mm256_setzero_si256();
+        }
+
+        for (; i + 16 <= n; i += 16)
+        {
+            __m256i x = _mm256_cvtepu8_epi16(_mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)), flip));
+
+            for (size_t r = 0; r < R; r++)
+            {
+                __m256i y = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b[r] + i)));
+
+                acc[r] = _mm256_add_epi32(acc[r], _mm256_madd_epi16(x, y));
+            }
+        }
+
+        for (size_t r = 0; r < R; r++)
+        {
+            __m128i half = _mm_add_epi32(_mm256_castsi256_si128(acc[r]), _mm256_extracti128_si256(acc[r], 1));
+            half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4E));
+            half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0xB1));
+
+            out[r] = _mm_cvtsi128_si32(half);
+        }
+
+        dot_biased_portable<R>(i, n, a, b, out);
+    }
+#endif
+
+    template <size_t R>
+    using DotBiased = void (*)(size_t, const int8_t*, const int8_t* const*, int32_t*);
+
+    /*
+        The variant for R picked on the first call, qmatmul_host() calls it through the pointer
+     */
+    template <size_t R>
+    void dot_biased(size_t n, const int8_t* a, const int8_t* const* b, int32_t* out)
+    {
+        static const DotBiased<R> kernel = NumcyCpu::select<DotBiased<R>>(("dot_biased<" + std::to_string(R) + ">").c_str(), {
+#if defined(NUMCY_X86)
+            {NumcyCpu::features().avx512vnni, "avx512vnni", &dot_biased_avx512vnni<R>},
+            {NumcyCpu::features().avx512, "avx512", &dot_biased_avx512<R>},
+            {NumcyCpu::features().avx2, "avx2", &dot_biased_avx2<R>},
+#endif
+            {true, "portable", &dot_biased_portable<R>}
+        });
+
+        kernel(n, a, b, out);
+    }
+
+    /*
+        qmatmul_host()
+        ├─► C[m x n] = A[m x k] * B[n x k]^T, both int8 with their quantization parameters, C float
+        ├─► per element, za/zb the zero points, sa/sb the scales and D = dot_biased(A_i, B_j):
+        │
+        │       C[i][j] = sa_i * sb_j * (D - 128 * sum(B_j) - zb_j * sum(A_i) - za_i * sum(B_j) + k * za_i * zb_j)
+        │
+        │   every term but D is known per row. D is exact in int32 (k < 2^16), the sum is not: each
+        │   correction term reaches 128 * 128 * k and four of them overflow int32, it is taken in int64
+        └─► B is walked in blocks of rows that fit L2, four rows of B per pass over a row of A, the
+            rows of A are split across the thread pool
+     */
+    template <typename E>
+    void qmatmul_host(size_t m, size_t n, size_t k, const Quantized<E>& a, const Quantized<E>& b, float* c)
+    {
+        constexpr size_t L2_BYTES = 256 * 1024;
+        constexpr size_t R = 4;
+
+        const int8_t* qa = a.values.getData();
+        const int8_t* qb = b.values.getData();
+
+        size_t block = std::max(R, (L2_BYTES / std::max(size_t(1), k)) / R * R);
+        size_t grain = std::max(size_t(1), NumcyThreads::ThreadPool::global().getSerialThreshold() / std::max(size_t(1), n * k));
+
+        NumcyThreads::parallel_for(0, m, grain, [=, &a, &b](size_t first, size_t last)
+        {
+            const int8_t* rows[R];
+            int32_t dots[R];
+
+            for (size_t j0 = 0; j0 < n; j0 += block)
+            {
+                size_t j1 = std::min(n, j0 + block);
+
+                for (size_t i = first; i < last; i++)
+                {
+                    float sa = a.scale(i);
+                    int64_t za = a.zeroPoint(i);
+                    int64_t row_a = a.sums[i];
+
+                    for (size_t j = j0; j < j1; j += R)
+                    {
+                        size_t count = std::min(R, j1 - j);
+
+                        for (size_t r = 0; r < count; r++)
+                        {
+                            rows[r] = qb + (j + r) * k;
+                        }
+
+                        if (count == R)
+                        {
+                            dot_biased<R>(k, qa + i * k, rows, dots);
+                        }
+                        else
+                        {
+                            for (size_t r = 0; r < count; r++)
+                            {
+                                dot_biased<1>(k, qa + i * k, rows + r, dots + r);
+                            }
+                        }
+
+                        for (size_t r = 0; r < count; r++)
+                        {
+                            int64_t zb = b.zeroPoint(j + r);
+                            int64_t row_b = b.sums[j + r];
+                            int64_t exact = dots[r] - 128 * row_b - zb * row_a - za * row_b + int64_t(k) * za * zb;
+
+                            c[i * n + j + r] = sa * b.scale(j + r) * float(exact);
+                        }
+                    }
+                }
+            }
+        });
+    }
+}
+
+#endif
@@ -0,0 +1,509 @@
+/*
+ * Numcy/lib/Serialize.hh
+ *
+ * Binary file format of a Collective, behind Numcy::save() and Numcy::load(). A fixed header
+ * (element type, shape, alignment, checksums) and the elements as they are in memory, starting
+ * at an aligned offset, so that load() maps the file instead of reading it. A multi-GB table is
+ * available in O(1), its pages are read in on first touch and are shared with the page cache.
+ *
+ * Q@hackers.pk
+ */
+
+#ifndef NUMCY_SERIALIZE_HH
+#define NUMCY_SERIALIZE_HH
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#if defined(__linux__)
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+
+    #define NUMCY_MMAP 1
+#endif
+
+namespace numcy {
+
+    /*
+        Element type of a saved collective, stored in the file header
+     */
+    enum class DType : uint32_t {
+        Float64  = 1,
+        Float32  = 2,
+        BFloat16 = 3,
+        Float16  = 4,
+        Int8     = 5,
+        UInt8    = 6,
+        Int16    = 7,
+        UInt16   = 8,
+        Int32    = 9,
+        UInt32   = 10,
+        Int64    = 11,
+        UInt64   = 12,
+        Bool     = 13
+    };
+
+    /*
+        How Numcy::load() gives the file's elements to the collective
+     */
+    enum class Mapping : int {
+        ReadOnly    = 0, // Shared read-only mapping, a write through getData() is a segmentation fault
+        CopyOnWrite = 1, // Private mapping, written pages are copied for this process, the file never changes
+        Copy        = 2  // Read into memory of its own, the file can be deleted or rewritten afterwards
+    };
+}
+
+namespace NumcySerialize
+{
+    /*
+        File layout, version 1, every field little-endian
+        -------------------------------------------------
+
+            offset 0            Header
+            sizeof(Header)      shape, rank x uint64, outermost axis first (Dimensions::toVector())
+                                zeros up to payload_offset
+            payload_offset      payload_bytes of elements, row-major, exactly as in memory
+
+        payload_offset is a multiple of alignment (a multiple of the page size), which is what lets
+        the payload be mmap()ed on its own.
+     */
+    constexpr char MAGIC[8] = {'N', 'U', 'M', 'C', 'Y', 'C', 'O', 'L'};
+    constexpr uint32_t FORMAT_VERSION = 1;
+    constexpr uint32_t BYTE_ORDER_MARK = 0x01020304U; // Reads back as 0x04030201 on a machine of the other byte order
+    constexpr size_t DEFAULT_ALIGNMENT = 4096;
+
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t byte_order;
+        uint32_t dtype;
+        uint32_t element_size;
+        uint32_t rank;
+        uint32_t reserved;
+        uint64_t alignment;
+        uint64_t payload_offset;
+        uint64_t payload_bytes;
+        uint64_t payload_checksum;  // checksum() of the payload
+        uint64_t header_checksum;   // checksum() of this header (with this field 0) followed by the shape
+    };
+
+    /*
+        TypeOf<T>::value, the numcy::DType of an element type. Integers by size and signedness,
+        so size_t maps to UInt64 whatever its name on the platform.
+     */
+    template <typename T, typename = void>
+    struct TypeOf;
+
+    template <typename T>
+    struct TypeOf<T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value>::type>
+    {
+        static constexpr numcy::DType value = numcy::DType(uint32_t(numcy::DType::Int8) + (sizeof(T) == 8 ? 6U : sizeof(T) == 4 ? 4U : sizeof(T) == 2 ? 2U : 0U) + (std::is_signed<T>::value ? 0U : 1U));
+    };
+
+    template <>
+    struct TypeOf<bool>
+    {
+        static constexpr numcy::DType value = numcy::DType::Bool;
+    };
+
+    template <>
+    struct TypeOf<double>
+    {
+        static constexpr numcy::DType value = numcy::DType::Float64;
+    };
+
+    template <>
+    struct TypeOf<float>
+    {
+        static constexpr numcy::DType value = numcy::DType::Float32;
+    };
+
+    template <>
+    struct TypeOf<numcy::bfloat16>
+    {
+        static constexpr numcy::DType value = numcy::DType::BFloat16;
+    };
+
+    template <>
+    struct TypeOf<numcy::float16>
+    {
+        static constexpr numcy::DType value = numcy::DType::Float16;
+    };
+
+    inline uint64_t mix(uint64_t h, uint64_t word)
+    {
+        h = h ^ (word * 0x9E3779B97F4A7C15ULL);
+        h = (h << 31) | (h >> 33);
+
+        return h * 0xC2B2AE3D27D4EB4FULL;
+    }
+
+    /*
+        checksum() of one block, four independent lanes of 8 byte words so the multiplies overlap
+     */
+    inline uint64_t checksumBlock(const unsigned char* p, size_t bytes)
+    {
+        uint64_t lane[4] = {0x243F6A8885A308D3ULL, 0x13198A2E03707344ULL, 0xA4093822299F31D0ULL, 0x082EFA98EC4E6C89ULL};
+        uint64_t word[4];
+        size_t i = 0;
+
+        for (; i + 32 <= bytes; i += 32)
+        {
+            std::memcpy(word, p + i, sizeof(word));
+
+            lane[0] = mix(lane[0], word[0]);
+            lane[1] = mix(lane[1], word[1]);
+            lane[2] = mix(lane[2], word[2]);
+            lane[3] = mix(lane[3], word[3]);
+        }
+
+        for (; i < bytes; i += 8)
+        {
+            uint64_t tail = 0;
+            std::memcpy(&tail, p + i, std::min(size_t(8), bytes - i));
+
+            lane[0] = mix(lane[0], tail);
+        }
+
+        return mix(mix(mix(mix(lane[0], lane[1]), lane[2]), lane[3]), bytes);
+    }
+
+    /*
+        checksum(data, bytes)
+        ├─► 64 bit, not cryptographic, catches truncated, torn and bit-flipped files
+        └─► the blocks of 1 MB are hashed on the thread pool and folded in order, the result does
+            not depend on the number of threads
+     */
+    inline uint64_t checksum(const void* data, size_t bytes)
+    {
+        constexpr size_t BLOCK = size_t(1) << 20;
+
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        size_t blocks = (bytes + BLOCK - 1) / BLOCK;
+        std::vector<uint64_t> partial(blocks);
+        uint64_t* hashes = partial.data();
+
+        NumcyThreads::parallel_for(0, blocks, 1, [=](size_t first, size_t last)
+        {
+            for (size_t b = first; b < last; b++)
+            {
+                hashes[b] = checksumBlock(p + b * BLOCK, std::min(BLOCK, bytes - b * BLOCK));
+            }
+        });
+
+        uint64_t h = 0x452821E638D01377ULL;
+
+        for (size_t b = 0; b < blocks; b++)
+        {
+            h = mix(h, partial[b]);
+        }
+
+        return mix(h, bytes);
+    }
+
+    inline uint64_t headerChecksum(Header header, const std::vector<uint64_t>& shape)
+    {
+        header.header_checksum = 0;
+
+        std::vector<unsigned char> bytes(sizeof(Header) + shape.size() * sizeof(uint64_t));
+        std::memcpy(bytes.data(), &header, sizeof(Header));
+
+        if (!shape.empty())
+        {
+            std::memcpy(bytes.data() + sizeof(Header), shape.data(), shape.size() * sizeof(uint64_t));
+        }
+
+        return checksumBlock(bytes.data(), bytes.size());
+    }
+
+    inline bool littleEndian(void)
+    {
+        uint32_t probe = 1;
+        unsigned char first;
+        std::memcpy(&first, &probe, 1);
+
+        return first == 1;
+    }
+
+    /*
+        save(path, c, alignment)
+        ├─► host collectives of a trivially copyable element type only
+        ├─► alignment, a power of two that is a multiple of 4096 (the page size of every target),
+        │   larger to place the payload at a huge page boundary
+        └─► header, shape, padding and payload in one sequential write
+     */
+    template <typename T, typename E>
+    void save(const std::string& path, const Collective<T, E>& c, size_t alignment)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "NumcySerialize::save(): the element type must be trivially copyable");
+
+        if (!littleEndian())
+        {
+            throw std::runtime_error("NumcySerialize::save() Error: only little-endian hosts are supported");
+        }
+
+        if (c.isEmpty() || c.getMemoryLocation() != MemoryLocation::Host)
+        {
+            throw std::runtime_error("NumcySerialize::save() Error: only host collectives are supported");
+        }
+
+        if (alignment < DEFAULT_ALIGNMENT || (alignment & (alignment - 1)) != 0)
+        {
+            throw std::runtime_error("NumcySerialize::save() Error: alignment must be a power of two of at least 4096");
+        }
+
+        std::vector<E> dims = c.getShape().toVector();
+        std::vector<uint64_t> shape(dims.begin(), dims.end());
+
+        Header header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+
+        header.version = FORMAT_VERSION;
+        header.byte_order = BYTE_ORDER_MARK;
+        header.dtype = uint32_t(TypeOf<T>::value);
+        header.element_size = uint32_t(sizeof(T));
+        header.rank = uint32_t(shape.size());
+        header.alignment = alignment;
+        header.payload_offset = (sizeof(Header) + shape.size() * sizeof(uint64_t) + alignment - 1) / alignment * alignment;
+        header.payload_bytes = c.getShape().numel() * sizeof(T);
+        header.payload_checksum = checksum(c.getData(), header.payload_bytes);
+        header.header_checksum = headerChecksum(header, shape);
+
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+
+        if (!file)
+        {
+            throw std::runtime_error("NumcySerialize::save() Error: cannot open " + path + " for writing");
+        }
+
+        std::vector<char> padding(header.payload_offset - sizeof(Header) - shape.size() * sizeof(uint64_t), 0);
+
+        file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+        file.write(reinterpret_cast<const char*>(shape.data()), std::streamsize(shape.size() * sizeof(uint64_t)));
+        file.write(padding.data(), std::streamsize(padding.size()));
+        file.write(reinterpret_cast<const char*>(c.getData()), std::streamsize(header.payload_bytes));
+        file.flush();
+
+        if (!file)
+        {
+            throw std::runtime_error("NumcySerialize::save() Error: write to " + path + " failed");
+        }
+    }
+
+    /*
+        validate<T>()
+        └─► throws unless header and shape describe a sound file of T of file_bytes bytes
+     */
+    template <typename T>
+    void validate(const Header& header, const std::vector<uint64_t>& shape, uint64_t file_bytes)
+    {
+        if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0)
+        {
+            throw std::runtime_error("not a Numcy collective file");
+        }
+
+        if (header.byte_order != BYTE_ORDER_MARK)
+        {
+            throw std::runtime_error("file was written on a machine of the other byte order");
+        }
+
+        if (header.version != FORMAT_VERSION)
+        {
+            throw std::runtime_error("unsupported format version " + std::to_string(header.version));
+        }
+
+        if (header.header_checksum != headerChecksum(header, shape))
+        {
+            throw std::runtime_error("header checksum mismatch, the file is corrupt");
+        }
+
+        if (header.dtype != uint32_t(TypeOf<T>::value) || header.element_size != sizeof(T))
+        {
+            throw std::runtime_error("element type of the file (dtype " + std::to_string(header.dtype) + ") is not the one requested");
+        }
+
+        uint64_t numel = 1;
+
+        for (size_t i = 0; i < shape.size(); i++)
+        {
+            numel = numel * shape[i];
+        }
+
+        if (header.payload_bytes != numel * sizeof(T) || header.payload_offset > file_bytes || header.payload_bytes > file_bytes - header.payload_offset)
+        {
+            throw std::runtime_error("file is truncated or its shape does not match its size");
+        }
+    }
+
+    /*
+        What a failed load() holds so far, the file descriptor and the payload pages
+     */
+    inline void _release(int fd, void* pages, size_t bytes)
+    {
+#if defined(NUMCY_MMAP)
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+#else
+        (void)fd;
+#endif
+        if (pages != nullptr)
+        {
+            NumcyNuma::release(pages, bytes);
+        }
+    }
+
+    /*
+        load<T, E>(path, mapping, verify)
+        ├─► header and shape read with pread(), validated (magic, byte order, version, header
+        │   checksum, element type, size)
+        ├─► ReadOnly / CopyOnWrite → the payload alone is mmap()ed, MAP_SHARED + PROT_READ or
+        │   MAP_PRIVATE + PROT_READ | PROT_WRITE, nothing is read yet. The mapping outlives the file
+        │   descriptor and is unmapped by the last handle of the collective.
+        ├─► Copy, or no mmap() on the platform → read into NumcyNuma::allocate()d memory
+        └─► verify → the payload checksum is recomputed, this touches every page and so gives
+            up the O(1) load, for a startup that wants to fail fast on a damaged file
+     */
+    template <typename T, typename E>
+    Collective<T, E> load(const std::string& path, numcy::Mapping mapping, bool verify)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "NumcySerialize::load(): the element type must be trivially copyable");
+
+        void* pages = nullptr;
+        size_t bytes = 0;
+        int fd = -1;
+
+        try
+        {
+            Header header;
+            std::vector<uint64_t> shape;
+
+#if defined(NUMCY_MMAP)
+            fd = open(path.c_str(), O_RDONLY);
+
+            if (fd < 0)
+            {
+                throw std::runtime_error("cannot open " + path);
+            }
+
+            struct stat status;
+
+            if (fstat(fd, &status) != 0 || pread(fd, &header, sizeof(Header), 0) != ssize_t(sizeof(Header)) || header.rank > 64)
+            {
+                throw std::runtime_error(path + " is too short for a header");
+            }
+
+            shape.resize(header.rank);
+
+            if (pread(fd, shape.data(), shape.size() * sizeof(uint64_t), sizeof(Header)) != ssize_t(shape.size() * sizeof(uint64_t)))
+            {
+                throw std::runtime_error(path + " is too short for its shape");
+            }
+
+            validate<T>(header, shape, uint64_t(status.st_size));
+
+            bytes = size_t(header.payload_bytes);
+
+            long page = sysconf(_SC_PAGESIZE);
+
+            if (mapping != numcy::Mapping::Copy && bytes > 0 && page > 0 && header.payload_offset % uint64_t(page) == 0)
+            {
+                int protection = mapping == numcy::Mapping::ReadOnly ? PROT_READ : PROT_READ | PROT_WRITE;
+                int flags = mapping == numcy::Mapping::ReadOnly ? MAP_SHARED : MAP_PRIVATE;
+
+                void* address = mmap(nullptr, bytes, protection, flags, fd, off_t(header.payload_offset));
+
+                if (address != MAP_FAILED)
+                {
+                    pages = address;
+                }
+            }
+
+            if (pages == nullptr)
+            {
+                pages = NumcyNuma::allocate(bytes, numcy::NumaPolicy::FirstTouch);
+
+                for (size_t done = 0; done < bytes; )
+                {
+                    ssize_t got = pread(fd, static_cast<char*>(pages) + done, bytes - done, off_t(header.payload_offset + done));
+
+                    if (got <= 0)
+                    {
+                        throw std::runtime_error("read of " + path + " failed");
+                    }
+
+                    done = done + size_t(got);
+                }
+            }
+
+            close(fd);
+            fd = -1;
+#else
+            std::ifstream file(path, std::ios::binary | std::ios::ate);
+
+            if (!file)
+            {
+                throw std::runtime_error("cannot open " + path);
+            }
+
+            uint64_t file_bytes = uint64_t(file.tellg());
+            file.seekg(0);
+
+            if (!file.read(reinterpret_cast<char*>(&header), sizeof(Header)) || header.rank > 64)
+            {
+                throw std::runtime_error(path + " is too short for a header");
+            }
+
+            shape.resize(header.rank);
+            file.read(reinterpret_cast<char*>(shape.data()), std::streamsize(shape.size() * sizeof(uint64_t)));
+
+            validate<T>(header, shape, file_bytes);
+
+            (void)mapping;
+
+            bytes = size_t(header.payload_bytes);
+            pages = NumcyNuma::allocate(bytes, numcy::NumaPolicy::FirstTouch);
+
+            file.seekg(std::streamoff(header.payload_offset));
+
+            if (!file.read(static_cast<char*>(pages), std::streamsize(bytes)))
+            {
+                throw std::runtime_error("read of " + path + " failed");
+            }
+#endif
+            if (verify && checksum(pages, bytes) != header.payload_checksum)
+            {
+                throw std::runtime_error("payload checksum mismatch, the file is corrupt");
+            }
+
+            Dimensions<E> dims;
+            dims.fromVector(std::vector<E>(shape.begin(), shape.end()));
+
+            Collective<T, E> c = Collective<T, E>::mapped(static_cast<T*>(pages), dims, bytes);
+            pages = nullptr; // Owned by c from here on
+
+            return c;
+        }
+        catch (const std::bad_alloc& e)
+        {
+            _release(fd, pages, bytes);
+            throw std::runtime_error("NumcySerialize::load() -> " + std::string(e.what()));
+        }
+        catch (std::runtime_error& e)
+        {
+            _release(fd, pages, bytes);
+            throw std::runtime_error("NumcySerialize::load() -> " + std::string(e.what()));
+        }
+    }
+}
+
+#endif
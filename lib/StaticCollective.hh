@@ -0,0 +1,447 @@
+/*
+ * Numcy/lib/StaticCollective.hh
+ *
+ * Small tensors of a shape known at compile time, 3x3 and 4x4 transforms, 16 wide feature
+ * vectors. The shape is in the type, the elements are stored inline (no heap, no control block,
+ * no Dimensions list), strides are constexpr and the kernels below are unrolled by the compiler
+ * from index sequences, so a 4x4 matmul is 64 multiply-adds and nothing else.
+ *
+ *     StaticCollective<float, 4, 4> m = StaticCollective<float, 4, 4>::identity();
+ *     StaticCollective<float, 4> v = {1.0f, 2.0f, 3.0f, 1.0f};
+ *
+ *     StaticCollective<float, 4> w = NumcyStatic::matvec(m, v);
+ *     Collective<float> c = w.toCollective();           // one allocation and one copy
+ *     StaticCollective<float, 4> back(c);               // throws unless c is [1, 4]
+ *
+ * Q@hackers.pk
+ */
+
+#ifndef NUMCY_STATIC_COLLECTIVE_HH
+#define NUMCY_STATIC_COLLECTIVE_HH
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <initializer_list>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace NumcyStatic
+{
+    /*
+        Past this many elements (or multiply-adds, for matmul()) a kernel is a plain loop instead
+        of unrolled, the compiler vectorizes it just as well and compiles it much faster
+     */
+    constexpr size_t UNROLL_LIMIT = 256;
+
+    /*
+        f(std::integral_constant<size_t, I>()) for I in [0, N), every call a separate statement
+     */
+    template <typename F, size_t... I>
+    inline void unroll(F&& f, std::index_sequence<I...>)
+    {
+        (f(std::integral_constant<size_t, I>()), ...);
+    }
+
+    template <size_t N, typename F>
+    inline void unroll(F&& f)
+    {
+        unroll(std::forward<F>(f), std::make_index_sequence<N>());
+    }
+
+    /*
+        The sum of a[A + p * AS] * b[B + p * BS] over p, one expression of sizeof...(P) multiply-adds
+     */
+    template <size_t A, size_t AS, size_t B, size_t BS, typename T, size_t... P>
+    inline T dot(const T* a, const T* b, std::index_sequence<P...>)
+    {
+        return (... + (a[A + P * AS] * b[B + P * BS]));
+    }
+
+    /*
+        size_t, one per axis in operator()
+     */
+    template <size_t>
+    using Index = size_t;
+
+    /*
+        Row major strides of Dims..., the last axis is contiguous
+     */
+    template <size_t... Dims>
+    constexpr std::array<size_t, sizeof...(Dims)> strides(void)
+    {
+        std::array<size_t, sizeof...(Dims)> dims = {Dims...};
+        std::array<size_t, sizeof...(Dims)> result = {};
+        size_t stride = 1;
+
+        for (size_t i = sizeof...(Dims); i > 0; i--)
+        {
+            result[i - 1] = stride;
+            stride = stride * dims[i - 1];
+        }
+
+        return result;
+    }
+}
+
+/*
+    StaticCollective<T, Dims...>
+    ----------------------------
+    ├─► rank, numel, shape and strides are static constexpr members
+    ├─► StaticCollective()          — every element T()
+    ├─► StaticCollective(value)     — every element value
+    ├─► StaticCollective({...})     — elements in row major order, the rest T()
+    ├─► StaticCollective(c)         — a copy of the Collective c, which must have exactly this shape
+    │                                 (a StaticCollective<T, N> takes [1, N] as well)
+    ├─► toCollective<E>()           — a host Collective<T, E> of this shape ([1, N] for a vector) with a
+    │                                 copy of the elements
+    ├─► operator[](i)               — element i in row major order, unchecked
+    └─► operator()(i, j, ...)       — element at one size_t index per axis, unchecked
+ */
+template <typename T, size_t... Dims>
+class StaticCollective
+{
+    static_assert(sizeof...(Dims) > 0, "StaticCollective<T, Dims...>: at least one axis");
+    static_assert(((Dims > 0) && ...), "StaticCollective<T, Dims...>: every axis needs at least one element");
+
+    public:
+        static constexpr size_t rank = sizeof...(Dims);
+        static constexpr size_t numel = (size_t(1) * ... * Dims);
+        static constexpr std::array<size_t, sizeof...(Dims)> shape = {Dims...};
+        static constexpr std::array<size_t, sizeof...(Dims)> strides = NumcyStatic::strides<Dims...>();
+
+    private:
+        T data[numel];
+
+        template <size_t... A>
+        static constexpr size_t _offset(std::index_sequence<A...>, NumcyStatic::Index<Dims>... index)
+        {
+            return ((index * strides[A]) + ...);
+        }
+
+        /*
+            The shape as a Collective has it, a vector is [1, N] (Dimensions has at least two axes)
+         */
+        template <typename E>
+        static std::vector<E> _dims(void)
+        {
+            std::vector<E> dims(shape.begin(), shape.end());
+
+            if (rank == 1)
+            {
+                dims.insert(dims.begin(), 1);
+            }
+
+            return dims;
+        }
+
+    public:
+        StaticCollective(void) : data()
+        {
+        }
+
+        explicit StaticCollective(const T& value) : data()
+        {
+            std::fill(this->data, this->data + numel, value);
+        }
+
+        StaticCollective(std::initializer_list<T> values) : data()
+        {
+            std::copy(values.begin(), values.begin() + std::min(values.size(), numel), this->data);
+        }
+
+        template <typename E>
+        explicit StaticCollective(const Collective<T, E>& c) : data()
+        {
+            if (c.isEmpty())
+            {
+                throw std::runtime_error("StaticCollective<T, Dims...>::StaticCollective(const Collective<T, E>&) Error: the collective is empty");
+            }
+
+            std::vector<E> dims = c.getShape().toVector();
+            std::vector<E> expected = _dims<E>();
+
+            if (dims != expected && !(rank == 1 && std::vector<E>(expected.begin() + 1, expected.end()) == dims))
+            {
+                throw std::runtime_error("StaticCollective<T, Dims...>::StaticCollective(const Collective<T, E>&) Error: the collective does not have the static shape");
+            }
+
+            const T* elements = c.getData();
+
+            std::copy(elements, elements + numel, this->data);
+        }
+
+        template <typename E = size_t>
+        Collective<T, E> toCollective(void) const
+        {
+            Dimensions<E> d;
+
+            d.fromVector(_dims<E>());
+
+            Collective<T, E> c(d, MemoryLocation::Host);
+
+            std::copy(this->data, this->data + numel, c.getData());
+
+            return c;
+        }
+
+        /*
+            The identity of a square matrix
+         */
+        static StaticCollective identity(void)
+        {
+            static_assert(rank == 2 && shape[0] == shape[1], "StaticCollective<T, Dims...>::identity(): a square matrix");
+
+            StaticCollective result;
+
+            NumcyStatic::unroll<shape[0]>([&](auto i) { result.data[decltype(i)::value * (shape[0] + 1)] = T(1); });
+
+            return result;
+        }
+
+        T* getData(void)
+        {
+            return this->data;
+        }
+
+        const T* getData(void) const
+        {
+            return this->data;
+        }
+
+        T& operator[](size_t i)
+        {
+            return this->data[i];
+        }
+
+        const T& operator[](size_t i) const
+        {
+            return this->data[i];
+        }
+
+        T& operator()(NumcyStatic::Index<Dims>... index)
+        {
+            return this->data[_offset(std::make_index_sequence<rank>(), index...)];
+        }
+
+        const T& operator()(NumcyStatic::Index<Dims>... index) const
+        {
+            return this->data[_offset(std::make_index_sequence<rank>(), index...)];
+        }
+
+        /*
+            Element-wise, unrolled up to NumcyStatic::UNROLL_LIMIT elements
+         */
+        template <typename F>
+        StaticCollective& apply(const StaticCollective& other, F op)
+        {
+            if constexpr (numel <= NumcyStatic::UNROLL_LIMIT)
+            {
+                NumcyStatic::unroll<numel>([&](auto i) { this->data[i] = op(this->data[i], other.data[i]); });
+            }
+            else
+            {
+                for (size_t i = 0; i < numel; i++)
+                {
+                    this->data[i] = op(this->data[i], other.data[i]);
+                }
+            }
+
+            return *this;
+        }
+
+        StaticCollective& operator+=(const StaticCollective& other)
+        {
+            return this->apply(other, [](const T& a, const T& b) { return a + b; });
+        }
+
+        StaticCollective& operator-=(const StaticCollective& other)
+        {
+            return this->apply(other, [](const T& a, const T& b) { return a - b; });
+        }
+
+        /*
+            Hadamard product, matmul() is the matrix product
+         */
+        StaticCollective& operator*=(const StaticCollective& other)
+        {
+            return this->apply(other, [](const T& a, const T& b) { return a * b; });
+        }
+
+        StaticCollective& operator*=(const T& scale)
+        {
+            return this->apply(*this, [scale](const T& a, const T&) { return a * scale; });
+        }
+
+        friend StaticCollective operator+(StaticCollective a, const StaticCollective& b)
+        {
+            return a += b;
+        }
+
+        friend StaticCollective operator-(StaticCollective a, const StaticCollective& b)
+        {
+            return a -= b;
+        }
+
+        friend StaticCollective operator*(StaticCollective a, const StaticCollective& b)
+        {
+            return a *= b;
+        }
+
+        friend StaticCollective operator*(StaticCollective a, const T& scale)
+        {
+            return a *= scale;
+        }
+
+        friend StaticCollective operator*(const T& scale, StaticCollective a)
+        {
+            return a *= scale;
+        }
+
+        bool operator==(const StaticCollective& other) const
+        {
+            return std::equal(this->data, this->data + numel, other.data);
+        }
+
+        bool operator!=(const StaticCollective& other) const
+        {
+            return !(*this == other);
+        }
+};
+
+namespace NumcyStatic
+{
+    /*
+        [M, K] x [K, N] -> [M, N]
+     */
+    template <typename T, size_t M, size_t K, size_t N>
+    inline StaticCollective<T, M, N> matmul(const StaticCollective<T, M, K>& a, const StaticCollective<T, K, N>& b)
+    {
+        StaticCollective<T, M, N> c;
+
+        if constexpr (M * N * K <= UNROLL_LIMIT)
+        {
+            unroll<M * N>([&](auto i)
+            {
+                constexpr size_t row = decltype(i)::value / N, column = decltype(i)::value % N;
+
+                c[i] = dot<row * K, 1, column, N>(a.getData(), b.getData(), std::make_index_sequence<K>());
+            });
+        }
+        else
+        {
+            for (size_t i = 0; i < M; i++)
+            {
+                for (size_t k = 0; k < K; k++)
+                {
+                    T scale = a[i * K + k];
+
+                    for (size_t j = 0; j < N; j++)
+                    {
+                        c[i * N + j] = c[i * N + j] + scale * b[k * N + j];
+                    }
+                }
+            }
+        }
+
+        return c;
+    }
+
+    /*
+        [M, K] x [K] -> [M]
+     */
+    template <typename T, size_t M, size_t K>
+    inline StaticCollective<T, M> matvec(const StaticCollective<T, M, K>& a, const StaticCollective<T, K>& x)
+    {
+        StaticCollective<T, M> y;
+
+        if constexpr (M * K <= UNROLL_LIMIT)
+        {
+            unroll<M>([&](auto i) { y[i] = dot<decltype(i)::value * K, 1, 0, 1>(a.getData(), x.getData(), std::make_index_sequence<K>()); });
+        }
+        else
+        {
+            for (size_t i = 0; i < M; i++)
+            {
+                T total = T();
+
+                for (size_t k = 0; k < K; k++)
+                {
+                    total = total + a[i * K + k] * x[k];
+                }
+
+                y[i] = total;
+            }
+        }
+
+        return y;
+    }
+
+    template <typename T, size_t M, size_t N>
+    inline StaticCollective<T, N, M> transpose(const StaticCollective<T, M, N>& a)
+    {
+        StaticCollective<T, N, M> t;
+
+        if constexpr (M * N <= UNROLL_LIMIT)
+        {
+            unroll<M * N>([&](auto i) { t[(i % N) * M + i / N] = a[i]; });
+        }
+        else
+        {
+            for (size_t i = 0; i < M; i++)
+            {
+                for (size_t j = 0; j < N; j++)
+                {
+                    t[j * M + i] = a[i * N + j];
+                }
+            }
+        }
+
+        return t;
+    }
+
+    template <typename T, size_t N>
+    inline T dot(const StaticCollective<T, N>& a, const StaticCollective<T, N>& b)
+    {
+        if constexpr (N <= UNROLL_LIMIT)
+        {
+            return dot<0, 1, 0, 1>(a.getData(), b.getData(), std::make_index_sequence<N>());
+        }
+        else
+        {
+            T total = T();
+
+            for (size_t i = 0; i < N; i++)
+            {
+                total = total + a[i] * b[i];
+            }
+
+            return total;
+        }
+    }
+
+    template <typename T, size_t... Dims>
+    inline T sum(const StaticCollective<T, Dims...>& a)
+    {
+        T total = T();
+
+        if constexpr (StaticCollective<T, Dims...>::numel <= UNROLL_LIMIT)
+        {
+            unroll<StaticCollective<T, Dims...>::numel>([&](auto i) { total = total + a[i]; });
+        }
+        else
+        {
+            for (size_t i = 0; i < StaticCollective<T, Dims...>::numel; i++)
+            {
+                total = total + a[i];
+            }
+        }
+
+        return total;
+    }
+}
+
+#endif
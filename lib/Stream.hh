@@ -0,0 +1,455 @@
+/*
+ * Numcy/lib/Stream.hh
+ *
+ * Batches of rows of an on-disk array too large to load, a Numcy collective file (Numcy::save())
+ * or a C order .npy. A background thread reads ahead into a ring of buffers allocated once, the
+ * training loop takes a batch that is (usually) already in memory and hands it back on its next
+ * call.
+ *
+ * Q@hackers.pk
+ */
+
+#ifndef NUMCY_STREAM_HH
+#define NUMCY_STREAM_HH
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace NumcyStream
+{
+    /*
+        StreamReader<T, E>
+        ------------------
+        The file is an array of shape [rows, d1, ..., dn], batches are [batch_rows, d1, ..., dn],
+        consecutive rows from the start of the file. A 1-D .npy of n elements is streamed as
+        [1, batch_rows] batches of its elements (a token stream).
+
+            Numcy::StreamReader<int32_t> tokens("tokens.npy", 4096);   // 4096 rows per batch, 3 buffers
+            Collective<int32_t> batch;
+
+            while (tokens.next(batch))
+            {
+                train(batch);
+            }
+
+        ├─► depth buffers of one batch each are allocated by the constructor, nothing after that
+        ├─► the reader thread fills free buffers in file order with pread(), the batch next()
+        │   returned is handed back to it by the following next() call. batch is valid until then,
+        │   copy it to keep it longer.
+        ├─► the rows left over after the last whole batch are not returned, every batch has the
+        │   same shape. With loop the stream starts over from row 0 instead of ending (epochs)
+        ├─► consumed file ranges are dropped from the page cache (POSIX_FADV_DONTNEED), a pass
+        │   over a file larger than RAM does not push everything else out of it
+        └─► stalls() — how many next() calls found no batch ready and waited for the disk, the
+            number to watch when choosing depth
+     */
+    template <typename T = double, typename E = size_t>
+    class StreamReader
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "NumcyStream::StreamReader: the element type must be trivially copyable");
+
+        std::string path;
+        size_t payload_offset;   // Of row 0 in the file
+        size_t batch_rows;
+        size_t batch_bytes;
+        size_t batches;          // Whole batches in the file
+        bool swap;               // Big-endian .npy
+        bool loop;
+
+        std::vector<Collective<T, E>> ring;
+        std::deque<size_t> free_slots;  // Buffers the reader thread may fill
+        std::deque<size_t> filled;      // Buffers holding a batch next() has not returned yet, file order
+        size_t handed;                  // The buffer the last next() returned, ring.size() when none
+
+        std::mutex lock;
+        std::condition_variable space;  // Reader thread waits for a free buffer
+        std::condition_variable data;   // next() waits for a filled one
+        bool stop;
+        bool finished;
+        std::exception_ptr failure;
+        size_t stall_count;
+
+#if defined(NUMCY_MMAP)
+        int fd;
+#else
+        std::ifstream file;
+#endif
+        std::thread reader;
+
+        /*
+            The header of the file, a Numcy collective file or a .npy, into payload_offset, swap
+            and the shape
+         */
+        std::vector<size_t> _open(void)
+        {
+            std::vector<size_t> shape;
+            unsigned char prefix[sizeof(NumcySerialize::Header)];
+            std::memset(prefix, 0, sizeof(prefix));
+
+            size_t got = this->_read(prefix, sizeof(prefix), 0, false);
+            size_t file_bytes = NumcyNpy::fileSize(this->path);
+
+            if (got >= sizeof(NumcySerialize::MAGIC) && std::memcmp(prefix, NumcySerialize::MAGIC, sizeof(NumcySerialize::MAGIC)) == 0 && got == sizeof(prefix))
+            {
+                NumcySerialize::Header header;
+                std::memcpy(&header, prefix, sizeof(header));
+
+                if (header.rank > 64)
+                {
+                    throw std::runtime_error(this->path + " is corrupt");
+                }
+
+                std::vector<uint64_t> dims(header.rank);
+                this->_read(dims.data(), dims.size() * sizeof(uint64_t), sizeof(NumcySerialize::Header), true);
+
+                NumcySerialize::validate<T>(header, dims, uint64_t(file_bytes));
+
+                this->payload_offset = size_t(header.payload_offset);
+                shape.assign(dims.begin(), dims.end());
+            }
+            else if (got >= 10 && prefix[0] == 0x93)
+            {
+                size_t size = prefix[6] == 1 ? 10 + (size_t(prefix[8]) | (size_t(prefix[9]) << 8)) : 12 + (size_t(prefix[8]) | (size_t(prefix[9]) << 8) | (size_t(prefix[10]) << 16) | (size_t(prefix[11]) << 24));
+
+                if (size > file_bytes)
+                {
+                    throw std::runtime_error(this->path + " is truncated");
+                }
+
+                std::vector<unsigned char> bytes(size);
+                this->_read(bytes.data(), size, 0, true);
+
+                NumcyNpy::Header header = NumcyNpy::parseHeader(bytes.data(), size);
+
+                this->swap = NumcyNpy::bigEndian<T>(header);
+
+                if (header.fortran_order && header.shape.size() > 1)
+                {
+                    throw std::runtime_error(this->path + " is in Fortran order, its rows are not contiguous, rewrite it in C order to stream it");
+                }
+
+                this->payload_offset = header.data_offset;
+                shape = header.shape;
+            }
+            else
+            {
+                throw std::runtime_error(this->path + " is neither a Numcy collective file nor a .npy");
+            }
+
+            size_t numel = 1;
+
+            for (size_t i = 0; i < shape.size(); i++)
+            {
+                numel = numel * shape[i];
+            }
+
+            if (shape.empty() || numel == 0 || this->payload_offset > file_bytes)
+            {
+                throw std::runtime_error(this->path + " holds no rows");
+            }
+
+            return shape;
+        }
+
+        /*
+            n bytes from offset, all of them unless partial
+         */
+        size_t _read(void* to, size_t n, size_t offset, bool whole)
+        {
+            size_t done = 0;
+#if defined(NUMCY_MMAP)
+            while (done < n)
+            {
+                ssize_t got = pread(this->fd, static_cast<char*>(to) + done, n - done, off_t(offset + done));
+
+                if (got <= 0)
+                {
+                    break;
+                }
+
+                done = done + size_t(got);
+            }
+#else
+            this->file.clear();
+            this->file.seekg(std::streamoff(offset));
+            this->file.read(static_cast<char*>(to), std::streamsize(n));
+
+            done = size_t(this->file.gcount());
+#endif
+            if (whole && done != n)
+            {
+                throw std::runtime_error("read of " + this->path + " failed at byte " + std::to_string(offset + done));
+            }
+
+            return done;
+        }
+
+        void _close(void)
+        {
+#if defined(NUMCY_MMAP)
+            if (this->fd >= 0)
+            {
+                close(this->fd);
+                this->fd = -1;
+            }
+#endif
+        }
+
+        /*
+            The reader thread, fills free buffers with batch after batch until stopped, the end of
+            the file (without loop) or an error
+         */
+        void _run(void)
+        {
+            try
+            {
+                for (size_t batch = 0; ; batch++)
+                {
+                    size_t slot = 0;
+
+                    {
+                        std::unique_lock<std::mutex> guard(this->lock);
+
+                        this->space.wait(guard, [this]() { return this->stop || !this->free_slots.empty(); });
+
+                        if (this->stop)
+                        {
+                            return;
+                        }
+
+                        if (batch == this->batches)
+                        {
+                            if (!this->loop)
+                            {
+                                this->finished = true;
+                                this->data.notify_all();
+
+                                return;
+                            }
+
+                            batch = 0;
+                        }
+
+                        slot = this->free_slots.front();
+                        this->free_slots.pop_front();
+                    }
+
+                    size_t offset = this->payload_offset + batch * this->batch_bytes;
+                    T* buffer = this->ring[slot].getData();
+
+                    this->_read(buffer, this->batch_bytes, offset, true);
+
+                    if (this->swap)
+                    {
+                        NumcyNpy::swapBytes(buffer, this->batch_bytes / sizeof(T));
+                    }
+#if defined(NUMCY_MMAP) && defined(POSIX_FADV_DONTNEED)
+                    posix_fadvise(this->fd, off_t(offset), off_t(this->batch_bytes), POSIX_FADV_DONTNEED);
+#endif
+                    {
+                        std::lock_guard<std::mutex> guard(this->lock);
+
+                        this->filled.push_back(slot);
+                    }
+
+                    this->data.notify_one();
+                }
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> guard(this->lock);
+
+                this->failure = std::current_exception();
+                this->data.notify_all();
+            }
+        }
+
+        public:
+            StreamReader(const std::string& p, size_t rows_per_batch, size_t depth = 3, bool repeat = false) : path(p), payload_offset(0), batch_rows(rows_per_batch), batch_bytes(0), batches(0), swap(false), loop(repeat), ring(), free_slots(), filled(), handed(0), lock(), space(), data(), stop(false), finished(false), failure(nullptr), stall_count(0),
+#if defined(NUMCY_MMAP)
+                fd(-1),
+#else
+                file(),
+#endif
+                reader()
+            {
+                try
+                {
+                    if (rows_per_batch == 0 || depth < 2)
+                    {
+                        throw std::runtime_error("a batch needs at least one row and the ring at least two buffers");
+                    }
+#if defined(NUMCY_MMAP)
+                    this->fd = open(p.c_str(), O_RDONLY);
+
+                    if (this->fd < 0)
+                    {
+                        throw std::runtime_error("cannot open " + p);
+                    }
+#if defined(POSIX_FADV_SEQUENTIAL)
+                    posix_fadvise(this->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+#else
+                    this->file.open(p, std::ios::binary);
+
+                    if (!this->file)
+                    {
+                        throw std::runtime_error("cannot open " + p);
+                    }
+#endif
+                    std::vector<size_t> shape = this->_open();
+                    std::vector<E> batch_shape(shape.begin(), shape.end());
+
+                    batch_shape[0] = E(rows_per_batch);
+
+                    if (batch_shape.size() == 1)
+                    {
+                        // A 1-D .npy, rows of one element
+                        batch_shape.insert(batch_shape.begin(), E(1));
+                    }
+
+                    size_t row = sizeof(T);
+
+                    for (size_t i = 1; i < shape.size(); i++)
+                    {
+                        row = row * shape[i];
+                    }
+
+                    this->batch_bytes = row * rows_per_batch;
+                    this->batches = shape[0] / rows_per_batch;
+
+                    if (this->batches == 0)
+                    {
+                        throw std::runtime_error(p + " has " + std::to_string(shape[0]) + " rows, fewer than one batch of " + std::to_string(rows_per_batch));
+                    }
+
+                    if (this->payload_offset + this->batches * this->batch_bytes > NumcyNpy::fileSize(p))
+                    {
+                        throw std::runtime_error(p + " is truncated");
+                    }
+
+                    Dimensions<E> dims;
+                    dims.fromVector(batch_shape);
+
+                    for (size_t i = 0; i < depth; i++)
+                    {
+                        this->ring.push_back(Collective<T, E>(dims, MemoryLocation::Host));
+                        this->free_slots.push_back(i);
+                    }
+
+                    this->handed = depth;
+                    this->reader = std::thread([this]() { this->_run(); });
+                }
+                catch (std::runtime_error& e)
+                {
+                    this->_close();
+                    throw std::runtime_error("NumcyStream::StreamReader::StreamReader(const std::string&, size_t, size_t, bool) -> " + std::string(e.what()));
+                }
+                catch (...)
+                {
+                    this->_close();
+                    throw std::runtime_error("NumcyStream::StreamReader::StreamReader(const std::string&, size_t, size_t, bool) Error: Unknown exception");
+                }
+            }
+
+            StreamReader(const StreamReader&) = delete;
+            StreamReader& operator=(const StreamReader&) = delete;
+
+            ~StreamReader()
+            {
+                {
+                    std::lock_guard<std::mutex> guard(this->lock);
+
+                    this->stop = true;
+                }
+
+                this->space.notify_all();
+
+                if (this->reader.joinable())
+                {
+                    this->reader.join();
+                }
+
+                this->_close();
+            }
+
+            /*
+                next(batch)
+                ├─► the buffer of the previous call goes back to the reader thread
+                ├─► batch = the next batch in file order, waits for the reader if it is not there yet
+                └─► false at the end of the file (never with loop), the reader's error is rethrown
+                    once the batches read before it are consumed
+             */
+            bool next(Collective<T, E>& batch)
+            {
+                std::unique_lock<std::mutex> guard(this->lock);
+
+                if (this->handed < this->ring.size())
+                {
+                    this->free_slots.push_back(this->handed);
+                    this->handed = this->ring.size();
+                    this->space.notify_one();
+                }
+
+                if (this->filled.empty() && !this->finished && !this->failure)
+                {
+                    this->stall_count++;
+                    this->data.wait(guard, [this]() { return !this->filled.empty() || this->finished || this->failure; });
+                }
+
+                if (!this->filled.empty())
+                {
+                    this->handed = this->filled.front();
+                    this->filled.pop_front();
+
+                    batch = this->ring[this->handed];
+
+                    return true;
+                }
+
+                if (this->failure)
+                {
+                    std::exception_ptr error = this->failure;
+
+                    guard.unlock();
+
+                    try
+                    {
+                        std::rethrow_exception(error);
+                    }
+                    catch (std::runtime_error& e)
+                    {
+                        throw std::runtime_error("NumcyStream::StreamReader::next(Collective<T, E>&) -> " + std::string(e.what()));
+                    }
+                }
+
+                return false;
+            }
+
+            /*
+                Whole batches in one pass over the file
+             */
+            size_t size(void) const
+            {
+                return this->batches;
+            }
+
+            size_t stalls(void)
+            {
+                std::lock_guard<std::mutex> guard(this->lock);
+
+                return this->stall_count;
+            }
+    };
+}
+
+#endif
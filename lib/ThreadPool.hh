@@ -0,0 +1,568 @@
+/*
+ * Numcy/lib/ThreadPool.hh
+ *
+ * The one pool of worker threads every host kernel runs on. Numcy::ThreadPool names the same class.
+ *
+ * Q@hackers.pk
+ */
+
+#ifndef NUMCY_THREAD_POOL_HH
+#define NUMCY_THREAD_POOL_HH
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "./Numa.hh"
+
+namespace NumcyThreads
+{
+    /*
+        Ranges with at most this many elements run on the calling thread, the pool is not touched
+     */
+    constexpr size_t DEFAULT_SERIAL_THRESHOLD = 1 << 16;
+
+    /*
+        ThreadPool
+        ----------
+        Threads are started once, for the whole process, and then reused by every parallel_for().
+        A small op therefore pays for a few queue operations rather than for starting and joining
+        threads.
+
+        ThreadPool::global()
+        ├─► getNumberOfThreads() threads take part in a parallel_for(), the calling thread plus
+        │   getNumberOfThreads() - 1 workers
+        │     ├─► NUMCY_NUM_THREADS in the environment, read when the pool is first used
+        │     ├─► otherwise std::thread::hardware_concurrency()
+        │     └─► setNumberOfThreads(n) restarts the workers, call it while no parallel_for() is running
+        ├─► setSerialThreshold(elements), see threadsFor()
+        └─► NUMA, more than one node
+              ├─► thread t (the caller is thread 0) belongs to node t * nodes / threads, worker
+              │   threads are pinned to the cpus of their node (NUMCY_NUMA_PIN=0 turns that off)
+              └─► parallel_for_static() always hands the same slice of a range to the same thread,
+                  a buffer first written that way has every slice on the node of the thread that
+                  reads it again in the next parallel_for_static()
+
+        parallel_for(begin, end, grain, body)
+        ├─► end - begin <= grain or a single thread → body(begin, end) on the calling thread
+        └─► otherwise [begin, end) is cut into chunks of at least grain indices
+              ├─► the chunks are pushed onto the workers' deques (onto its own deque when the
+              │   caller is itself a worker, a nested parallel_for())
+              ├─► a worker pops from the back of its own deque and, when that is empty, steals
+              │   from the front of the others, idle workers sleep until work is queued
+              └─► the caller does not block, it runs chunks too until every chunk of its loop is
+                  done, then rethrows the first exception body threw
+     */
+    class ThreadPool
+    {
+        /*
+            One parallel_for() call, it lives on the caller's stack until pending drops to zero,
+            or one submit()ted job, on the heap until it has run
+         */
+        struct Loop
+        {
+            std::function<void(size_t, size_t)> body;
+            std::atomic<size_t> pending;
+            std::mutex error_lock;
+            std::exception_ptr error;
+            bool detached; // a submit()ed job, nobody waits for it, the worker deletes it when done
+
+            Loop(std::function<void(size_t, size_t)> f, size_t chunks, bool fire_and_forget = false) : body(f), pending(chunks), error_lock(), error(nullptr), detached(fire_and_forget)
+            {
+            }
+
+            Loop(const Loop&) = delete;
+            Loop& operator=(const Loop&) = delete;
+        };
+
+        struct Task
+        {
+            Loop* loop;
+            size_t first;
+            size_t last;
+            bool pinned; // only the worker whose deque it is on may run it, never stolen
+        };
+
+        struct Queue
+        {
+            std::mutex lock;
+            std::deque<Task> tasks;
+            std::atomic<size_t> pinned; // pinned tasks on this deque, only its worker can take them
+
+            Queue(void) : lock(), tasks(), pinned(0)
+            {
+            }
+        };
+
+        static constexpr size_t NOT_A_WORKER = static_cast<size_t>(-1);
+
+        std::vector<std::unique_ptr<Queue>> queues; // one per worker
+        std::vector<std::thread> workers;
+        std::mutex sleep_lock;
+        std::condition_variable wake;
+        std::atomic<size_t> stealable; // unpinned tasks on all deques, any worker can take them
+        std::atomic<size_t> next_queue;
+        bool stopping;
+        bool pinning;
+        size_t serial_threshold;
+
+        /*
+            Index of the worker the calling thread is, NOT_A_WORKER for every other thread
+         */
+        static size_t& _current(void)
+        {
+            static thread_local size_t index = NOT_A_WORKER;
+
+            return index;
+        }
+
+        /*
+            Own deque first (LIFO, the chunks it pushed last are the ones still in cache),
+            then the other deques (FIFO, steal the oldest and usually largest piece of work)
+         */
+        bool _take(size_t self, Task& task)
+        {
+            size_t count = this->queues.size();
+
+            if (self < count)
+            {
+                Queue& own = *this->queues[self];
+                std::lock_guard<std::mutex> guard(own.lock);
+
+                if (!own.tasks.empty())
+                {
+                    task = own.tasks.back();
+                    own.tasks.pop_back();
+                    (task.pinned ? own.pinned : this->stealable).fetch_sub(1);
+
+                    return true;
+                }
+            }
+
+            size_t start = self < count ? self + 1 : this->next_queue.load(std::memory_order_relaxed);
+
+            for (size_t i = 0; i < count; i++)
+            {
+                Queue& victim = *this->queues[(start + i) % count];
+                std::lock_guard<std::mutex> guard(victim.lock);
+
+                for (auto it = victim.tasks.begin(); it != victim.tasks.end(); ++it)
+                {
+                    if (!it->pinned)
+                    {
+                        task = *it;
+                        victim.tasks.erase(it);
+                        this->stealable.fetch_sub(1);
+
+                        return true;
+                    }
+                }
+            }
+
+            return false;
+        }
+
+        static void _run(const Task& task)
+        {
+            bool detached = task.loop->detached;
+
+            try
+            {
+                task.loop->body(task.first, task.last);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> guard(task.loop->error_lock);
+
+                if (!task.loop->error)
+                {
+                    task.loop->error = std::current_exception();
+                }
+            }
+
+            // Last touch of the loop, the caller may return as soon as this reaches zero
+            task.loop->pending.fetch_sub(1, std::memory_order_acq_rel);
+
+            if (detached)
+            {
+                delete task.loop;
+            }
+        }
+
+        void _work(size_t self, size_t threads)
+        {
+            _current() = self;
+
+            if (this->pinning)
+            {
+                NumcyNuma::pinCurrentThread(_nodeOf(self + 1, threads));
+            }
+
+            Queue& own = *this->queues[self];
+
+            // Pinned tasks on other deques are not ours to take, they must not keep us awake
+            auto has_work = [this, &own]() { return this->stealable.load() > 0 || own.pinned.load() > 0; };
+
+            while (true)
+            {
+                Task task = {nullptr, 0, 0, false};
+
+                if (this->_take(self, task))
+                {
+                    _run(task);
+
+                    continue;
+                }
+
+                std::unique_lock<std::mutex> lock(this->sleep_lock);
+
+                this->wake.wait(lock, [this, &has_work]() { return this->stopping || has_work(); });
+
+                if (this->stopping && !has_work())
+                {
+                    return;
+                }
+            }
+        }
+
+        void _start(size_t threads)
+        {
+            this->stopping = false;
+
+            for (size_t i = 0; i + 1 < threads; i++)
+            {
+                this->queues.push_back(std::unique_ptr<Queue>(new Queue()));
+            }
+
+            for (size_t i = 0; i + 1 < threads; i++)
+            {
+                this->workers.emplace_back([this, i, threads]() { this->_work(i, threads); });
+            }
+        }
+
+        void _stop(void)
+        {
+            {
+                std::lock_guard<std::mutex> guard(this->sleep_lock);
+                this->stopping = true;
+            }
+
+            this->wake.notify_all();
+
+            for (size_t i = 0; i < this->workers.size(); i++)
+            {
+                this->workers[i].join();
+            }
+
+            this->workers.clear();
+            this->queues.clear();
+        }
+
+        static size_t _defaultNumberOfThreads(void)
+        {
+            const char* env = std::getenv("NUMCY_NUM_THREADS");
+            size_t requested = env != nullptr ? std::strtoul(env, nullptr, 10) : 0;
+
+            if (requested > 0)
+            {
+                return requested;
+            }
+
+            size_t threads = std::thread::hardware_concurrency();
+
+            return threads == 0 ? 1 : threads;
+        }
+
+        static bool _defaultPinning(void)
+        {
+            const char* env = std::getenv("NUMCY_NUMA_PIN");
+
+            return NumcyNuma::numberOfNodes() > 1 && !(env != nullptr && env[0] == '0');
+        }
+
+        static size_t _nodeOf(size_t thread, size_t threads)
+        {
+            return thread * NumcyNuma::numberOfNodes() / threads;
+        }
+
+        /*
+            Queues chunks [begin + i * chunk, ...) for i in [first_chunk, chunks) of loop, chunk i
+            on the deque of worker worker(i), then wakes the workers. A task is counted before it
+            is pushed, so the count _take() decrements after popping it can never wrap.
+         */
+        template <typename W>
+        void _push(Loop& loop, size_t begin, size_t end, size_t chunk, size_t first_chunk, size_t chunks, bool pinned, W worker)
+        {
+            for (size_t i = first_chunk; i < chunks; i++)
+            {
+                Task task = {&loop, begin + i * chunk, std::min(end, begin + (i + 1) * chunk), pinned};
+                Queue& target = *this->queues[worker(i)];
+
+                (pinned ? target.pinned : this->stealable).fetch_add(1);
+
+                {
+                    std::lock_guard<std::mutex> guard(target.lock);
+                    target.tasks.push_back(task);
+                }
+            }
+
+            {
+                std::lock_guard<std::mutex> guard(this->sleep_lock);
+            }
+
+            this->wake.notify_all();
+        }
+
+        /*
+            Helps until every chunk of loop is done, whoever ran it, then rethrows its first exception
+         */
+        void _wait(Loop& loop, size_t self)
+        {
+            while (loop.pending.load(std::memory_order_acquire) > 0)
+            {
+                Task task = {nullptr, 0, 0, false};
+
+                if (this->_take(self, task))
+                {
+                    _run(task);
+                }
+                else
+                {
+                    std::this_thread::yield();
+                }
+            }
+
+            if (loop.error)
+            {
+                std::rethrow_exception(loop.error);
+            }
+        }
+
+        public:
+            explicit ThreadPool(size_t threads = _defaultNumberOfThreads()) : queues(), workers(), sleep_lock(), wake(), stealable(0), next_queue(0), stopping(false), pinning(_defaultPinning()), serial_threshold(DEFAULT_SERIAL_THRESHOLD)
+            {
+                this->_start(threads == 0 ? 1 : threads);
+            }
+
+            ThreadPool(const ThreadPool&) = delete;
+            ThreadPool& operator=(const ThreadPool&) = delete;
+
+            ~ThreadPool()
+            {
+                this->_stop();
+            }
+
+            /*
+                The pool every Numcy kernel uses, started on first use
+             */
+            static ThreadPool& global(void)
+            {
+                static ThreadPool pool;
+
+                return pool;
+            }
+
+            size_t getNumberOfThreads(void) const
+            {
+                return this->workers.size() + 1;
+            }
+
+            void setNumberOfThreads(size_t threads)
+            {
+                this->_stop();
+                this->_start(threads == 0 ? 1 : threads);
+            }
+
+            size_t getSerialThreshold(void) const
+            {
+                return this->serial_threshold;
+            }
+
+            void setSerialThreshold(size_t elements)
+            {
+                this->serial_threshold = elements;
+            }
+
+            /*
+                threadsFor()
+                └─► How many threads a memory bound pass over this many elements is worth,
+                    1 at or below the serial threshold
+             */
+            size_t threadsFor(size_t elements) const
+            {
+                return elements <= this->serial_threshold ? 1 : this->getNumberOfThreads();
+            }
+
+            template <typename F>
+            void parallel_for(size_t begin, size_t end, size_t grain, F body)
+            {
+                if (end <= begin)
+                {
+                    return;
+                }
+
+                size_t range = end - begin;
+                size_t workers_count = this->queues.size();
+
+                grain = grain == 0 ? 1 : grain;
+
+                if (range <= grain || workers_count == 0)
+                {
+                    body(begin, end);
+
+                    return;
+                }
+
+                // A few chunks per thread so that stealing can even out uneven chunks
+                size_t chunks = std::min((range + grain - 1) / grain, 4 * (workers_count + 1));
+                size_t chunk = (range + chunks - 1) / chunks;
+
+                chunks = (range + chunk - 1) / chunk;
+
+                const std::function<void(size_t, size_t)> function = [&body](size_t first, size_t last) { body(first, last); };
+                Loop loop(function, chunks);
+
+                size_t self = _current();
+                bool nested = self < workers_count;
+
+                this->_push(loop, begin, end, chunk, 0, chunks, false, [this, nested, self, workers_count](size_t)
+                {
+                    return nested ? self : this->next_queue.fetch_add(1, std::memory_order_relaxed) % workers_count;
+                });
+
+                this->_wait(loop, nested ? self : NOT_A_WORKER);
+            }
+
+            /*
+                parallel_for_static()
+                ├─► [begin, end) is cut into getNumberOfThreads() equal slices, slice t always goes
+                │   to thread t: slice 0 to the caller, slice t to worker t - 1, never stolen
+                └─► for passes that should find their pages on the local node, the pass that first
+                    writes a buffer and every later pass over it
+             */
+            template <typename F>
+            void parallel_for_static(size_t begin, size_t end, size_t grain, F body)
+            {
+                if (end <= begin)
+                {
+                    return;
+                }
+
+                size_t range = end - begin;
+                size_t workers_count = this->queues.size();
+
+                if (range <= (grain == 0 ? 1 : grain) || workers_count == 0)
+                {
+                    body(begin, end);
+
+                    return;
+                }
+
+                size_t slices = workers_count + 1;
+                size_t slice = (range + slices - 1) / slices;
+
+                slices = (range + slice - 1) / slice;
+
+                const std::function<void(size_t, size_t)> function = [&body](size_t first, size_t last) { body(first, last); };
+                Loop loop(function, slices);
+
+                size_t self = _current();
+
+                this->_push(loop, begin, end, slice, 1, slices, true, [](size_t i) { return i - 1; });
+
+                _run(Task{&loop, begin, std::min(end, begin + slice), false});
+
+                this->_wait(loop, self < workers_count ? self : NOT_A_WORKER);
+            }
+
+            /*
+                submit()
+                ├─► queues job to run once on some worker and returns without waiting for it
+                ├─► job must not throw, there is nobody to rethrow to (Numcy::async() catches for it)
+                └─► no workers (a single thread) → job runs right here, before submit() returns
+             */
+            void submit(std::function<void()> job)
+            {
+                size_t workers_count = this->queues.size();
+
+                if (workers_count == 0)
+                {
+                    job();
+
+                    return;
+                }
+
+                Loop* loop = new Loop([job](size_t, size_t) { job(); }, 1, true);
+                size_t self = _current();
+                bool nested = self < workers_count;
+
+                this->_push(*loop, 0, 1, 1, 0, 1, false, [this, nested, self, workers_count](size_t)
+                {
+                    return nested ? self : this->next_queue.fetch_add(1, std::memory_order_relaxed) % workers_count;
+                });
+            }
+
+            /*
+                Runs one queued task on the calling thread, false when there was none. For threads
+                that have to wait for the pool (a pending Collective) and can help instead of sleeping.
+             */
+            bool runPendingTask(void)
+            {
+                Task task = {nullptr, 0, 0, false};
+                size_t self = _current();
+
+                if (this->_take(self < this->queues.size() ? self : NOT_A_WORKER, task))
+                {
+                    _run(task);
+
+                    return true;
+                }
+
+                return false;
+            }
+
+            /*
+                The node (index into NumcyNuma::topology().nodes) thread t of a parallel_for_static() runs on
+             */
+            size_t getNodeOfThread(size_t thread) const
+            {
+                return _nodeOf(thread, this->getNumberOfThreads());
+            }
+    };
+
+    /*
+        parallel_for() on the global pool, body(first, last) is called on disjoint sub-ranges
+        that together cover [begin, end)
+     */
+    template <typename F>
+    void parallel_for(size_t begin, size_t end, size_t grain, F body)
+    {
+        ThreadPool::global().parallel_for(begin, end, grain, body);
+    }
+
+    template <typename F>
+    void parallel_for_static(size_t begin, size_t end, size_t grain, F body)
+    {
+        ThreadPool::global().parallel_for_static(begin, end, grain, body);
+    }
+
+    inline size_t getNumberOfThreads(void)
+    {
+        return ThreadPool::global().getNumberOfThreads();
+    }
+
+    inline size_t threadsFor(size_t elements)
+    {
+        return ThreadPool::global().threadsFor(elements);
+    }
+}
+
+#endif
@@ -0,0 +1,113 @@
+/*
+ * Numcy/lib/TopK.hh
+ * Q@hackers.pk
+ */
+
+#ifndef NUMCY_TOPK_HH
+#define NUMCY_TOPK_HH
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace NumcyUtils
+{
+    /*
+        BoundedHeap<T, E>
+        -----------------
+        Keeps the k largest (value, index) pairs pushed into it, in O(log k) per push and O(k) memory.
+        It is a min-heap on value: the root is the worst pair kept so far, so a new pair either loses
+        against the root in one compare (the common case once the heap is full) or replaces it.
+
+            threshold() — the smallest value kept, anything not greater can be skipped without a push
+            merge()     — folds another heap in, how per-thread heaps are combined
+            sorted()    — the kept pairs, best first
+
+        Ties on value are broken by index, the smaller index wins, so the result does not depend on
+        how the input was split across threads. NaN values are never kept.
+     */
+    template <typename T = double, typename E = size_t>
+    class BoundedHeap
+    {
+        size_t k;
+        std::vector<std::pair<T, E>> items;
+
+        /*
+            _better(x, y) — x ranks above y. Used as the "less than" of the std heap algorithms,
+            which makes the worst kept pair the root.
+         */
+        static bool _better(const std::pair<T, E>& x, const std::pair<T, E>& y)
+        {
+            return x.first > y.first || (!(y.first > x.first) && x.second < y.second);
+        }
+
+        public:
+            BoundedHeap(size_t capacity = 0) : k(capacity), items()
+            {
+                this->items.reserve(capacity);
+            }
+
+            void push(T value, E index)
+            {
+                if (this->k == 0 || value != value)
+                {
+                    return;
+                }
+
+                std::pair<T, E> item(value, index);
+
+                if (this->items.size() < this->k)
+                {
+                    this->items.push_back(item);
+                    std::push_heap(this->items.begin(), this->items.end(), _better);
+                }
+                else if (_better(item, this->items.front()))
+                {
+                    std::pop_heap(this->items.begin(), this->items.end(), _better);
+                    this->items.back() = item;
+                    std::push_heap(this->items.begin(), this->items.end(), _better);
+                }
+            }
+
+            bool full(void) const
+            {
+                return this->items.size() == this->k;
+            }
+
+            // Only meaningful when full()
+            T threshold(void) const
+            {
+                return this->items.front().first;
+            }
+
+            void merge(const BoundedHeap<T, E>& other)
+            {
+                for (size_t i = 0; i < other.items.size(); i++)
+                {
+                    this->push(other.items[i].first, other.items[i].second);
+                }
+            }
+
+            size_t size(void) const
+            {
+                return this->items.size();
+            }
+
+            // Empties the heap but keeps its storage, so one heap can be reused line after line
+            void clear(void)
+            {
+                this->items.clear();
+            }
+
+            std::vector<std::pair<T, E>> sorted(void) const
+            {
+                std::vector<std::pair<T, E>> result(this->items);
+
+                std::sort(result.begin(), result.end(), _better);
+
+                return result;
+            }
+    };
+}
+
+#endif
@@ -0,0 +1,306 @@
+/*
+ * Numcy/lib/Trace.hh
+ *
+ * Per-op tracing, compiled in with -DNUMCY_TRACE and absent otherwise. Every Numcy op records
+ * when it began and ended, on which thread, the shapes of its operands and the bytes they hold,
+ * into a ring buffer of its thread. NumcyTrace::write() exports everything recorded as a Chrome
+ * trace (chrome://tracing, ui.perfetto.dev).
+ *
+ * Without NUMCY_TRACE nothing of it is compiled and NUMCY_TRACE_OP() expands to nothing. The
+ * allocation site of an op is named by NUMCY_MEMORY_SITE() (lib/Memory.hh), traced or not.
+ *
+ * Q@hackers.pk
+ */
+
+#ifndef NUMCY_TRACE_HH
+#define NUMCY_TRACE_HH
+
+#ifdef NUMCY_TRACE
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/*
+    Events each thread keeps, the oldest are overwritten once it is full
+ */
+#ifndef NUMCY_TRACE_CAPACITY
+    #define NUMCY_TRACE_CAPACITY 16384
+#endif
+
+namespace NumcyTrace
+{
+    constexpr size_t MAX_OPERANDS = 3;
+    constexpr size_t MAX_RANK = 6;
+
+    /*
+        One op, fixed size so recording it never allocates. name is a string literal.
+     */
+    struct Event
+    {
+        const char* name;
+        uint64_t begin;   // Nanoseconds since the first event of the process
+        uint64_t end;
+        uint64_t bytes;   // Of the operands
+        uint32_t shape[MAX_OPERANDS][MAX_RANK];
+        uint8_t rank[MAX_OPERANDS];  // MAX_RANK + 1 for an operand of more axes than kept
+        uint8_t operands;
+    };
+
+    /*
+        The ring of one thread. Only its thread writes, head is published with a release store
+        after the event is complete, write() reads up to the head it acquires.
+     */
+    struct Buffer
+    {
+        std::vector<Event> events;
+        std::atomic<uint64_t> head;
+        uint32_t thread;
+
+        explicit Buffer(uint32_t id) : events(NUMCY_TRACE_CAPACITY), head(0), thread(id)
+        {
+        }
+
+        void push(const Event& event)
+        {
+            uint64_t at = this->head.load(std::memory_order_relaxed);
+
+            this->events[at % this->events.size()] = event;
+            this->head.store(at + 1, std::memory_order_release);
+        }
+    };
+
+    /*
+        Every thread's buffer, the registry holds them beyond the lives of their threads so a
+        pool resized or a thread joined still shows up in the trace
+     */
+    class Registry
+    {
+        std::mutex lock;
+        std::vector<std::shared_ptr<Buffer>> buffers;
+
+        Registry(void) : lock(), buffers()
+        {
+        }
+
+        public:
+            Registry(const Registry&) = delete;
+            Registry& operator=(const Registry&) = delete;
+
+            static Registry& global(void)
+            {
+                static Registry registry;
+
+                return registry;
+            }
+
+            std::shared_ptr<Buffer> add(void)
+            {
+                std::lock_guard<std::mutex> guard(this->lock);
+
+                this->buffers.push_back(std::make_shared<Buffer>(uint32_t(this->buffers.size())));
+
+                return this->buffers.back();
+            }
+
+            std::vector<std::shared_ptr<Buffer>> all(void)
+            {
+                std::lock_guard<std::mutex> guard(this->lock);
+
+                return this->buffers;
+            }
+    };
+
+    /*
+        The calling thread's buffer, registered on its first event (the only lock taken)
+     */
+    inline Buffer& local(void)
+    {
+        thread_local std::shared_ptr<Buffer> buffer = Registry::global().add();
+
+        return *buffer;
+    }
+
+    inline uint64_t now(void)
+    {
+        static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+        return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count());
+    }
+
+    /*
+        Scope
+        -----
+        NUMCY_TRACE_OP("matmul", a, b) at the top of an op, the constructor takes the shapes and
+        sizes of the operands (Collectives or Dimensions, the first MAX_OPERANDS are kept) and the
+        start time, the destructor the end time, and pushes the event. An op that throws is
+        recorded too.
+     */
+    class Scope
+    {
+        Event event;
+
+        template <typename C>
+        void _operand(const C& c)
+        {
+            if (this->event.operands == MAX_OPERANDS || c.isEmpty())
+            {
+                return;
+            }
+
+            auto dims = c.getShape().toVector();
+            size_t slot = this->event.operands++;
+
+            this->event.rank[slot] = uint8_t(dims.size() > MAX_RANK ? MAX_RANK + 1 : dims.size());
+
+            for (size_t i = 0; i < dims.size() && i < MAX_RANK; i++)
+            {
+                this->event.shape[slot][i] = uint32_t(dims[i]);
+            }
+
+            this->event.bytes = this->event.bytes + uint64_t(c.getShape().numel() * sizeof(*c.getData()));
+        }
+
+        /*
+            A shape alone, the ops that make a collective from one (no bytes)
+         */
+        template <typename E>
+        void _operand(const Dimensions<E>& d)
+        {
+            if (this->event.operands == MAX_OPERANDS || d.size() == 0)
+            {
+                return;
+            }
+
+            auto dims = d.toVector();
+
+            size_t slot = this->event.operands++;
+
+            this->event.rank[slot] = uint8_t(dims.size() > MAX_RANK ? MAX_RANK + 1 : dims.size());
+
+            for (size_t i = 0; i < dims.size() && i < MAX_RANK; i++)
+            {
+                this->event.shape[slot][i] = uint32_t(dims[i]);
+            }
+        }
+
+        public:
+            template <typename... C>
+            explicit Scope(const char* name, const C&... operands) : event()
+            {
+                this->event.name = name;
+
+                int expand[] = {0, (this->_operand(operands), 0)...};
+                (void)expand;
+
+                this->event.begin = now();
+            }
+
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+
+            ~Scope()
+            {
+                this->event.end = now();
+
+                local().push(this->event);
+            }
+    };
+
+    /*
+        Forgets everything recorded so far (call while no op is running)
+     */
+    inline void clear(void)
+    {
+        std::vector<std::shared_ptr<Buffer>> buffers = Registry::global().all();
+
+        for (size_t i = 0; i < buffers.size(); i++)
+        {
+            buffers[i]->head.store(0, std::memory_order_release);
+        }
+    }
+
+    /*
+        The trace as Chrome trace event JSON, one complete ("X") event per op
+        ├─► ts / dur in microseconds, tid the order in which threads first recorded
+        └─► args.shapes and args.bytes of the operands
+        Ops still recording on other threads may be missing or, when their ring wraps meanwhile,
+        torn. Export between steps.
+     */
+    inline std::string json(void)
+    {
+        std::vector<std::shared_ptr<Buffer>> buffers = Registry::global().all();
+        std::ostringstream out;
+        bool first = true;
+
+        out << std::fixed << std::setprecision(3);
+        out << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [";
+
+        for (size_t b = 0; b < buffers.size(); b++)
+        {
+            const Buffer& buffer = *buffers[b];
+            uint64_t head = buffer.head.load(std::memory_order_acquire);
+            uint64_t size = buffer.events.size();
+
+            out << (first ? "" : ",") << "\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << buffer.thread << ", \"args\": {\"name\": \"numcy " << buffer.thread << "\"}}";
+            first = false;
+
+            for (uint64_t i = head > size ? head - size : 0; i < head; i++)
+            {
+                const Event& e = buffer.events[i % size];
+
+                out << ",\n{\"name\": \"" << e.name << "\", \"cat\": \"numcy\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << buffer.thread;
+                out << ", \"ts\": " << double(e.begin) / 1000.0 << ", \"dur\": " << double(e.end - e.begin) / 1000.0;
+                out << ", \"args\": {\"bytes\": " << e.bytes << ", \"shapes\": \"";
+
+                for (size_t o = 0; o < e.operands; o++)
+                {
+                    out << (o == 0 ? "[" : " [");
+
+                    for (size_t d = 0; d < e.rank[o] && d < MAX_RANK; d++)
+                    {
+                        out << (d == 0 ? "" : ", ") << e.shape[o][d];
+                    }
+
+                    out << (e.rank[o] > MAX_RANK ? ", ...]" : "]");
+                }
+
+                out << "\"}}";
+            }
+        }
+
+        out << "\n]}\n";
+
+        return out.str();
+    }
+
+    inline void write(const std::string& path)
+    {
+        std::ofstream file(path);
+
+        file << json();
+
+        if (!file)
+        {
+            throw std::runtime_error("NumcyTrace::write(const std::string&) Error: cannot write " + path);
+        }
+    }
+}
+
+#define NUMCY_TRACE_OP(...) NumcyTrace::Scope numcy_trace_scope(__VA_ARGS__)
+
+#else
+
+#define NUMCY_TRACE_OP(...)
+
+#endif
+
+#endif
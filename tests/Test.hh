@@ -0,0 +1,98 @@
+/*
+ * Numcy/tests/Test.hh
+ *
+ * What every test program includes. CHECK(condition) reports a condition that does not hold with
+ * its file and line and counts it, a test keeps going after a failure so one run shows them all.
+ * main() ends with return NumcyTest::result("name"), non-zero when anything failed.
+ *
+ * make test builds every test program with AddressSanitizer and UBSan and runs it on the default
+ * thread pool and on four threads.
+ *
+ * Q@hackers.pk
+ */
+
+#ifndef NUMCY_TEST_HH
+#define NUMCY_TEST_HH
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../header.hh"
+
+namespace NumcyTest
+{
+    inline size_t& failures(void)
+    {
+        static size_t count = 0;
+
+        return count;
+    }
+
+    inline void check(bool holds, const char* condition, const char* file, int line)
+    {
+        if (!holds)
+        {
+            failures()++;
+            std::cerr << file << ":" << line << ": CHECK(" << condition << ") failed" << std::endl;
+        }
+    }
+
+    inline int result(const char* name)
+    {
+        std::cout << name << ": " << (failures() == 0 ? std::string("ok") : std::to_string(failures()) + " failed") << std::endl;
+
+        return failures() == 0 ? 0 : 1;
+    }
+
+    /*
+        |x - y| <= tolerance * max(1, |y|)
+     */
+    inline bool close(double x, double y, double tolerance)
+    {
+        return std::fabs(x - y) <= tolerance * std::max(1.0, std::fabs(y));
+    }
+
+    inline Dimensions<size_t> shape(const std::vector<size_t>& axes)
+    {
+        Dimensions<size_t> d;
+        d.fromVector(axes);
+
+        return d;
+    }
+
+    /*
+        A host collective of shape filled with f(i), i the flat index
+     */
+    template <typename T, typename F>
+    Collective<T> filled(const std::vector<size_t>& axes, F f)
+    {
+        Collective<T> c(shape(axes));
+
+        for (size_t i = 0; i < c.getShape().numel(); i++)
+        {
+            c[i] = f(i);
+        }
+
+        return c;
+    }
+
+    /*
+        Deterministic values in [-1, 1), the same on every platform
+     */
+    inline double uniform(uint64_t& state)
+    {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+
+        return double(state >> 11) / double(1ULL << 52) - 1.0;
+    }
+}
+
+#define CHECK(condition) NumcyTest::check((condition), #condition, __FILE__, __LINE__)
+
+#endif
@@ -0,0 +1,79 @@
+/*
+ * Numcy/tests/async.cpp
+ *
+ * Numcy::async() and async_matmul(): a chain of dependent ops gives what the eager ops give, an
+ * op that throws fails its result and every op that depends on it, and the caller sees the
+ * exception on wait() and on access.
+ *
+ * Q@hackers.pk
+ */
+
+#include "./Test.hh"
+
+template <typename F>
+bool throws(F f)
+{
+    try
+    {
+        f();
+    }
+    catch (const std::runtime_error&)
+    {
+        return true;
+    }
+
+    return false;
+}
+
+int main(void)
+{
+    uint64_t state = 5;
+
+    Collective<double> x = NumcyTest::filled<double>({40, 30}, [&](size_t) { return NumcyTest::uniform(state); });
+    Collective<double> w1 = NumcyTest::filled<double>({30, 20}, [&](size_t) { return NumcyTest::uniform(state); });
+    Collective<double> w2 = NumcyTest::filled<double>({20, 10}, [&](size_t) { return NumcyTest::uniform(state); });
+
+    // h and y are pending until their ops have run, y waits for h
+    Collective<double> h = Numcy::async_matmul(x, w1);
+    Collective<double> y = Numcy::async_matmul(h, w2);
+    Collective<double> eager = Numcy::matmul(Numcy::matmul(x, w1), w2);
+
+    y.wait();
+
+    CHECK(h.isReady() && y.isReady());
+    CHECK(y.getShape().toVector() == (std::vector<size_t>{40, 10}));
+
+    bool same = true;
+
+    for (size_t i = 0; i < 400; i++)
+    {
+        same = same && y[i] == eager[i];
+    }
+
+    CHECK(same);
+
+    // An op that throws, and one that depends on it
+    Collective<double> failed = Numcy::async([]() -> Collective<double> { throw std::runtime_error("op threw"); });
+    Collective<double> after = Numcy::async_matmul(failed, w2);
+
+    CHECK(throws([&]() { failed.wait(); }));
+    CHECK(throws([&]() { after.wait(); }));
+    CHECK(throws([&]() { return after[0]; }));
+    CHECK(throws([&]() { return failed.getShape().numel(); }));
+
+    // The message of the op's exception reaches the caller as it was
+    bool message = false;
+
+    try
+    {
+        failed.wait();
+    }
+    catch (const std::runtime_error& e)
+    {
+        message = std::string(e.what()).find("op threw") != std::string::npos;
+    }
+
+    CHECK(message);
+
+    return NumcyTest::result("async");
+}
@@ -0,0 +1,114 @@
+/*
+ * Numcy/tests/autograd.cpp
+ *
+ * NumcyAutograd::Tape gradients against central finite differences, for a two layer model with
+ * broadcast biases, recorded plainly and with its first layer as a checkpointed segment.
+ *
+ * Q@hackers.pk
+ */
+
+#include "./Test.hh"
+
+struct Model
+{
+    Collective<double> x, t, w1, b1, w2, b2;
+};
+
+/*
+    loss = mean((relu(x * w1 + b1) * w2 + b2 - t)^2) + sum(0.1 * relu(x * w1 + b1)), its value,
+    and after backward() the gradients of the four parameters when gradients is given
+ */
+double loss(const Model& m, bool checkpointed, std::vector<std::vector<double>>* gradients)
+{
+    NumcyAutograd::Tape<double> tape;
+
+    size_t x = tape.constant(m.x), t = tape.constant(m.t);
+    std::vector<size_t> parameters = {tape.variable(m.w1), tape.variable(m.b1), tape.variable(m.w2), tape.variable(m.b2)};
+
+    auto first = [](NumcyAutograd::Tape<double>& inner, const std::vector<size_t>& in)
+    {
+        return inner.relu(inner.add(inner.matmul(in[0], in[1]), in[2]));
+    };
+
+    size_t h = checkpointed ? tape.checkpoint(first, {x, parameters[0], parameters[1]}) : first(tape, {x, parameters[0], parameters[1]});
+    size_t z = tape.sub(tape.add(tape.matmul(h, parameters[2]), parameters[3]), t);
+    size_t l = tape.add(tape.mean(tape.mul(z, z)), tape.sum(tape.scale(h, 0.1)));
+
+    double value = tape.value(l)[0];
+
+    if (gradients != nullptr)
+    {
+        tape.backward(l);
+
+        for (size_t p = 0; p < parameters.size(); p++)
+        {
+            const Collective<double>& g = tape.grad(parameters[p]);
+
+            gradients->push_back(std::vector<double>(g.getData(), g.getData() + g.getShape().numel()));
+        }
+    }
+
+    return value;
+}
+
+int main(void)
+{
+    uint64_t state = 41;
+    auto random = [&](const std::vector<size_t>& axes) { return NumcyTest::filled<double>(axes, [&](size_t) { return NumcyTest::uniform(state); }); };
+
+    Model m = {random({5, 4}), random({5, 3}), random({4, 6}), random({1, 6}), random({6, 3}), random({1, 3})};
+    std::vector<Collective<double>> parameters = {m.w1, m.b1, m.w2, m.b2};
+
+    for (int checkpointed = 0; checkpointed < 2; checkpointed++)
+    {
+        std::vector<std::vector<double>> gradients;
+
+        loss(m, checkpointed != 0, &gradients);
+
+        bool agree = gradients.size() == parameters.size();
+
+        for (size_t p = 0; agree && p < parameters.size(); p++)
+        {
+            // Variables share the parameters' buffers, nudging an element moves the next forward pass
+            Collective<double> parameter = parameters[p];
+
+            agree = gradients[p].size() == parameter.getShape().numel();
+
+            for (size_t i = 0; agree && i < parameter.getShape().numel(); i++)
+            {
+                const double step = 1e-6;
+                double kept = parameter[i];
+
+                parameter[i] = kept + step;
+                double above = loss(m, checkpointed != 0, nullptr);
+                parameter[i] = kept - step;
+                double below = loss(m, checkpointed != 0, nullptr);
+                parameter[i] = kept;
+
+                agree = NumcyTest::close(gradients[p][i], (above - below) / (2.0 * step), 1e-7);
+            }
+        }
+
+        CHECK(agree);
+    }
+
+    // The checkpointed segment gives the plain loss and gradients
+    std::vector<std::vector<double>> plain, checkpointed;
+
+    CHECK(loss(m, false, &plain) == loss(m, true, &checkpointed));
+    CHECK(plain.size() == checkpointed.size());
+
+    bool same = true;
+
+    for (size_t p = 0; p < plain.size() && p < checkpointed.size(); p++)
+    {
+        for (size_t i = 0; i < plain[p].size(); i++)
+        {
+            same = same && NumcyTest::close(plain[p][i], checkpointed[p][i], 1e-14);
+        }
+    }
+
+    CHECK(same);
+
+    return NumcyTest::result("autograd");
+}
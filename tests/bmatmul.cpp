@@ -0,0 +1,114 @@
+/*
+ * Numcy/tests/bmatmul.cpp
+ *
+ * Numcy::bmatmul() against a naive loop over the broadcast batch, with batch axes that match, are
+ * missing on one side or are 1 on one side.
+ *
+ * Q@hackers.pk
+ */
+
+#include "./Test.hh"
+
+/*
+    Flat index of the first element of the matrix of batch b in an operand of batch axes axes,
+    axes aligned from the right with the batch axes of the output out
+ */
+size_t matrix_of(size_t b, const std::vector<size_t>& out, const std::vector<size_t>& axes, size_t matrix)
+{
+    size_t offset = 0;
+    size_t stride = matrix;
+
+    for (size_t i = 0; i < out.size(); i++)
+    {
+        size_t index = b % out[out.size() - 1 - i];
+
+        b = b / out[out.size() - 1 - i];
+
+        if (i < axes.size())
+        {
+            size_t axis = axes[axes.size() - 1 - i];
+
+            offset = offset + (axis == 1 ? 0 : index) * stride;
+            stride = stride * axis;
+        }
+    }
+
+    return offset;
+}
+
+template <typename T>
+void check_bmatmul(const std::vector<size_t>& a_axes, const std::vector<size_t>& b_axes, const std::vector<size_t>& c_axes, double tolerance)
+{
+    uint64_t state = a_axes.size() * 7 + b_axes.size();
+
+    Collective<T> a = NumcyTest::filled<T>(a_axes, [&](size_t) { return T(NumcyTest::uniform(state)); });
+    Collective<T> b = NumcyTest::filled<T>(b_axes, [&](size_t) { return T(NumcyTest::uniform(state)); });
+    Collective<T> c = Numcy::bmatmul(a, b);
+
+    CHECK(c.getShape().toVector() == c_axes);
+
+    size_t m = a_axes[a_axes.size() - 2];
+    size_t k = a_axes.back();
+    size_t n = b_axes.back();
+
+    std::vector<size_t> batch(c_axes.begin(), c_axes.end() - 2);
+    std::vector<size_t> a_batch(a_axes.begin(), a_axes.end() - 2);
+    std::vector<size_t> b_batch(b_axes.begin(), b_axes.end() - 2);
+    size_t batches = 1;
+
+    for (size_t axis : batch)
+    {
+        batches = batches * axis;
+    }
+
+    bool same = true;
+
+    for (size_t bi = 0; bi < batches; bi++)
+    {
+        size_t ao = matrix_of(bi, batch, a_batch, m * k);
+        size_t bo = matrix_of(bi, batch, b_batch, k * n);
+
+        for (size_t i = 0; i < m; i++)
+        {
+            for (size_t j = 0; j < n; j++)
+            {
+                double exact = 0.0;
+
+                for (size_t p = 0; p < k; p++)
+                {
+                    exact = exact + double(a[ao + i * k + p]) * double(b[bo + p * n + j]);
+                }
+
+                same = same && std::fabs(double(c[bi * m * n + i * n + j]) - exact) <= tolerance * double(k);
+            }
+        }
+    }
+
+    CHECK(same);
+}
+
+int main(void)
+{
+    check_bmatmul<double>({2, 3, 5, 7}, {2, 3, 7, 4}, {2, 3, 5, 4}, 1e-14);
+    check_bmatmul<double>({2, 3, 5, 7}, {7, 4}, {2, 3, 5, 4}, 1e-14);
+    check_bmatmul<double>({2, 1, 5, 7}, {1, 3, 7, 4}, {2, 3, 5, 4}, 1e-14);
+    check_bmatmul<double>({5, 7}, {3, 7, 4}, {3, 5, 4}, 1e-14);
+    check_bmatmul<float>({4, 33, 65}, {4, 65, 17}, {4, 33, 17}, 1e-6);
+    check_bmatmul<float>({3, 1, 9, 130}, {2, 130, 3}, {3, 2, 9, 3}, 1e-6);
+
+    // Batch axes that neither match nor broadcast
+    bool threw = false;
+
+    try
+    {
+        Numcy::bmatmul(NumcyTest::filled<double>({2, 3, 4}, [](size_t) { return 1.0; }), NumcyTest::filled<double>({3, 4, 2}, [](size_t) { return 1.0; }));
+    }
+    catch (const std::runtime_error&)
+    {
+        threw = true;
+    }
+
+    CHECK(threw);
+
+    return NumcyTest::result("bmatmul");
+}
@@ -0,0 +1,137 @@
+/*
+ * Numcy/tests/checkpoint.cpp
+ *
+ * A checkpoint committed, reopened and committed again: every tensor reads back as written across
+ * several shards, a Reader opened before the second commit keeps reading the first checkpoint,
+ * the shards the old index named are removed, a corrupt chunk fails its checksum, and a wrong
+ * name or element type is refused. The directory is created next to the test programs and
+ * removed again.
+ *
+ * Q@hackers.pk
+ */
+
+#include "./Test.hh"
+
+#include <cstdio>
+#include <fstream>
+
+template <typename T>
+bool equal(const Collective<T>& x, const Collective<T>& y)
+{
+    bool same = x.getShape().toVector() == y.getShape().toVector();
+
+    for (size_t i = 0; same && i < x.getShape().numel(); i++)
+    {
+        same = x[i] == y[i];
+    }
+
+    return same;
+}
+
+bool exists(const std::string& path)
+{
+    return bool(std::ifstream(path));
+}
+
+template <typename F>
+bool throws(F f)
+{
+    try
+    {
+        f();
+    }
+    catch (const std::runtime_error&)
+    {
+        return true;
+    }
+
+    return false;
+}
+
+int main(void)
+{
+    const std::string directory = "tests/checkpoint_tmp";
+    uint64_t state = 11;
+
+    Collective<float> w = NumcyTest::filled<float>({300, 70}, [&](size_t) { return float(NumcyTest::uniform(state)); });
+    Collective<int64_t> ids = NumcyTest::filled<int64_t>({5, 7}, [](size_t i) { return int64_t(i) * 1000003 - 17; });
+
+    // 4 KiB chunks, w alone is 21 of them, spread over 3 shards
+    {
+        Numcy::CheckpointWriter writer(directory, 4096, 3);
+
+        writer.add("layer0.w", w);
+        writer.add("ids", ids);
+        writer.commit();
+    }
+
+    NumcyCheckpoint::Index first = NumcyCheckpoint::parse(directory + "/index");
+
+    CHECK(first.shards == 3);
+    CHECK(first.tensors.size() == 2 && first.tensors[0].chunks.size() == 21);
+
+    Numcy::CheckpointReader before(directory);
+
+    CHECK(before.names() == (std::vector<std::string>{"layer0.w", "ids"}));
+    CHECK(equal(before.get<float>("layer0.w"), w));
+    CHECK(equal(before.get<int64_t>("ids"), ids));
+
+    // A second commit replaces the first
+    Collective<float> w2 = NumcyTest::filled<float>({300, 70}, [&](size_t) { return float(NumcyTest::uniform(state)); });
+
+    {
+        Numcy::CheckpointWriter writer(directory, 4096, 2);
+
+        writer.add("layer0.w", w2);
+        writer.commit();
+    }
+
+    NumcyCheckpoint::Index second = NumcyCheckpoint::parse(directory + "/index");
+
+    CHECK(second.tag != first.tag && second.shards == 2);
+    CHECK(!exists(NumcyCheckpoint::shardPath(directory, first.tag, 0)));
+    CHECK(exists(NumcyCheckpoint::shardPath(directory, second.tag, 0)));
+
+    // The reader opened before it still reads the first checkpoint from the shards it holds open
+    CHECK(equal(before.get<float>("layer0.w"), w));
+
+    {
+        Numcy::CheckpointReader after(directory);
+
+        CHECK(after.names() == (std::vector<std::string>{"layer0.w"}));
+        CHECK(equal(after.get<float>("layer0.w"), w2));
+        CHECK(throws([&]() { after.get<float>("ids"); }));
+        CHECK(throws([&]() { after.get<double>("layer0.w"); }));
+    }
+
+    // One flipped byte in a shard, caught by the chunk checksums unless verify is off
+    {
+        std::fstream shard(NumcyCheckpoint::shardPath(directory, second.tag, 1), std::ios::binary | std::ios::in | std::ios::out);
+        char byte = 0;
+
+        shard.seekg(100);
+        shard.read(&byte, 1);
+        byte = char(byte ^ 0x55);
+        shard.seekp(100);
+        shard.write(&byte, 1);
+    }
+
+    {
+        Numcy::CheckpointReader corrupt(directory);
+
+        CHECK(throws([&]() { corrupt.get<float>("layer0.w"); }));
+        CHECK(!equal(corrupt.get<float>("layer0.w", false), w2));
+    }
+
+    for (size_t s = 0; s < second.shards; s++)
+    {
+        std::remove(NumcyCheckpoint::shardPath(directory, second.tag, s).c_str());
+    }
+
+    std::remove((directory + "/index").c_str());
+    std::remove(directory.c_str());
+
+    CHECK(throws([&]() { Numcy::CheckpointReader missing(directory); }));
+
+    return NumcyTest::result("checkpoint");
+}
@@ -0,0 +1,90 @@
+/*
+ * Numcy/tests/cpu.cpp
+ *
+ * NUMCY_ISA: a value that names no level is refused, and NUMCY_ISA=scalar makes every kernel
+ * family that runs resolve to its portable variant and still compute the right thing. The
+ * environment is set by the test itself, before the first kernel is used.
+ *
+ * Q@hackers.pk
+ */
+
+#include "./Test.hh"
+
+#include <cstdlib>
+
+int main(void)
+{
+    // A level no kernel has a variant for, refused and not remembered
+    setenv("NUMCY_ISA", "sse4.2", 1);
+
+    bool threw = false;
+
+    try
+    {
+        NumcyCpu::features();
+    }
+    catch (const std::runtime_error&)
+    {
+        threw = true;
+    }
+
+    CHECK(threw);
+
+    setenv("NUMCY_ISA", "scalar", 1);
+
+    CHECK(NumcyCpu::isa() == numcy::Isa::Scalar);
+    CHECK(!NumcyCpu::features().avx2 && !NumcyCpu::features().avx512 && !NumcyCpu::features().f16c);
+
+    uint64_t state = 5;
+
+    Collective<float> a = NumcyTest::filled<float>({17, 33}, [&](size_t) { return float(NumcyTest::uniform(state)); });
+    Collective<float> b = NumcyTest::filled<float>({33, 9}, [&](size_t) { return float(NumcyTest::uniform(state)); });
+    Collective<float> c = Numcy::matmul(a, b);
+
+    bool same = true;
+
+    for (size_t i = 0; i < 17; i++)
+    {
+        for (size_t j = 0; j < 9; j++)
+        {
+            double exact = 0.0;
+
+            for (size_t p = 0; p < 33; p++)
+            {
+                exact = exact + double(a[i * 33 + p]) * double(b[p * 9 + j]);
+            }
+
+            same = same && NumcyTest::close(double(c[i * 9 + j]), exact, 1e-5);
+        }
+    }
+
+    CHECK(same);
+
+    std::vector<float> wide = {1.0f, -2.5f, 0.15625f, 65504.0f};
+    std::vector<numcy::bfloat16> narrow(wide.size());
+    std::vector<numcy::float16> half(wide.size());
+    std::vector<float> back(wide.size());
+
+    NumcyHalf::convert(wide.data(), narrow.data(), wide.size());
+    NumcyHalf::convert(narrow.data(), back.data(), wide.size());
+
+    CHECK(back[0] == 1.0f && back[1] == -2.5f && back[2] == 0.15625f);
+
+    NumcyHalf::convert(wide.data(), half.data(), wide.size());
+    NumcyHalf::convert(half.data(), back.data(), wide.size());
+
+    CHECK(back == wide);
+
+    // Everything that ran was the portable variant
+    std::vector<std::pair<std::string, std::string>> entries = NumcyCpu::Registry::global().entries();
+    bool portable = !entries.empty();
+
+    for (const std::pair<std::string, std::string>& entry : entries)
+    {
+        portable = portable && entry.second == "portable";
+    }
+
+    CHECK(portable);
+
+    return NumcyTest::result("cpu");
+}
@@ -0,0 +1,132 @@
+/*
+ * Numcy/tests/csv.cpp
+ *
+ * Numcy::from_csv() on what CSV and TSV files look like in practice: a header line, CRLF line
+ * ends, blank lines, no newline at the end, empty and signed fields, a file large enough to be cut
+ * into several pieces, and ragged or non-numeric rows that must throw. The files are written next
+ * to the test programs and removed again.
+ *
+ * Q@hackers.pk
+ */
+
+#include "./Test.hh"
+
+#include <cstdio>
+#include <fstream>
+
+const std::string path = "tests/csv_tmp.csv";
+
+void write(const std::string& text)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+
+    file.write(text.data(), std::streamsize(text.size()));
+}
+
+template <typename T>
+bool holds(const Collective<T>& c, size_t rows, size_t columns, const std::vector<T>& values)
+{
+    bool same = c.getShape().toVector() == (std::vector<size_t>{rows, columns});
+
+    for (size_t i = 0; same && i < values.size(); i++)
+    {
+        same = c[i] == values[i];
+    }
+
+    return same;
+}
+
+/*
+    from_csv() on text throws, and says which data row
+ */
+bool refused(const std::string& text, const std::string& row)
+{
+    write(text);
+
+    try
+    {
+        Numcy::from_csv<double>(path);
+    }
+    catch (const std::runtime_error& e)
+    {
+        return std::string(e.what()).find("data row " + row + " ") != std::string::npos;
+    }
+
+    return false;
+}
+
+int main(void)
+{
+    // Header, CRLF, a blank line, no newline at the end
+    write("x,y,z\r\n1,2.5,-3\r\n\r\n+4, 5 ,6e2\r\n7,8,9");
+
+    CHECK(holds(Numcy::from_csv<double>(path), 3, 3, {1.0, 2.5, -3.0, 4.0, 5.0, 600.0, 7.0, 8.0, 9.0}));
+
+    // No header, the first line is data
+    write("1,2\n3,4\n");
+
+    CHECK(holds(Numcy::from_csv<int32_t>(path), 2, 2, {1, 2, 3, 4}));
+
+    // Tabs found on their own, quoted header names
+    write("\"a\"\t\"b\"\r\n0.5\t-1\r\n2\t3\r\n");
+
+    CHECK(holds(Numcy::from_csv<float>(path), 2, 2, {0.5f, -1.0f, 2.0f, 3.0f}));
+
+    // An empty field of a floating point column is NaN
+    write("1,,3\n");
+
+    Collective<double> gap = Numcy::from_csv<double>(path);
+
+    CHECK(gap[0] == 1.0 && std::isnan(gap[1]) && gap[2] == 3.0);
+
+    // Ragged rows and fields that are not numbers, with the data row they are on
+    CHECK(refused("a,b,c\n1,2,3\n4,5\n6,7,8\n", "2"));
+    CHECK(refused("1,2,3\r\n4,5,6\r\n7,8,9,10\r\n", "3"));
+    CHECK(refused("1,2,3\n4,x,6\n", "2"));
+
+    // Header only
+    write("a,b,c\r\n");
+
+    bool threw = false;
+
+    try
+    {
+        Numcy::from_csv<double>(path);
+    }
+    catch (const std::runtime_error&)
+    {
+        threw = true;
+    }
+
+    CHECK(threw);
+
+    // Large enough to be cut into several pieces, every row in its place
+    const size_t rows = 20000, columns = 5;
+    std::string text = "c0,c1,c2,c3,c4\r\n";
+
+    for (size_t r = 0; r < rows; r++)
+    {
+        for (size_t c = 0; c < columns; c++)
+        {
+            text += std::to_string(r * columns + c) + (c + 1 < columns ? "," : "\r\n");
+        }
+
+        text += r % 1000 == 999 ? "\r\n" : "";
+    }
+
+    write(text);
+
+    Collective<int64_t> big = Numcy::from_csv<int64_t>(path);
+    bool in_place = big.getShape().toVector() == (std::vector<size_t>{rows, columns});
+
+    for (size_t i = 0; in_place && i < rows * columns; i++)
+    {
+        in_place = big[i] == int64_t(i);
+    }
+
+    CHECK(in_place);
+
+    std::remove(path.c_str());
+
+    return NumcyTest::result("csv");
+}
@@ -0,0 +1,93 @@
+/*
+ * Numcy/tests/dimensions_cache.cpp
+ *
+ * Interned shapes: two fromVector() of one shape share one chain and add one entry to the table,
+ * append() on an interned shape gives that Dimensions a chain of its own and leaves the shared
+ * one as it was, interned and not interned shapes compare by value, NUMCY_SHAPE_CACHE=0 interns
+ * nothing, and a full table stops interning new shapes. Every element type has a table of its
+ * own, each is set up through the environment before its first use.
+ *
+ * Q@hackers.pk
+ */
+
+#include "./Test.hh"
+
+#include <cstdlib>
+
+template <typename T>
+Dimensions<T> make(const std::vector<T>& axes)
+{
+    Dimensions<T> d;
+
+    d.fromVector(axes);
+
+    return d;
+}
+
+int main(void)
+{
+    // size_t, the default capacity
+    setenv("NUMCY_SHAPE_CACHE", "4096", 1);
+
+    DimensionsCache<size_t>& cache = DimensionsCache<size_t>::global();
+    size_t before = cache.size();
+
+    Dimensions<size_t> a = make<size_t>({7, 11, 13});
+
+    CHECK(cache.size() == before + 1);
+
+    Dimensions<size_t> b = make<size_t>({7, 11, 13});
+
+    // One entry, one chain: two interned shapes are only equal when they share their head
+    CHECK(cache.size() == before + 1);
+    CHECK(a.isInterned() && b.isInterned() && a == b);
+    CHECK(make<size_t>({7, 11, 14}) != a);
+
+    // append() copies the shared chain first, a, b and the table keep the shape they had
+    Dimensions<size_t> grown = b;
+
+    grown.append(5, 3);
+
+    CHECK(!grown.isInterned());
+    CHECK(grown.toVector() != a.toVector() && grown != a);
+    CHECK(a.toVector() == (std::vector<size_t>{7, 11, 13}) && b.toVector() == a.toVector());
+    CHECK(a == b && make<size_t>({7, 11, 13}) == a);
+    CHECK(make<size_t>(grown.toVector()) == grown && grown == make<size_t>(grown.toVector()));
+
+    // Interned against built by hand, both ways round
+    Dimensions<size_t> by_hand(13, 11);
+
+    CHECK(!by_hand.isInterned());
+    CHECK(by_hand == make<size_t>({11, 13}) && make<size_t>({11, 13}) == by_hand);
+    CHECK(by_hand != make<size_t>({13, 11}) && make<size_t>({11, 12}) != by_hand);
+
+    // NUMCY_SHAPE_CACHE=0, nothing is interned and shapes still compare by value
+    setenv("NUMCY_SHAPE_CACHE", "0", 1);
+
+    Dimensions<uint32_t> c = make<uint32_t>({2, 3, 4}), d = make<uint32_t>({2, 3, 4});
+
+    CHECK(DimensionsCache<uint32_t>::global().size() == 0);
+    CHECK(!c.isInterned() && !d.isInterned());
+    CHECK(c == d && c != make<uint32_t>({2, 3, 5}));
+
+    // A table of three, full after three shapes, a fourth is built as before
+    setenv("NUMCY_SHAPE_CACHE", "3", 1);
+
+    typedef unsigned long long Wide;
+
+    Dimensions<Wide> first = make<Wide>({1, 2}), second = make<Wide>({3, 4}), third = make<Wide>({5, 6, 7});
+    Dimensions<Wide> fourth = make<Wide>({8, 9}), again = make<Wide>({8, 9});
+
+    CHECK(DimensionsCache<Wide>::global().size() == 3);
+    CHECK(first.isInterned() && second.isInterned() && third.isInterned());
+    CHECK(!fourth.isInterned() && !again.isInterned());
+    CHECK(fourth == again && fourth.toVector() == (std::vector<Wide>{8, 9}));
+
+    // The shapes already in it are still shared
+    Dimensions<Wide> shared = make<Wide>({5, 6, 7});
+
+    CHECK(shared.isInterned() && shared == third);
+    CHECK(DimensionsCache<Wide>::global().size() == 3);
+
+    return NumcyTest::result("dimensions_cache");
+}
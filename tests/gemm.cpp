@@ -0,0 +1,78 @@
+/*
+ * Numcy/tests/gemm.cpp
+ *
+ * Numcy::matmul() against a naive triple loop in double, float and double, over shapes that
+ * are smaller than a micro-kernel, not a multiple of any block, and larger than the cache blocks.
+ *
+ * Q@hackers.pk
+ */
+
+#include "./Test.hh"
+
+template <typename T>
+void check_matmul(const std::vector<size_t>& a_axes, size_t n, double tolerance)
+{
+    uint64_t state = a_axes.back() * 131 + n;
+    size_t k = a_axes.back();
+
+    Collective<T> a = NumcyTest::filled<T>(a_axes, [&](size_t) { return T(NumcyTest::uniform(state)); });
+    Collective<T> b = NumcyTest::filled<T>({k, n}, [&](size_t) { return T(NumcyTest::uniform(state)); });
+    Collective<T> c = Numcy::matmul(a, b);
+
+    size_t m = a.getShape().getNumberOfRows();
+    std::vector<size_t> c_axes = a_axes;
+    c_axes.back() = n;
+
+    CHECK(c.getShape().toVector() == c_axes);
+
+    bool same = true;
+
+    for (size_t i = 0; i < m; i++)
+    {
+        for (size_t j = 0; j < n; j++)
+        {
+            double exact = 0.0;
+
+            for (size_t p = 0; p < k; p++)
+            {
+                exact = exact + double(a[i * k + p]) * double(b[p * n + j]);
+            }
+
+            // Every product is below 1, the error grows with k
+            same = same && std::fabs(double(c[i * n + j]) - exact) <= tolerance * double(k);
+        }
+    }
+
+    CHECK(same);
+}
+
+int main(void)
+{
+    const std::vector<std::vector<size_t>> shapes = {{1, 1}, {1, 7}, {3, 5}, {17, 33}, {64, 64}, {129, 100}, {300, 513}, {2, 3, 19}};
+    const size_t columns[] = {1, 7, 65, 257};
+
+    for (size_t s = 0; s < shapes.size(); s++)
+    {
+        for (size_t n : columns)
+        {
+            check_matmul<float>(shapes[s], n, 1e-6);
+            check_matmul<double>(shapes[s], n, 1e-14);
+        }
+    }
+
+    // Inner dimensions that do not match
+    bool threw = false;
+
+    try
+    {
+        Numcy::matmul(NumcyTest::filled<double>({2, 3}, [](size_t) { return 1.0; }), NumcyTest::filled<double>({4, 2}, [](size_t) { return 1.0; }));
+    }
+    catch (const std::runtime_error&)
+    {
+        threw = true;
+    }
+
+    CHECK(threw);
+
+    return NumcyTest::result("gemm");
+}
@@ -0,0 +1,79 @@
+/*
+ * Numcy/tests/gemm_flags.cpp
+ *
+ * Numcy::matmul(a, b, transA, transB, alpha, beta, out) against a naive loop, every combination
+ * of the transpose flags, an out allocated by the call and one accumulated into in place.
+ *
+ * Q@hackers.pk
+ */
+
+#include "./Test.hh"
+
+void check_flags(bool trans_a, bool trans_b, size_t m, size_t n, size_t k)
+{
+    uint64_t state = m * 1000 + n * 10 + k;
+
+    // The buffers as stored, op() transposes them
+    Collective<double> a = NumcyTest::filled<double>(trans_a ? std::vector<size_t>{k, m} : std::vector<size_t>{m, k}, [&](size_t) { return NumcyTest::uniform(state); });
+    Collective<double> b = NumcyTest::filled<double>(trans_b ? std::vector<size_t>{n, k} : std::vector<size_t>{k, n}, [&](size_t) { return NumcyTest::uniform(state); });
+    Collective<double> c0 = NumcyTest::filled<double>({m, n}, [&](size_t) { return NumcyTest::uniform(state); });
+
+    auto at = [&](size_t i, size_t p) { return trans_a ? a[p * m + i] : a[i * k + p]; };
+    auto bt = [&](size_t p, size_t j) { return trans_b ? b[j * k + p] : b[p * n + j]; };
+
+    Collective<double> fresh;
+    Collective<double> accumulated = NumcyTest::filled<double>({m, n}, [&](size_t i) { return c0[i]; });
+
+    Numcy::matmul(a, b, trans_a, trans_b, 2.0, 0.0, fresh);
+    Numcy::matmul(a, b, trans_a, trans_b, -0.5, 1.5, accumulated);
+
+    CHECK(fresh.getShape().toVector() == (std::vector<size_t>{m, n}));
+
+    bool same = true;
+
+    for (size_t i = 0; i < m; i++)
+    {
+        for (size_t j = 0; j < n; j++)
+        {
+            double product = 0.0;
+
+            for (size_t p = 0; p < k; p++)
+            {
+                product = product + at(i, p) * bt(p, j);
+            }
+
+            same = same && NumcyTest::close(fresh[i * n + j], 2.0 * product, 1e-12 * double(k));
+            same = same && NumcyTest::close(accumulated[i * n + j], -0.5 * product + 1.5 * c0[i * n + j], 1e-12 * double(k));
+        }
+    }
+
+    CHECK(same);
+}
+
+int main(void)
+{
+    for (int flags = 0; flags < 4; flags++)
+    {
+        check_flags((flags & 1) != 0, (flags & 2) != 0, 37, 29, 71);
+        check_flags((flags & 1) != 0, (flags & 2) != 0, 1, 130, 9);
+    }
+
+    // beta without an out to accumulate into
+    bool threw = false;
+
+    try
+    {
+        Collective<double> empty;
+        Collective<double> a = NumcyTest::filled<double>({2, 2}, [](size_t) { return 1.0; });
+
+        Numcy::matmul(a, a, false, false, 1.0, 1.0, empty);
+    }
+    catch (const std::runtime_error&)
+    {
+        threw = true;
+    }
+
+    CHECK(threw);
+
+    return NumcyTest::result("gemm_flags");
+}
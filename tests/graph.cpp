@@ -0,0 +1,177 @@
+/*
+ * Numcy/tests/graph.cpp
+ *
+ * NumcyLazy::Graph against the eager ops: a dense layer and a softmax, a fused chain ending in a
+ * reduction, dead values, broadcast operands, memory planning over a chain of matmuls, run()
+ * again after the inputs have been written to, and a copy-on-write input that run() leaves shared.
+ *
+ * Q@hackers.pk
+ */
+
+#include "./Test.hh"
+
+/*
+    softmax(relu(x * w + b)) over the last axis, eager
+ */
+Collective<double> layer(const Collective<double>& x, const Collective<double>& w, const Collective<double>& b)
+{
+    Collective<double> h = Numcy::matmul(x, w);
+    size_t rows = h.getShape().getNumberOfRows(), columns = h.getShape().getNumberOfColumns();
+
+    for (size_t r = 0; r < rows; r++)
+    {
+        double top = -std::numeric_limits<double>::infinity(), total = 0.0;
+
+        for (size_t c = 0; c < columns; c++)
+        {
+            h[r * columns + c] = std::max(0.0, h[r * columns + c] + b[c]);
+            top = std::max(top, h[r * columns + c]);
+        }
+
+        for (size_t c = 0; c < columns; c++)
+        {
+            h[r * columns + c] = std::exp(h[r * columns + c] - top);
+            total = total + h[r * columns + c];
+        }
+
+        for (size_t c = 0; c < columns; c++)
+        {
+            h[r * columns + c] = h[r * columns + c] / total;
+        }
+    }
+
+    return h;
+}
+
+const double* address(const Collective<double>& c)
+{
+    return c.getData();
+}
+
+bool close_to(const Collective<double>& x, const Collective<double>& y, double tolerance)
+{
+    bool same = x.getShape().toVector() == y.getShape().toVector();
+
+    for (size_t i = 0; same && i < x.getShape().numel(); i++)
+    {
+        same = NumcyTest::close(x[i], y[i], tolerance);
+    }
+
+    return same;
+}
+
+int main(void)
+{
+    uint64_t state = 7;
+
+    // 300 columns, more than one tile of a fused loop
+    Collective<double> x = NumcyTest::filled<double>({64, 300}, [&](size_t) { return NumcyTest::uniform(state); });
+    Collective<double> w = NumcyTest::filled<double>({300, 300}, [&](size_t) { return NumcyTest::uniform(state); });
+    Collective<double> b = NumcyTest::filled<double>({1, 300}, [&](size_t) { return NumcyTest::uniform(state); });
+
+    // matmul, relu(add), max, exp(sub), sum, div: six loops, add and sub are never stored
+    NumcyLazy::Graph<double> g;
+    size_t xi = g.input(x), wi = g.input(w), bi = g.input(b);
+    size_t h = g.relu(g.add(g.matmul(xi, wi), bi));
+    size_t p = g.exp(g.sub(h, g.max(h)));
+    size_t out = g.div(p, g.sum(p));
+
+    g.log(g.scale(h, 2.0)); // Dead, no output depends on it
+
+    NumcyLazy::Program<double> program = g.compile({out});
+
+    CHECK(program.getNumberOfKernels() == 6);
+    CHECK(program.getPlannedBytes() <= program.getUnplannedBytes());
+    CHECK(close_to(program.run()[0], layer(x, w, b), 1e-12));
+
+    // The same program after the inputs were written to reads their new values
+    for (size_t i = 0; i < 300; i++)
+    {
+        x[i] = -x[i];
+        b[i] = 2.0 * b[i];
+    }
+
+    CHECK(close_to(program.run()[0], layer(x, w, b), 1e-12));
+
+    // sum(relu(x * 0.5 + 0.25) - s), a single loop, one read of x and one write of the row sums
+    Collective<double> s = NumcyTest::filled<double>({1, 1}, [](size_t) { return 0.125; });
+
+    NumcyLazy::Graph<double> chain;
+    size_t total = chain.sum(chain.sub(chain.relu(chain.shift(chain.scale(chain.input(x), 0.5), 0.25)), chain.input(s)));
+    NumcyLazy::Program<double> fused = chain.compile({total});
+
+    CHECK(fused.getNumberOfKernels() == 1);
+    CHECK(fused.getPlannedBytes() == 0);
+
+    Collective<double> sums = fused.run()[0];
+    bool summed = sums.getShape().toVector() == (std::vector<size_t>{64, 1});
+
+    for (size_t r = 0; summed && r < 64; r++)
+    {
+        double exact = 0.0;
+
+        for (size_t c = 0; c < 300; c++)
+        {
+            exact = exact + std::max(0.0, x[r * 300 + c] * 0.5 + 0.25) - 0.125;
+        }
+
+        summed = NumcyTest::close(sums[r], exact, 1e-12);
+    }
+
+    CHECK(summed);
+
+    // An output that also feeds another value is stored, not fused, and both come back
+    NumcyLazy::Graph<double> shared;
+    size_t e = shared.exp(shared.input(b));
+    std::vector<Collective<double>> both = shared.evaluate({e, shared.mean(e)});
+    double mean = 0.0;
+
+    for (size_t c = 0; c < 300; c++)
+    {
+        mean = mean + std::exp(b[c]) / 300.0;
+    }
+
+    CHECK(NumcyTest::close(both[0][17], std::exp(b[17]), 1e-15) && NumcyTest::close(both[1][0], mean, 1e-12));
+
+    // Four matmuls in a row, three intermediates but only two alive at any time
+    NumcyLazy::Graph<double> layers;
+    size_t y = layers.input(x);
+
+    for (size_t i = 0; i < 4; i++)
+    {
+        y = layers.matmul(y, layers.input(w));
+    }
+
+    NumcyLazy::Program<double> planned = layers.compile({y});
+
+    CHECK(planned.getNumberOfKernels() == 4);
+    CHECK(planned.getPlannedBytes() == 2 * 64 * 300 * sizeof(double));
+    CHECK(planned.getUnplannedBytes() == 3 * 64 * 300 * sizeof(double));
+    CHECK(close_to(planned.run()[0], Numcy::matmul(Numcy::matmul(Numcy::matmul(Numcy::matmul(x, w), w), w), w), 1e-12));
+
+    // A copy-on-write input: run() reads it without detaching it, the graph keeps the values
+    // input() saw, and a write through the caller's handle detaches only the caller's
+    Collective<double> v = NumcyTest::filled<double>({1, 4}, [](size_t i) { return double(i + 1); });
+
+    v.setCopyOnWrite(true);
+
+    const double* captured = address(v);
+
+    NumcyLazy::Graph<double> cow;
+    size_t vi = cow.input(v);
+    NumcyLazy::Program<double> reads = cow.compile({vi, cow.sum(vi)});
+
+    std::vector<Collective<double>> first = reads.run(), second = reads.run();
+
+    CHECK(first[1][0] == 10.0 && second[1][0] == 10.0);
+    CHECK(address(first[0]) == captured && address(second[0]) == captured && address(v) == captured);
+
+    v[0] = 31.0;
+
+    std::vector<Collective<double>> third = reads.run();
+
+    CHECK(address(v) != captured && v[0] == 31.0);
+    CHECK(third[1][0] == 10.0 && address(third[0]) == captured && third[0][0] == 1.0);
+
+    return NumcyTest::result("graph");
+}
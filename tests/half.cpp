@@ -0,0 +1,147 @@
+/*
+ * Numcy/tests/half.cpp
+ *
+ * bfloat16 and float16 conversions: round to nearest even, subnormals, signed zero, infinity,
+ * NaN and overflow to infinity, every float16 through a round trip, and the vectorized variants
+ * convert() picks on this machine (F16C, AVX2, AVX512-BF16) against the portable ones.
+ *
+ * Q@hackers.pk
+ */
+
+#include "./Test.hh"
+
+bool is_nan16(uint16_t bits)
+{
+    return (bits & 0x7C00U) == 0x7C00U && (bits & 0x03FFU) != 0;
+}
+
+bool is_nan_bf16(uint16_t bits)
+{
+    return (bits & 0x7F80U) == 0x7F80U && (bits & 0x007FU) != 0;
+}
+
+/*
+    Bit for bit, any NaN equal to any other NaN
+ */
+template <typename H>
+bool same(const std::vector<H>& x, const std::vector<H>& y, bool (*nan)(uint16_t))
+{
+    bool equal = x.size() == y.size();
+
+    for (size_t i = 0; equal && i < x.size(); i++)
+    {
+        equal = x[i].bits == y[i].bits || (nan(x[i].bits) && nan(y[i].bits));
+    }
+
+    return equal;
+}
+
+bool same(const std::vector<float>& x, const std::vector<float>& y)
+{
+    bool equal = x.size() == y.size();
+
+    for (size_t i = 0; equal && i < x.size(); i++)
+    {
+        equal = NumcyHalf::bitsOf(x[i]) == NumcyHalf::bitsOf(y[i]) || (std::isnan(x[i]) && std::isnan(y[i]));
+    }
+
+    return equal;
+}
+
+int main(void)
+{
+    using NumcyHalf::floatOf;
+    using NumcyHalf::toBFloat16;
+    using NumcyHalf::toFloat16;
+
+    const float infinity = std::numeric_limits<float>::infinity();
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+
+    // float16, ties to even, the largest finite value, overflow, subnormals and what is below them
+    CHECK(toFloat16(1.0f) == 0x3C00U && toFloat16(-2.0f) == 0xC000U);
+    CHECK(toFloat16(1.0f + std::ldexp(1.0f, -11)) == 0x3C00U);        // Halfway, down to the even 1.0
+    CHECK(toFloat16(1.0f + 3.0f * std::ldexp(1.0f, -11)) == 0x3C02U); // Halfway, up to the even one
+    CHECK(toFloat16(1.0f + std::ldexp(1.0f, -11) + std::ldexp(1.0f, -20)) == 0x3C01U);
+    CHECK(toFloat16(65504.0f) == 0x7BFFU);
+    CHECK(toFloat16(65519.0f) == 0x7BFFU && toFloat16(65520.0f) == 0x7C00U && toFloat16(-1e6f) == 0xFC00U);
+    CHECK(toFloat16(std::ldexp(1.0f, -14)) == 0x0400U);               // Smallest normal
+    CHECK(toFloat16(std::ldexp(1.0f, -24)) == 0x0001U);               // Smallest subnormal
+    CHECK(toFloat16(std::ldexp(1.0f, -25)) == 0x0000U);               // Halfway to it, down to even 0
+    CHECK(toFloat16(std::ldexp(1.5f, -25)) == 0x0001U);
+    CHECK(toFloat16(std::ldexp(3.0f, -25)) == 0x0002U);               // 1.5 ulp, up to the even 2
+    CHECK(toFloat16(-std::ldexp(1.0f, -30)) == 0x8000U && toFloat16(-0.0f) == 0x8000U);
+    CHECK(toFloat16(infinity) == 0x7C00U && toFloat16(-infinity) == 0xFC00U && is_nan16(toFloat16(nan)));
+
+    // bfloat16, the same cases
+    CHECK(toBFloat16(1.0f) == 0x3F80U && toBFloat16(-2.0f) == 0xC000U);
+    CHECK(toBFloat16(1.0f + std::ldexp(1.0f, -8)) == 0x3F80U);
+    CHECK(toBFloat16(1.0f + 3.0f * std::ldexp(1.0f, -8)) == 0x3F82U);
+    CHECK(toBFloat16(std::numeric_limits<float>::max()) == 0x7F80U);  // Rounds up past the largest bfloat16
+    CHECK(toBFloat16(floatOf(0x00010000U)) == 0x0001U);               // A float subnormal stays one
+    CHECK(toBFloat16(floatOf(0x00008000U)) == 0x0000U && toBFloat16(floatOf(0x00018000U)) == 0x0002U);
+    CHECK(toBFloat16(-0.0f) == 0x8000U && toBFloat16(-infinity) == 0xFF80U);
+    CHECK(is_nan_bf16(toBFloat16(nan)) && is_nan_bf16(toBFloat16(floatOf(0x7F800001U)))); // A NaN whose payload would round away
+
+    // Every float16 widens exactly and narrows back to itself
+    bool round_trip = true;
+
+    for (uint32_t bits = 0; bits < 0x10000U; bits++)
+    {
+        uint16_t h = static_cast<uint16_t>(bits);
+        uint32_t exponent = (bits >> 10) & 0x1FU, mantissa = bits & 0x3FFU;
+        float value = NumcyHalf::fromFloat16(h);
+        float exact = exponent == 0 ? std::ldexp(float(mantissa), -24) : std::ldexp(float(mantissa | 0x400U), int(exponent) - 25);
+
+        exact = (bits & 0x8000U) != 0 ? -exact : exact;
+
+        if (exponent == 0x1F)
+        {
+            round_trip = round_trip && (mantissa == 0 ? value == ((bits & 0x8000U) != 0 ? -infinity : infinity) : std::isnan(value));
+            round_trip = round_trip && (mantissa == 0 ? toFloat16(value) == h : is_nan16(toFloat16(value)));
+        }
+        else
+        {
+            round_trip = round_trip && value == exact && std::signbit(value) == ((bits & 0x8000U) != 0) && toFloat16(value) == h;
+        }
+    }
+
+    CHECK(round_trip);
+
+    // The variants convert() picks against the portable ones, on a sweep of float bit patterns
+    std::vector<float> in;
+
+    for (uint64_t bits = 0; bits < (uint64_t(1) << 32); bits += 65521)
+    {
+        in.push_back(floatOf(static_cast<uint32_t>(bits)));
+    }
+
+    for (float special : {0.0f, -0.0f, infinity, -infinity, nan, 65504.0f, 65520.0f, std::ldexp(1.0f, -25), std::numeric_limits<float>::max(), std::numeric_limits<float>::denorm_min()})
+    {
+        in.push_back(special);
+    }
+
+    std::vector<numcy::float16> f16(in.size()), f16_portable(in.size());
+    std::vector<numcy::bfloat16> bf16(in.size()), bf16_portable(in.size());
+
+    NumcyHalf::convert(in.data(), f16.data(), in.size());
+    NumcyHalf::convert_portable(in.data(), f16_portable.data(), in.size());
+    NumcyHalf::convert(in.data(), bf16.data(), in.size());
+    NumcyHalf::convert_portable(in.data(), bf16_portable.data(), in.size());
+
+    CHECK(same(f16, f16_portable, is_nan16));
+    CHECK(same(bf16, bf16_portable, is_nan_bf16));
+
+    std::vector<float> out(in.size()), out_portable(in.size());
+
+    NumcyHalf::convert(f16.data(), out.data(), in.size());
+    NumcyHalf::convert_portable(f16.data(), out_portable.data(), in.size());
+
+    CHECK(same(out, out_portable));
+
+    NumcyHalf::convert(bf16.data(), out.data(), in.size());
+    NumcyHalf::convert_portable(bf16.data(), out_portable.data(), in.size());
+
+    CHECK(same(out, out_portable));
+
+    return NumcyTest::result("half");
+}
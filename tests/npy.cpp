@@ -0,0 +1,213 @@
+/*
+ * Numcy/tests/npy.cpp
+ *
+ * .npy round trips: save_npy() and load_npy() mapped and copied, files written the way NumPy writes
+ * a Fortran order or a big-endian array (and both), 1-D and 3-D shapes, a descr that does not match
+ * the element type, a .npz of two entries, and .npz archives that are corrupt or cut short. The
+ * files are written next to the test programs and removed again.
+ *
+ * Q@hackers.pk
+ */
+
+#include "./Test.hh"
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+/*
+    A .npy of descr and shape holding the bytes of elements, fortran_order as asked
+ */
+template <typename T>
+void write_npy(const std::string& path, const char* descr, bool fortran_order, const std::vector<size_t>& shape, const std::vector<T>& elements)
+{
+    std::string header = NumcyNpy::makeHeader(descr, shape);
+
+    if (fortran_order)
+    {
+        // "True " is as long as "False", the padding stays right
+        header.replace(header.find("False"), 5, "True ");
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+
+    file.write(header.data(), std::streamsize(header.size()));
+    file.write(static_cast<const char*>(static_cast<const void*>(elements.data())), std::streamsize(elements.size() * sizeof(T)));
+}
+
+/*
+    The elements of c (C order, shape axes) in Fortran order, bytes reversed when big_endian
+ */
+template <typename T>
+std::vector<T> as_stored(const Collective<T>& c, const std::vector<size_t>& axes, bool fortran_order, bool big_endian)
+{
+    size_t numel = c.getShape().numel();
+    std::vector<T> elements(numel);
+
+    for (size_t i = 0; i < numel; i++)
+    {
+        // Index of element i along every axis, C order
+        size_t rest = i, at = 0, stride = 1;
+        std::vector<size_t> index(axes.size());
+
+        for (size_t a = axes.size(); a > 0; a--)
+        {
+            index[a - 1] = rest % axes[a - 1];
+            rest = rest / axes[a - 1];
+        }
+
+        for (size_t a = 0; a < axes.size(); a++)
+        {
+            at = at + index[a] * stride;
+            stride = stride * axes[a];
+        }
+
+        elements[fortran_order ? at : i] = c[i];
+    }
+
+    if (big_endian)
+    {
+        for (size_t i = 0; i < numel; i++)
+        {
+            unsigned char* p = static_cast<unsigned char*>(static_cast<void*>(&elements[i]));
+
+            std::reverse(p, p + sizeof(T));
+        }
+    }
+
+    return elements;
+}
+
+template <typename T>
+bool equal(const Collective<T>& x, const Collective<T>& y)
+{
+    bool same = x.getShape().toVector() == y.getShape().toVector();
+
+    for (size_t i = 0; same && i < x.getShape().numel(); i++)
+    {
+        same = x[i] == y[i];
+    }
+
+    return same;
+}
+
+template <typename T>
+void check_stored(const std::vector<size_t>& axes, const char* descr, bool fortran_order, bool big_endian)
+{
+    const std::string path = "tests/npy_tmp.npy";
+    uint64_t state = axes.size() * 13 + (fortran_order ? 1 : 0) + (big_endian ? 2 : 0);
+
+    Collective<T> c = NumcyTest::filled<T>(axes, [&](size_t) { return T(NumcyTest::uniform(state) * 1000.0); });
+
+    write_npy(path, descr, fortran_order, axes, as_stored(c, axes, fortran_order, big_endian));
+
+    CHECK(equal(Numcy::load_npy<T>(path), c));
+    CHECK(equal(Numcy::load_npy<T>(path, numcy::Mapping::Copy), c));
+
+    std::remove(path.c_str());
+}
+
+int main(void)
+{
+    const std::string path = "tests/npy_tmp.npy";
+    uint64_t state = 3;
+
+    // Written by save_npy(), read back mapped and copied
+    Collective<float> c = NumcyTest::filled<float>({3, 4, 5}, [&](size_t) { return float(NumcyTest::uniform(state)); });
+
+    Numcy::save_npy(path, c);
+
+    CHECK(equal(Numcy::load_npy<float>(path), c));
+    CHECK(equal(Numcy::load_npy<float>(path, numcy::Mapping::CopyOnWrite), c));
+    CHECK(equal(Numcy::load_npy<float>(path, numcy::Mapping::Copy), c));
+
+    // A descr other than the element type's
+    bool threw = false;
+
+    try
+    {
+        Numcy::load_npy<double>(path);
+    }
+    catch (const std::runtime_error&)
+    {
+        threw = true;
+    }
+
+    CHECK(threw);
+
+    std::remove(path.c_str());
+
+    // Fortran order, 2-D larger than a transpose tile and 3-D
+    check_stored<double>({37, 70}, "<f8", true, false);
+    check_stored<float>({3, 4, 5}, "<f4", true, false);
+    check_stored<int32_t>({2, 3, 4, 5}, "<i4", true, false);
+
+    // Big-endian, and big-endian in Fortran order
+    check_stored<double>({6, 9}, ">f8", false, true);
+    check_stored<int32_t>({4, 6}, ">i4", false, true);
+    check_stored<int16_t>({5, 3, 7}, ">i2", true, true);
+
+    // (n,) loads as [1, n]
+    std::vector<double> line = {1.5, -2.0, 3.25};
+
+    write_npy(path, "<f8", false, {3}, line);
+
+    Collective<double> r = Numcy::load_npy<double>(path);
+
+    CHECK(r.getShape().toVector() == (std::vector<size_t>{1, 3}));
+    CHECK(r[0] == 1.5 && r[1] == -2.0 && r[2] == 3.25);
+
+    std::remove(path.c_str());
+
+    // A .npz of two entries
+    const std::string npz = "tests/npy_tmp.npz";
+    Collective<float> w = NumcyTest::filled<float>({4, 3}, [&](size_t) { return float(NumcyTest::uniform(state)); });
+
+    Numcy::savez<float>(npz, {{"c", c}, {"w", w}});
+
+    CHECK(equal(Numcy::load_npz<float>(npz, "w"), w));
+    CHECK(equal(Numcy::load_npz<float>(npz, "c", numcy::Mapping::Copy), c));
+
+    // A central directory entry whose name runs past the end of the archive, and an archive cut short
+    std::string archive;
+
+    {
+        std::ifstream file(npz, std::ios::binary);
+
+        archive.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    const size_t directory = archive.find(std::string("PK\x01\x02", 4));
+    std::string corrupt = archive;
+
+    corrupt[directory + 28] = char(0xFF);
+    corrupt[directory + 29] = char(0xFF);
+
+    const std::vector<std::string> broken = {corrupt, archive.substr(0, archive.size() / 2), archive.substr(0, 40)};
+
+    for (const std::string& bytes : broken)
+    {
+        {
+            std::ofstream file(npz, std::ios::binary | std::ios::trunc);
+
+            file.write(bytes.data(), std::streamsize(bytes.size()));
+        }
+
+        bool refused = false;
+
+        try
+        {
+            Numcy::load_npz<float>(npz, "w");
+        }
+        catch (const std::runtime_error&)
+        {
+            refused = true;
+        }
+
+        CHECK(refused);
+    }
+
+    std::remove(npz.c_str());
+
+    return NumcyTest::result("npy");
+}
@@ -0,0 +1,118 @@
+/*
+ * Numcy/tests/qmatmul.cpp
+ *
+ * Numcy::qmatmul() against float math on the dequantized operands, per row and per tensor, with a
+ * k large enough for the zero point corrections to leave int32, k at the limit it refuses, and
+ * quantize() of a collective without elements.
+ *
+ * Q@hackers.pk
+ */
+
+#include "./Test.hh"
+
+/*
+    Numcy::qmatmul(a, b) against the product of dequantize(a) and dequantize(b)^T in double
+ */
+void check_qmatmul(size_t m, size_t n, size_t k, numcy::Quantization granularity, double offset)
+{
+    uint64_t state = m * 100 + n * 10 + k;
+
+    Collective<float> a = NumcyTest::filled<float>({m, k}, [&](size_t) { return float(NumcyTest::uniform(state) + offset); });
+    Collective<float> b = NumcyTest::filled<float>({n, k}, [&](size_t) { return float(NumcyTest::uniform(state) - offset); });
+
+    NumcyQuant::Quantized<size_t> qa = Numcy::quantize(a, granularity);
+    NumcyQuant::Quantized<size_t> qb = Numcy::quantize(b, granularity);
+
+    Collective<float> da = Numcy::dequantize(qa);
+    Collective<float> db = Numcy::dequantize(qb);
+    Collective<float> c = Numcy::qmatmul(qa, qb);
+
+    CHECK(c.getShape().toVector() == (std::vector<size_t>{m, n}));
+
+    bool same = true;
+
+    for (size_t i = 0; i < m; i++)
+    {
+        for (size_t j = 0; j < n; j++)
+        {
+            double exact = 0.0, magnitude = 0.0;
+
+            for (size_t p = 0; p < k; p++)
+            {
+                exact = exact + double(da[i * k + p]) * double(db[j * k + p]);
+                magnitude = magnitude + std::fabs(double(da[i * k + p]) * double(db[j * k + p]));
+            }
+
+            // The scales are applied in float
+            same = same && std::fabs(double(c[i * n + j]) - exact) <= 1e-5 * magnitude;
+        }
+    }
+
+    CHECK(same);
+}
+
+int main(void)
+{
+    check_qmatmul(7, 9, 300, numcy::Quantization::PerRow, 0.0);
+    check_qmatmul(3, 5, 1000, numcy::Quantization::PerTensor, 0.0);
+
+    // Values far from 0, zero points at the end of their range, k * za * zb alone is about 2^30
+    check_qmatmul(2, 3, 65535, numcy::Quantization::PerRow, 3.0);
+    check_qmatmul(2, 3, 40000, numcy::Quantization::PerTensor, 5.0);
+
+    // All ones, every entry of C is k
+    const size_t k = 40000;
+
+    Collective<float> ones_a = NumcyTest::filled<float>({2, k}, [](size_t) { return 1.0f; });
+    Collective<float> ones_b = NumcyTest::filled<float>({3, k}, [](size_t) { return 1.0f; });
+    Collective<float> c = Numcy::qmatmul(Numcy::quantize(ones_a), Numcy::quantize(ones_b));
+
+    bool counted = true;
+
+    for (size_t i = 0; i < 6; i++)
+    {
+        counted = counted && NumcyTest::close(double(c[i]), double(k), 1e-6);
+    }
+
+    CHECK(counted);
+
+    // k = 2^16 could overflow the int32 dot products
+    bool threw = false;
+
+    try
+    {
+        Collective<float> wide = NumcyTest::filled<float>({1, size_t(1) << 16}, [](size_t) { return 1.0f; });
+
+        Numcy::qmatmul(Numcy::quantize(wide), Numcy::quantize(wide));
+    }
+    catch (const std::runtime_error&)
+    {
+        threw = true;
+    }
+
+    CHECK(threw);
+
+    // Nothing to take a range of, no columns or no rows
+    for (int per_row = 0; per_row < 2; per_row++)
+    {
+        numcy::Quantization granularity = per_row != 0 ? numcy::Quantization::PerRow : numcy::Quantization::PerTensor;
+        bool refused = true;
+
+        for (Dimensions<size_t> empty : {Dimensions<size_t>(0, 4), Dimensions<size_t>(4, 0)})
+        {
+            try
+            {
+                Numcy::quantize(Collective<double>(empty), granularity);
+
+                refused = false;
+            }
+            catch (const std::runtime_error&)
+            {
+            }
+        }
+
+        CHECK(refused);
+    }
+
+    return NumcyTest::result("qmatmul");
+}
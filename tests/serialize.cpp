@@ -0,0 +1,156 @@
+/*
+ * Numcy/tests/serialize.cpp
+ *
+ * Numcy::save() and Numcy::load() round trips mapped read-only, copy-on-write and copied, with and
+ * without a page alignment of its own, and the files load() must refuse: another element type, a
+ * shape that does not match the payload, a file cut short, a flipped payload byte when verifying.
+ * The files are written next to the test programs and removed again.
+ *
+ * Q@hackers.pk
+ */
+
+#include "./Test.hh"
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+const std::string path = "tests/serialize_tmp.ncy";
+
+template <typename T>
+bool equal(const Collective<T>& x, const Collective<T>& y)
+{
+    bool same = x.getShape().toVector() == y.getShape().toVector();
+
+    for (size_t i = 0; same && i < x.getShape().numel(); i++)
+    {
+        same = x[i] == y[i];
+    }
+
+    return same;
+}
+
+template <typename F>
+bool throws(F f)
+{
+    try
+    {
+        f();
+    }
+    catch (const std::runtime_error&)
+    {
+        return true;
+    }
+
+    return false;
+}
+
+std::string read(void)
+{
+    std::ifstream file(path, std::ios::binary);
+
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+void write(const std::string& bytes)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+
+    file.write(bytes.data(), std::streamsize(bytes.size()));
+}
+
+int main(void)
+{
+    uint64_t state = 7;
+
+    Collective<double> c = NumcyTest::filled<double>({3, 50, 70}, [&](size_t) { return NumcyTest::uniform(state); });
+    Collective<int32_t> ids = NumcyTest::filled<int32_t>({9, 4}, [](size_t i) { return int32_t(i) * 7919 - 100000; });
+
+    // Mapped, copy-on-write and copied, the payload page aligned
+    Numcy::save(path, c);
+
+    CHECK(equal(Numcy::load<double>(path), c));
+    CHECK(equal(Numcy::load<double>(path, numcy::Mapping::Copy, true), c));
+
+    {
+        Collective<double> private_pages = Numcy::load<double>(path, numcy::Mapping::CopyOnWrite);
+
+        private_pages.getData()[0] = 42.0;
+
+        // The write stayed in this process, the file still holds the old element
+        CHECK(private_pages[0] == 42.0);
+        CHECK(equal(Numcy::load<double>(path), c));
+    }
+
+    // A larger alignment, and a type whose payload is not a whole page
+    Numcy::save(path, ids, 65536);
+
+    CHECK(read().size() == 65536 + 9 * 4 * sizeof(int32_t));
+    CHECK(equal(Numcy::load<int32_t>(path), ids));
+    CHECK(equal(Numcy::load<int32_t>(path, numcy::Mapping::Copy, true), ids));
+
+    CHECK(throws([]() { Collective<int32_t> odd(Dimensions<size_t>(2, 2)); Numcy::save(path, odd, 5000); }));
+
+    // Another element type, of the same size and of another
+    CHECK(throws([]() { Numcy::load<float>(path); }));
+    CHECK(throws([]() { Numcy::load<uint32_t>(path); }));
+    CHECK(throws([]() { Numcy::load<double>(path, numcy::Mapping::Copy); }));
+
+    // A shape that does not match the payload, with a header checksum that does
+    Numcy::save(path, c);
+
+    {
+        std::string bytes = read();
+        NumcySerialize::Header header;
+        std::vector<uint64_t> shape(3);
+
+        std::memcpy(&header, bytes.data(), sizeof(header));
+        std::memcpy(shape.data(), bytes.data() + sizeof(header), 3 * sizeof(uint64_t));
+
+        shape[1] = shape[1] + 1;
+        header.header_checksum = 0;
+        header.header_checksum = NumcySerialize::headerChecksum(header, shape);
+
+        std::memcpy(&bytes[0], &header, sizeof(header));
+        std::memcpy(&bytes[sizeof(header)], shape.data(), 3 * sizeof(uint64_t));
+        write(bytes);
+
+        CHECK(throws([]() { Numcy::load<double>(path); }));
+        CHECK(throws([]() { Numcy::load<double>(path, numcy::Mapping::Copy); }));
+
+        // The same shape edit without a new checksum, the header is corrupt
+        shape[1] = shape[1] - 2;
+        std::memcpy(&bytes[sizeof(header)], shape.data(), 3 * sizeof(uint64_t));
+        write(bytes);
+
+        CHECK(throws([]() { Numcy::load<double>(path); }));
+    }
+
+    // Cut short in the payload, in the shape and in the header
+    Numcy::save(path, c);
+
+    std::string whole = read();
+    const size_t cuts[] = {whole.size() - 1, whole.size() / 2, sizeof(NumcySerialize::Header) + 8, 10, 0};
+
+    for (size_t cut : cuts)
+    {
+        write(whole.substr(0, cut));
+
+        CHECK(throws([]() { Numcy::load<double>(path); }));
+        CHECK(throws([]() { Numcy::load<double>(path, numcy::Mapping::Copy); }));
+    }
+
+    // One flipped payload byte, only found when verifying
+    whole[whole.size() - 3] = char(whole[whole.size() - 3] ^ 0x10);
+    write(whole);
+
+    CHECK(!equal(Numcy::load<double>(path), c));
+    CHECK(throws([]() { Numcy::load<double>(path, numcy::Mapping::ReadOnly, true); }));
+    CHECK(throws([]() { Numcy::load<double>(path, numcy::Mapping::Copy, true); }));
+
+    std::remove(path.c_str());
+
+    CHECK(throws([]() { Numcy::load<double>(path); }));
+
+    return NumcyTest::result("serialize");
+}
@@ -0,0 +1,101 @@
+/*
+ * Numcy/tests/similarity.cpp
+ *
+ * Numcy::gemv(), row_norms() and cosine_similarity() (scores and top-k) against naive loops,
+ * and on a table without rows.
+ *
+ * Q@hackers.pk
+ */
+
+#include "./Test.hh"
+
+int main(void)
+{
+    const size_t n = 1000, d = 37, q = 3;
+    uint64_t state = 29;
+
+    Collective<double> table = NumcyTest::filled<double>({n, d}, [&](size_t) { return NumcyTest::uniform(state); });
+    Collective<double> query = NumcyTest::filled<double>({q, d}, [&](size_t) { return NumcyTest::uniform(state); });
+    Collective<double> x = NumcyTest::filled<double>({1, d}, [&](size_t) { return NumcyTest::uniform(state); });
+
+    for (size_t i = 0; i < d; i++)
+    {
+        table[5 * d + i] = 0.0; // A zero row, its score is 0
+    }
+
+    Collective<double> y = Numcy::gemv(table, x);
+    Collective<double> norms = Numcy::row_norms(table);
+    Collective<double> scores = Numcy::cosine_similarity(query, table, norms);
+
+    bool same = true;
+
+    for (size_t j = 0; j < n; j++)
+    {
+        double dot = 0.0, norm = 0.0;
+
+        for (size_t i = 0; i < d; i++)
+        {
+            dot = dot + table[j * d + i] * x[i];
+            norm = norm + table[j * d + i] * table[j * d + i];
+        }
+
+        same = same && NumcyTest::close(y[j], dot, 1e-12) && NumcyTest::close(norms[j], std::sqrt(norm), 1e-12);
+
+        for (size_t r = 0; r < q; r++)
+        {
+            double qdot = 0.0, qnorm = 0.0;
+
+            for (size_t i = 0; i < d; i++)
+            {
+                qdot = qdot + query[r * d + i] * table[j * d + i];
+                qnorm = qnorm + query[r * d + i] * query[r * d + i];
+            }
+
+            double exact = norm == 0.0 ? 0.0 : qdot / (std::sqrt(qnorm) * std::sqrt(norm));
+
+            same = same && NumcyTest::close(scores[r * n + j], exact, 1e-12);
+        }
+    }
+
+    CHECK(same);
+
+    // Top-k scores are the k largest of the full scores, in order
+    Collective<double> values;
+    Collective<size_t> indices;
+
+    Numcy::cosine_similarity(query, table, norms, size_t(10), values, indices);
+
+    bool ranked = true;
+
+    for (size_t r = 0; r < q; r++)
+    {
+        for (size_t j = 0; j < 10; j++)
+        {
+            ranked = ranked && values[r * 10 + j] == scores[r * n + indices[r * 10 + j]];
+            ranked = ranked && (j == 0 || values[r * 10 + j - 1] >= values[r * 10 + j]);
+        }
+
+        size_t above = 0;
+
+        for (size_t j = 0; j < n; j++)
+        {
+            above = above + (scores[r * n + j] > values[r * 10 + 9] ? 1 : 0);
+        }
+
+        ranked = ranked && above <= 9;
+    }
+
+    CHECK(ranked);
+
+    // A table without rows (fromVector() refuses a zero axis, Dimensions(columns, rows) does not)
+    Collective<double> none = Collective<double>(Dimensions<size_t>(d, 0));
+    double out = 0.0;
+
+    NumcyGemm::gemv_host(0, d, 1.0, table.getData(), d, x.getData(), 0.0, &out);
+
+    CHECK(Numcy::gemv(none, x).getShape().numel() == 0);
+    CHECK(Numcy::row_norms(none).getShape().numel() == 0);
+    CHECK(Numcy::cosine_similarity(query, none, Numcy::row_norms(none)).getShape().numel() == 0);
+
+    return NumcyTest::result("similarity");
+}
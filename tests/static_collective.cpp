@@ -0,0 +1,191 @@
+/*
+ * Numcy/tests/static_collective.cpp
+ *
+ * StaticCollective arithmetic against plain loops, on integers so every result is exact, at sizes
+ * below NumcyStatic::UNROLL_LIMIT (unrolled) and above it (looped): the element-wise operators,
+ * matmul(), matvec(), transpose(), dot() and sum(), identity(), and the way to and from a
+ * Collective, which refuses another shape.
+ *
+ * Q@hackers.pk
+ */
+
+#include "./Test.hh"
+
+/*
+    A StaticCollective whose element i is f(i)
+ */
+template <typename S, typename F>
+S make(F f)
+{
+    S s;
+
+    for (size_t i = 0; i < S::numel; i++)
+    {
+        s[i] = f(i);
+    }
+
+    return s;
+}
+
+template <size_t R, size_t C>
+void check_elementwise(void)
+{
+    using S = StaticCollective<int64_t, R, C>;
+
+    const S a = make<S>([](size_t i) { return int64_t(i * 7 % 23) - 11; });
+    const S b = make<S>([](size_t i) { return int64_t(i * 5 % 17) - 8; });
+
+    S sum = a + b, difference = a - b, product = a * b, scaled = a * int64_t(3), left = int64_t(-2) * b;
+    bool same = true;
+
+    for (size_t i = 0; i < S::numel; i++)
+    {
+        same = same && sum[i] == a[i] + b[i] && difference[i] == a[i] - b[i] && product[i] == a[i] * b[i];
+        same = same && scaled[i] == a[i] * 3 && left[i] == -2 * b[i];
+    }
+
+    CHECK(same);
+
+    // The compound forms agree with the binary ones
+    S c = a;
+
+    c += b;
+    CHECK(c == sum);
+    c -= b;
+    CHECK(c == a);
+    c *= b;
+    CHECK(c == product);
+    c = a;
+    c *= int64_t(3);
+    CHECK(c == scaled && c != a);
+
+    // Row major, operator() agrees with operator[]
+    bool indexed = true;
+
+    for (size_t i = 0; i < R; i++)
+    {
+        for (size_t j = 0; j < C; j++)
+        {
+            indexed = indexed && a(i, j) == a[i * C + j];
+        }
+    }
+
+    CHECK(indexed);
+
+    int64_t total = 0;
+
+    for (size_t i = 0; i < S::numel; i++)
+    {
+        total = total + a[i];
+    }
+
+    CHECK(NumcyStatic::sum(a) == total);
+}
+
+template <size_t M, size_t K, size_t N>
+void check_products(void)
+{
+    using A = StaticCollective<int64_t, M, K>;
+    using B = StaticCollective<int64_t, K, N>;
+
+    const A a = make<A>([](size_t i) { return int64_t(i * 13 % 19) - 9; });
+    const B b = make<B>([](size_t i) { return int64_t(i * 11 % 29) - 14; });
+    const StaticCollective<int64_t, K> x = make<StaticCollective<int64_t, K>>([](size_t i) { return int64_t(i % 5) - 2; });
+
+    StaticCollective<int64_t, M, N> c = NumcyStatic::matmul(a, b);
+    StaticCollective<int64_t, M> y = NumcyStatic::matvec(a, x);
+    StaticCollective<int64_t, K, M> t = NumcyStatic::transpose(a);
+
+    bool product = true, vector = true, transposed = true;
+
+    for (size_t i = 0; i < M; i++)
+    {
+        int64_t row = 0;
+
+        for (size_t j = 0; j < N; j++)
+        {
+            int64_t exact = 0;
+
+            for (size_t p = 0; p < K; p++)
+            {
+                exact = exact + a[i * K + p] * b[p * N + j];
+            }
+
+            product = product && c(i, j) == exact;
+        }
+
+        for (size_t p = 0; p < K; p++)
+        {
+            row = row + a[i * K + p] * x[p];
+            transposed = transposed && t(p, i) == a(i, p);
+        }
+
+        vector = vector && y[i] == row;
+    }
+
+    CHECK(product);
+    CHECK(vector);
+    CHECK(transposed);
+
+    // a I = a, I b = b
+    CHECK(NumcyStatic::matmul(a, StaticCollective<int64_t, K, K>::identity()) == a);
+    CHECK(NumcyStatic::matmul(StaticCollective<int64_t, K, K>::identity(), b) == b);
+
+    int64_t exact = 0;
+
+    for (size_t p = 0; p < K; p++)
+    {
+        exact = exact + x[p] * x[p];
+    }
+
+    CHECK(NumcyStatic::dot(x, x) == exact);
+}
+
+int main(void)
+{
+    // Below and above NumcyStatic::UNROLL_LIMIT
+    check_elementwise<3, 4>();
+    check_elementwise<20, 20>();
+
+    check_products<2, 3, 4>();
+    check_products<4, 4, 4>();
+    check_products<9, 10, 11>();
+    check_products<17, 300, 3>();
+
+    // The constructors
+    using Matrix = StaticCollective<double, 2, 3>;
+    using Vector = StaticCollective<double, 6>;
+
+    Matrix zeros, sevens(7.0), some({1.0, 2.0, 3.0});
+
+    CHECK(zeros == Matrix(0.0));
+    CHECK(sevens[5] == 7.0);
+    CHECK(some[2] == 3.0 && some[3] == 0.0 && some[5] == 0.0);
+
+    // To a Collective and back, a vector goes as [1, N]
+    Matrix m = make<Matrix>([](size_t i) { return double(i) + 0.5; });
+    Collective<double> c = m.toCollective();
+
+    CHECK(c.getShape().toVector() == (std::vector<size_t>{2, 3}));
+    CHECK(Matrix(c) == m);
+
+    Vector v = make<Vector>([](size_t i) { return double(i); });
+
+    CHECK(v.toCollective().getShape().toVector() == (std::vector<size_t>{1, 6}));
+    CHECK(Vector(v.toCollective()) == v);
+
+    bool threw = false;
+
+    try
+    {
+        StaticCollective<double, 3, 2> wrong(c);
+    }
+    catch (const std::runtime_error&)
+    {
+        threw = true;
+    }
+
+    CHECK(threw);
+
+    return NumcyTest::result("static_collective");
+}
@@ -0,0 +1,153 @@
+/*
+ * Numcy/tests/stream.cpp
+ *
+ * Numcy::StreamReader over Numcy collective files and .npy files: every batch holds the rows that
+ * follow the previous one, across buffer reuse and for a ring of two, the rows after the last whole
+ * batch are left out, the end of the file stays the end, a looping stream starts over at row 0,
+ * and files too short for one batch are refused. The files are written next to the test programs
+ * and removed again.
+ *
+ * Q@hackers.pk
+ */
+
+#include "./Test.hh"
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+const std::string path = "tests/stream_tmp.ncy";
+const std::string npy = "tests/stream_tmp.npy";
+
+/*
+    Element i of the file is i, a batch of shape axes holds the elements from first on
+ */
+bool holds(const Collective<int32_t>& batch, const std::vector<size_t>& axes, size_t first)
+{
+    bool same = batch.getShape().toVector() == axes;
+
+    for (size_t i = 0; same && i < batch.getShape().numel(); i++)
+    {
+        same = batch[i] == int32_t(first + i);
+    }
+
+    return same;
+}
+
+template <typename F>
+bool throws(F f)
+{
+    try
+    {
+        f();
+    }
+    catch (const std::runtime_error&)
+    {
+        return true;
+    }
+
+    return false;
+}
+
+/*
+    Reads the file at p to its end in batches of rows, every batch in place, and returns how many
+ */
+size_t drain(const std::string& p, size_t rows, size_t depth, const std::vector<size_t>& batch_axes)
+{
+    Numcy::StreamReader<int32_t> stream(p, rows, depth);
+    Collective<int32_t> batch;
+    size_t count = 0;
+    bool in_place = true;
+
+    while (stream.next(batch))
+    {
+        in_place = in_place && holds(batch, batch_axes, count * batch.getShape().numel());
+        count++;
+    }
+
+    CHECK(in_place);
+    CHECK(count == stream.size());
+
+    // The end stays the end
+    CHECK(!stream.next(batch) && !stream.next(batch));
+
+    return count;
+}
+
+int main(void)
+{
+    // 103 rows, batches of 10, the 3 rows of the last partial batch are left out
+    Numcy::save(path, NumcyTest::filled<int32_t>({103, 5}, [](size_t i) { return int32_t(i); }));
+
+    CHECK(drain(path, 10, 3, {10, 5}) == 10);
+    CHECK(drain(path, 10, 2, {10, 5}) == 10);
+    CHECK(drain(path, 1, 2, {1, 5}) == 103);
+    CHECK(drain(path, 103, 2, {103, 5}) == 1);
+
+    // Rows that are a whole number of batches, the last batch is full and then the end
+    Numcy::save(path, NumcyTest::filled<int32_t>({100, 2, 3}, [](size_t i) { return int32_t(i); }));
+
+    CHECK(drain(path, 20, 4, {20, 2, 3}) == 5);
+    CHECK(drain(path, 7, 3, {7, 2, 3}) == 14);
+
+    // A looping stream starts over at row 0 instead of ending
+    {
+        Numcy::StreamReader<int32_t> stream(path, 40, 2, true);
+        Collective<int32_t> batch;
+        bool in_place = true;
+
+        for (size_t k = 0; k < 7; k++)
+        {
+            in_place = in_place && stream.next(batch) && holds(batch, {40, 2, 3}, (k % 2) * 40 * 6);
+        }
+
+        CHECK(in_place);
+        CHECK(stream.size() == 2);
+    }
+
+    // Too few rows for one batch, a ring of one, a batch of no rows, another element type, no file
+    CHECK(throws([]() { Numcy::StreamReader<int32_t> stream(path, 101); }));
+    CHECK(throws([]() { Numcy::StreamReader<int32_t> stream(path, 10, 1); }));
+    CHECK(throws([]() { Numcy::StreamReader<int32_t> stream(path, 0); }));
+    CHECK(throws([]() { Numcy::StreamReader<float> stream(path, 10); }));
+
+    // Cut short, the rows the header promises are not there
+    {
+        std::ifstream in(path, std::ios::binary);
+        std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+        in.close();
+
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+
+        out.write(bytes.data(), std::streamsize(bytes.size() - 12));
+    }
+
+    CHECK(throws([]() { Numcy::StreamReader<int32_t> stream(path, 10); }));
+
+    std::remove(path.c_str());
+
+    CHECK(throws([]() { Numcy::StreamReader<int32_t> stream(path, 10); }));
+
+    // A 1-D .npy is a token stream of [1, rows] batches
+    {
+        std::string header = NumcyNpy::makeHeader("<i4", {1000});
+        std::vector<int32_t> tokens(1000);
+
+        for (size_t i = 0; i < tokens.size(); i++)
+        {
+            tokens[i] = int32_t(i);
+        }
+
+        std::ofstream out(npy, std::ios::binary | std::ios::trunc);
+
+        out.write(header.data(), std::streamsize(header.size()));
+        out.write(static_cast<const char*>(static_cast<const void*>(tokens.data())), std::streamsize(tokens.size() * sizeof(int32_t)));
+    }
+
+    CHECK(drain(npy, 64, 3, {1, 64}) == 15);
+
+    std::remove(npy.c_str());
+
+    return NumcyTest::result("stream");
+}
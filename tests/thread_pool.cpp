@@ -0,0 +1,105 @@
+/*
+ * Numcy/tests/thread_pool.cpp
+ *
+ * A private ThreadPool of four threads: parallel_for() and parallel_for_static() cover their range
+ * exactly once, alone, interleaved and nested, submit()ted jobs all run, and the pool stops cleanly
+ * with pinned and stealable work having gone through every deque.
+ *
+ * Q@hackers.pk
+ */
+
+#include "./Test.hh"
+
+#include <atomic>
+
+int main(void)
+{
+    const size_t n = 100000;
+
+    std::vector<std::atomic<size_t>> hits(n);
+    bool covered = true;
+
+    {
+        NumcyThreads::ThreadPool pool(4);
+
+        for (size_t round = 0; round < 50; round++)
+        {
+            for (size_t i = 0; i < n; i++)
+            {
+                hits[i].store(0);
+            }
+
+            pool.parallel_for_static(0, n, 1000, [&](size_t first, size_t last)
+            {
+                for (size_t i = first; i < last; i++)
+                {
+                    hits[i].fetch_add(1);
+                }
+            });
+
+            pool.parallel_for(0, n, 1000, [&](size_t first, size_t last)
+            {
+                // A nested loop from a worker, its chunks go onto that worker's own deque
+                pool.parallel_for(first, last, 100, [&](size_t inner_first, size_t inner_last)
+                {
+                    for (size_t i = inner_first; i < inner_last; i++)
+                    {
+                        hits[i].fetch_add(1);
+                    }
+                });
+            });
+
+            pool.parallel_for_static(0, n, 1000, [&](size_t first, size_t last)
+            {
+                // Pinned slices that start stealable work
+                pool.parallel_for(first, last, 500, [&](size_t inner_first, size_t inner_last)
+                {
+                    for (size_t i = inner_first; i < inner_last; i++)
+                    {
+                        hits[i].fetch_add(1);
+                    }
+                });
+            });
+
+            for (size_t i = 0; i < n; i++)
+            {
+                covered = covered && hits[i].load() == 3;
+            }
+        }
+
+        std::atomic<size_t> jobs(0);
+
+        for (size_t i = 0; i < 200; i++)
+        {
+            pool.submit([&jobs]() { jobs.fetch_add(1); });
+        }
+
+        while (jobs.load() < 200)
+        {
+            if (!pool.runPendingTask())
+            {
+                std::this_thread::yield();
+            }
+        }
+
+        CHECK(jobs.load() == 200);
+
+        // A body that throws, the caller gets the exception once every chunk is done
+        bool threw = false;
+
+        try
+        {
+            pool.parallel_for(0, n, 1000, [](size_t first, size_t) { if (first == 0) { throw std::runtime_error("first chunk"); } });
+        }
+        catch (const std::runtime_error&)
+        {
+            threw = true;
+        }
+
+        CHECK(threw);
+    }
+
+    CHECK(covered);
+
+    return NumcyTest::result("thread_pool");
+}
@@ -0,0 +1,96 @@
+/*
+ * Numcy/tests/topk.cpp
+ *
+ * Numcy::topk() against a full sort of every line, along the last axis and axis 0, on many
+ * short lines and on one line long enough to be split across the threads, with ties and with
+ * lines that hold more NaN than k leaves room for.
+ *
+ * Q@hackers.pk
+ */
+
+#include "./Test.hh"
+
+#include <algorithm>
+
+/*
+    The k best of a line, NaN below every number, ties to the smaller index
+ */
+std::vector<std::pair<double, size_t>> expected(const std::vector<double>& line, size_t k)
+{
+    std::vector<std::pair<double, size_t>> all;
+
+    for (size_t j = 0; j < line.size(); j++)
+    {
+        all.push_back(std::pair<double, size_t>(line[j], j));
+    }
+
+    std::stable_sort(all.begin(), all.end(), [](const std::pair<double, size_t>& x, const std::pair<double, size_t>& y)
+    {
+        bool x_nan = std::isnan(x.first), y_nan = std::isnan(y.first);
+
+        return x_nan != y_nan ? y_nan : (!x_nan && x.first > y.first);
+    });
+
+    all.resize(k);
+
+    return all;
+}
+
+void check_topk(const std::vector<size_t>& axes, numcy::Axis axis, size_t k, double nan_share)
+{
+    uint64_t state = axes.front() * 31 + k;
+
+    Collective<double> c = NumcyTest::filled<double>(axes, [&](size_t)
+    {
+        double u = NumcyTest::uniform(state);
+
+        // Few distinct values, so there are ties
+        return (u + 1.0) / 2.0 < nan_share ? std::numeric_limits<double>::quiet_NaN() : std::floor(u * 8.0);
+    });
+
+    std::pair<Collective<double>, Collective<size_t>> top = Numcy::topk(c, k, axis);
+
+    size_t rows = axes[0], columns = axes[1];
+    bool last = axis == numcy::Axis::Last;
+    size_t lines = last ? rows : columns, len = last ? columns : rows;
+    bool same = true;
+
+    for (size_t l = 0; l < lines; l++)
+    {
+        std::vector<double> line(len);
+
+        for (size_t j = 0; j < len; j++)
+        {
+            line[j] = last ? c[l * columns + j] : c[j * columns + l];
+        }
+
+        std::vector<std::pair<double, size_t>> best = expected(line, k);
+
+        for (size_t r = 0; r < k; r++)
+        {
+            size_t at = last ? l * k + r : r * columns + l;
+            double value = top.first[at];
+
+            same = same && top.second[at] == best[r].second;
+            same = same && (std::isnan(best[r].first) ? std::isnan(value) : value == best[r].first);
+        }
+    }
+
+    CHECK(same);
+}
+
+int main(void)
+{
+    check_topk({300, 50}, numcy::Axis::Last, 5, 0.0);
+    check_topk({50, 300}, numcy::Axis::Rows, 7, 0.0);
+
+    // NaN heavy, most lines have fewer than k numbers, some none
+    check_topk({300, 50}, numcy::Axis::Last, 10, 0.9);
+    check_topk({40, 30}, numcy::Axis::Rows, 30, 0.5);
+
+    // One long line, split across the threads, nearly all NaN
+    check_topk({1, 200000}, numcy::Axis::Last, 20, 0.99995);
+    check_topk({1, 200000}, numcy::Axis::Last, 8, 0.3);
+
+    return NumcyTest::result("topk");
+}